@@ -17,8 +17,10 @@
 #include "IteratableMatrix.hpp"
 #include "ResizableMatrix.hpp"
 #include "FastCopy.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
 #include <type_traits>
-#include <map>
+#include <vector>
 
 namespace DGP {
 
@@ -26,6 +28,107 @@ namespace CompressedSparseMatrixInternal {
 
 struct Base {};
 
+/**
+ * Compute the compressed layout of a list of entries, given by their primary (\a index1) and secondary (\a index2) indices,
+ * which may repeat. The entries are bucketed by primary index, keeping their order within each bucket, and each bucket is
+ * sorted by secondary index in parallel. Repeated (primary, secondary) pairs share a slot of the compressed arrays.
+ *
+ * @param size1 The number of primary indices.
+ * @param num_entries The number of entries.
+ * @param index1 The primary index of each entry.
+ * @param index2 The secondary index of each entry.
+ * @param indices1 Used to return the position of the first slot of each primary index, and one past the last slot.
+ * @param indices2 Used to return the secondary index of each slot.
+ * @param order Used to return the entries grouped by slot, in slot order, and in their original order within a slot.
+ * @param slot_start Used to return the position in \a order of the first entry of each slot, and one past the last entry.
+ * @param pool Threads to use.
+ */
+template <typename Index2D, typename Index1D>
+void
+compressPattern(long size1, long num_entries, long const * index1, long const * index2, std::vector<Index1D> & indices1,
+                std::vector<Index2D> & indices2, std::vector<long> & order, std::vector<long> & slot_start, ThreadPool & pool)
+{
+  // Bucket the entries by primary index
+  std::vector<long> bucket_start((size_t)size1 + 1, 0);
+  for (long e = 0; e < num_entries; ++e)
+  {
+    alwaysAssertM(index1[e] >= 0 && index1[e] < size1, "CompressedSparseMatrix: Primary index out of range");
+    bucket_start[(size_t)index1[e] + 1]++;
+  }
+
+  for (long i = 0; i < size1; ++i)
+    bucket_start[(size_t)i + 1] += bucket_start[(size_t)i];
+
+  order.resize((size_t)num_entries);
+  {
+    std::vector<long> next(bucket_start.begin(), bucket_start.end() - 1);
+    for (long e = 0; e < num_entries; ++e)
+      order[(size_t)next[(size_t)index1[e]]++] = e;
+  }
+
+  // Sort each bucket by secondary index, breaking ties by position in the input, and count the slots
+  indices1.resize((size_t)size1 + 1);
+  indices1[0] = 0;
+  pool.parallelFor(0, size1, [&](long lo, long hi, long) {
+    for (long i = lo; i < hi; ++i)
+    {
+      long * begin = order.data() + bucket_start[(size_t)i], * end = order.data() + bucket_start[(size_t)i + 1];
+      std::sort(begin, end, [&](long a, long b) { return index2[a] < index2[b] || (index2[a] == index2[b] && a < b); });
+
+      long num_slots = 0;
+      for (long const * k = begin; k != end; ++k)
+        if (k == begin || index2[*k] != index2[*(k - 1)])
+          num_slots++;
+
+      indices1[(size_t)i + 1] = static_cast<Index1D>(num_slots);
+    }
+  });
+
+  for (long i = 0; i < size1; ++i)
+    indices1[(size_t)i + 1] += indices1[(size_t)i];
+
+  // Write the slots
+  long num_slots = (long)indices1[(size_t)size1];
+  indices2.resize((size_t)num_slots);
+  slot_start.resize((size_t)num_slots + 1);
+  slot_start[(size_t)num_slots] = num_entries;
+  pool.parallelFor(0, size1, [&](long lo, long hi, long) {
+    for (long i = lo; i < hi; ++i)
+    {
+      size_t s = (size_t)indices1[(size_t)i];
+      for (long k = bucket_start[(size_t)i]; k < bucket_start[(size_t)i + 1]; ++k)
+        if (k == bucket_start[(size_t)i] || index2[order[(size_t)k]] != index2[order[(size_t)k - 1]])
+        {
+          indices2[s] = static_cast<Index2D>(index2[order[(size_t)k]]);
+          slot_start[s++] = k;
+        }
+    }
+  });
+}
+
+/**
+ * Set the value of each slot computed by compressPattern() to the sum of the values of its entries, in their original order,
+ * so the result does not depend on the number of threads.
+ */
+template <typename T, typename S>
+void
+sumSlots(std::vector<long> const & order, std::vector<long> const & slot_start, S const * entry_values, std::vector<T> & values,
+         ThreadPool & pool)
+{
+  long num_slots = (long)slot_start.size() - 1;
+  values.resize((size_t)num_slots);
+  pool.parallelFor(0, num_slots, [&](long lo, long hi, long) {
+    for (long s = lo; s < hi; ++s)
+    {
+      T sum = static_cast<T>(0);
+      for (long k = slot_start[(size_t)s]; k < slot_start[(size_t)s + 1]; ++k)
+        sum += static_cast<T>(entry_values[order[(size_t)k]]);
+
+      values[(size_t)s] = sum;
+    }
+  });
+}
+
 } // namespace CompressedSparseMatrixInternal
 
 /**
@@ -219,7 +322,7 @@ class /* DGP_API */ CompressedSparseMatrix : public virtual IteratableMatrix<T>,
       fastCopy(src.values.begin(), src.values.end(), values.begin());
     }
 
-    /** Initialize from an iteratable matrix. */
+    /** Initialize from an iteratable matrix. Elements visited more than once by its iterator are summed. */
     template <typename MatrixT> explicit
     CompressedSparseMatrix(MatrixT const & src,
                            typename std::enable_if< std::is_base_of< IteratableMatrix<typename MatrixT::Value>,
@@ -236,46 +339,27 @@ class /* DGP_API */ CompressedSparseMatrix : public virtual IteratableMatrix<T>,
         size2 = src.numRows();
       }
 
-      typedef std::map<typename MatrixT::IndexPair, typename MatrixT::Value> EntryMap;
-      EntryMap src_entries;
-
+      // Collect the set elements as entries, which are bucketed by primary index instead of being sorted as a whole
+      std::vector<long> index1, index2;
+      std::vector<typename MatrixT::Value> entry_values;
       for (typename MatrixT::ConstIterator si = src.begin(); si != src.end(); ++si)
       {
         if (si->second != 0)
         {
-          typename MatrixT::IndexPair indices =
-              (L == MatrixLayout::ROW_MAJOR ? si->first : typename MatrixT::IndexPair(si->first.second, si->first.first));
-
-          src_entries[indices] = si->second;
-        }
-      }
-
-      indices1.resize(size1 + 1);
-      std::fill(indices1.begin(), indices1.end(), 0);
-
-      indices2.resize((size_t)src_entries.size());
-      values.resize((size_t)src_entries.size());
-
-      // Now read back the values in lexicographic order
-      long i, last_index1 = -1;
-      size_t curr_pos = 0;
-      for (typename EntryMap::const_iterator ei = src_entries.begin(); ei != src_entries.end(); ++ei, ++curr_pos)
-      {
-        i = (long)ei->first.first;
-        if (i != last_index1)  // change of primary index since last iteration
-        {
-          for (long k = last_index1 + 1; k <= i; ++k)
-            indices1[(size_t)k] = static_cast<Index1D>(curr_pos);
-
-          last_index1 = i;
+          bool row_major = (L == MatrixLayout::ROW_MAJOR);
+          index1.push_back((long)(row_major ? si->first.first : si->first.second));
+          index2.push_back((long)(row_major ? si->first.second : si->first.first));
+          entry_values.push_back(si->second);
         }
-
-        indices2[curr_pos] = static_cast<Index2D>(ei->first.second);
-        values  [curr_pos] = static_cast<T>(ei->second);
       }
 
-      // One beyond last position, stores number of non-zeros
-      indices1[(size_t)size1] = curr_pos;
+      std::vector<long> order, slot_start;
+      long num_entries = (long)entry_values.size();
+      CompressedSparseMatrixInternal::compressPattern(size1, num_entries, (num_entries > 0 ? &index1[0] : NULL),
+                                                      (num_entries > 0 ? &index2[0] : NULL), indices1, indices2, order,
+                                                      slot_start, ThreadPool::common());
+      CompressedSparseMatrixInternal::sumSlots(order, slot_start, (num_entries > 0 ? &entry_values[0] : NULL), values,
+                                               ThreadPool::common());
     }
 
     /** Resizes the matrix to the specified dimensions. All existing data is discarded and the matrix is set to zero. */
@@ -355,6 +439,39 @@ class /* DGP_API */ CompressedRowMatrix : public CompressedSparseMatrix<T, Matri
       }
     }
 
+    /**
+     * Multiply several vectors by rows [\a begin, \a end) of this matrix. The vectors are interleaved: element \a i of vector
+     * \a k is at <tt>v[i * num_vectors + k]</tt>, and likewise for the results, of which only rows [\a begin, \a end) are
+     * written. Each entry of the matrix is read once for all the vectors, so when the product is limited by memory bandwidth,
+     * as it usually is, a few vectors cost little more than one.
+     *
+     * @param begin The first row.
+     * @param end One past the last row.
+     * @param num_vectors The number of vectors, at least 1.
+     * @param v The interleaved vectors to be multiplied, with numColumns() * \a num_vectors elements.
+     * @param result The interleaved results, preallocated to numRows() * \a num_vectors elements.
+     */
+    template <typename U> void postmulVectors(long begin, long end, long num_vectors, U const * v, U * result) const
+    {
+      switch (num_vectors)
+      {
+        // Fixed counts let the compiler keep the sums in registers
+        case 1:  postmulRows<1>(begin, end, 1, v, result); break;
+        case 3:  postmulRows<3>(begin, end, 3, v, result); break;
+        default: postmulRows<0>(begin, end, num_vectors, v, result);
+      }
+    }
+
+    /**
+     * Multiply several interleaved vectors by this matrix, in parallel over blocks of rows (see
+     * postmulVectors(long, long, long, U const *, U *) const). Every row is computed in the same order whatever the number of
+     * threads, so the result does not depend on it.
+     */
+    template <typename U> void postmulVectors(long num_vectors, U const * v, U * result, ThreadPool & pool) const
+    {
+      pool.parallelFor(0, BaseT::size1, [&](long lo, long hi, long) { postmulVectors(lo, hi, num_vectors, v, result); });
+    }
+
     /**
      * Utility function for efficiently computing  a matrix-vector product (w = M * v). This lets this matrix be passed directly
      * to ARPACK++. The implementation simply calls postmulVector().
@@ -363,6 +480,27 @@ class /* DGP_API */ CompressedRowMatrix : public CompressedSparseMatrix<T, Matri
      */
     template <typename U> void MultMv(U const * v, U * w) const { postmulVector(v, w); }
 
+  private:
+    /** Multiply interleaved vectors by a range of rows. If \a K is positive, it is the number of vectors. */
+    template <long K, typename U> void postmulRows(long begin, long end, long num_vectors, U const * v, U * result) const
+    {
+      long const k = (K > 0 ? K : num_vectors);
+      for (long row = begin; row < end; ++row)
+      {
+        U * rp = result + row * k;
+        for (long j = 0; j < k; ++j)
+          rp[j] = static_cast<U>(0);
+
+        for (size_t e = (size_t)BaseT::indices1[row], e_end = (size_t)BaseT::indices1[row + 1]; e < e_end; ++e)
+        {
+          U a = static_cast<U>(BaseT::values[e]);
+          U const * vp = v + (long)BaseT::indices2[e] * k;
+          for (long j = 0; j < k; ++j)
+            rp[j] += a * vp[j];
+        }
+      }
+    }
+
 }; // class CompressedRowMatrix
 
 /** Column-major sparse matrix. Non-zero values are packed contiguously column-by-column. */
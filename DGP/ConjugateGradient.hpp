@@ -0,0 +1,280 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#ifndef __DGP_ConjugateGradient_hpp__
+#define __DGP_ConjugateGradient_hpp__
+
+#include "Common.hpp"
+#include "CompressedSparseMatrix.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace DGP {
+
+/**
+ * Preconditioned conjugate gradient solver for sparse symmetric positive definite systems <tt>A X = B</tt>, where A is a
+ * CompressedRowMatrix and X and B have one or more columns, such as the three coordinates of the vertices of a mesh. The
+ * columns are solved together, each with its own step lengths, so every iteration reads the matrix once for all of them (see
+ * CompressedRowMatrix::postmulVectors()). The preconditioner is the inverse of the diagonal of A (Jacobi).
+ *
+ * The matrix product and the vector updates run in parallel over fixed blocks of rows, and dot products are summed block by
+ * block in a fixed order, so the result does not depend on the number of threads.
+ */
+class ConjugateGradient
+{
+  public:
+    /** %Options controlling solve(). */
+    struct Options
+    {
+      long max_iterations;      ///< Maximum number of iterations (default 1000).
+      double tolerance;         /**< A column has converged once the norm of its residual <tt>B - A X</tt> is at most this
+                                     fraction of the norm of its right-hand side (default 1e-6). */
+      ThreadPool * thread_pool; ///< Threads to use (default null, indicating ThreadPool::common()).
+
+      /** Constructor. */
+      Options() : max_iterations(1000), tolerance(1e-6), thread_pool(NULL) {}
+
+      /** Get the default set of options. */
+      static Options const & defaults() { static Options const def; return def; }
+
+    }; // struct Options
+
+    /** Result of solve(). */
+    struct Result
+    {
+      long num_iterations;      ///< Number of iterations run.
+      double max_residual;      ///< Largest relative residual norm of any column when it stopped, as estimated by the iterations.
+      bool converged;           ///< True if every column reached the tolerance.
+
+      /** Constructor. */
+      Result() : num_iterations(0), max_residual(0), converged(false) {}
+
+    }; // struct Result
+
+    /**
+     * Solve <tt>A X = B</tt>, starting from the values in \a x. X and B are interleaved: element \a i of column \a k is at
+     * <tt>x[i * num_columns + k]</tt>. A column whose right-hand side is zero gets the solution zero.
+     *
+     * @param a The matrix, which must be square, symmetric and positive definite.
+     * @param num_columns The number of columns of X and B.
+     * @param b The right-hand sides.
+     * @param x The initial guess, and used to return the solution.
+     * @param options Options controlling the solver.
+     */
+    template <typename T, typename Index2DT, typename Index1DT, typename U>
+    static Result solve(CompressedRowMatrix<T, Index2DT, Index1DT> const & a, long num_columns, U const * b, U * x,
+                        Options const & options = Options::defaults())
+    {
+      alwaysAssertM(a.numRows() == a.numColumns(), "ConjugateGradient: Matrix must be square");
+      alwaysAssertM(num_columns >= 1, "ConjugateGradient: Need at least one column");
+
+      ThreadPool & pool = (options.thread_pool ? *options.thread_pool : ThreadPool::common());
+      long const n = a.numRows(), k = num_columns;
+      long const num_blocks = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+      std::vector<Index1DT> const & row_start = a.getRowIndices();
+      std::vector<Index2DT> const & cols = a.getColumnIndices();
+      std::vector<T> const & values = a.getValues();
+
+      // Inverse diagonal, falling back to 1 for rows without a positive diagonal entry
+      std::vector<U> inv_diag((size_t)n);
+      pool.parallelFor(0, n, [&](long lo, long hi, long) {
+        for (long i = lo; i < hi; ++i)
+        {
+          U d = 0;
+          for (size_t e = (size_t)row_start[(size_t)i]; e < (size_t)row_start[(size_t)i + 1]; ++e)
+            if ((long)cols[e] == i) { d = static_cast<U>(values[e]); break; }
+
+          inv_diag[(size_t)i] = (d > 0 ? 1 / d : 1);
+        }
+      });
+
+      std::vector<U> r((size_t)(n * k)), z((size_t)(n * k)), p((size_t)(n * k)), q((size_t)(n * k));
+      std::vector<double> partials((size_t)(num_blocks * k * NUM_SUMS));  // sums per column per block
+      std::vector<double> b_norm((size_t)k), rz((size_t)k), alpha((size_t)k), beta((size_t)k);
+      std::vector<char> active((size_t)k, 1);
+
+      // Sum the partials of up to NUM_SUMS quantities (per column) over the blocks, in block order. The sums go to the
+      // non-null outputs.
+      auto reduce = [&](std::vector<double> * sum0, std::vector<double> * sum1, std::vector<double> * sum2) {
+        std::vector<double> * sums[NUM_SUMS] = { sum0, sum1, sum2 };
+        for (long s = 0; s < NUM_SUMS; ++s)
+        {
+          if (!sums[s]) continue;
+
+          for (long j = 0; j < k; ++j)
+          {
+            double sum = 0;
+            for (long blk = 0; blk < num_blocks; ++blk)
+              sum += partials[(size_t)((blk * k + j) * NUM_SUMS + s)];
+
+            (*sums[s])[(size_t)j] = sum;
+          }
+        }
+      };
+
+      // r = b - A x, z = M^-1 r, p = z, with the products b.b, r.z and r.r
+      pool.parallelFor(0, num_blocks, [&](long lo, long hi, long) {
+        for (long blk = lo; blk < hi; ++blk)
+        {
+          long begin = blk * BLOCK_SIZE, end = std::min(begin + BLOCK_SIZE, n);
+          a.postmulVectors(begin, end, k, x, &q[0]);
+
+          double * part = &partials[(size_t)(blk * k * NUM_SUMS)];
+          std::fill(part, part + NUM_SUMS * k, 0.0);
+          for (long i = begin; i < end; ++i)
+            for (long j = 0; j < k; ++j)
+            {
+              size_t m = (size_t)(i * k + j);
+              r[m] = b[m] - q[m];
+              z[m] = inv_diag[(size_t)i] * r[m];
+              p[m] = z[m];
+              part[NUM_SUMS * j]     += (double)b[m] * b[m];
+              part[NUM_SUMS * j + 1] += (double)r[m] * z[m];
+              part[NUM_SUMS * j + 2] += (double)r[m] * r[m];
+            }
+        }
+      }, 1);
+
+      std::vector<double> pq((size_t)k), rr((size_t)k), rz_new((size_t)k);
+      std::vector<double> residuals((size_t)k, 0.0);  // last relative residual of each column
+      reduce(&b_norm, &rz, &rr);
+
+      Result result;
+      result.converged = true;
+      for (long j = 0; j < k; ++j)
+      {
+        b_norm[(size_t)j] = std::sqrt(b_norm[(size_t)j]);
+        if (b_norm[(size_t)j] <= 0)
+        {
+          // The solution is zero
+          for (long i = 0; i < n; ++i)
+            x[i * k + j] = p[(size_t)(i * k + j)] = 0;
+
+          active[(size_t)j] = 0;
+          continue;
+        }
+
+        double residual = std::sqrt(rr[(size_t)j]) / b_norm[(size_t)j];
+        residuals[(size_t)j] = residual;
+        if (residual <= options.tolerance || !(rz[(size_t)j] > 0))
+        {
+          for (long i = 0; i < n; ++i)
+            p[(size_t)(i * k + j)] = 0;
+
+          active[(size_t)j] = 0;
+          if (!(residual <= options.tolerance))
+            result.converged = false;
+        }
+      }
+
+      while (std::find(active.begin(), active.end(), 1) != active.end())
+      {
+        if (result.num_iterations >= options.max_iterations)
+        {
+          result.converged = false;
+          break;
+        }
+
+        result.num_iterations++;
+
+        // q = A p, with the products p.q
+        pool.parallelFor(0, num_blocks, [&](long lo, long hi, long) {
+          for (long blk = lo; blk < hi; ++blk)
+          {
+            long begin = blk * BLOCK_SIZE, end = std::min(begin + BLOCK_SIZE, n);
+            a.postmulVectors(begin, end, k, &p[0], &q[0]);
+
+            double * part = &partials[(size_t)(blk * k * NUM_SUMS)];
+            std::fill(part, part + NUM_SUMS * k, 0.0);
+            for (long i = begin; i < end; ++i)
+              for (long j = 0; j < k; ++j)
+                part[NUM_SUMS * j] += (double)p[(size_t)(i * k + j)] * q[(size_t)(i * k + j)];
+          }
+        }, 1);
+
+        reduce(&pq, NULL, NULL);
+        for (long j = 0; j < k; ++j)
+          alpha[(size_t)j] = (active[(size_t)j] && pq[(size_t)j] > 0 ? rz[(size_t)j] / pq[(size_t)j] : 0);
+
+        // x += alpha p, r -= alpha q, z = M^-1 r, with the products r.r and r.z
+        pool.parallelFor(0, num_blocks, [&](long lo, long hi, long) {
+          for (long blk = lo; blk < hi; ++blk)
+          {
+            long begin = blk * BLOCK_SIZE, end = std::min(begin + BLOCK_SIZE, n);
+            double * part = &partials[(size_t)(blk * k * NUM_SUMS)];
+            std::fill(part, part + NUM_SUMS * k, 0.0);
+            for (long i = begin; i < end; ++i)
+              for (long j = 0; j < k; ++j)
+              {
+                size_t m = (size_t)(i * k + j);
+                U s = static_cast<U>(alpha[(size_t)j]);
+                x[m] += s * p[m];
+                r[m] -= s * q[m];
+                z[m] = inv_diag[(size_t)i] * r[m];
+                part[NUM_SUMS * j]     += (double)r[m] * r[m];
+                part[NUM_SUMS * j + 1] += (double)r[m] * z[m];
+              }
+          }
+        }, 1);
+
+        reduce(&rr, &rz_new, NULL);
+
+        for (long j = 0; j < k; ++j)
+        {
+          if (!active[(size_t)j]) { beta[(size_t)j] = 0; continue; }
+
+          double residual = std::sqrt(rr[(size_t)j]) / b_norm[(size_t)j];
+          residuals[(size_t)j] = residual;
+
+          // A column that has converged, or broken down, stops moving: its search direction is zeroed
+          if (residual <= options.tolerance || !(pq[(size_t)j] > 0) || !(rz[(size_t)j] > 0))
+          {
+            active[(size_t)j] = 0;
+            beta[(size_t)j] = 0;
+            if (!(residual <= options.tolerance))
+              result.converged = false;
+          }
+          else
+            beta[(size_t)j] = rz_new[(size_t)j] / rz[(size_t)j];
+
+          rz[(size_t)j] = rz_new[(size_t)j];
+        }
+
+        // p = z + beta p, for the columns still moving
+        pool.parallelFor(0, n, [&](long lo, long hi, long) {
+          for (long i = lo; i < hi; ++i)
+            for (long j = 0; j < k; ++j)
+            {
+              size_t m = (size_t)(i * k + j);
+              p[m] = (active[(size_t)j] ? z[m] + static_cast<U>(beta[(size_t)j]) * p[m] : 0);
+            }
+        });
+      }
+
+      result.max_residual = *std::max_element(residuals.begin(), residuals.end());
+      return result;
+    }
+
+  private:
+    /** Number of rows in each block of the parallel loops. Blocks are the same whatever the number of threads. */
+    static long const BLOCK_SIZE = 2048;
+
+    /** Number of dot products per column accumulated in one pass over the blocks. */
+    static long const NUM_SUMS = 3;
+
+}; // class ConjugateGradient
+
+} // namespace DGP
+
+#endif
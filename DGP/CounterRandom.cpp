@@ -0,0 +1,249 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#include "CounterRandom.hpp"
+#include <algorithm>
+
+#if (defined(DGP_X64) || defined(DGP_X86)) && defined(__GNUC__)
+#  define DGP_COUNTER_RANDOM_X86 1
+#  include <immintrin.h>
+#endif
+
+namespace DGP {
+
+namespace CounterRandomInternal {
+
+// Number of words converted to reals at a time by the bulk fills. Must be even.
+static long const CHUNK_SIZE = 512;
+
+// Compute a run of blocks from SoA arrays of their initial counter words, one lane per block, and write them out in order. The
+// rounds are those of CounterRandom::block(), each step applied to all lanes.
+template <int LANES> void
+philoxLanes(uint64 seed, uint32 c0[LANES], uint32 c1[LANES], uint32 c2[LANES], uint32 c3[LANES], uint32 * out)
+{
+  uint32 k0 = (uint32)seed, k1 = (uint32)(seed >> 32);
+  for (int round = 0; round < 10; ++round)
+  {
+    for (int i = 0; i < LANES; ++i)
+    {
+      uint64 p0 = (uint64)0xD2511F53U * c0[i];
+      uint64 p1 = (uint64)0xCD9E8D57U * c2[i];
+      uint32 n0 = (uint32)(p1 >> 32) ^ c1[i] ^ k0;
+      uint32 n2 = (uint32)(p0 >> 32) ^ c3[i] ^ k1;
+      c0[i] = n0; c1[i] = (uint32)p1; c2[i] = n2; c3[i] = (uint32)p0;
+    }
+
+    k0 += 0x9E3779B9U;
+    k1 += 0xBB67AE85U;
+  }
+
+  for (int i = 0; i < LANES; ++i)
+  {
+    out[4 * i    ] = c0[i];
+    out[4 * i + 1] = c1[i];
+    out[4 * i + 2] = c2[i];
+    out[4 * i + 3] = c3[i];
+  }
+}
+
+#ifdef DGP_COUNTER_RANDOM_X86
+
+// Multiply eight 32-bit words by a constant, returning the high and low halves of the 64-bit products. The widening multiply
+// takes the even words, so the odd words are shifted down and multiplied separately.
+__attribute__((target("avx2"))) inline void
+mulHiLoAVX2(__m256i a, __m256i m, __m256i & hi, __m256i & lo)
+{
+  __m256i even = _mm256_mul_epu32(a, m);
+  __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+  hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+  lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+}
+
+// The same as philoxLanes<16>(), with two vectors per counter word, which are independent so the latency of one multiply is
+// hidden behind the other.
+__attribute__((target("avx2"))) void
+philoxLanesAVX2(uint64 seed, uint32 c0[16], uint32 c1[16], uint32 c2[16], uint32 c3[16], uint32 * out)
+{
+  __m256i const M0 = _mm256_set1_epi32((int32)0xD2511F53U);
+  __m256i const M1 = _mm256_set1_epi32((int32)0xCD9E8D57U);
+  __m256i x0[2], x1[2], x2[2], x3[2];
+  for (int h = 0; h < 2; ++h)
+  {
+    x0[h] = _mm256_loadu_si256((__m256i const *)(c0 + 8 * h));
+    x1[h] = _mm256_loadu_si256((__m256i const *)(c1 + 8 * h));
+    x2[h] = _mm256_loadu_si256((__m256i const *)(c2 + 8 * h));
+    x3[h] = _mm256_loadu_si256((__m256i const *)(c3 + 8 * h));
+  }
+
+  uint32 k0 = (uint32)seed, k1 = (uint32)(seed >> 32);
+  for (int round = 0; round < 10; ++round)
+  {
+    __m256i key0 = _mm256_set1_epi32((int32)k0), key1 = _mm256_set1_epi32((int32)k1);
+    for (int h = 0; h < 2; ++h)
+    {
+      __m256i hi0, lo0, hi1, lo1;
+      mulHiLoAVX2(x0[h], M0, hi0, lo0);
+      mulHiLoAVX2(x2[h], M1, hi1, lo1);
+      x0[h] = _mm256_xor_si256(_mm256_xor_si256(hi1, x1[h]), key0);
+      x2[h] = _mm256_xor_si256(_mm256_xor_si256(hi0, x3[h]), key1);
+      x1[h] = lo1;
+      x3[h] = lo0;
+    }
+
+    k0 += 0x9E3779B9U;
+    k1 += 0xBB67AE85U;
+  }
+
+  // Interleave the words of each block: transpose 4x4 blocks of words within each 128-bit half, then write the halves out
+  for (int h = 0; h < 2; ++h)
+  {
+    __m256i t0 = _mm256_unpacklo_epi32(x0[h], x1[h]);  // c0 c1 of blocks 0 1 | 4 5
+    __m256i t1 = _mm256_unpackhi_epi32(x0[h], x1[h]);  // c0 c1 of blocks 2 3 | 6 7
+    __m256i t2 = _mm256_unpacklo_epi32(x2[h], x3[h]);  // c2 c3 of blocks 0 1 | 4 5
+    __m256i t3 = _mm256_unpackhi_epi32(x2[h], x3[h]);  // c2 c3 of blocks 2 3 | 6 7
+    __m256i b01 = _mm256_unpacklo_epi64(t0, t2);       // blocks 0 | 4
+    __m256i b11 = _mm256_unpackhi_epi64(t0, t2);       // blocks 1 | 5
+    __m256i b21 = _mm256_unpacklo_epi64(t1, t3);       // blocks 2 | 6
+    __m256i b31 = _mm256_unpackhi_epi64(t1, t3);       // blocks 3 | 7
+
+    uint32 * o = out + 32 * h;
+    _mm256_storeu_si256((__m256i *)(o     ), _mm256_permute2x128_si256(b01, b11, 0x20));  // blocks 0 1
+    _mm256_storeu_si256((__m256i *)(o +  8), _mm256_permute2x128_si256(b21, b31, 0x20));  // blocks 2 3
+    _mm256_storeu_si256((__m256i *)(o + 16), _mm256_permute2x128_si256(b01, b11, 0x31));  // blocks 4 5
+    _mm256_storeu_si256((__m256i *)(o + 24), _mm256_permute2x128_si256(b21, b31, 0x31));  // blocks 6 7
+  }
+}
+
+#endif // DGP_COUNTER_RANDOM_X86
+
+} // namespace CounterRandomInternal
+
+CounterRandom::CounterRandom(uint64 seed_, uint64 stream_, uint64 counter_)
+: Random((void *)NULL), seed(seed_), stream(stream_), counter(counter_), next(4)
+{}
+
+uint32
+CounterRandom::bits()
+{
+  if (next >= 4)
+  {
+    block(seed, stream, counter++, words);
+    next = 0;
+  }
+
+  return words[next++];
+}
+
+Real
+CounterRandom::gaussian(Real mean, Real stddev)
+{
+  // One of each pair of normal numbers is discarded, so that every call consumes the same number of words
+  Real g0, g1;
+  uint32 w0 = bits();
+  toGaussians(w0, bits(), g0, g1);
+  return mean + stddev * g0;
+}
+
+void
+CounterRandom::fillBits(uint32 * out, long n)
+{
+  long i = 0;
+  while (i < n && next < 4)
+    out[i++] = words[next++];
+
+  long num_blocks = (n - i) / 4;
+  if (num_blocks > 0)
+  {
+    blocks(seed, stream, counter, num_blocks, out + i);
+    counter += (uint64)num_blocks;
+    i += 4 * num_blocks;
+  }
+
+  while (i < n)
+    out[i++] = bits();
+}
+
+void
+CounterRandom::fillUniform(Real lo, Real hi, Real * out, long n)
+{
+  using namespace CounterRandomInternal;
+
+  uint32 w[CHUNK_SIZE];
+  for (long i = 0; i < n; i += CHUNK_SIZE)
+  {
+    long m = std::min(CHUNK_SIZE, n - i);
+    fillBits(w, m);
+
+    // The same expression as Random::uniform(), so the results match calls to it exactly
+    for (long j = 0; j < m; ++j)
+      out[i + j] = lo + (hi - lo) * ((Real)w[j] / (Real)0xFFFFFFFFUL);
+  }
+}
+
+void
+CounterRandom::fillGaussian(Real mean, Real stddev, Real * out, long n)
+{
+  using namespace CounterRandomInternal;
+
+  uint32 w[CHUNK_SIZE];
+  for (long i = 0; i < n; i += CHUNK_SIZE)
+  {
+    long m = std::min(CHUNK_SIZE, n - i);
+    fillBits(w, (m + 1) & ~1L);
+
+    for (long j = 0; j < m; j += 2)
+    {
+      Real g0, g1;
+      toGaussians(w[j], w[j + 1], g0, g1);
+      out[i + j] = mean + stddev * g0;
+      if (j + 1 < m)
+        out[i + j + 1] = mean + stddev * g1;
+    }
+  }
+}
+
+void
+CounterRandom::blocks(uint64 seed, uint64 stream, uint64 counter, long num_blocks, uint32 * out)
+{
+  using namespace CounterRandomInternal;
+
+  enum { LANES = 16 };
+
+#ifdef DGP_COUNTER_RANDOM_X86
+  static bool const has_avx2 = []() { __builtin_cpu_init(); return (bool)__builtin_cpu_supports("avx2"); }();
+#endif
+
+  long b = 0;
+  for ( ; b + LANES <= num_blocks; b += LANES)
+  {
+    uint32 c0[LANES], c1[LANES], c2[LANES], c3[LANES];
+    for (int i = 0; i < LANES; ++i)
+    {
+      uint64 ctr = counter + (uint64)(b + i);
+      c0[i] = (uint32)ctr; c1[i] = (uint32)(ctr >> 32); c2[i] = (uint32)stream; c3[i] = (uint32)(stream >> 32);
+    }
+
+#ifdef DGP_COUNTER_RANDOM_X86
+    if (has_avx2)
+    {
+      philoxLanesAVX2(seed, c0, c1, c2, c3, out + 4 * b);
+      continue;
+    }
+#endif
+
+    philoxLanes<LANES>(seed, c0, c1, c2, c3, out + 4 * b);
+  }
+
+  for ( ; b < num_blocks; ++b)
+    block(seed, stream, counter + (uint64)b, out + 4 * b);
+}
+
+} // namespace DGP
@@ -0,0 +1,139 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#ifndef __DGP_CounterRandom_hpp__
+#define __DGP_CounterRandom_hpp__
+
+#include "Common.hpp"
+#include "Random.hpp"
+
+namespace DGP {
+
+/**
+ * Counter-based random number generator. Each block of four random 32-bit words is a pure function of a 64-bit seed, a 64-bit
+ * stream index and a 64-bit counter, computed with the Philox4x32-10 bijection. So any number can be regenerated on demand
+ * without generating the ones before it, and work split across threads by stream (for instance one stream per mesh vertex)
+ * gives exactly the same numbers however it is scheduled.
+ *
+ * The static functions are the stateless interface. An instance is a Random that reads consecutive blocks of one stream, so
+ * all the distributions of Random are available. Instances have no shared state and need no lock, but an instance must not be
+ * used by several threads at once; give each thread its own instance (see RandomStreams), or its own stream.
+ *
+ * @cite Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", Proc. SC 2011.
+ */
+class DGP_API CounterRandom : public Random
+{
+  public:
+    /**
+     * Constructor.
+     *
+     * @param seed The key of the generator.
+     * @param stream The index of the stream to read. Different streams are statistically independent.
+     * @param counter The index of the first block to read.
+     */
+    CounterRandom(uint64 seed = 0, uint64 stream = 0, uint64 counter = 0);
+
+    /** Get the seed. */
+    uint64 getSeed() const { return seed; }
+
+    /** Get the index of the stream being read. */
+    uint64 getStream() const { return stream; }
+
+    /** Get the index of the next block of the stream to be computed. */
+    uint64 getCounter() const { return counter; }
+
+    /** Start reading another stream, from a given block. */
+    void setStream(uint64 stream_, uint64 counter_ = 0) { stream = stream_; seek(counter_); }
+
+    /** Skip forwards or backwards to a given block of the current stream, in constant time. */
+    void seek(uint64 counter_) { counter = counter_; next = 4; }
+
+    uint32 bits();
+
+    /** Generate normally distributed real numbers, with the given mean and standard deviation. */
+    Real gaussian(Real mean, Real stddev);
+
+    /** Fill an array with uniform random real numbers, computing whole blocks of the stream at a time (see blocks()). */
+    void fillUniform(Real lo, Real hi, Real * out, long n);
+
+    /**
+     * Fill an array with normally distributed real numbers, computing whole blocks of the stream at a time (see blocks()). Each
+     * number consumes one word of the stream, rounded up to a whole pair.
+     */
+    void fillGaussian(Real mean, Real stddev, Real * out, long n);
+
+    /**
+     * Compute a block of four random words, as a function of a seed, a stream index and a counter, with Philox4x32-10.
+     *
+     * @param seed The key of the generator.
+     * @param stream The stream index, forming the upper half of the 128-bit counter.
+     * @param counter The counter within the stream, forming the lower half of the 128-bit counter.
+     * @param out Used to return the four words.
+     */
+    static void block(uint64 seed, uint64 stream, uint64 counter, uint32 out[4])
+    {
+      uint32 k0 = (uint32)seed, k1 = (uint32)(seed >> 32);
+      uint32 c0 = (uint32)counter, c1 = (uint32)(counter >> 32), c2 = (uint32)stream, c3 = (uint32)(stream >> 32);
+
+      for (int round = 0; round < 10; ++round)
+      {
+        uint64 p0 = (uint64)0xD2511F53U * c0;
+        uint64 p1 = (uint64)0xCD9E8D57U * c2;
+        uint32 n0 = (uint32)(p1 >> 32) ^ c1 ^ k0;
+        uint32 n2 = (uint32)(p0 >> 32) ^ c3 ^ k1;
+        c0 = n0; c1 = (uint32)p1; c2 = n2; c3 = (uint32)p0;
+
+        k0 += 0x9E3779B9U;  // Weyl sequence bumps of the key
+        k1 += 0xBB67AE85U;
+      }
+
+      out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+    }
+
+    /**
+     * Compute consecutive blocks of a stream, the same as calls to block() for counters <tt>counter</tt>,
+     * <tt>counter + 1</tt>... but several blocks at a time, side by side in vector registers.
+     *
+     * @param seed The key of the generator.
+     * @param stream The stream index.
+     * @param counter The counter of the first block.
+     * @param num_blocks The number of blocks to compute.
+     * @param out Used to return the blocks. Must have space for 4 * \a num_blocks words.
+     */
+    static void blocks(uint64 seed, uint64 stream, uint64 counter, long num_blocks, uint32 * out);
+
+    /**
+     * Get four independent standard normal numbers that are a function of a seed, a stream index and a counter (one block,
+     * see block()).
+     */
+    static void gaussians(uint64 seed, uint64 stream, uint64 counter, Real out[4])
+    {
+      uint32 words[4];
+      block(seed, stream, counter, words);
+      toGaussians(words[0], words[1], out[0], out[1]);
+      toGaussians(words[2], words[3], out[2], out[3]);
+    }
+
+  private:
+    /** Read the next \a n words of the stream, taking whole blocks straight from blocks(). */
+    void fillBits(uint32 * out, long n);
+
+    uint64 seed;       ///< The key of the generator.
+    uint64 stream;     ///< The stream being read.
+    uint64 counter;    ///< The next block to compute.
+    uint32 words[4];   ///< The current block.
+    int next;          ///< The next word of the current block to return, or 4 if the block is used up.
+
+}; // class CounterRandom
+
+} // namespace DGP
+
+#endif
@@ -62,12 +62,41 @@ static uint32 crc32_tab[] =
   0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
 };
 
+// Tables for processing 8 bytes per step ("slicing-by-8"). Table k gives the CRC contribution of a byte followed by k zero
+// bytes, so the contributions of 8 consecutive bytes can be looked up independently and combined.
+struct Crc32SliceTables
+{
+  uint32 tab[8][256];
+
+  Crc32SliceTables()
+  {
+    for (int i = 0; i < 256; ++i)
+      tab[0][i] = crc32_tab[i];
+
+    for (int k = 1; k < 8; ++k)
+      for (int i = 0; i < 256; ++i)
+        tab[k][i] = (tab[k - 1][i] >> 8) ^ crc32_tab[tab[k - 1][i] & 0xFF];
+  }
+};
+
 uint32
 base_crc32(uint32 crc, void const * buf, size_t size)
 {
+  static Crc32SliceTables const slice;
+  uint32 const (*t)[256] = slice.tab;
+
   uint8 const * p = (uint8 const *)buf;
   crc = crc ^ ~0U;
 
+  // Bytes are assembled explicitly, so the result does not depend on the endianness of the host
+  for ( ; size >= 8; size -= 8, p += 8)
+  {
+    uint32 lo = crc ^ ((uint32)p[0] | ((uint32)p[1] << 8) | ((uint32)p[2] << 16) | ((uint32)p[3] << 24));
+    uint32 hi = (uint32)p[4] | ((uint32)p[5] << 8) | ((uint32)p[6] << 16) | ((uint32)p[7] << 24);
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+        ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+  }
+
   while (size--)
     crc = crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
 
@@ -0,0 +1,257 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#include "GaussianWeights.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#if (defined(DGP_X64) || defined(DGP_X86)) && defined(__GNUC__)
+#  define DGP_GAUSSIAN_WEIGHTS_X86 1
+   // Some AVX-512 intrinsics in GCC 12 start from a deliberately uninitialized vector, which triggers a spurious warning
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#  include <immintrin.h>
+#  pragma GCC diagnostic pop
+#endif
+
+namespace DGP {
+
+namespace GaussianWeightsInternal {
+
+// The exponential is computed as in the Cephes library: x = k ln(2) + r with |r| <= ln(2) / 2, and exp(x) = 2^k exp(r), where
+// exp(r) is a degree 7 polynomial. ln(2) is split into a part exact in a few bits and a small correction, so k ln(2) is
+// subtracted without losing precision.
+static float const EXP_MIN = -87.3365447504f;  // just above ln(smallest normalized float)
+static float const EXP_MAX = 88.3762626647949f;
+static float const LOG2E = 1.44269504088896341f;
+static float const LN2_HI = 0.693359375f;
+static float const LN2_LO = -2.12194440e-4f;
+static float const P0 = 1.9875691500e-4f;
+static float const P1 = 1.3981999507e-3f;
+static float const P2 = 8.3334519073e-3f;
+static float const P3 = 4.1665795894e-2f;
+static float const P4 = 1.6666665459e-1f;
+static float const P5 = 5.0000001201e-1f;
+
+static std::atomic<int> limit(GaussianWeights::InstructionSet::AVX512);
+
+inline float
+expScalar(float x)
+{
+  x = std::min(std::max(x, EXP_MIN), EXP_MAX);
+
+  // Round to the nearest integer without std::floor(), which is a library call without SSE4.1. If t is a negative integer, k is
+  // one less than its floor, which still leaves |r| <= ln(2) / 2.
+  float t = x * LOG2E + 0.5f;
+  float k = (float)((int32)t - (int32)(t < 0));
+
+  x = x - k * LN2_HI;
+  x = x - k * LN2_LO;
+
+  float y = ((((P0 * x + P1) * x + P2) * x + P3) * x + P4) * x + P5;
+  y = y * (x * x) + x + 1.0f;
+
+  int32 bits = ((int32)k + 127) << 23;
+  float scale;
+  std::memcpy(&scale, &bits, sizeof(scale));
+
+  return y * scale;
+}
+
+void
+evaluateScalar(long n, float const * sq_dist, float const * height, float a, float b, float * weights)
+{
+  if (height)
+  {
+    for (long i = 0; i < n; ++i)
+      weights[i] = expScalar(-(a * sq_dist[i] + b * (height[i] * height[i])));
+  }
+  else
+  {
+    for (long i = 0; i < n; ++i)
+      weights[i] = expScalar(-(a * sq_dist[i]));
+  }
+}
+
+#ifdef DGP_GAUSSIAN_WEIGHTS_X86
+
+__attribute__((target("avx2,fma"))) inline __m256
+expAVX2(__m256 x)
+{
+  x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_MIN)), _mm256_set1_ps(EXP_MAX));
+
+  __m256 k = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(LOG2E), _mm256_set1_ps(0.5f)));
+  x = _mm256_fnmadd_ps(k, _mm256_set1_ps(LN2_HI), x);
+  x = _mm256_fnmadd_ps(k, _mm256_set1_ps(LN2_LO), x);
+
+  __m256 y = _mm256_set1_ps(P0);
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(P1));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(P2));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(P3));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(P4));
+  y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(P5));
+  y = _mm256_add_ps(_mm256_fmadd_ps(y, _mm256_mul_ps(x, x), x), _mm256_set1_ps(1.0f));
+
+  __m256i bits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(k), _mm256_set1_epi32(127)), 23);
+  return _mm256_mul_ps(y, _mm256_castsi256_ps(bits));
+}
+
+__attribute__((target("avx2,fma"))) inline __m256
+weightsAVX2(float const * sq_dist, float const * height, __m256 a, __m256 b)
+{
+  __m256 e = _mm256_mul_ps(a, _mm256_loadu_ps(sq_dist));
+  if (height)
+  {
+    __m256 h = _mm256_loadu_ps(height);
+    e = _mm256_fmadd_ps(b, _mm256_mul_ps(h, h), e);
+  }
+
+  return expAVX2(_mm256_sub_ps(_mm256_setzero_ps(), e));
+}
+
+__attribute__((target("avx2,fma"))) void
+evaluateAVX2(long n, float const * sq_dist, float const * height, float a, float b, float * weights)
+{
+  __m256 va = _mm256_set1_ps(a), vb = _mm256_set1_ps(b);
+
+  long i = 0;
+  for ( ; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(weights + i, weightsAVX2(sq_dist + i, (height ? height + i : NULL), va, vb));
+
+  // Pad the last partial vector, so every weight goes through the same instructions
+  if (i < n)
+  {
+    float s[8] = { 0 }, h[8] = { 0 }, w[8];
+    std::memcpy(s, sq_dist + i, (size_t)(n - i) * sizeof(float));
+    if (height) std::memcpy(h, height + i, (size_t)(n - i) * sizeof(float));
+
+    _mm256_storeu_ps(w, weightsAVX2(s, (height ? h : NULL), va, vb));
+    std::memcpy(weights + i, w, (size_t)(n - i) * sizeof(float));
+  }
+}
+
+__attribute__((target("avx512f"))) inline __m512
+expAVX512(__m512 x)
+{
+  x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(EXP_MIN)), _mm512_set1_ps(EXP_MAX));
+
+  __m512 k = _mm512_roundscale_ps(_mm512_fmadd_ps(x, _mm512_set1_ps(LOG2E), _mm512_set1_ps(0.5f)),
+                                  _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+  x = _mm512_fnmadd_ps(k, _mm512_set1_ps(LN2_HI), x);
+  x = _mm512_fnmadd_ps(k, _mm512_set1_ps(LN2_LO), x);
+
+  __m512 y = _mm512_set1_ps(P0);
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(P1));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(P2));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(P3));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(P4));
+  y = _mm512_fmadd_ps(y, x, _mm512_set1_ps(P5));
+  y = _mm512_add_ps(_mm512_fmadd_ps(y, _mm512_mul_ps(x, x), x), _mm512_set1_ps(1.0f));
+
+  return _mm512_scalef_ps(y, k);  // y * 2^k
+}
+
+__attribute__((target("avx512f"))) void
+evaluateAVX512(long n, float const * sq_dist, float const * height, float a, float b, float * weights)
+{
+  __m512 va = _mm512_set1_ps(a), vb = _mm512_set1_ps(b);
+
+  // The last partial vector is loaded and stored under a mask
+  for (long i = 0; i < n; i += 16)
+  {
+    __mmask16 mask = (n - i >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - i)) - 1));
+
+    __m512 e = _mm512_mul_ps(va, _mm512_maskz_loadu_ps(mask, sq_dist + i));
+    if (height)
+    {
+      __m512 h = _mm512_maskz_loadu_ps(mask, height + i);
+      e = _mm512_fmadd_ps(vb, _mm512_mul_ps(h, h), e);
+    }
+
+    _mm512_mask_storeu_ps(weights + i, mask, expAVX512(_mm512_sub_ps(_mm512_setzero_ps(), e)));
+  }
+}
+
+#endif // DGP_GAUSSIAN_WEIGHTS_X86
+
+} // namespace GaussianWeightsInternal
+
+GaussianWeights::InstructionSet
+GaussianWeights::supported()
+{
+  static InstructionSet const best = []() {
+#ifdef DGP_GAUSSIAN_WEIGHTS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+      return InstructionSet(InstructionSet::AVX512);
+
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      return InstructionSet(InstructionSet::AVX2);
+#endif
+
+    return InstructionSet(InstructionSet::SCALAR);
+  }();
+
+  return best;
+}
+
+GaussianWeights::InstructionSet
+GaussianWeights::active()
+{
+  return InstructionSet(std::min((int)supported(), GaussianWeightsInternal::limit.load()));
+}
+
+GaussianWeights::InstructionSet
+GaussianWeights::setLimit(InstructionSet limit)
+{
+  GaussianWeightsInternal::limit.store((int)limit);
+  return active();
+}
+
+char const *
+GaussianWeights::name(InstructionSet set)
+{
+  switch (set)
+  {
+    case InstructionSet::AVX2:   return "AVX2";
+    case InstructionSet::AVX512: return "AVX-512";
+    default:                     return "scalar";
+  }
+}
+
+void
+GaussianWeights::evaluate(InstructionSet set, long n, float const * sq_dist, float const * height, float a, float b,
+                          float * weights)
+{
+  using namespace GaussianWeightsInternal;
+
+  if ((int)set > (int)supported())
+    set = supported();
+
+  switch (set)
+  {
+#ifdef DGP_GAUSSIAN_WEIGHTS_X86
+    case InstructionSet::AVX512: evaluateAVX512(n, sq_dist, height, a, b, weights); break;
+    case InstructionSet::AVX2:   evaluateAVX2(n, sq_dist, height, a, b, weights); break;
+#endif
+    default:                     evaluateScalar(n, sq_dist, height, a, b, weights);
+  }
+}
+
+float
+GaussianWeights::exp(float x)
+{
+  return GaussianWeightsInternal::expScalar(x);
+}
+
+} // namespace DGP
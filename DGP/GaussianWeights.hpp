@@ -0,0 +1,93 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#ifndef __DGP_GaussianWeights_hpp__
+#define __DGP_GaussianWeights_hpp__
+
+#include "Common.hpp"
+
+namespace DGP {
+
+/**
+ * Batched evaluation of products of two Gaussians, as used to weight neighbours in bilateral filters. A batch of weights
+ *
+ *   <tt>weights[i] = exp(-(a * sq_dist[i] + b * height[i]^2))</tt>
+ *
+ * is computed in single precision with a polynomial approximation of the exponential, 8 or 16 at a time with AVX2 or AVX-512
+ * when the CPU supports them (detected at run time), else one at a time with the same approximation. Every code path meets
+ * the error bound of maxRelativeError(), so the paths agree to that accuracy but not necessarily bit for bit.
+ *
+ * Exponents below about -87.3 are clamped, so weights never fall below the smallest normalized float and sums of weights are
+ * never zero.
+ */
+class DGP_API GaussianWeights
+{
+  public:
+    /** Instruction sets with a separate code path (enum class). */
+    struct InstructionSet
+    {
+      /** Supported values, in order of increasing vector width. */
+      enum Value
+      {
+        SCALAR,  ///< Plain C++, one weight at a time. Always available.
+        AVX2,    ///< AVX2 with FMA, 8 weights at a time.
+        AVX512   ///< AVX-512F, 16 weights at a time.
+      };
+
+      DGP_ENUM_CLASS_BODY(InstructionSet)
+    };
+
+    /** Get the widest instruction set supported by this CPU and build. Detected on the first call. */
+    static InstructionSet supported();
+
+    /** Get the instruction set used by evaluate(), which is the widest supported one unless limited by setLimit(). */
+    static InstructionSet active();
+
+    /**
+     * Limit the instruction set used by evaluate(), for instance to validate the vector paths against the scalar one. Takes
+     * effect for all threads. Returns the instruction set that is now active.
+     */
+    static InstructionSet setLimit(InstructionSet limit);
+
+    /** Get the name of an instruction set, for display. */
+    static char const * name(InstructionSet set);
+
+    /**
+     * Get a bound on the relative error of a weight with a given exponent <tt>-(a * sq_dist + b * height^2)</tt>, compared to
+     * the exact value, if the exponent is not clamped. Most of the error for large exponents comes from rounding the exponent
+     * itself to single precision.
+     */
+    static double maxRelativeError(double exponent) { return 2.5e-7 * (1 + (exponent < 0 ? -exponent : exponent)); }
+
+    /**
+     * Compute <tt>weights[i] = exp(-(a * sq_dist[i] + b * height[i]^2))</tt> for \a n entries, using the active instruction
+     * set. \a a and \a b must be non-negative. If \a height is null, the second term is omitted.
+     */
+    static void evaluate(long n, float const * sq_dist, float const * height, float a, float b, float * weights)
+    {
+      evaluate(active(), n, sq_dist, height, a, b, weights);
+    }
+
+    /**
+     * Compute weights as evaluate() does, with a specific instruction set. If the set is not supported, the widest supported
+     * one is used instead.
+     */
+    static void evaluate(InstructionSet set, long n, float const * sq_dist, float const * height, float a, float b,
+                         float * weights);
+
+    /** Approximate <tt>exp(x)</tt> for x <= 0 with the same polynomial as the batched paths. */
+    static float exp(float x);
+
+}; // class GaussianWeights
+
+} // namespace DGP
+
+#endif
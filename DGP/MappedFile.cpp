@@ -0,0 +1,118 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#include "MappedFile.hpp"
+#include "FileSystem.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+#ifndef DGP_WINDOWS
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace DGP {
+
+bool
+MappedFile::open(std::string const & path)
+{
+  close();
+
+#ifndef DGP_WINDOWS
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    DGP_ERROR << "MappedFile: Couldn't open file '" << path << "' for reading";
+    return false;
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0)
+  {
+    DGP_ERROR << "MappedFile: Couldn't get size of file '" << path << '\'';
+    ::close(fd);
+    return false;
+  }
+
+  size = (int64)st.st_size;
+  if (size > 0)
+  {
+    void * addr = ::mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED)
+    {
+      ::madvise(addr, (size_t)size, MADV_SEQUENTIAL);
+      data = static_cast<char *>(addr);
+      mapped = true;
+    }
+  }
+
+  ::close(fd);
+
+  if (mapped || size == 0)
+    return true;
+
+  // Mapping failed (e.g. the file is on a filesystem that does not support it), fall through to reading it
+#endif
+
+  size = FileSystem::fileSize(path);
+  if (size < 0)
+  {
+    DGP_ERROR << "MappedFile: Couldn't get size of file '" << path << '\'';
+    size = 0;
+    return false;
+  }
+
+  if (size == 0)
+    return true;
+
+  data = static_cast<char *>(std::malloc((size_t)size));
+  if (!data)
+  {
+    DGP_ERROR << "MappedFile: Could not allocate buffer to hold " << size << " bytes from file '" << path << '\'';
+    size = 0;
+    return false;
+  }
+
+  FILE * f = std::fopen(path.c_str(), "rb");
+  size_t num_read = (f ? std::fread(data, 1, (size_t)size, f) : 0);
+  if (f) std::fclose(f);
+
+  if ((int64)num_read != size)
+  {
+    DGP_ERROR << "MappedFile: Error reading from file '" << path << '\'';
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+void
+MappedFile::close()
+{
+  if (data)
+  {
+#ifndef DGP_WINDOWS
+    if (mapped)
+      ::munmap(data, (size_t)size);
+    else
+#endif
+      std::free(data);
+  }
+
+  data = NULL;
+  size = 0;
+  mapped = false;
+}
+
+} // namespace DGP
@@ -0,0 +1,61 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#ifndef __DGP_MappedFile_hpp__
+#define __DGP_MappedFile_hpp__
+
+#include "Common.hpp"
+#include "Noncopyable.hpp"
+#include <string>
+
+namespace DGP {
+
+/**
+ * Read-only view of the contents of a file. On POSIX systems the file is memory-mapped, so its pages are loaded on demand and
+ * no copy is made. Elsewhere, or if mapping fails, the file is read into a heap buffer. Either way the data stays valid until
+ * the file is closed or the object is destroyed.
+ *
+ * The data is <b>not</b> null-terminated.
+ */
+class DGP_API MappedFile : private Noncopyable
+{
+  public:
+    /** Constructor. Does not open any file. */
+    MappedFile() : data(NULL), size(0), mapped(false) {}
+
+    /** Destructor. Closes the file if it is open. */
+    ~MappedFile() { close(); }
+
+    /** Open a file, closing the previous one if any. Prints an error and returns false on failure. */
+    bool open(std::string const & path);
+
+    /** Close the file and release the data. */
+    void close();
+
+    /** Get a pointer to the first byte of the file. */
+    char const * getData() const { return data; }
+
+    /** Get the number of bytes in the file. */
+    int64 getSize() const { return size; }
+
+    /** Check if the data is memory-mapped (else it was read into a buffer). */
+    bool isMapped() const { return mapped; }
+
+  private:
+    char * data;   ///< The file contents.
+    int64 size;    ///< The number of bytes in the file.
+    bool mapped;   ///< Was the file memory-mapped?
+
+}; // class MappedFile
+
+} // namespace DGP
+
+#endif
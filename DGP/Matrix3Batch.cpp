@@ -0,0 +1,758 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#include "Matrix3Batch.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+
+#if (defined(DGP_X64) || defined(DGP_X86)) && defined(__GNUC__)
+#  define DGP_MATRIX3_BATCH_X86 1
+#  include <immintrin.h>
+#endif
+
+namespace DGP {
+
+namespace Matrix3BatchInternal {
+
+// Added to the denominator of the tangent of a Jacobi rotation, so a zero off-diagonal entry with equal diagonal entries gives
+// no rotation instead of 0/0
+static double const TINY = DBL_MIN;
+
+// Pairs (p, q) of the rotations of a sweep, with the remaining index r
+static int const ROTATIONS[3][3] = { { 0, 1, 2 }, { 0, 2, 1 }, { 1, 2, 0 } };
+
+// Positions of the entries of a symmetric matrix in the 6-value upper triangle
+static int const SYM_INDEX[3][3] = { { 0, 1, 2 }, { 1, 3, 4 }, { 2, 4, 5 } };
+
+// Row and column of each entry of the 6-value upper triangle of a symmetric matrix
+static int const SYM_ROW[6] = { 0, 0, 0, 1, 1, 2 };
+static int const SYM_COL[6] = { 0, 1, 2, 1, 2, 2 };
+
+// Compare-and-swap steps that sort three eigenvalues
+static int const SORT_STEPS[3][2] = { { 0, 1 }, { 1, 2 }, { 0, 1 } };
+
+// Number of point sets whose normals fitPlanes() finds at a time, before building their planes
+static long const PLANE_CHUNK = 256;
+
+// Number of Newton steps for the smallest eigenvalue of a covariance matrix in fitPlanes(). Most matrices of near-planar points
+// converge in 3.
+static int const NUM_NEWTON_STEPS = 4;
+
+// Largest next Newton step, relative to the trace, for which the smallest eigenvalue is taken as converged
+static double const MAX_NEXT_STEP = 1e-12;
+
+// Smallest gap between the two smallest eigenvalues of a covariance matrix, relative to its trace, for which fitPlanes() takes
+// the normal from the cross products instead of from symmetricEigen()
+static double const MIN_EIGEN_GAP = 1e-4;
+
+static std::atomic<int> limit(Matrix3Batch::InstructionSet::AVX2);
+
+void
+invertScalar(long n, double const * m, double * inv, double * det)
+{
+  for (long i = 0; i < n; ++i, m += 9, inv += 9)
+  {
+    double adj[9] = { m[4] * m[8] - m[5] * m[7], m[2] * m[7] - m[1] * m[8], m[1] * m[5] - m[2] * m[4],
+                      m[5] * m[6] - m[3] * m[8], m[0] * m[8] - m[2] * m[6], m[2] * m[3] - m[0] * m[5],
+                      m[3] * m[7] - m[4] * m[6], m[1] * m[6] - m[0] * m[7], m[0] * m[4] - m[1] * m[3] };
+
+    double d = m[0] * adj[0] + m[1] * adj[3] + m[2] * adj[6];
+    double r = 1.0 / d;
+    for (int j = 0; j < 9; ++j)
+      inv[j] = (d != 0 ? adj[j] * r : 0.0);
+
+    det[i] = d;
+  }
+}
+
+// One Jacobi rotation zeroing a[p][q], also rotating the eigenvector matrix v (row-major, eigenvectors in columns)
+inline void
+rotateScalar(double * a, double * v, int p, int q, int r)
+{
+  double & app = a[SYM_INDEX[p][p]], & aqq = a[SYM_INDEX[q][q]], & apq = a[SYM_INDEX[p][q]];
+  double & arp = a[SYM_INDEX[r][p]], & arq = a[SYM_INDEX[r][q]];
+
+  double d = aqq - app;
+  double num = std::copysign(1.0, d) * (apq + apq);
+  double den = (std::fabs(d) + std::sqrt(d * d + 4.0 * (apq * apq))) + TINY;
+  double t = num / den;
+  double c = 1.0 / std::sqrt(1.0 + t * t);
+  double s = t * c;
+
+  double tapq = t * apq;
+  app = app - tapq;
+  aqq = aqq + tapq;
+  apq = 0.0;
+
+  double rp = arp, rq = arq;
+  arp = c * rp - s * rq;
+  arq = s * rp + c * rq;
+
+  for (int k = 0; k < 3; ++k)
+  {
+    double vp = v[3 * k + p], vq = v[3 * k + q];
+    v[3 * k + p] = c * vp - s * vq;
+    v[3 * k + q] = s * vp + c * vq;
+  }
+}
+
+void
+symmetricEigenScalar(long n, double const * sym, double * eigenvalues, double * eigenvectors)
+{
+  for (long i = 0; i < n; ++i)
+  {
+    double a[6] = { sym[6 * i], sym[6 * i + 1], sym[6 * i + 2], sym[6 * i + 3], sym[6 * i + 4], sym[6 * i + 5] };
+    double v[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+
+    for (int sweep = 0; sweep < Matrix3Batch::NUM_SWEEPS; ++sweep)
+      for (int k = 0; k < 3; ++k)
+        rotateScalar(a, v, ROTATIONS[k][0], ROTATIONS[k][1], ROTATIONS[k][2]);
+
+    double lambda[3] = { a[0], a[3], a[5] };
+    for (int k = 0; k < 3; ++k)
+    {
+      int p = SORT_STEPS[k][0], q = SORT_STEPS[k][1];
+      bool swap = (lambda[q] < lambda[p]);
+      double lp = lambda[p], lq = lambda[q];
+      lambda[p] = (swap ? lq : lp);
+      lambda[q] = (swap ? lp : lq);
+
+      for (int j = 0; j < 3; ++j)
+      {
+        double vp = v[3 * j + p], vq = v[3 * j + q];
+        v[3 * j + p] = (swap ? vq : vp);
+        v[3 * j + q] = (swap ? vp : vq);
+      }
+    }
+
+    for (int k = 0; k < 3; ++k)
+      eigenvalues[3 * i + k] = lambda[k];
+
+    if (eigenvectors)
+    {
+      for (int k = 0; k < 3; ++k)
+        for (int j = 0; j < 3; ++j)
+          eigenvectors[9 * i + 3 * k + j] = v[3 * j + k];
+    }
+  }
+}
+
+// Centroid, winding (the sum of the cross products of a fan of triangles) and covariance matrix of a set of m points, in
+// double precision, in one pass over the offsets of the points from the first. Offsets of single-precision points, and their
+// products, are exact in double precision, so only the sums round, and the covariance is their difference from the sums of
+// offsets, which are small near the first point.
+inline void
+planeMomentsScalar(Vector3 const * p, long m, double * c, double * w, double * s)
+{
+  double d[3] = { 0, 0, 0 }, u[3] = { 0, 0, 0 };
+  std::fill(w, w + 3, 0.0);
+  std::fill(s, s + 6, 0.0);
+  for (long j = 1; j < m; ++j)
+  {
+    double v[3] = { (double)p[j][0] - p[0][0], (double)p[j][1] - p[0][1], (double)p[j][2] - p[0][2] };
+    for (int k = 0; k < 3; ++k)
+      d[k] += v[k];
+
+    w[0] += u[1] * v[2] - u[2] * v[1];
+    w[1] += u[2] * v[0] - u[0] * v[2];
+    w[2] += u[0] * v[1] - u[1] * v[0];
+
+    for (int k = 0; k < 6; ++k)
+      s[k] += v[SYM_ROW[k]] * v[SYM_COL[k]];
+
+    std::copy(v, v + 3, u);
+  }
+
+  double r = (m > 0 ? 1.0 / m : 0.0);
+  for (int k = 0; k < 3; ++k)
+    c[k] = (m > 0 ? p[0][k] + d[k] * r : 0.0);
+
+  for (int k = 0; k < 6; ++k)
+    s[k] = s[k] - (d[SYM_ROW[k]] * d[SYM_COL[k]]) * r;
+}
+
+// Unit eigenvector of the smallest eigenvalue of a symmetric positive semi-definite matrix, without iterating on the matrix:
+// the eigenvalue is the smallest root of the characteristic cubic, found by a fixed number of Newton steps, and the eigenvector
+// the longest cross product of two rows of (A - lambda I). Gives a zero vector if the eigenvalue has not converged or is not
+// well separated from the next, so the eigenvector is ill-conditioned (as for collinear points) and needs symmetricEigen().
+inline void
+smallestEigenvectorScalar(double const * s, double * e)
+{
+  // det(A - lambda I) = c0 - c1 lambda + c2 lambda^2 - lambda^3
+  double c2 = (s[0] + s[3]) + s[5];
+  double c1 = ((s[0] * s[3] - s[1] * s[1]) + (s[0] * s[5] - s[2] * s[2])) + (s[3] * s[5] - s[4] * s[4]);
+  double c0 = (s[0] * (s[3] * s[5] - s[4] * s[4]) - s[1] * (s[1] * s[5] - s[4] * s[2])) + s[2] * (s[1] * s[4] - s[3] * s[2]);
+
+  // The cubic is positive, decreasing and convex from 0 up to its smallest root, so Newton's method from 0 climbs to the root
+  // without overshooting, quadratically unless the root is nearly double
+  double lambda = 0;
+  for (int k = 0; k < NUM_NEWTON_STEPS; ++k)
+  {
+    double p = c0 - lambda * (c1 - lambda * (c2 - lambda));
+    double dp = lambda * (c2 + c2 - 3.0 * lambda) - c1;
+    double step = (dp < 0 ? (0.0 - p) / dp : 0.0);
+    lambda = lambda + (step > 0 ? step : 0.0);
+  }
+
+  // Converged if the next step, -p / dp, would be small, tested without a division
+  double p = c0 - lambda * (c1 - lambda * (c2 - lambda));
+  double dp = lambda * (c2 + c2 - 3.0 * lambda) - c1;
+  bool converged = (p <= (MAX_NEXT_STEP * c2) * (0.0 - dp));
+
+  double r[3][3] = { { s[0] - lambda, s[1], s[2] }, { s[1], s[3] - lambda, s[4] }, { s[2], s[4], s[5] - lambda } };
+  double best[3], best_sq = 0;
+  for (int k = 0; k < 3; ++k)
+  {
+    double const * u = r[ROTATIONS[k][0]], * v = r[ROTATIONS[k][1]];
+    double x = u[1] * v[2] - u[2] * v[1], y = u[2] * v[0] - u[0] * v[2], z = u[0] * v[1] - u[1] * v[0];
+    double sq = (x * x + y * y) + z * z;
+    bool longer = (k == 0 || sq > best_sq);
+    best[0] = (longer ? x : best[0]);
+    best[1] = (longer ? y : best[1]);
+    best[2] = (longer ? z : best[2]);
+    best_sq = (longer ? sq : best_sq);
+  }
+
+  // The longest cross product has length about (lambda_2 - lambda_1) (lambda_3 - lambda_1). The rounding of the cubic puts
+  // lambda_1, and so the direction of the product, off by about DBL_EPSILON (lambda_3 / lambda_2)^2, so lambda_2 must be at
+  // least a small fraction of the trace.
+  double min_sq = (MIN_EIGEN_GAP * MIN_EIGEN_GAP) * ((c2 * c2) * (c2 * c2));
+  bool ok = (best_sq > min_sq && converged && c2 <= DBL_MAX);
+  double scale = 1.0 / std::sqrt(best_sq);
+  for (int k = 0; k < 3; ++k)
+    e[k] = (ok ? best[k] * scale : 0.0);
+}
+
+// Centroid and unit normal of the least-squares plane of each of n sets of points, the normal oriented to agree with the
+// winding. A set whose normal needs symmetricEigen() gets a zero normal.
+void
+planeNormalsScalar(long n, Vector3 const * points, long const * point_start, double * centroids, double * normals)
+{
+  for (long i = 0; i < n; ++i, centroids += 3, normals += 3)
+  {
+    long m = point_start[i + 1] - point_start[i];
+    double w[3], s[6], e[3];
+    planeMomentsScalar(points + point_start[i], m, centroids, w, s);
+
+    // A triangle lies in its plane, whose normal is the cross product of its edges. Otherwise the normal is the direction of
+    // least variance.
+    double len = std::sqrt((w[0] * w[0] + w[1] * w[1]) + w[2] * w[2]);
+    if (m == 3 && len > 0 && len <= DBL_MAX)
+    {
+      for (int k = 0; k < 3; ++k)
+        e[k] = w[k] / len;
+    }
+    else
+      smallestEigenvectorScalar(s, e);
+
+    double sign = ((e[0] * w[0] + e[1] * w[1]) + e[2] * w[2] < 0 ? -1.0 : 1.0);
+    for (int k = 0; k < 3; ++k)
+      normals[k] = sign * e[k];
+  }
+}
+
+#ifdef DGP_MATRIX3_BATCH_X86
+
+// Load value e of 4 consecutive matrices of a given size, or of fewer (possibly none) if the batch ends, padding with zeros.
+// Lanes are inserted into a register instead of stored to memory and reloaded, which would stall forwarding the stores to the
+// load.
+__attribute__((target("avx2"))) inline __m256d
+gather4(double const * values, long size, long count, int e)
+{
+  values += e;
+  if (count == 4)
+    return _mm256_set_pd(values[3 * size], values[2 * size], values[size], values[0]);
+
+  return _mm256_set_pd(0.0, (count > 2 ? values[2 * size] : 0.0), (count > 1 ? values[size] : 0.0),
+                       (count > 0 ? values[0] : 0.0));
+}
+
+// Store value e of up to 4 consecutive matrices of a given size
+__attribute__((target("avx2"))) inline void
+scatter4(__m256d x, double * values, long size, long count, int e)
+{
+  double lanes[4];
+  _mm256_storeu_pd(lanes, x);
+  for (long l = 0; l < count; ++l)
+    values[l * size + e] = lanes[l];
+}
+
+__attribute__((target("avx2"))) void
+invertAVX2(long n, double const * m, double * inv, double * det)
+{
+  __m256d const zero = _mm256_setzero_pd();
+  for (long i = 0; i < n; i += 4)
+  {
+    long count = std::min(n - i, 4L);
+    __m256d a[9];
+    for (int e = 0; e < 9; ++e)
+      a[e] = gather4(m + 9 * i, 9, count, e);
+
+    #define DGP_MATRIX3_BATCH_COFACTOR(i0, i1, i2, i3) \
+      _mm256_sub_pd(_mm256_mul_pd(a[i0], a[i1]), _mm256_mul_pd(a[i2], a[i3]))
+
+    __m256d adj[9] = { DGP_MATRIX3_BATCH_COFACTOR(4, 8, 5, 7), DGP_MATRIX3_BATCH_COFACTOR(2, 7, 1, 8),
+                       DGP_MATRIX3_BATCH_COFACTOR(1, 5, 2, 4), DGP_MATRIX3_BATCH_COFACTOR(5, 6, 3, 8),
+                       DGP_MATRIX3_BATCH_COFACTOR(0, 8, 2, 6), DGP_MATRIX3_BATCH_COFACTOR(2, 3, 0, 5),
+                       DGP_MATRIX3_BATCH_COFACTOR(3, 7, 4, 6), DGP_MATRIX3_BATCH_COFACTOR(1, 6, 0, 7),
+                       DGP_MATRIX3_BATCH_COFACTOR(0, 4, 1, 3) };
+
+    #undef DGP_MATRIX3_BATCH_COFACTOR
+
+    __m256d d = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(a[0], adj[0]), _mm256_mul_pd(a[1], adj[3])),
+                              _mm256_mul_pd(a[2], adj[6]));
+    __m256d r = _mm256_div_pd(_mm256_set1_pd(1.0), d);
+    __m256d nonzero = _mm256_cmp_pd(d, zero, _CMP_NEQ_UQ);
+    for (int e = 0; e < 9; ++e)
+      scatter4(_mm256_and_pd(nonzero, _mm256_mul_pd(adj[e], r)), inv + 9 * i, 9, count, e);
+
+    scatter4(d, det + i, 1, count, 0);
+  }
+}
+
+__attribute__((target("avx2"))) inline void
+rotateAVX2(__m256d * a, __m256d * v, int p, int q, int r)
+{
+  __m256d const sign_mask = _mm256_set1_pd(-0.0);
+  __m256d & app = a[SYM_INDEX[p][p]], & aqq = a[SYM_INDEX[q][q]], & apq = a[SYM_INDEX[p][q]];
+  __m256d & arp = a[SYM_INDEX[r][p]], & arq = a[SYM_INDEX[r][q]];
+
+  __m256d d = _mm256_sub_pd(aqq, app);
+  __m256d sign_d = _mm256_or_pd(_mm256_and_pd(d, sign_mask), _mm256_set1_pd(1.0));  // copysign(1, d)
+  __m256d num = _mm256_mul_pd(sign_d, _mm256_add_pd(apq, apq));
+  __m256d root = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(d, d),
+                                              _mm256_mul_pd(_mm256_set1_pd(4.0), _mm256_mul_pd(apq, apq))));
+  __m256d den = _mm256_add_pd(_mm256_add_pd(_mm256_andnot_pd(sign_mask, d), root), _mm256_set1_pd(TINY));
+  __m256d t = _mm256_div_pd(num, den);
+  __m256d c = _mm256_div_pd(_mm256_set1_pd(1.0),
+                            _mm256_sqrt_pd(_mm256_add_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(t, t))));
+  __m256d s = _mm256_mul_pd(t, c);
+
+  __m256d tapq = _mm256_mul_pd(t, apq);
+  app = _mm256_sub_pd(app, tapq);
+  aqq = _mm256_add_pd(aqq, tapq);
+  apq = _mm256_setzero_pd();
+
+  __m256d rp = arp, rq = arq;
+  arp = _mm256_sub_pd(_mm256_mul_pd(c, rp), _mm256_mul_pd(s, rq));
+  arq = _mm256_add_pd(_mm256_mul_pd(s, rp), _mm256_mul_pd(c, rq));
+
+  for (int k = 0; k < 3; ++k)
+  {
+    __m256d vp = v[3 * k + p], vq = v[3 * k + q];
+    v[3 * k + p] = _mm256_sub_pd(_mm256_mul_pd(c, vp), _mm256_mul_pd(s, vq));
+    v[3 * k + q] = _mm256_add_pd(_mm256_mul_pd(s, vp), _mm256_mul_pd(c, vq));
+  }
+}
+
+__attribute__((target("avx2"))) void
+symmetricEigenAVX2(long n, double const * sym, double * eigenvalues, double * eigenvectors)
+{
+  // Each rotation is a long chain of dependent square roots and divisions, so two groups of 4 matrices are rotated in turn
+  // to overlap their latencies
+  static long const NUM_GROUPS = 2;
+
+  __m256d const zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1.0);
+  for (long i = 0; i < n; i += 4 * NUM_GROUPS)
+  {
+    long count[NUM_GROUPS];
+    __m256d a[NUM_GROUPS][6], v[NUM_GROUPS][9];
+    for (long g = 0; g < NUM_GROUPS; ++g)
+    {
+      count[g] = std::max(std::min(n - i - 4 * g, 4L), 0L);
+      for (int e = 0; e < 6; ++e)
+        a[g][e] = gather4(sym + 6 * (i + 4 * g), 6, count[g], e);
+
+      for (int e = 0; e < 9; ++e)
+        v[g][e] = (e % 4 == 0 ? one : zero);
+    }
+
+    for (int sweep = 0; sweep < Matrix3Batch::NUM_SWEEPS; ++sweep)
+      for (int k = 0; k < 3; ++k)
+        for (long g = 0; g < NUM_GROUPS; ++g)
+          rotateAVX2(a[g], v[g], ROTATIONS[k][0], ROTATIONS[k][1], ROTATIONS[k][2]);
+
+    for (long g = 0; g < NUM_GROUPS && count[g] > 0; ++g)
+    {
+      __m256d lambda[3] = { a[g][0], a[g][3], a[g][5] };
+      for (int k = 0; k < 3; ++k)
+      {
+        int p = SORT_STEPS[k][0], q = SORT_STEPS[k][1];
+        __m256d swap = _mm256_cmp_pd(lambda[q], lambda[p], _CMP_LT_OQ);
+        __m256d lp = lambda[p], lq = lambda[q];
+        lambda[p] = _mm256_blendv_pd(lp, lq, swap);
+        lambda[q] = _mm256_blendv_pd(lq, lp, swap);
+
+        for (int j = 0; j < 3; ++j)
+        {
+          __m256d vp = v[g][3 * j + p], vq = v[g][3 * j + q];
+          v[g][3 * j + p] = _mm256_blendv_pd(vp, vq, swap);
+          v[g][3 * j + q] = _mm256_blendv_pd(vq, vp, swap);
+        }
+      }
+
+      for (int k = 0; k < 3; ++k)
+        scatter4(lambda[k], eigenvalues + 3 * (i + 4 * g), 3, count[g], k);
+
+      if (eigenvectors)
+      {
+        for (int k = 0; k < 3; ++k)
+          for (int j = 0; j < 3; ++j)
+            scatter4(v[g][3 * j + k], eigenvectors + 9 * (i + 4 * g), 9, count[g], 3 * k + j);
+      }
+    }
+  }
+}
+
+// Point j of a set of m points as 4 floats, or zeros if there is no such point. If the set has a point after it (\a inner), the
+// last float is the first coordinate of that point. Otherwise the last float is zero, and the load is masked, without a branch
+// on the (often varying) sizes of the sets, so it never touches memory past the last point.
+__attribute__((target("avx2"))) inline __m128
+loadPoint(Vector3 const * p, long m, long j, bool inner)
+{
+  if (inner)
+    return _mm_loadu_ps(&p[j][0]);
+
+  __m128i mask = _mm_and_si128(_mm_set_epi32(0, -1, -1, -1), _mm_set1_epi32(-(int)(j < m)));
+  return _mm_maskload_ps(&p[j][0], mask);
+}
+
+// Coordinates of point j of 4 sets of points, or zeros for a set with no such point. \a inner tells if every set has a point
+// after it.
+__attribute__((target("avx2"))) inline void
+loadPoints4(Vector3 const * const * p, long const * m, long j, bool inner, __m256d & x, __m256d & y, __m256d & z)
+{
+  __m128 q0 = loadPoint(p[0], m[0], j, inner), q1 = loadPoint(p[1], m[1], j, inner), q2 = loadPoint(p[2], m[2], j, inner),
+         q3 = loadPoint(p[3], m[3], j, inner);
+  _MM_TRANSPOSE4_PS(q0, q1, q2, q3);
+  x = _mm256_cvtps_pd(q0);
+  y = _mm256_cvtps_pd(q1);
+  z = _mm256_cvtps_pd(q2);
+}
+
+__attribute__((target("avx2"))) inline void
+planeMomentsAVX2(Vector3 const * const * p, long const * m, __m256d size, __m256d * c, __m256d * w, __m256d * s)
+{
+  __m256d const zero = _mm256_setzero_pd();
+  long min_m = std::min(std::min(m[0], m[1]), std::min(m[2], m[3]));
+  long max_m = std::max(std::max(m[0], m[1]), std::max(m[2], m[3]));
+
+  // Sets with fewer points add zeros, which leave their sums unchanged
+  __m256d x0, y0, z0, dx = zero, dy = zero, dz = zero, ux = zero, uy = zero, uz = zero, wx = zero, wy = zero, wz = zero;
+  __m256d sxx = zero, sxy = zero, sxz = zero, syy = zero, syz = zero, szz = zero;
+  loadPoints4(p, m, 0, 1 < min_m, x0, y0, z0);
+  for (long j = 1; j < max_m; ++j)
+  {
+    __m256d x, y, z;
+    loadPoints4(p, m, j, j + 1 < min_m, x, y, z);
+    __m256d active = _mm256_cmp_pd(_mm256_set1_pd((double)j), size, _CMP_LT_OQ);
+    __m256d vx = _mm256_and_pd(active, _mm256_sub_pd(x, x0));
+    __m256d vy = _mm256_and_pd(active, _mm256_sub_pd(y, y0));
+    __m256d vz = _mm256_and_pd(active, _mm256_sub_pd(z, z0));
+    dx = _mm256_add_pd(dx, vx);
+    dy = _mm256_add_pd(dy, vy);
+    dz = _mm256_add_pd(dz, vz);
+
+    wx = _mm256_add_pd(wx, _mm256_sub_pd(_mm256_mul_pd(uy, vz), _mm256_mul_pd(uz, vy)));
+    wy = _mm256_add_pd(wy, _mm256_sub_pd(_mm256_mul_pd(uz, vx), _mm256_mul_pd(ux, vz)));
+    wz = _mm256_add_pd(wz, _mm256_sub_pd(_mm256_mul_pd(ux, vy), _mm256_mul_pd(uy, vx)));
+
+    sxx = _mm256_add_pd(sxx, _mm256_mul_pd(vx, vx)); sxy = _mm256_add_pd(sxy, _mm256_mul_pd(vx, vy));
+    sxz = _mm256_add_pd(sxz, _mm256_mul_pd(vx, vz)); syy = _mm256_add_pd(syy, _mm256_mul_pd(vy, vy));
+    syz = _mm256_add_pd(syz, _mm256_mul_pd(vy, vz)); szz = _mm256_add_pd(szz, _mm256_mul_pd(vz, vz));
+
+    ux = vx; uy = vy; uz = vz;
+  }
+
+  __m256d nonempty = _mm256_cmp_pd(size, zero, _CMP_GT_OQ);
+  __m256d r = _mm256_and_pd(nonempty, _mm256_div_pd(_mm256_set1_pd(1.0), size));
+  c[0] = _mm256_and_pd(nonempty, _mm256_add_pd(x0, _mm256_mul_pd(dx, r)));
+  c[1] = _mm256_and_pd(nonempty, _mm256_add_pd(y0, _mm256_mul_pd(dy, r)));
+  c[2] = _mm256_and_pd(nonempty, _mm256_add_pd(z0, _mm256_mul_pd(dz, r)));
+  w[0] = wx; w[1] = wy; w[2] = wz;
+
+  __m256d d[3] = { dx, dy, dz }, sums[6] = { sxx, sxy, sxz, syy, syz, szz };
+  for (int k = 0; k < 6; ++k)
+    s[k] = _mm256_sub_pd(sums[k], _mm256_mul_pd(_mm256_mul_pd(d[SYM_ROW[k]], d[SYM_COL[k]]), r));
+}
+
+// Centroids and normals of sets of points as planeNormalsScalar() computes them, with the moments and the eigenvector of each
+// set in the same lane
+__attribute__((target("avx2"))) void
+planeNormalsAVX2(long n, Vector3 const * points, long const * point_start, double * centroids, double * normals)
+{
+  // As in symmetricEigenAVX2(), two groups of 4 sets overlap the latencies of their chains of divisions
+  static long const NUM_GROUPS = 2;
+
+  __m256d const zero = _mm256_setzero_pd(), three = _mm256_set1_pd(3.0);
+  for (long i = 0; i < n; i += 4 * NUM_GROUPS)
+  {
+    long count[NUM_GROUPS];
+    __m256d c[NUM_GROUPS][3], w[NUM_GROUPS][3], s[NUM_GROUPS][6], e[NUM_GROUPS][3], triangle[NUM_GROUPS];
+    bool all_triangles = true;
+    for (long g = 0; g < NUM_GROUPS; ++g)
+    {
+      count[g] = std::max(std::min(n - i - 4 * g, 4L), 0L);
+      Vector3 const * p[4];
+      long m[4];
+      for (long l = 0; l < 4; ++l)
+      {
+        long set = i + 4 * g + l;
+        p[l] = (l < count[g] ? points + point_start[set] : points);
+        m[l] = (l < count[g] ? point_start[set + 1] - point_start[set] : 0);
+      }
+
+      __m256d size = _mm256_set_pd((double)m[3], (double)m[2], (double)m[1], (double)m[0]);
+      planeMomentsAVX2(p, m, size, c[g], w[g], s[g]);
+
+      // Groups without triangles, as of most vertex rings, skip their normals
+      triangle[g] = _mm256_cmp_pd(size, three, _CMP_EQ_OQ);
+      if (_mm256_movemask_pd(triangle[g]) != 0)
+      {
+        __m256d len = _mm256_sqrt_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(w[g][0], w[g][0]),
+                                                                 _mm256_mul_pd(w[g][1], w[g][1])),
+                                                   _mm256_mul_pd(w[g][2], w[g][2])));
+        triangle[g] = _mm256_and_pd(_mm256_and_pd(triangle[g], _mm256_cmp_pd(len, zero, _CMP_GT_OQ)),
+                                    _mm256_cmp_pd(len, _mm256_set1_pd(DBL_MAX), _CMP_LE_OQ));
+        for (int k = 0; k < 3; ++k)
+          e[g][k] = _mm256_div_pd(w[g][k], len);
+      }
+      else
+      {
+        for (int k = 0; k < 3; ++k)
+          e[g][k] = zero;
+      }
+
+      // Lanes past the end of the batch count as triangles
+      all_triangles = all_triangles && ((_mm256_movemask_pd(triangle[g]) | (0xF << count[g])) & 0xF) == 0xF;
+    }
+
+    // Batches of triangles, as of most meshes, skip the eigenvectors
+    if (!all_triangles)
+    {
+      __m256d c0[NUM_GROUPS], c1[NUM_GROUPS], c2[NUM_GROUPS], lambda[NUM_GROUPS], converged[NUM_GROUPS];
+      for (long g = 0; g < NUM_GROUPS; ++g)
+      {
+        #define DGP_MATRIX3_BATCH_MINOR(i0, i1, i2, i3) \
+          _mm256_sub_pd(_mm256_mul_pd(s[g][i0], s[g][i1]), _mm256_mul_pd(s[g][i2], s[g][i3]))
+
+        c2[g] = _mm256_add_pd(_mm256_add_pd(s[g][0], s[g][3]), s[g][5]);
+        c1[g] = _mm256_add_pd(_mm256_add_pd(DGP_MATRIX3_BATCH_MINOR(0, 3, 1, 1), DGP_MATRIX3_BATCH_MINOR(0, 5, 2, 2)),
+                              DGP_MATRIX3_BATCH_MINOR(3, 5, 4, 4));
+        c0[g] = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(s[g][0], DGP_MATRIX3_BATCH_MINOR(3, 5, 4, 4)),
+                                            _mm256_mul_pd(s[g][1], DGP_MATRIX3_BATCH_MINOR(1, 5, 4, 2))),
+                              _mm256_mul_pd(s[g][2], DGP_MATRIX3_BATCH_MINOR(1, 4, 3, 2)));
+
+        #undef DGP_MATRIX3_BATCH_MINOR
+
+        lambda[g] = zero;
+      }
+
+      for (int k = 0; k <= NUM_NEWTON_STEPS; ++k)
+        for (long g = 0; g < NUM_GROUPS; ++g)
+        {
+          __m256d p = _mm256_sub_pd(c0[g], _mm256_mul_pd(lambda[g], _mm256_sub_pd(c1[g], _mm256_mul_pd(lambda[g],
+                                                                                  _mm256_sub_pd(c2[g], lambda[g])))));
+          __m256d dp = _mm256_sub_pd(_mm256_mul_pd(lambda[g], _mm256_sub_pd(_mm256_add_pd(c2[g], c2[g]),
+                                                                            _mm256_mul_pd(three, lambda[g]))), c1[g]);
+          if (k == NUM_NEWTON_STEPS)
+          {
+            __m256d max_step = _mm256_mul_pd(_mm256_set1_pd(MAX_NEXT_STEP), c2[g]);
+            converged[g] = _mm256_cmp_pd(p, _mm256_mul_pd(max_step, _mm256_sub_pd(zero, dp)), _CMP_LE_OQ);
+            continue;
+          }
+
+          __m256d step = _mm256_and_pd(_mm256_cmp_pd(dp, zero, _CMP_LT_OQ), _mm256_div_pd(_mm256_sub_pd(zero, p), dp));
+          lambda[g] = _mm256_add_pd(lambda[g], _mm256_and_pd(_mm256_cmp_pd(step, zero, _CMP_GT_OQ), step));
+        }
+
+      for (long g = 0; g < NUM_GROUPS; ++g)
+      {
+        __m256d r[3][3] = { { _mm256_sub_pd(s[g][0], lambda[g]), s[g][1], s[g][2] },
+                            { s[g][1], _mm256_sub_pd(s[g][3], lambda[g]), s[g][4] },
+                            { s[g][2], s[g][4], _mm256_sub_pd(s[g][5], lambda[g]) } };
+        __m256d best[3], best_sq = zero;
+        for (int k = 0; k < 3; ++k)
+        {
+          __m256d const * u = r[ROTATIONS[k][0]], * v = r[ROTATIONS[k][1]];
+          __m256d x = _mm256_sub_pd(_mm256_mul_pd(u[1], v[2]), _mm256_mul_pd(u[2], v[1]));
+          __m256d y = _mm256_sub_pd(_mm256_mul_pd(u[2], v[0]), _mm256_mul_pd(u[0], v[2]));
+          __m256d z = _mm256_sub_pd(_mm256_mul_pd(u[0], v[1]), _mm256_mul_pd(u[1], v[0]));
+          __m256d sq = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y)), _mm256_mul_pd(z, z));
+          __m256d longer = (k == 0 ? _mm256_cmp_pd(zero, zero, _CMP_EQ_OQ) : _mm256_cmp_pd(sq, best_sq, _CMP_GT_OQ));
+          best[0] = (k == 0 ? x : _mm256_blendv_pd(best[0], x, longer));
+          best[1] = (k == 0 ? y : _mm256_blendv_pd(best[1], y, longer));
+          best[2] = (k == 0 ? z : _mm256_blendv_pd(best[2], z, longer));
+          best_sq = _mm256_blendv_pd(best_sq, sq, longer);
+        }
+
+        __m256d gap = _mm256_set1_pd(MIN_EIGEN_GAP * MIN_EIGEN_GAP);
+        __m256d min_sq = _mm256_mul_pd(gap, _mm256_mul_pd(_mm256_mul_pd(c2[g], c2[g]), _mm256_mul_pd(c2[g], c2[g])));
+        __m256d ok = _mm256_and_pd(_mm256_and_pd(_mm256_cmp_pd(best_sq, min_sq, _CMP_GT_OQ), converged[g]),
+                                   _mm256_cmp_pd(c2[g], _mm256_set1_pd(DBL_MAX), _CMP_LE_OQ));
+        __m256d scale = _mm256_div_pd(_mm256_set1_pd(1.0), _mm256_sqrt_pd(best_sq));
+        for (int k = 0; k < 3; ++k)
+          e[g][k] = _mm256_blendv_pd(_mm256_and_pd(ok, _mm256_mul_pd(best[k], scale)), e[g][k], triangle[g]);
+      }
+    }
+
+    for (long g = 0; g < NUM_GROUPS && count[g] > 0; ++g)
+    {
+      __m256d dot = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(e[g][0], w[g][0]), _mm256_mul_pd(e[g][1], w[g][1])),
+                                  _mm256_mul_pd(e[g][2], w[g][2]));
+      __m256d sign = _mm256_blendv_pd(_mm256_set1_pd(1.0), _mm256_set1_pd(-1.0), _mm256_cmp_pd(dot, zero, _CMP_LT_OQ));
+      for (int k = 0; k < 3; ++k)
+      {
+        scatter4(c[g][k], centroids + 3 * (i + 4 * g), 3, count[g], k);
+        scatter4(_mm256_mul_pd(sign, e[g][k]), normals + 3 * (i + 4 * g), 3, count[g], k);
+      }
+    }
+  }
+}
+
+#endif // DGP_MATRIX3_BATCH_X86
+
+} // namespace Matrix3BatchInternal
+
+Matrix3Batch::InstructionSet
+Matrix3Batch::supported()
+{
+  static InstructionSet const best = []() {
+#ifdef DGP_MATRIX3_BATCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      return InstructionSet(InstructionSet::AVX2);
+#endif
+
+    return InstructionSet(InstructionSet::SCALAR);
+  }();
+
+  return best;
+}
+
+Matrix3Batch::InstructionSet
+Matrix3Batch::active()
+{
+  return InstructionSet(std::min((int)supported(), Matrix3BatchInternal::limit.load()));
+}
+
+Matrix3Batch::InstructionSet
+Matrix3Batch::setLimit(InstructionSet limit)
+{
+  Matrix3BatchInternal::limit.store((int)limit);
+  return active();
+}
+
+char const *
+Matrix3Batch::name(InstructionSet set)
+{
+  switch (set)
+  {
+    case InstructionSet::AVX2: return "AVX2";
+    default:                   return "scalar";
+  }
+}
+
+void
+Matrix3Batch::invert(InstructionSet set, long n, double const * m, double * inv, double * det)
+{
+  using namespace Matrix3BatchInternal;
+
+  if ((int)set > (int)supported())
+    set = supported();
+
+  switch (set)
+  {
+#ifdef DGP_MATRIX3_BATCH_X86
+    case InstructionSet::AVX2: invertAVX2(n, m, inv, det); break;
+#endif
+    default:                   invertScalar(n, m, inv, det);
+  }
+}
+
+void
+Matrix3Batch::symmetricEigen(InstructionSet set, long n, double const * sym, double * eigenvalues, double * eigenvectors)
+{
+  using namespace Matrix3BatchInternal;
+
+  if ((int)set > (int)supported())
+    set = supported();
+
+  switch (set)
+  {
+#ifdef DGP_MATRIX3_BATCH_X86
+    case InstructionSet::AVX2: symmetricEigenAVX2(n, sym, eigenvalues, eigenvectors); break;
+#endif
+    default:                   symmetricEigenScalar(n, sym, eigenvalues, eigenvectors);
+  }
+}
+
+void
+Matrix3Batch::fitPlanes(InstructionSet set, long n, Vector3 const * points, long const * point_start, Plane3 * planes)
+{
+  using namespace Matrix3BatchInternal;
+
+  if ((int)set > (int)supported())
+    set = supported();
+
+  double centroids[3 * PLANE_CHUNK], normals[3 * PLANE_CHUNK];
+  double sym[6 * PLANE_CHUNK], windings[3 * PLANE_CHUNK], eigenvalues[3 * PLANE_CHUNK], eigenvectors[9 * PLANE_CHUNK];
+  long pending[PLANE_CHUNK];
+  for (long begin = 0; begin < n; begin += PLANE_CHUNK)
+  {
+    long count = std::min(n - begin, PLANE_CHUNK);
+    switch (set)
+    {
+#ifdef DGP_MATRIX3_BATCH_X86
+      case InstructionSet::AVX2: planeNormalsAVX2(count, points, point_start + begin, centroids, normals); break;
+#endif
+      default:                   planeNormalsScalar(count, points, point_start + begin, centroids, normals);
+    }
+
+    // The sets without a normal, which are rare, are decomposed together
+    long num_pending = 0;
+    for (long j = 0; j < count; ++j)
+    {
+      double const * e = normals + 3 * j;
+      if (e[0] == 0 && e[1] == 0 && e[2] == 0)
+      {
+        long i = begin + j;
+        planeMomentsScalar(points + point_start[i], point_start[i + 1] - point_start[i], centroids + 3 * j,
+                           windings + 3 * num_pending, sym + 6 * num_pending);
+        pending[num_pending++] = j;
+      }
+    }
+
+    if (num_pending > 0)
+    {
+      // The normal is the eigenvector of the smallest eigenvalue, oriented to agree with the winding
+      symmetricEigen(set, num_pending, sym, eigenvalues, eigenvectors);
+      for (long k = 0; k < num_pending; ++k)
+      {
+        double const * v = eigenvectors + 9 * k, * w = windings + 3 * k;
+        double sign = ((v[0] * w[0] + v[1] * w[1]) + v[2] * w[2] < 0 ? -1.0 : 1.0);
+        for (int l = 0; l < 3; ++l)
+          normals[3 * pending[k] + l] = sign * v[l];
+      }
+    }
+
+    for (long j = 0; j < count; ++j)
+    {
+      double const * c = centroids + 3 * j, * e = normals + 3 * j;
+      Vector3 normal((Real)e[0], (Real)e[1], (Real)e[2]);
+      planes[begin + j] = Plane3::fromPointAndNormal(Vector3((Real)c[0], (Real)c[1], (Real)c[2]), normal);
+    }
+  }
+}
+
+} // namespace DGP
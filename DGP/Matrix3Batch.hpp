@@ -0,0 +1,133 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#ifndef __DGP_Matrix3Batch_hpp__
+#define __DGP_Matrix3Batch_hpp__
+
+#include "Common.hpp"
+#include "Plane3.hpp"
+#include "Vector3.hpp"
+
+namespace DGP {
+
+/**
+ * Batched kernels for 3x3 matrices in double precision: inverses, symmetric eigendecompositions and least-squares plane fits,
+ * over arrays of many small problems at once, such as a plane per face of a mesh or a quadric per edge. The matrices of a batch
+ * are processed 4 at a time with AVX2 when the CPU supports it (detected at run time), else one at a time.
+ *
+ * Both code paths perform the same operations in the same order, without fused multiply-adds, and every matrix is processed
+ * on its own, so the result for a matrix does not depend on the other matrices in the batch, its position in it, or the size
+ * of the batch. Unless the compiler contracts the scalar path to fused multiply-adds, the paths agree bit for bit.
+ *
+ * A general 3x3 matrix is stored as 9 consecutive values in row-major order. A symmetric 3x3 matrix is stored as its upper
+ * triangle, 6 consecutive values in the order (xx, xy, xz, yy, yz, zz).
+ */
+class DGP_API Matrix3Batch
+{
+  public:
+    /** Instruction sets with a separate code path (enum class). */
+    struct InstructionSet
+    {
+      /** Supported values, in order of increasing vector width. */
+      enum Value
+      {
+        SCALAR,  ///< Plain C++, one matrix at a time. Always available.
+        AVX2     ///< AVX2, 4 matrices at a time.
+      };
+
+      DGP_ENUM_CLASS_BODY(InstructionSet)
+    };
+
+    /** Number of cyclic Jacobi sweeps of symmetricEigen(), each of 3 rotations. */
+    static int const NUM_SWEEPS = 5;
+
+    /** Get the widest instruction set supported by this CPU and build. Detected on the first call. */
+    static InstructionSet supported();
+
+    /** Get the instruction set used by the kernels, which is the widest supported one unless limited by setLimit(). */
+    static InstructionSet active();
+
+    /**
+     * Limit the instruction set used by the kernels, for instance to validate the vector path against the scalar one. Takes
+     * effect for all threads. Returns the instruction set that is now active.
+     */
+    static InstructionSet setLimit(InstructionSet limit);
+
+    /** Get the name of an instruction set, for display. */
+    static char const * name(InstructionSet set);
+
+    /**
+     * Invert \a n general 3x3 matrices by cofactors, using the active instruction set.
+     *
+     * @param n The number of matrices.
+     * @param m The matrices, 9 values each.
+     * @param inv Used to return the inverses, 9 values each. A matrix with zero determinant gets all zeros.
+     * @param det Used to return the determinants, one per matrix, which the caller should compare to a tolerance suited to
+     *   its matrices to decide if an inverse is usable.
+     */
+    static void invert(long n, double const * m, double * inv, double * det) { invert(active(), n, m, inv, det); }
+
+    /** Invert matrices as invert() does, with a specific instruction set, or the widest supported one if it is not. */
+    static void invert(InstructionSet set, long n, double const * m, double * inv, double * det);
+
+    /**
+     * Compute the eigenvalues and eigenvectors of \a n symmetric 3x3 matrices, with a fixed number (NUM_SWEEPS) of cyclic
+     * Jacobi sweeps, using the active instruction set. The eigenvectors are orthonormal and accurate even when eigenvalues
+     * are repeated. Entries should be well below 1e150 in magnitude, so their squares do not overflow.
+     *
+     * @param n The number of matrices.
+     * @param sym The symmetric matrices, 6 values each.
+     * @param eigenvalues Used to return the eigenvalues of each matrix, 3 values each, in ascending order.
+     * @param eigenvectors Used to return the unit eigenvectors of each matrix, 9 values each: the eigenvector of the i'th
+     *   eigenvalue is at offset 3 * i. May be null if only the eigenvalues are wanted.
+     */
+    static void symmetricEigen(long n, double const * sym, double * eigenvalues, double * eigenvectors)
+    {
+      symmetricEigen(active(), n, sym, eigenvalues, eigenvectors);
+    }
+
+    /**
+     * Compute eigendecompositions as symmetricEigen() does, with a specific instruction set, or the widest supported one if it
+     * is not.
+     */
+    static void symmetricEigen(InstructionSet set, long n, double const * sym, double * eigenvalues, double * eigenvectors);
+
+    /**
+     * Fit a plane to each of \a n sets of points in the least-squares sense, using the active instruction set. Each plane
+     * passes through the centroid of its points, with the normal along the eigenvector of the smallest eigenvalue of their
+     * covariance matrix. The normal is oriented to agree with the winding of the points, as the vertices of a polygon, by the
+     * sum of the cross products of a fan of triangles. For the vertices of a planar polygon, this is the plane of the polygon.
+     * Sets of fewer than 3 points, or of collinear points, get a plane through their centroid with an arbitrary normal.
+     *
+     * The normal of a triangle is the unit cross product of its edges. For other sets, the smallest eigenvalue is found by a
+     * fixed number of Newton steps on the characteristic polynomial, and its eigenvector by cross products, in the same vector
+     * lane as the covariance matrix, without Jacobi sweeps. Only sets whose two smallest eigenvalues are too close for that to
+     * be accurate, such as collinear points, are decomposed by symmetricEigen().
+     *
+     * @param n The number of sets.
+     * @param points The points of all the sets, set after set.
+     * @param point_start The position in \a points of the first point of each set, and one past the last point, so
+     *   <tt>n + 1</tt> values.
+     * @param planes Used to return the fitted planes.
+     */
+    static void fitPlanes(long n, Vector3 const * points, long const * point_start, Plane3 * planes)
+    {
+      fitPlanes(active(), n, points, point_start, planes);
+    }
+
+    /** Fit planes as fitPlanes() does, with a specific instruction set, or the widest supported one if it is not. */
+    static void fitPlanes(InstructionSet set, long n, Vector3 const * points, long const * point_start, Plane3 * planes);
+
+}; // class Matrix3Batch
+
+} // namespace DGP
+
+#endif
@@ -0,0 +1,116 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#include "PointHashGrid3.hpp"
+#include "AxisAlignedBox3.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace DGP {
+
+void
+PointHashGrid3::build(Vector3 const * points, long num_points, Real radius_hint)
+{
+  static int32 const MAX_CELL = (1 << 21) - 1;  // cell coordinates are packed into 21 bits each
+
+  AxisAlignedBox3 bounds;
+  for (long i = 0; i < num_points; ++i)
+    bounds.merge(points[i]);
+
+  origin = (num_points > 0 ? bounds.getLow() : Vector3::zero());
+  Vector3 ext = (num_points > 0 ? bounds.getExtent() : Vector3::zero());
+  Real max_ext = std::max(ext.x(), std::max(ext.y(), ext.z()));
+
+  if (radius_hint > 0)
+    cell_size = radius_hint;
+  else
+  {
+    // About 4 points per cell if the points were spread uniformly through the box
+    Real vol = std::max(ext.x(), max_ext * 1e-3f) * std::max(ext.y(), max_ext * 1e-3f) * std::max(ext.z(), max_ext * 1e-3f);
+    cell_size = (num_points > 0 && vol > 0 ? std::cbrt(4 * vol / num_points) : 1);
+  }
+
+  // Keep coordinates within range
+  cell_size = std::max(cell_size, max_ext / (MAX_CELL - 1));
+  if (!(cell_size > 0)) cell_size = 1;
+
+  inv_cell_size = 1 / cell_size;
+  max_cell = MAX_CELL;
+
+  size_t num_buckets = 1;
+  while (num_buckets < 2 * (size_t)num_points) num_buckets <<= 1;
+  hash_mask = (uint64)num_buckets - 1;
+
+  // Counting sort of points by bucket
+  std::vector<uint64> keys((size_t)num_points);
+  bucket_offsets.assign(num_buckets + 1, 0);
+  int32 cell[3];
+  for (long i = 0; i < num_points; ++i)
+  {
+    getCell(points[i], cell);
+    keys[(size_t)i] = cellKey(cell[0], cell[1], cell[2]);
+    bucket_offsets[(size_t)bucket(keys[(size_t)i]) + 1]++;
+  }
+
+  for (size_t b = 0; b < num_buckets; ++b)
+    bucket_offsets[b + 1] += bucket_offsets[b];
+
+  sorted_keys.resize((size_t)num_points);
+  sorted_points.resize((size_t)num_points);
+  sorted_indices.resize((size_t)num_points);
+
+  std::vector<uint32> fill(bucket_offsets.begin(), bucket_offsets.end() - 1);
+  for (long i = 0; i < num_points; ++i)
+  {
+    uint32 dst = fill[(size_t)bucket(keys[(size_t)i])]++;
+    sorted_keys[dst] = keys[(size_t)i];
+    sorted_points[dst] = points[i];
+    sorted_indices[dst] = (uint32)i;
+  }
+}
+
+void
+PointHashGrid3::getCell(Vector3 const & p, int32 cell[3]) const
+{
+  for (int i = 0; i < 3; ++i)
+  {
+    Real c = std::floor((p[i] - origin[i]) * inv_cell_size);
+    cell[i] = (c <= 0 ? 0 : (c >= max_cell ? max_cell : (int32)c));
+  }
+}
+
+void
+PointHashGrid3::rangeQuery(Vector3 const & center, Real radius, std::vector<uint32> & result) const
+{
+  result.clear();
+  if (sorted_indices.empty() || radius <= 0)
+    return;
+
+  int32 lo[3], hi[3];
+  getCell(center - Vector3(radius, radius, radius), lo);
+  getCell(center + Vector3(radius, radius, radius), hi);
+
+  Real r2 = radius * radius;
+  for (int32 x = lo[0]; x <= hi[0]; ++x)
+    for (int32 y = lo[1]; y <= hi[1]; ++y)
+      for (int32 z = lo[2]; z <= hi[2]; ++z)
+      {
+        uint64 key = cellKey(x, y, z);
+        uint64 b = bucket(key);
+        for (uint32 i = bucket_offsets[(size_t)b], end = bucket_offsets[(size_t)b + 1]; i < end; ++i)
+        {
+          if (sorted_keys[i] == key && (sorted_points[i] - center).squaredLength() < r2)
+            result.push_back(sorted_indices[i]);
+        }
+      }
+}
+
+} // namespace DGP
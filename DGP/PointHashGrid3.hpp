@@ -0,0 +1,77 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#ifndef __DGP_PointHashGrid3_hpp__
+#define __DGP_PointHashGrid3_hpp__
+
+#include "Common.hpp"
+#include "PointIndex3.hpp"
+#include "Vector3.hpp"
+
+namespace DGP {
+
+/**
+ * A uniform grid over a set of points in 3-space, with cells hashed into a table of buckets. Points are stored bucket by bucket
+ * in contiguous arrays (a counting sort by hash), so a query only touches the runs of the buckets of cells overlapping the
+ * query ball. Best suited to queries with radius close to the cell size.
+ */
+class DGP_API PointHashGrid3 : public PointIndex3
+{
+  public:
+    /** Constructor. */
+    PointHashGrid3() : cell_size(1), inv_cell_size(1), hash_mask(0) {}
+
+    /**
+     * Build the grid. The cell size is set to \a radius_hint if it is positive, else chosen so that cells contain a few points
+     * on average for a uniform distribution over the bounding box.
+     */
+    void build(Vector3 const * points, long num_points, Real radius_hint = -1);
+
+    long numPoints() const { return (long)sorted_indices.size(); }
+
+    void rangeQuery(Vector3 const & center, Real radius, std::vector<uint32> & result) const;
+
+    /** Get the edge length of each cell. */
+    Real getCellSize() const { return cell_size; }
+
+  private:
+    /** Integer coordinates of the cell containing a point, clamped to the valid range. */
+    void getCell(Vector3 const & p, int32 cell[3]) const;
+
+    /** Pack integer cell coordinates into a single key. */
+    static uint64 cellKey(int32 x, int32 y, int32 z)
+    {
+      return ((uint64)(uint32)x << 42) | ((uint64)(uint32)y << 21) | (uint64)(uint32)z;
+    }
+
+    /** Hash a cell key into the bucket table. */
+    uint64 bucket(uint64 key) const
+    {
+      key ^= key >> 31;
+      key *= 0x9E3779B97F4A7C15ULL;
+      return (key >> 29) & hash_mask;
+    }
+
+    Real cell_size;                      ///< Edge length of each cell.
+    Real inv_cell_size;                  ///< Reciprocal of the cell size.
+    Vector3 origin;                      ///< Lower corner of the grid.
+    int32 max_cell;                      ///< Maximum cell coordinate along each axis.
+    uint64 hash_mask;                    ///< Number of buckets minus one (the number of buckets is a power of 2).
+    std::vector<uint32> bucket_offsets;  ///< Start of each bucket's run in the sorted arrays.
+    std::vector<uint64> sorted_keys;     ///< Cell key of each point, in bucket order.
+    std::vector<Vector3> sorted_points;  ///< Points, in bucket order.
+    std::vector<uint32> sorted_indices;  ///< Original index of each point, in bucket order.
+
+}; // class PointHashGrid3
+
+} // namespace DGP
+
+#endif
@@ -0,0 +1,54 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#ifndef __DGP_PointIndex3_hpp__
+#define __DGP_PointIndex3_hpp__
+
+#include "Common.hpp"
+#include "Vector3.hpp"
+#include <vector>
+
+namespace DGP {
+
+/**
+ * Interface for spatial indices over a static set of points in 3-space, answering fixed-radius neighbour queries. The index
+ * keeps its own copy of the points, so the source array may be modified after build() without affecting query results.
+ */
+class DGP_API PointIndex3
+{
+  public:
+    /** Destructor. */
+    virtual ~PointIndex3() {}
+
+    /**
+     * Build the index over an array of points, discarding any previous contents.
+     *
+     * @param points The points to index. Queries return positions in this array.
+     * @param num_points The number of points.
+     * @param radius_hint The radius of typical queries, which some indices use to choose their resolution. Ignored if
+     *   non-positive.
+     */
+    virtual void build(Vector3 const * points, long num_points, Real radius_hint = -1) = 0;
+
+    /** Get the number of indexed points. */
+    virtual long numPoints() const = 0;
+
+    /**
+     * Find all points strictly closer than \a radius to \a center. The indices of the points are written to \a result, which
+     * is cleared first and whose capacity is reused. The order of the results is unspecified.
+     */
+    virtual void rangeQuery(Vector3 const & center, Real radius, std::vector<uint32> & result) const = 0;
+
+}; // class PointIndex3
+
+} // namespace DGP
+
+#endif
@@ -0,0 +1,120 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#include "PointKDTree3.hpp"
+#include "AxisAlignedBox3.hpp"
+#include <algorithm>
+
+namespace DGP {
+
+namespace PointKDTree3Internal {
+
+// Orders point indices by one coordinate of the points.
+struct AxisLess
+{
+  AxisLess(Vector3 const * points_, int axis_) : points(points_), axis(axis_) {}
+  bool operator()(uint32 a, uint32 b) const { return points[a][axis] < points[b][axis]; }
+
+  Vector3 const * points;
+  int axis;
+};
+
+} // namespace PointKDTree3Internal
+
+void
+PointKDTree3::build(Vector3 const * points, long num_points, Real radius_hint)
+{
+  (void)radius_hint;
+
+  nodes.clear();
+  sorted_points.assign(points, points + num_points);
+  sorted_indices.resize((size_t)num_points);
+  for (long i = 0; i < num_points; ++i)
+    sorted_indices[(size_t)i] = (uint32)i;
+
+  if (num_points <= 0)
+    return;
+
+  nodes.reserve(2 * (size_t)(num_points / MAX_LEAF_POINTS + 1));
+  Node root = { 0, (uint32)num_points, 0, 0, 0 };
+  nodes.push_back(root);
+  buildNode(0);
+
+  // Store the points in leaf order
+  for (size_t i = 0; i < sorted_indices.size(); ++i)
+    sorted_points[i] = points[sorted_indices[i]];
+}
+
+void
+PointKDTree3::buildNode(uint32 node_index)
+{
+  uint32 begin = nodes[node_index].begin, end = nodes[node_index].end;
+  if (end - begin <= (uint32)MAX_LEAF_POINTS)
+    return;
+
+  // Points have not been reordered yet, so sorted_points still holds them in their original order
+  AxisAlignedBox3 bounds;
+  for (uint32 i = begin; i < end; ++i)
+    bounds.merge(sorted_points[sorted_indices[i]]);
+
+  Vector3 ext = bounds.getExtent();
+  int axis = (ext.x() >= ext.y() ? (ext.x() >= ext.z() ? 0 : 2) : (ext.y() >= ext.z() ? 1 : 2));
+
+  uint32 mid = begin + (end - begin) / 2;
+  std::nth_element(sorted_indices.begin() + begin, sorted_indices.begin() + mid, sorted_indices.begin() + end,
+                   PointKDTree3Internal::AxisLess(&sorted_points[0], axis));
+
+  uint32 child = (uint32)nodes.size();
+  nodes[node_index].child = child;
+  nodes[node_index].axis = axis;
+  nodes[node_index].split = sorted_points[sorted_indices[mid]][axis];
+
+  Node lo = { begin, mid, 0, 0, 0 };
+  Node hi = { mid, end, 0, 0, 0 };
+  nodes.push_back(lo);
+  nodes.push_back(hi);
+
+  buildNode(child);
+  buildNode(child + 1);
+}
+
+void
+PointKDTree3::rangeQuery(Vector3 const & center, Real radius, std::vector<uint32> & result) const
+{
+  result.clear();
+  if (nodes.empty() || radius <= 0)
+    return;
+
+  Real r2 = radius * radius;
+  uint32 stack[64];
+  int top = 0;
+  stack[top++] = 0;
+
+  while (top > 0)
+  {
+    Node const & node = nodes[stack[--top]];
+    if (node.child == 0)
+    {
+      for (uint32 i = node.begin; i < node.end; ++i)
+        if ((sorted_points[i] - center).squaredLength() < r2)
+          result.push_back(sorted_indices[i]);
+    }
+    else
+    {
+      // The first child holds points <= split and the second points >= split
+      Real d = center[node.axis] - node.split;
+      if (d < radius)  stack[top++] = node.child;
+      if (d > -radius) stack[top++] = node.child + 1;
+    }
+  }
+}
+
+} // namespace DGP
@@ -0,0 +1,65 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#ifndef __DGP_PointKDTree3_hpp__
+#define __DGP_PointKDTree3_hpp__
+
+#include "Common.hpp"
+#include "PointIndex3.hpp"
+#include "Vector3.hpp"
+
+namespace DGP {
+
+/**
+ * A balanced k-d tree over a set of points in 3-space. Each node splits its points at the median along the axis of greatest
+ * extent, down to small leaves. Nodes are stored in a flat array, and points in leaf order in a contiguous array, so that the
+ * points of each subtree are consecutive in memory. Unlike PointHashGrid3, performance does not depend on choosing a cell size
+ * to match the query radius.
+ */
+class DGP_API PointKDTree3 : public PointIndex3
+{
+  public:
+    /** Constructor. */
+    PointKDTree3() {}
+
+    /** Build the tree. \a radius_hint is ignored. */
+    void build(Vector3 const * points, long num_points, Real radius_hint = -1);
+
+    long numPoints() const { return (long)sorted_indices.size(); }
+
+    void rangeQuery(Vector3 const & center, Real radius, std::vector<uint32> & result) const;
+
+  private:
+    /** Maximum number of points in a leaf. */
+    static int const MAX_LEAF_POINTS = 8;
+
+    /** A node of the tree. */
+    struct Node
+    {
+      uint32 begin;  ///< Index of the first point of the node in the sorted arrays.
+      uint32 end;    ///< One past the index of the last point of the node in the sorted arrays.
+      uint32 child;  ///< Index of the first child (the second child follows it), or 0 for a leaf.
+      int32 axis;    ///< Splitting axis.
+      Real split;    ///< Splitting coordinate: the first child holds points at or below it, the second at or above it.
+    };
+
+    /** Recursively build the subtree of a node. */
+    void buildNode(uint32 node_index);
+
+    std::vector<Node> nodes;             ///< Nodes of the tree, with the root first.
+    std::vector<Vector3> sorted_points;  ///< Points, in leaf order.
+    std::vector<uint32> sorted_indices;  ///< Original index of each point, in leaf order.
+
+}; // class PointKDTree3
+
+} // namespace DGP
+
+#endif
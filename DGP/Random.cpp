@@ -176,6 +176,27 @@ Random::gaussian(Real mean, Real stddev)
   return x2 * (Real)Math::square(stddev) * std::sqrt((-2.0f * std::log(w) ) / w) + mean;
 }
 
+void
+Random::fillUniform(Real lo, Real hi, Real * out, long n)
+{
+  for (long i = 0; i < n; ++i)
+    out[i] = uniform(lo, hi);
+}
+
+void
+Random::fillGaussian(Real mean, Real stddev, Real * out, long n)
+{
+  for (long i = 0; i < n; i += 2)
+  {
+    Real g0, g1;
+    uint32 w0 = bits();
+    toGaussians(w0, bits(), g0, g1);
+    out[i] = mean + stddev * g0;
+    if (i + 1 < n)
+      out[i + 1] = mean + stddev * g1;
+  }
+}
+
 void
 Random::cosHemi(Real & x, Real & y, Real & z)
 {
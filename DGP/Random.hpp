@@ -29,6 +29,7 @@
 #include "Common.hpp"
 #include "Spinlock.hpp"
 #include <algorithm>
+#include <cmath>
 
 namespace DGP {
 
@@ -130,6 +131,35 @@ class DGP_API Random
     /** Generate normally distributed real numbers. */
     virtual Real gaussian(Real mean, Real stddev);
 
+    /**
+     * Fill an array with uniform random real numbers in the range [lo, hi]. The result is the same as \a n calls to
+     * uniform(), but subclasses can generate the numbers in bulk.
+     */
+    virtual void fillUniform(Real lo, Real hi, Real * out, long n);
+
+    /**
+     * Fill an array with normally distributed real numbers, with the given mean and standard deviation. The numbers are
+     * generated in pairs by the Box-Muller transform (see toGaussians()), so they differ from the results of calls to
+     * gaussian(). Subclasses can generate the numbers in bulk.
+     */
+    virtual void fillGaussian(Real mean, Real stddev, Real * out, long n);
+
+    /** Map a random word to a real number uniformly distributed in the open interval (0, 1), so it is safe to take its log. */
+    static Real toUniform01(uint32 word)
+    {
+      // The top 24 bits, offset by half a step, fit the float mantissa exactly
+      return ((Real)(word >> 8) + 0.5f) * (1.0f / 16777216.0f);
+    }
+
+    /** Map two random words to two independent standard normal numbers, with the Box-Muller transform. */
+    static void toGaussians(uint32 word0, uint32 word1, Real & g0, Real & g1)
+    {
+      Real r = std::sqrt(-2 * std::log(toUniform01(word0)));
+      Real theta = 6.28318531f * toUniform01(word1);
+      g0 = r * std::cos(theta);
+      g1 = r * std::sin(theta);
+    }
+
     /** Generate 3D unit vectors distributed according to a cosine distribution about the z-axis. */
     virtual void cosHemi(Real & x, Real & y, Real & z);
 
@@ -0,0 +1,82 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#ifndef __DGP_RandomStreams_hpp__
+#define __DGP_RandomStreams_hpp__
+
+#include "Common.hpp"
+#include "CounterRandom.hpp"
+#include "Noncopyable.hpp"
+#include <memory>
+#include <vector>
+
+namespace DGP {
+
+/**
+ * A set of independent random number generators, one for each thread working on a parallel loop, so that threads draw random
+ * numbers without sharing a lock, unlike Random::common(). Generator \a i reads stream <tt>first_stream + i</tt> of a
+ * CounterRandom with the given seed: the streams are statistically independent and each is reproducible, and any generator
+ * can jump ahead in its stream in constant time (CounterRandom::seek()).
+ *
+ * Typical use, with one generator per participant of a ThreadPool loop:
+ * \code
+ *   RandomStreams streams(seed, pool.maxParticipants());
+ *   pool.parallelFor(0, n, [&](long lo, long hi, long participant) {
+ *     streams[participant].fillUniform(0, 1, &samples[lo], hi - lo);
+ *   });
+ * \endcode
+ *
+ * The numbers each item of such a loop gets depend on how the loop is split among the threads. If they must not depend on the
+ * number of threads, give each item its own stream instead (CounterRandom::setStream()).
+ */
+class RandomStreams : private Noncopyable
+{
+  public:
+    /**
+     * Constructor.
+     *
+     * @param seed The key of the generators.
+     * @param num_streams The number of generators.
+     * @param first_stream The stream index read by the first generator. Sets with the same seed draw different numbers if
+     *   their ranges of stream indices do not overlap.
+     */
+    RandomStreams(uint64 seed, long num_streams, uint64 first_stream = 0)
+    {
+      alwaysAssertM(num_streams >= 0, "RandomStreams: Number of streams must be non-negative");
+
+      streams.reserve((size_t)num_streams);
+      for (long i = 0; i < num_streams; ++i)
+        streams.push_back(std::unique_ptr<Padded>(new Padded(seed, first_stream + (uint64)i)));
+    }
+
+    /** Get the number of generators. */
+    long size() const { return (long)streams.size(); }
+
+    /** Get a generator. */
+    CounterRandom & operator[](long i) { return streams[(size_t)i]->random; }
+
+  private:
+    /** A generator, padded so that generators allocated one after the other do not share a cache line. */
+    struct Padded
+    {
+      Padded(uint64 seed, uint64 stream) : random(seed, stream) {}
+
+      CounterRandom random;
+      char padding[64];
+    };
+
+    std::vector< std::unique_ptr<Padded> > streams;  ///< The generators.
+
+}; // class RandomStreams
+
+} // namespace DGP
+
+#endif
@@ -0,0 +1,175 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#ifndef __DGP_SparseTriplets_hpp__
+#define __DGP_SparseTriplets_hpp__
+
+#include "Common.hpp"
+#include "CompressedSparseMatrix.hpp"
+#include "ThreadPool.hpp"
+#include <vector>
+
+namespace DGP {
+
+/**
+ * A list of (row, column, value) triplets (coordinate format) for assembling a CompressedRowMatrix or CompressedColumnMatrix.
+ * Triplets may repeat a (row, column) pair, in which case their values are summed, as when adding the contributions of each
+ * face of a mesh to a matrix.
+ *
+ * compress() buckets the triplets by row (or column) and sorts each bucket in parallel, which takes time linear in the number
+ * of triplets apart from sorting the short buckets, and remembers where each triplet went. When the pattern of the matrix does
+ * not change, as when a matrix is reassembled every iteration on a fixed mesh, refill() then overwrites just the values of the
+ * matrix, without sorting. In both cases the values are summed in the order the triplets were added, so the result does not
+ * depend on the number of threads.
+ *
+ * Example:
+ * \code
+ *   SparseTriplets<double> triplets(n, n);
+ *   // ... triplets.add(row, col, value) ...
+ *   CompressedRowMatrix<double> m;
+ *   triplets.compress(m);
+ *
+ *   // Later, with new values for the same sequence of (row, column) pairs
+ *   triplets.clear();
+ *   // ... triplets.add(row, col, value) ...
+ *   triplets.refill(m);
+ * \endcode
+ */
+template <typename T>
+class /* DGP_API */ SparseTriplets
+{
+  public:
+    /** Constructor, for a matrix of the given size. */
+    SparseTriplets(long num_rows_ = 0, long num_cols_ = 0) : num_rows(0), num_cols(0) { resize(num_rows_, num_cols_); }
+
+    /** Get the number of rows of the matrix. */
+    long numRows() const { return num_rows; }
+
+    /** Get the number of columns of the matrix. */
+    long numColumns() const { return num_cols; }
+
+    /** Set the size of the matrix, removing all triplets and the pattern of the last compress(). */
+    void resize(long num_rows_, long num_cols_)
+    {
+      alwaysAssertM(num_rows_ >= 0 && num_cols_ >= 0, "SparseTriplets: Dimensions must be non-negative");
+
+      num_rows = num_rows_;
+      num_cols = num_cols_;
+      clear();
+      order.clear();
+      slot_start.clear();
+    }
+
+    /** Reserve space for a number of triplets. */
+    void reserve(long n)
+    {
+      rows.reserve((size_t)n);
+      cols.reserve((size_t)n);
+      values.reserve((size_t)n);
+    }
+
+    /** Add a triplet. */
+    void add(long row, long col, T const & value)
+    {
+      debugAssertM(row >= 0 && row < num_rows && col >= 0 && col < num_cols, "SparseTriplets: Index out of range");
+
+      rows.push_back(row);
+      cols.push_back(col);
+      values.push_back(value);
+    }
+
+    /** Get the number of triplets. */
+    long numTriplets() const { return (long)values.size(); }
+
+    /** Remove all triplets. The pattern of the last compress() is kept for refill(). */
+    void clear()
+    {
+      rows.clear();
+      cols.clear();
+      values.clear();
+    }
+
+    /** Get the row of each triplet, in the order they were added. */
+    std::vector<long> const & getRows() const { return rows; }
+
+    /** Get the column of each triplet, in the order they were added. */
+    std::vector<long> const & getColumns() const { return cols; }
+
+    /** Get the value of each triplet, in the order they were added. */
+    std::vector<T> const & getValues() const { return values; }
+
+    /** Get the value of each triplet, in the order they were added. Values may be overwritten in place before refill(). */
+    std::vector<T> & getValues() { return values; }
+
+    /** Check if there is a pattern from compress() for refill() to reuse. */
+    bool hasPattern() const { return !slot_start.empty(); }
+
+    /**
+     * Build a matrix from the triplets, replacing its previous contents. Every distinct (row, column) pair becomes a set
+     * element, even if its value sums to zero, so the pattern depends only on the indices of the triplets.
+     *
+     * @param m The matrix, a CompressedRowMatrix or CompressedColumnMatrix.
+     * @param pool Threads to use. If null, ThreadPool::common() is used.
+     */
+    template <typename MatrixT> void compress(MatrixT & m, ThreadPool * pool = NULL)
+    {
+      ThreadPool & p = (pool ? *pool : ThreadPool::common());
+      bool row_major = (MatrixT::Layout == MatrixLayout::ROW_MAJOR);
+      long n = numTriplets();
+
+      m.resize(num_rows, num_cols);
+      CompressedSparseMatrixInternal::compressPattern((row_major ? num_rows : num_cols), n,
+                                                      (n > 0 ? &(row_major ? rows : cols)[0] : NULL),
+                                                      (n > 0 ? &(row_major ? cols : rows)[0] : NULL),
+                                                      m.indices1, m.indices2, order, slot_start, p);
+      CompressedSparseMatrixInternal::sumSlots(order, slot_start, values.data(), m.values, p);
+    }
+
+    /**
+     * Overwrite the values of a matrix built by the last compress(), without changing its pattern. The triplets must have the
+     * same (row, column) pairs, in the same order, as when the matrix was built: only their values may differ.
+     *
+     * @param m The matrix, a CompressedRowMatrix or CompressedColumnMatrix built by compress().
+     * @param pool Threads to use. If null, ThreadPool::common() is used.
+     */
+    template <typename MatrixT> void refill(MatrixT & m, ThreadPool * pool = NULL) const
+    {
+      alwaysAssertM(hasPattern() && numTriplets() == (long)order.size()
+                 && m.numSetElements() == (long)slot_start.size() - 1,
+                    "SparseTriplets: Triplets or matrix do not match the pattern of the last compress()");
+
+#ifdef DGP_DEBUG_BUILD
+      // The triplets of each slot must have the same secondary index as the slot
+      bool row_major = (MatrixT::Layout == MatrixLayout::ROW_MAJOR);
+      for (size_t s = 0; s + 1 < slot_start.size(); ++s)
+        for (long k = slot_start[s]; k < slot_start[s + 1]; ++k)
+          debugAssertM((long)m.indices2[s] == (row_major ? cols : rows)[(size_t)order[(size_t)k]],
+                       "SparseTriplets: Triplets do not match the pattern of the last compress()");
+#endif
+
+      CompressedSparseMatrixInternal::sumSlots(order, slot_start, values.data(), m.values,
+                                               (pool ? *pool : ThreadPool::common()));
+    }
+
+  private:
+    long num_rows;                  ///< Number of rows of the matrix.
+    long num_cols;                  ///< Number of columns of the matrix.
+    std::vector<long> rows;         ///< Row of each triplet.
+    std::vector<long> cols;         ///< Column of each triplet.
+    std::vector<T> values;          ///< Value of each triplet.
+    std::vector<long> order;        ///< Triplets grouped by the element of the matrix they were summed into.
+    std::vector<long> slot_start;   ///< Position in #order of the first triplet of each element, and one past the last.
+
+}; // class SparseTriplets
+
+} // namespace DGP
+
+#endif
@@ -0,0 +1,154 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#ifndef __DGP_TextScanner_hpp__
+#define __DGP_TextScanner_hpp__
+
+#include "Common.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+
+namespace DGP {
+
+/**
+ * Minimal scanner for whitespace-separated words and numbers in a memory buffer, such as a memory-mapped text file (see
+ * MappedFile). Parses integers and reals by hand instead of through the locale-aware iostream machinery, falling back to
+ * strtof/strtod only for reals that cannot be converted exactly with a single floating-point operation, so the results are
+ * identical to reading with std::istream.
+ *
+ * A scanner is just a pair of pointers, so copying it saves the position in the buffer, to scan the same text again later.
+ */
+class TextScanner
+{
+  public:
+    /** Constructor, for the buffer [\a begin_, \a end_). */
+    TextScanner(char const * begin_, char const * end_) : curr(begin_), end(end_) {}
+
+    /** Read a whitespace-delimited word. */
+    bool readWord(std::string & word)
+    {
+      skipSpace();
+      char const * start = curr;
+      while (curr < end && !isSpace(*curr)) ++curr;
+      word.assign(start, curr);
+      return curr > start;
+    }
+
+    /** Read a signed decimal integer. */
+    bool readInteger(long & value)
+    {
+      skipSpace();
+      char const * start = curr;
+      bool neg = readSign();
+
+      long v = 0;
+      char const * digits = curr;
+      while (curr < end && isDigit(*curr)) v = 10 * v + (*curr++ - '0');
+
+      if (curr == digits || (curr < end && !isSpace(*curr))) { curr = start; return false; }
+
+      value = (neg ? -v : v);
+      return true;
+    }
+
+    /** Read a real number in decimal or scientific notation. */
+    bool readReal(Real & value)
+    {
+      // Powers of ten that are exactly representable as Real
+      static Real const POW10[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+      static int const MAX_EXACT_POW10 = 10;
+      static uint64 const MAX_EXACT_MANTISSA = (uint64)1 << std::numeric_limits<Real>::digits;
+
+      skipSpace();
+      char const * start = curr;
+      bool neg = readSign();
+
+      uint64 mantissa = 0;
+      int num_digits = 0, exponent = 0;
+      bool any_digits = false;
+      for ( ; curr < end && isDigit(*curr); ++curr, any_digits = true)
+        if (num_digits < 19) { mantissa = 10 * mantissa + (uint64)(*curr - '0'); if (mantissa) ++num_digits; }
+        else ++exponent;
+
+      if (curr < end && *curr == '.')
+      {
+        for (++curr; curr < end && isDigit(*curr); ++curr, any_digits = true)
+          if (num_digits < 19) { mantissa = 10 * mantissa + (uint64)(*curr - '0'); if (mantissa) ++num_digits; --exponent; }
+      }
+
+      if (!any_digits) { curr = start; return false; }
+
+      if (curr < end && (*curr == 'e' || *curr == 'E'))
+      {
+        ++curr;
+        bool exp_neg = readSign();
+        int e = 0;
+        char const * exp_digits = curr;
+        while (curr < end && isDigit(*curr)) { if (e < 100000) e = 10 * e + (*curr - '0'); ++curr; }
+        if (curr == exp_digits) { curr = start; return false; }
+        exponent += (exp_neg ? -e : e);
+      }
+
+      if (curr < end && !isSpace(*curr)) { curr = start; return false; }
+
+      // A single correctly rounded multiply or divide gives the correctly rounded result if both operands are exact
+      if (mantissa == 0)
+        value = (neg ? -(Real)0 : (Real)0);
+      else if (mantissa <= MAX_EXACT_MANTISSA && exponent >= -MAX_EXACT_POW10 && exponent <= MAX_EXACT_POW10)
+      {
+        Real r = (Real)mantissa;
+        r = (exponent >= 0 ? r * POW10[exponent] : r / POW10[-exponent]);
+        value = (neg ? -r : r);
+      }
+      else
+        return readRealSlow(start, value);
+
+      return true;
+    }
+
+  private:
+    /** Convert a token with the standard library. */
+    bool readRealSlow(char const * start, Real & value)
+    {
+      char buf[128];
+      size_t len = (size_t)(curr - start);
+      if (len >= sizeof(buf)) { curr = start; return false; }
+
+      std::memcpy(buf, start, len);
+      buf[len] = 0;
+      convert(buf, value);
+      return true;
+    }
+
+    static void convert(char const * s, float & value) { value = std::strtof(s, NULL); }
+    static void convert(char const * s, double & value) { value = std::strtod(s, NULL); }
+
+    static bool isSpace(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f'; }
+    static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+    bool readSign()
+    {
+      if (curr < end && (*curr == '-' || *curr == '+')) return *curr++ == '-';
+      return false;
+    }
+
+    void skipSpace() { while (curr < end && isSpace(*curr)) ++curr; }
+
+    char const * curr;  ///< The next character to scan.
+    char const * end;   ///< The end of the buffer.
+
+}; // class TextScanner
+
+} // namespace DGP
+
+#endif
@@ -0,0 +1,79 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#include "ThreadPool.hpp"
+#include "System.hpp"
+
+namespace DGP {
+
+ThreadPool::ThreadPool(long num_threads)
+: stopping(false)
+{
+  if (num_threads < 0)
+    num_threads = System::concurrency() - 1;
+
+  workers.reserve((size_t)num_threads);
+  for (long i = 0; i < num_threads; ++i)
+    workers.push_back(std::thread(&ThreadPool::workerMain, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    stopping = true;
+  }
+
+  wakeup.notify_all();
+
+  for (size_t i = 0; i < workers.size(); ++i)
+    workers[i].join();
+}
+
+void
+ThreadPool::enqueue(Task const & task)
+{
+  if (workers.empty())
+  {
+    task();
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    tasks.push_back(task);
+  }
+
+  wakeup.notify_one();
+}
+
+void
+ThreadPool::workerMain()
+{
+  while (true)
+  {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wakeup.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+      if (tasks.empty())  // stopping, and no work left
+        return;
+
+      task = tasks.front();
+      tasks.pop_front();
+    }
+
+    task();
+  }
+}
+
+} // namespace DGP
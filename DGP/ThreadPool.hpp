@@ -0,0 +1,180 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#ifndef __DGP_ThreadPool_hpp__
+#define __DGP_ThreadPool_hpp__
+
+#include "Common.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace DGP {
+
+/**
+ * A fixed set of worker threads that execute queued tasks, with a data-parallel loop on top.
+ *
+ * In parallelFor(), the calling thread processes chunks of the range alongside the workers and returns only when every chunk
+ * has been processed. Hence a loop makes progress even if all workers are busy, and loops may be nested inside tasks or other
+ * loops without deadlocking.
+ */
+class DGP_API ThreadPool : private Noncopyable
+{
+  public:
+    typedef std::function<void ()> Task;  ///< A unit of work.
+
+    /**
+     * Constructor.
+     *
+     * @param num_threads The number of worker threads. If negative, one less than the hardware concurrency is used, since the
+     *   thread calling parallelFor() also does work.
+     */
+    explicit ThreadPool(long num_threads = -1);
+
+    /** Destructor. Waits for queued tasks to finish. */
+    ~ThreadPool();
+
+    /** Get the number of worker threads. */
+    long numThreads() const { return (long)workers.size(); }
+
+    /**
+     * Get the maximum number of threads, including the calling thread, that can concurrently execute the body of a single
+     * parallelFor() loop. Per-thread scratch data for a loop should be allocated for this many threads.
+     */
+    long maxParticipants() const { return numThreads() + 1; }
+
+    /** Queue a task for execution on some worker thread. If there are no workers, the task is executed immediately. */
+    void enqueue(Task const & task);
+
+    /**
+     * Call \a func(lo, hi, participant) over disjoint chunks [lo, hi) covering [begin, end), in parallel. \a participant is
+     * a distinct integer in [0, maxParticipants()) for each thread working on the loop, and may be used to index per-thread
+     * scratch data. The function returns when all chunks have been processed. If any call throws an exception, the first
+     * exception is rethrown on the calling thread after all chunks have been processed.
+     *
+     * @param begin The first index of the range.
+     * @param end One past the last index of the range.
+     * @param func The loop body, called on subranges.
+     * @param grain The number of indices per chunk. If non-positive, a size giving several chunks per thread is chosen.
+     */
+    template <typename RangeFunc> void parallelFor(long begin, long end, RangeFunc func, long grain = 0)
+    {
+      if (end <= begin)
+        return;
+
+      long n = end - begin;
+      if (grain <= 0)
+        grain = std::max(1L, n / (8 * maxParticipants()));
+
+      long num_chunks = (n + grain - 1) / grain;
+      if (workers.empty() || num_chunks <= 1)
+      {
+        func(begin, end, 0L);
+        return;
+      }
+
+      std::shared_ptr<Loop> loop(new Loop(begin, end, grain, num_chunks, func));
+      long num_helpers = std::min(numThreads(), num_chunks - 1);
+      for (long i = 0; i < num_helpers; ++i)
+        enqueue([loop]() { loop->run(); });
+
+      loop->run();
+      loop->wait();
+
+      if (loop->error)
+        std::rethrow_exception(loop->error);
+    }
+
+    /** A shared pool, suggested for general usage, with as many threads as the hardware concurrency. */
+    static ThreadPool & common()
+    {
+      static ThreadPool pool;
+      return pool;
+    }
+
+  private:
+    /** State of a parallelFor() loop, shared by all threads working on it. */
+    struct Loop
+    {
+      typedef std::function<void (long, long, long)> Body;
+
+      /** Constructor. */
+      Loop(long begin_, long end_, long grain_, long num_chunks_, Body const & body_)
+      : begin(begin_), end(end_), grain(grain_), num_chunks(num_chunks_), body(body_), next_chunk(0), next_participant(0),
+        num_done(0)
+      {}
+
+      /** Process chunks until none remain. */
+      void run()
+      {
+        long participant = next_participant++;
+        long num_processed = 0;
+        for (long c = next_chunk++; c < num_chunks; c = next_chunk++, ++num_processed)
+        {
+          long lo = begin + c * grain;
+          long hi = std::min(lo + grain, end);
+
+          try
+          {
+            body(lo, hi, participant);
+          }
+          catch (...)
+          {
+            std::lock_guard<std::mutex> guard(mutex);
+            if (!error) error = std::current_exception();
+          }
+        }
+
+        if (num_processed > 0 && (num_done += num_processed) == num_chunks)
+        {
+          std::lock_guard<std::mutex> guard(mutex);
+          finished.notify_all();
+        }
+      }
+
+      /** Wait for all chunks to be processed. */
+      void wait()
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this]() { return num_done.load() == num_chunks; });
+      }
+
+      long begin, end, grain, num_chunks;
+      Body body;
+      std::atomic<long> next_chunk;
+      std::atomic<long> next_participant;
+      std::atomic<long> num_done;
+      std::mutex mutex;
+      std::condition_variable finished;
+      std::exception_ptr error;
+
+    }; // struct Loop
+
+    /** Main function of each worker thread. */
+    void workerMain();
+
+    std::vector<std::thread> workers;  ///< Worker threads.
+    std::deque<Task> tasks;            ///< Queued tasks.
+    std::mutex mutex;                  ///< Guards the task queue.
+    std::condition_variable wakeup;    ///< Signalled when a task is queued or the pool is shutting down.
+    bool stopping;                     ///< Set when the pool is being destroyed.
+
+}; // class ThreadPool
+
+} // namespace DGP
+
+#endif
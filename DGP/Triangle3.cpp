@@ -10,6 +10,7 @@
 //============================================================================
 
 #include "Triangle3.hpp"
+#include <algorithm>
 
 namespace DGP
 {
@@ -942,6 +943,42 @@ rayTriangleIntersectionTime(Ray3 const & ray, Vector3 const & v0, Vector3 const
   return -1;
 }
 
+bool
+triangleIntersectsAAB(Vector3 const & v0, Vector3 const & v1, Vector3 const & v2, Vector3 const & lo, Vector3 const & hi)
+{
+  // Separating axis test from Tomas Akenine-Moller, "Fast 3D Triangle-Box Overlap Testing", Journal of Graphics Tools,
+  // 6(1), 2001. The candidate axes are the face normals of the box, the normal of the triangle, and the cross products of
+  // the box and triangle edges. The objects are disjoint if and only if their projections on one of them are.
+  Vector3 center = 0.5f * (lo + hi);
+  Vector3 half = 0.5f * (hi - lo);
+  Vector3 u[3] = { v0 - center, v1 - center, v2 - center };
+
+  // Face normals of the box, i.e. the bounding box of the triangle against the box
+  for (int i = 0; i < 3; ++i)
+  {
+    if (std::min(u[0][i], std::min(u[1][i], u[2][i])) > half[i]) return false;
+    if (std::max(u[0][i], std::max(u[1][i], u[2][i])) < -half[i]) return false;
+  }
+
+  // Cross products of the triangle edges and the box edges
+  Vector3 edges[3] = { u[1] - u[0], u[2] - u[1], u[0] - u[2] };
+  Vector3 const * box_axes[3] = { &Vector3::unitX(), &Vector3::unitY(), &Vector3::unitZ() };
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j)
+    {
+      Vector3 axis = box_axes[j]->cross(edges[i]);
+      Real p0 = axis.dot(u[0]), p1 = axis.dot(u[1]), p2 = axis.dot(u[2]);
+      Real r = half.x() * std::fabs(axis.x()) + half.y() * std::fabs(axis.y()) + half.z() * std::fabs(axis.z());
+      if (std::min(p0, std::min(p1, p2)) > r || std::max(p0, std::max(p1, p2)) < -r)
+        return false;
+    }
+
+  // Normal of the triangle
+  Vector3 n = edges[0].cross(edges[1]);
+  Real r = half.x() * std::fabs(n.x()) + half.y() * std::fabs(n.y()) + half.z() * std::fabs(n.z());
+  return std::fabs(n.dot(u[0])) <= r;
+}
+
 } // namespace Triangle3Internal
 
 } // namespace DGP
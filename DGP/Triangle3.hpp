@@ -102,6 +102,10 @@ DGP_API Vector3 closestPointOnTrianglePerimeter(const Vector3   &   v0,
                                                  const Vector3   &   v2,
                                                  const Vector3   &   point);
 
+// Check if a triangle intersects a closed axis-aligned box, given by its minimum and maximum corners.
+DGP_API bool triangleIntersectsAAB(Vector3 const & v0, Vector3 const & v1, Vector3 const & v2, Vector3 const & lo,
+                                   Vector3 const & hi);
+
 // Intersection time of a ray with a triangle. Returns a negative value if the ray does not intersect the triangle.
 DGP_API Real rayTriangleIntersectionTime(Ray3 const & ray, Vector3 const & v0, Vector3 const & edge01, Vector3 const & edge02);
 
@@ -276,11 +280,20 @@ class /* DGP_DLL_LOCAL */ Triangle3Base : public RayIntersectable3
       return false;
     }
 
-    /** Check if the triangle intersects a ball. */
-    bool intersects(Ball3 const & ball) const { throw Error("Triangle3: Intersection with ball not implemented"); }
+    /** Check if the triangle intersects a (closed) ball. */
+    bool intersects(Ball3 const & ball) const
+    {
+      return squaredDistance(ball.getCenter()) <= ball.getRadius() * ball.getRadius();
+    }
+
+    /** Check if the triangle intersects a (closed) axis-aligned box. */
+    bool intersects(AxisAlignedBox3 const & aab) const
+    {
+      if (aab.isNull())
+        return false;
 
-    /** Check if the triangle intersects an axis-aligned box. */
-    bool intersects(AxisAlignedBox3 const & aab) const { throw Error("Triangle3: Intersection with AAB not implemented"); }
+      return Triangle3Internal::triangleIntersectsAAB(getVertex(0), getVertex(1), getVertex(2), aab.getLow(), aab.getHigh());
+    }
 
     /** Check if the triangle intersects an oriented box. */
     bool intersects(Box3 const & box) const { throw Error("Triangle3: Intersection with oriented box not implemented"); }
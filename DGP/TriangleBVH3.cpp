@@ -0,0 +1,610 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#include "TriangleBVH3.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace DGP {
+
+namespace TriangleBVH3Internal {
+
+// Number of bins of centroids over which the surface area heuristic is evaluated.
+int const NUM_BINS = 16;
+
+// Subtrees with at most this many triangles are built as separate parallel tasks. Fixed, so the layout of the hierarchy does
+// not depend on the number of threads.
+uint32 const TASK_TRIANGLES = 2048;
+
+// Orders triangle indices by one coordinate of the triangle centroids.
+struct AxisLess
+{
+  AxisLess(Vector3 const * centroids_, int axis_) : centroids(centroids_), axis(axis_) {}
+  bool operator()(uint32 a, uint32 b) const { return centroids[a][axis] < centroids[b][axis]; }
+
+  Vector3 const * centroids;
+  int axis;
+};
+
+// Maps centroids to bins along an axis.
+struct Binner
+{
+  Binner(Vector3 const * centroids_, int axis_, Real lo_, Real extent)
+  : centroids(centroids_), axis(axis_), lo(lo_), scale(NUM_BINS / extent) {}
+
+  int operator()(uint32 t) const { return std::min((int)((centroids[t][axis] - lo) * scale), NUM_BINS - 1); }
+
+  Vector3 const * centroids;
+  int axis;
+  Real lo, scale;
+};
+
+// Orders triangle indices by whether their centroids fall in a bin before a split.
+struct BinLess
+{
+  BinLess(Binner const & binner_, int split_) : binner(binner_), split(split_) {}
+  bool operator()(uint32 t) const { return binner(t) < split; }
+
+  Binner binner;
+  int split;
+};
+
+// Half the surface area of a non-empty box.
+Real
+halfArea(AxisAlignedBox3 const & box)
+{
+  Vector3 e = box.getExtent();
+  return e.x() * e.y() + e.y() * e.z() + e.z() * e.x();
+}
+
+// A subtree built as a separate task.
+struct Task
+{
+  uint32 node;   // Index of the root in the hierarchy.
+  uint32 begin;  // First triangle in the sorted arrays.
+  uint32 end;    // One past the last triangle in the sorted arrays.
+  int level;     // Level of the root.
+};
+
+} // namespace TriangleBVH3Internal
+
+struct TriangleBVH3::BuildData
+{
+  std::vector<Vector3> centroids;        // Centroid of each triangle.
+  std::vector<AxisAlignedBox3> bounds;   // Bounding box of each triangle.
+  SplitMethod split_method;
+  uint32 max_leaf_triangles;
+};
+
+void
+TriangleBVH3::build(Vector3 const * vertices, uint32 const * indices, long num_triangles, Options const & options)
+{
+  std::vector<LocalTriangle3> tris((size_t)std::max(num_triangles, 0L));
+  ThreadPool & pool = (options.thread_pool ? *options.thread_pool : ThreadPool::common());
+  pool.parallelFor(0, num_triangles, [&](long lo, long hi, long /* participant */) {
+    for (long i = lo; i < hi; ++i)
+      tris[(size_t)i].set(vertices[indices[3 * i]], vertices[indices[3 * i + 1]], vertices[indices[3 * i + 2]]);
+  });
+
+  build(tris.empty() ? NULL : &tris[0], num_triangles, options);
+}
+
+void
+TriangleBVH3::build(LocalTriangle3 const * triangles, long num_triangles, Options const & options)
+{
+  using namespace TriangleBVH3Internal;
+
+  clear();
+  if (num_triangles <= 0)
+    return;
+
+  ThreadPool & pool = (options.thread_pool ? *options.thread_pool : ThreadPool::common());
+  uint32 n = (uint32)num_triangles;
+
+  BuildData data;
+  data.split_method = options.split_method;
+  data.max_leaf_triangles = (uint32)std::max(options.max_leaf_triangles, 1);
+  data.centroids.resize(n);
+  data.bounds.resize(n);
+  sorted_indices.resize(n);
+  pool.parallelFor(0, n, [&](long lo, long hi, long /* participant */) {
+    for (long i = lo; i < hi; ++i)
+    {
+      data.centroids[(size_t)i] = triangles[i].getCentroid();
+      data.bounds[(size_t)i] = triangles[i].getBounds();
+      sorted_indices[(size_t)i] = (uint32)i;
+    }
+  });
+
+  // Split the top of the hierarchy serially, depth-first, until the subtrees are small enough to be separate tasks
+  nodes.reserve(2 * (size_t)(n / data.max_leaf_triangles + 1));
+  nodes.push_back(Node());
+
+  std::vector<Task> tasks;
+  std::vector<Task> pending(1);
+  pending[0].node = 0; pending[0].begin = 0; pending[0].end = n; pending[0].level = 0;
+  while (!pending.empty())
+  {
+    Task task = pending.back();
+    pending.pop_back();
+
+    if (task.end - task.begin <= std::max(TASK_TRIANGLES, data.max_leaf_triangles))
+    {
+      tasks.push_back(task);
+      continue;
+    }
+
+    uint32 mid = partition(data, task.begin, task.end, task.level);
+    uint32 child = (uint32)nodes.size();
+    nodes[task.node].first = child;
+    nodes[task.node].count = 0;
+    nodes.push_back(Node());
+    nodes.push_back(Node());
+
+    Task hi_task = { child + 1, mid, task.end, task.level + 1 };
+    Task lo_task = { child, task.begin, mid, task.level + 1 };
+    pending.push_back(hi_task);
+    pending.push_back(lo_task);
+  }
+
+  // Build the subtrees in parallel, each into its own array with its root first
+  std::vector< std::vector<Node> > subtrees(tasks.size());
+  pool.parallelFor(0, (long)tasks.size(), [&](long lo, long hi, long /* participant */) {
+    for (long i = lo; i < hi; ++i)
+    {
+      subtrees[(size_t)i].push_back(Node());
+      buildSubtree(data, subtrees[(size_t)i], 0, tasks[(size_t)i].begin, tasks[(size_t)i].end, tasks[(size_t)i].level);
+    }
+  }, 1);
+
+  // Append the subtrees in task order. Each root replaces its placeholder, and the rest follow, so children still come after
+  // their parents.
+  for (size_t i = 0; i < tasks.size(); ++i)
+  {
+    std::vector<Node> & subtree = subtrees[i];
+    uint32 offset = (uint32)nodes.size() - 1;  // position of node 1 of the subtree, minus 1
+    for (size_t j = 0; j < subtree.size(); ++j)
+    {
+      if (subtree[j].count == 0)
+        subtree[j].first += offset;
+
+      if (j == 0) nodes[tasks[i].node] = subtree[j];
+      else        nodes.push_back(subtree[j]);
+    }
+  }
+
+  // Store the triangles in leaf order
+  sorted_triangles.resize(n);
+  leaf_positions.resize(n);
+  pool.parallelFor(0, n, [&](long lo, long hi, long /* participant */) {
+    for (long i = lo; i < hi; ++i)
+    {
+      sorted_triangles[(size_t)i] = triangles[sorted_indices[(size_t)i]];
+      leaf_positions[sorted_indices[(size_t)i]] = (uint32)i;
+    }
+  });
+
+  updateBounds();
+}
+
+void
+TriangleBVH3::refit(Vector3 const * vertices, uint32 const * indices, ThreadPool * pool)
+{
+  ThreadPool & tp = (pool ? *pool : ThreadPool::common());
+  tp.parallelFor(0, numTriangles(), [&](long lo, long hi, long /* participant */) {
+    for (long i = lo; i < hi; ++i)
+    {
+      uint32 const * tri = indices + 3 * (size_t)sorted_indices[(size_t)i];
+      sorted_triangles[(size_t)i].set(vertices[tri[0]], vertices[tri[1]], vertices[tri[2]]);
+    }
+  });
+
+  updateBounds();
+}
+
+void
+TriangleBVH3::updateBounds()
+{
+  // Children come after their parents, so a backward pass visits every child before its parent
+  for (size_t i = nodes.size(); i-- > 0; )
+  {
+    Node & node = nodes[i];
+    if (node.count > 0)
+    {
+      AxisAlignedBox3 box;
+      for (uint32 j = node.first; j < node.first + node.count; ++j)
+        box.merge(sorted_triangles[j].getBounds());
+
+      for (int j = 0; j < 3; ++j)
+      {
+        node.lo[j] = box.getLow()[j];
+        node.hi[j] = box.getHigh()[j];
+      }
+    }
+    else
+    {
+      Node const & c0 = nodes[node.first];
+      Node const & c1 = nodes[node.first + 1];
+      for (int j = 0; j < 3; ++j)
+      {
+        node.lo[j] = std::min(c0.lo[j], c1.lo[j]);
+        node.hi[j] = std::max(c0.hi[j], c1.hi[j]);
+      }
+    }
+  }
+}
+
+uint32
+TriangleBVH3::partition(BuildData const & data, uint32 begin, uint32 end, int level)
+{
+  using namespace TriangleBVH3Internal;
+
+  Vector3 const * centroids = &data.centroids[0];
+  Vector3 lo = centroids[sorted_indices[begin]], hi = lo;
+  for (uint32 i = begin + 1; i < end; ++i)
+  {
+    lo = lo.min(centroids[sorted_indices[i]]);
+    hi = hi.max(centroids[sorted_indices[i]]);
+  }
+
+  Vector3 ext = hi - lo;
+  int longest = (ext.x() >= ext.y() ? (ext.x() >= ext.z() ? 0 : 2) : (ext.y() >= ext.z() ? 1 : 2));
+  uint32 mid = begin + (end - begin) / 2;
+  if (!(ext[longest] > 0))  // all centroids coincide, so any split is as good as any other
+    return mid;
+
+  std::vector<uint32>::iterator first = sorted_indices.begin() + begin, last = sorted_indices.begin() + end;
+  if (data.split_method == SplitMethod::SAH && level < MAX_SAH_LEVEL)
+  {
+    // Cost of a split: the summed surface areas of the children, each weighted by its number of triangles
+    Real best_cost = std::numeric_limits<Real>::max();
+    int best_axis = -1, best_split = 0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      if (!(ext[axis] > 0))
+        continue;
+
+      Binner binner(centroids, axis, lo[axis], ext[axis]);
+      uint32 counts[NUM_BINS] = { 0 };
+      AxisAlignedBox3 boxes[NUM_BINS];
+      for (uint32 i = begin; i < end; ++i)
+      {
+        int b = binner(sorted_indices[i]);
+        counts[b]++;
+        boxes[b].merge(data.bounds[sorted_indices[i]]);
+      }
+
+      // Sweep from the right for the costs of the right children, then from the left
+      Real right_cost[NUM_BINS];
+      AxisAlignedBox3 acc;
+      uint32 acc_count = 0;
+      for (int b = NUM_BINS - 1; b > 0; --b)
+      {
+        acc.merge(boxes[b]);
+        acc_count += counts[b];
+        right_cost[b] = (acc_count > 0 ? acc_count * halfArea(acc) : -1);
+      }
+
+      acc = AxisAlignedBox3();
+      acc_count = 0;
+      for (int b = 1; b < NUM_BINS; ++b)
+      {
+        acc.merge(boxes[b - 1]);
+        acc_count += counts[b - 1];
+        if (acc_count == 0 || right_cost[b] < 0)
+          continue;
+
+        Real cost = acc_count * halfArea(acc) + right_cost[b];
+        if (cost < best_cost)
+        {
+          best_cost = cost;
+          best_axis = axis;
+          best_split = b;
+        }
+      }
+    }
+
+    if (best_axis >= 0)
+    {
+      Binner binner(centroids, best_axis, lo[best_axis], ext[best_axis]);
+      uint32 sah_mid = begin + (uint32)(std::partition(first, last, BinLess(binner, best_split)) - first);
+      if (sah_mid > begin && sah_mid < end)
+        return sah_mid;
+    }
+  }
+
+  std::nth_element(first, sorted_indices.begin() + mid, last, AxisLess(centroids, longest));
+  return mid;
+}
+
+void
+TriangleBVH3::buildSubtree(BuildData const & data, std::vector<Node> & out, uint32 node_index, uint32 begin, uint32 end,
+                           int level)
+{
+  if (end - begin <= data.max_leaf_triangles)
+  {
+    out[node_index].first = begin;
+    out[node_index].count = end - begin;
+    return;
+  }
+
+  uint32 mid = partition(data, begin, end, level);
+  uint32 child = (uint32)out.size();
+  out[node_index].first = child;
+  out[node_index].count = 0;
+  out.push_back(Node());
+  out.push_back(Node());
+
+  buildSubtree(data, out, child, begin, mid, level + 1);
+  buildSubtree(data, out, child + 1, mid, end, level + 1);
+}
+
+void
+TriangleBVH3::clear()
+{
+  nodes.clear();
+  sorted_triangles.clear();
+  sorted_indices.clear();
+  leaf_positions.clear();
+}
+
+int
+TriangleBVH3::depth() const
+{
+  // Children come after their parents, so one forward pass finds the level of every node
+  std::vector<int> levels(nodes.size(), 1);
+  int max_level = (nodes.empty() ? 0 : 1);
+  for (size_t i = 0; i < nodes.size(); ++i)
+  {
+    if (nodes[i].count == 0)
+    {
+      levels[nodes[i].first] = levels[nodes[i].first + 1] = levels[i] + 1;
+      max_level = std::max(max_level, levels[i] + 1);
+    }
+  }
+
+  return max_level;
+}
+
+AxisAlignedBox3
+TriangleBVH3::getBounds() const
+{
+  if (nodes.empty())
+    return AxisAlignedBox3();
+
+  Node const & root = nodes[0];
+  return AxisAlignedBox3(Vector3(root.lo[0], root.lo[1], root.lo[2]), Vector3(root.hi[0], root.hi[1], root.hi[2]));
+}
+
+long
+TriangleBVH3::closestPoint(Vector3 const & p, Vector3 & closest, Real & sqdist, Real max_sqdist) const
+{
+  long best = -1;
+  if (nodes.empty())
+    return best;
+
+  Real best_sqdist = (max_sqdist >= 0 ? max_sqdist : std::numeric_limits<Real>::max());
+  uint32 stack[STACK_SIZE];
+  int top = 0;
+  stack[top++] = 0;
+
+  while (top > 0)
+  {
+    Node const & node = nodes[stack[--top]];
+    if (squaredDistance(node, p) > best_sqdist)  // the box may have been pushed before a closer point was found
+      continue;
+
+    if (node.count > 0)
+    {
+      for (uint32 i = node.first, end = node.first + node.count; i < end; ++i)
+      {
+        // No point of the triangle is closer than its plane
+        Real plane_dist = sorted_triangles[i].getPlane().signedDistance(p);
+        if (plane_dist * plane_dist > best_sqdist)
+          continue;
+
+        Vector3 q = sorted_triangles[i].closestPoint(p);
+        Real d2 = (q - p).squaredLength();
+        if (d2 <= best_sqdist)
+        {
+          best = (long)sorted_indices[i];
+          best_sqdist = d2;
+          closest = q;
+        }
+      }
+    }
+    else
+    {
+      // Push the nearer child last, so it is visited first
+      Real d0 = squaredDistance(nodes[node.first], p);
+      Real d1 = squaredDistance(nodes[node.first + 1], p);
+      if (d0 < d1)
+      {
+        if (d1 <= best_sqdist) stack[top++] = node.first + 1;
+        if (d0 <= best_sqdist) stack[top++] = node.first;
+      }
+      else
+      {
+        if (d0 <= best_sqdist) stack[top++] = node.first;
+        if (d1 <= best_sqdist) stack[top++] = node.first + 1;
+      }
+    }
+  }
+
+  if (best >= 0)
+    sqdist = best_sqdist;
+
+  return best;
+}
+
+long
+TriangleBVH3::findHit(Ray3 const & ray, Real & time, Real max_time, bool any_hit) const
+{
+  long best = -1;
+  if (nodes.empty())
+    return best;
+
+  Vector3 const & origin = ray.getOrigin();
+  Vector3 const & dir = ray.getDirection();
+  Vector3 inv_dir(1 / dir.x(), 1 / dir.y(), 1 / dir.z());  // infinite components for axis-parallel rays are handled
+
+  Real best_time = (max_time >= 0 ? max_time : std::numeric_limits<Real>::infinity());
+  uint32 stack[STACK_SIZE];
+  int top = 0;
+  stack[top++] = 0;
+
+  while (top > 0)
+  {
+    Node const & node = nodes[stack[--top]];
+    Real t0 = 0, t1 = best_time;
+    if (!clipRay(node, origin, inv_dir, t0, t1))  // the box may have been pushed before a nearer hit was found
+      continue;
+
+    if (node.count > 0)
+    {
+      for (uint32 i = node.first, end = node.first + node.count; i < end; ++i)
+      {
+        Real t = sorted_triangles[i].rayIntersectionTime(ray, best_time);
+        if (t >= 0 && (best < 0 || t < best_time))
+        {
+          best = (long)i;
+          best_time = t;
+          if (any_hit)
+          {
+            time = t;
+            return best;
+          }
+        }
+      }
+    }
+    else
+    {
+      // Push the child entered later first, so the nearer one is visited first
+      Real a0 = 0, a1 = best_time, b0 = 0, b1 = best_time;
+      bool hit_a = clipRay(nodes[node.first], origin, inv_dir, a0, a1);
+      bool hit_b = clipRay(nodes[node.first + 1], origin, inv_dir, b0, b1);
+      if (hit_a && hit_b)
+      {
+        uint32 nearer = (a0 <= b0 ? node.first : node.first + 1);
+        stack[top++] = (nearer == node.first ? node.first + 1 : node.first);
+        stack[top++] = nearer;
+      }
+      else if (hit_a) stack[top++] = node.first;
+      else if (hit_b) stack[top++] = node.first + 1;
+    }
+  }
+
+  if (best >= 0)
+    time = best_time;
+
+  return best;
+}
+
+long
+TriangleBVH3::rayCast(Ray3 const & ray, Real & time, Real max_time) const
+{
+  long hit = findHit(ray, time, max_time, false);
+  return hit >= 0 ? (long)sorted_indices[(size_t)hit] : -1;
+}
+
+bool
+TriangleBVH3::rayIntersects(Ray3 const & ray, Real max_time) const
+{
+  Real time;
+  return findHit(ray, time, max_time, true) >= 0;
+}
+
+Real
+TriangleBVH3::rayIntersectionTime(Ray3 const & ray, Real max_time) const
+{
+  Real time;
+  return findHit(ray, time, max_time, false) >= 0 ? time : -1;
+}
+
+RayIntersection3
+TriangleBVH3::rayIntersection(Ray3 const & ray, Real max_time) const
+{
+  Real time;
+  long hit = findHit(ray, time, max_time, false);
+  if (hit < 0)
+    return RayIntersection3(-1);
+
+  return RayIntersection3(time, &sorted_triangles[(size_t)hit].getNormal());
+}
+
+void
+TriangleBVH3::boxQuery(AxisAlignedBox3 const & box, std::vector<uint32> & result) const
+{
+  result.clear();
+  if (nodes.empty() || box.isNull())
+    return;
+
+  Vector3 const & lo = box.getLow();
+  Vector3 const & hi = box.getHigh();
+  uint32 stack[STACK_SIZE];
+  int top = 0;
+  stack[top++] = 0;
+
+  while (top > 0)
+  {
+    Node const & node = nodes[stack[--top]];
+    if (!intersects(node, lo, hi))
+      continue;
+
+    if (node.count > 0)
+    {
+      for (uint32 i = node.first, end = node.first + node.count; i < end; ++i)
+        if (Triangle3Internal::triangleIntersectsAAB(sorted_triangles[i].getVertex(0), sorted_triangles[i].getVertex(1),
+                                                     sorted_triangles[i].getVertex(2), lo, hi))
+          result.push_back(sorted_indices[i]);
+    }
+    else
+    {
+      stack[top++] = node.first + 1;
+      stack[top++] = node.first;
+    }
+  }
+}
+
+void
+TriangleBVH3::ballQuery(Ball3 const & ball, std::vector<uint32> & result) const
+{
+  result.clear();
+  if (nodes.empty() || ball.getRadius() < 0)
+    return;
+
+  Vector3 const & center = ball.getCenter();
+  Real r2 = ball.getRadius() * ball.getRadius();
+  uint32 stack[STACK_SIZE];
+  int top = 0;
+  stack[top++] = 0;
+
+  while (top > 0)
+  {
+    Node const & node = nodes[stack[--top]];
+    if (squaredDistance(node, center) > r2)
+      continue;
+
+    if (node.count > 0)
+    {
+      for (uint32 i = node.first, end = node.first + node.count; i < end; ++i)
+        if (sorted_triangles[i].intersects(ball))
+          result.push_back(sorted_indices[i]);
+    }
+    else
+    {
+      stack[top++] = node.first + 1;
+      stack[top++] = node.first;
+    }
+  }
+}
+
+} // namespace DGP
@@ -0,0 +1,251 @@
+//============================================================================
+//
+// DGP: Digital Geometry Processing toolkit
+// Copyright (C) 2016, Siddhartha Chaudhuri
+//
+// This software is covered by a BSD license. Portions derived from other
+// works are covered by their respective licenses. For full licensing
+// information see the LICENSE.txt file.
+//
+//============================================================================
+
+#ifndef __DGP_TriangleBVH3_hpp__
+#define __DGP_TriangleBVH3_hpp__
+
+#include "Common.hpp"
+#include "AxisAlignedBox3.hpp"
+#include "Ball3.hpp"
+#include "Ray3.hpp"
+#include "RayIntersectable3.hpp"
+#include "ThreadPool.hpp"
+#include "Triangle3.hpp"
+#include "Vector3.hpp"
+#include <algorithm>
+#include <vector>
+
+namespace DGP {
+
+/**
+ * A bounding volume hierarchy over a set of triangles in 3-space, for closest-point, ray, box and ball queries. By default
+ * each node is split where the surface area heuristic (SAH), evaluated over bins of triangle centroids, predicts the cheapest
+ * queries, down to small leaves. Nodes are stored in a flat array of 32-byte records, with every node before its children,
+ * and copies of the triangles in leaf order in a contiguous array, so that the triangles of each subtree are consecutive in
+ * memory.
+ *
+ * Subtrees below a fixed size are built in parallel. The hierarchy, and hence the result of every query, does not depend on
+ * the number of threads. When the triangles deform without changing connectivity, refit() updates the hierarchy in place.
+ */
+class DGP_API TriangleBVH3 : public RayIntersectable3
+{
+  public:
+    /** How a node is divided between its children (enum class). */
+    struct SplitMethod
+    {
+      /** Supported values. */
+      enum Value
+      {
+        MEDIAN,  ///< At the median centroid along the axis in which the centroids are most spread out.
+        SAH      ///< At the bin boundary of least cost according to the surface area heuristic.
+      };
+
+      DGP_ENUM_CLASS_BODY(SplitMethod)
+    };
+
+    /** %Options controlling construction. */
+    struct Options
+    {
+      SplitMethod split_method;  ///< How nodes are split (default SplitMethod::SAH).
+      int max_leaf_triangles;    ///< Maximum number of triangles in a leaf (default 4).
+      ThreadPool * thread_pool;  ///< Threads to build with (default null, indicating ThreadPool::common()).
+
+      /** Constructor. */
+      Options() : split_method(SplitMethod::SAH), max_leaf_triangles(4), thread_pool(NULL) {}
+
+      /** Get the default set of options. */
+      static Options const & defaults() { static Options const def; return def; }
+
+    }; // struct Options
+
+    /** Constructor. */
+    TriangleBVH3() {}
+
+    /**
+     * Build the hierarchy over triangles given by consecutive triples of indices into an array of vertices. Triangles are
+     * identified in queries by their position in the index array, divided by three.
+     */
+    void build(Vector3 const * vertices, uint32 const * indices, long num_triangles,
+               Options const & options = Options::defaults());
+
+    /** Build the hierarchy over copies of a set of triangles, identified in queries by their positions in the array. */
+    void build(LocalTriangle3 const * triangles, long num_triangles, Options const & options = Options::defaults());
+
+    /**
+     * Build the hierarchy over local copies (see Triangle3::localClone()) of a set of triangles with any vertex storage,
+     * identified in queries by their positions in the array.
+     */
+    template <typename VertexTripleT>
+    void build(Triangle3<VertexTripleT> const * triangles, long num_triangles, Options const & options = Options::defaults())
+    {
+      std::vector<LocalTriangle3> local;
+      local.reserve((size_t)std::max(num_triangles, 0L));
+      for (long i = 0; i < num_triangles; ++i)
+        local.push_back(triangles[i].localClone());
+
+      build(local.empty() ? NULL : &local[0], num_triangles, options);
+    }
+
+    /**
+     * Update the hierarchy after the vertices of its triangles have moved, without changing its structure. The triangles must
+     * be given by the same indices that were passed to build(), into an array of new vertex positions. Only the triangles and
+     * the bounding boxes of the nodes are recomputed, which is much faster than rebuilding, but queries slow down as the
+     * vertices move further from where the hierarchy was built.
+     *
+     * @param vertices The new vertex positions.
+     * @param indices The vertex indices of the triangles, as passed to build().
+     * @param pool Threads to update the triangles with. If null, ThreadPool::common() is used.
+     */
+    void refit(Vector3 const * vertices, uint32 const * indices, ThreadPool * pool = NULL);
+
+    /** Remove all triangles. */
+    void clear();
+
+    /** Get the number of triangles. */
+    long numTriangles() const { return (long)sorted_indices.size(); }
+
+    /** Get a triangle, as of the last build or refit, by its index. */
+    LocalTriangle3 const & getTriangle(long index) const { return sorted_triangles[leaf_positions[(size_t)index]]; }
+
+    /** Get the number of nodes. */
+    long numNodes() const { return (long)nodes.size(); }
+
+    /** Get the number of levels of the hierarchy (0 if it is empty, 1 if the root is a leaf). */
+    int depth() const;
+
+    /** Get a bounding box for all the triangles. */
+    AxisAlignedBox3 getBounds() const;
+
+    /**
+     * Find the point of the triangles closest to a query point. Returns the index of the triangle containing it, or a negative
+     * value if there are no triangles or none is within the (optional) maximum squared distance.
+     *
+     * @param p The query point.
+     * @param closest Used to return the closest point.
+     * @param sqdist Used to return the squared distance from the query point to the closest point.
+     * @param max_sqdist If non-negative, triangles further than the square root of this value are ignored.
+     */
+    long closestPoint(Vector3 const & p, Vector3 & closest, Real & sqdist, Real max_sqdist = -1) const;
+
+    /**
+     * Find the first triangle hit by a ray. Returns its index, or a negative value if no triangle is hit in the forward
+     * direction (before \a max_time, if it is non-negative). Triangles parallel to the ray are not hit.
+     *
+     * @param ray The ray.
+     * @param time Used to return the hit time, in units of the ray's direction vector.
+     * @param max_time Maximum allowable hit time, ignored if negative.
+     */
+    long rayCast(Ray3 const & ray, Real & time, Real max_time = -1) const;
+
+    bool rayIntersects(Ray3 const & ray, Real max_time = -1) const;
+
+    Real rayIntersectionTime(Ray3 const & ray, Real max_time = -1) const;
+
+    /** Get the first intersection of a ray with the triangles, including the normal of the triangle that was hit. */
+    RayIntersection3 rayIntersection(Ray3 const & ray, Real max_time = -1) const;
+
+    /** Get the indices of all triangles intersecting a closed axis-aligned box, in no particular order. */
+    void boxQuery(AxisAlignedBox3 const & box, std::vector<uint32> & result) const;
+
+    /** Get the indices of all triangles intersecting a closed ball, in no particular order. */
+    void ballQuery(Ball3 const & ball, std::vector<uint32> & result) const;
+
+  private:
+    /** A node of the hierarchy: 32 bytes, so two nodes share a cache line. */
+    struct Node
+    {
+      Real lo[3];    ///< Minimum corner of the bounding box of the node's triangles.
+      uint32 first;  ///< Index of the first triangle in the sorted arrays (leaf), or of the first child (internal node).
+      Real hi[3];    ///< Maximum corner of the bounding box of the node's triangles.
+      uint32 count;  ///< Number of triangles (leaf), or 0 for an internal node, whose second child follows the first.
+    };
+
+    /** Data shared by the threads building a hierarchy. */
+    struct BuildData;
+
+    /**
+     * Reorder the sorted indices [begin, end) and return a position mid with begin < mid < end, so that [begin, mid) and
+     * [mid, end) hold the triangles of the two children.
+     */
+    uint32 partition(BuildData const & data, uint32 begin, uint32 end, int level);
+
+    /** Recompute the bounding boxes of all nodes from the triangles, children before parents. */
+    void updateBounds();
+
+    /** Recursively build the subtree of a node over the triangles [begin, end), appending its descendants to an array. */
+    void buildSubtree(BuildData const & data, std::vector<Node> & out, uint32 node_index, uint32 begin, uint32 end, int level);
+
+    /**
+     * Find the first triangle hit by a ray, or any triangle hit if \a any_hit is true. Returns its position in the sorted
+     * arrays, or a negative value if there is no hit.
+     */
+    long findHit(Ray3 const & ray, Real & time, Real max_time, bool any_hit) const;
+
+    /** Get the squared distance from a point to the bounding box of a node. */
+    static Real squaredDistance(Node const & node, Vector3 const & p)
+    {
+      Real d2 = 0;
+      for (int i = 0; i < 3; ++i)
+      {
+        Real d = (p[i] < node.lo[i] ? node.lo[i] - p[i] : (p[i] > node.hi[i] ? p[i] - node.hi[i] : 0));
+        d2 += d * d;
+      }
+
+      return d2;
+    }
+
+    /** Check if the bounding box of a node intersects a box given by its minimum and maximum corners. */
+    static bool intersects(Node const & node, Vector3 const & lo, Vector3 const & hi)
+    {
+      return node.lo[0] <= hi[0] && node.hi[0] >= lo[0]
+          && node.lo[1] <= hi[1] && node.hi[1] >= lo[1]
+          && node.lo[2] <= hi[2] && node.hi[2] >= lo[2];
+    }
+
+    /**
+     * Clip a range of times [t0, t1] to the times at which a ray, given by its origin and the reciprocals of its direction's
+     * components, is inside the bounding box of a node. Returns false if the clipped range is empty.
+     */
+    static bool clipRay(Node const & node, Vector3 const & origin, Vector3 const & inv_dir, Real & t0, Real & t1)
+    {
+      for (int i = 0; i < 3; ++i)
+      {
+        Real near_t = (node.lo[i] - origin[i]) * inv_dir[i];
+        Real far_t = (node.hi[i] - origin[i]) * inv_dir[i];
+        if (near_t > far_t) std::swap(near_t, far_t);
+
+        // A NaN, from a ray in the plane of a face of the box, leaves the range unchanged
+        if (near_t > t0) t0 = near_t;
+        if (far_t < t1) t1 = far_t;
+      }
+
+      return t0 <= t1;
+    }
+
+    /**
+     * Nodes below this level are split at the median, so a hierarchy over fewer than 2^32 triangles has fewer than
+     * MAX_SAH_LEVEL + 33 levels, and traversal stacks of STACK_SIZE entries cannot overflow.
+     */
+    static int const MAX_SAH_LEVEL = 64;
+
+    /** Size of the traversal stacks. */
+    static int const STACK_SIZE = 128;
+
+    std::vector<Node> nodes;                        ///< Nodes of the hierarchy, with the root first.
+    std::vector<LocalTriangle3> sorted_triangles;   ///< Triangles, in leaf order.
+    std::vector<uint32> sorted_indices;             ///< Original index of each triangle, in leaf order.
+    std::vector<uint32> leaf_positions;             ///< Position of each triangle in leaf order, by original index.
+
+}; // class TriangleBVH3
+
+} // namespace DGP
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef __A3_Batch_hpp__
+#define __A3_Batch_hpp__
+
+#include "Common.hpp"
+#include <string>
+
+/**
+ * Headless executor for a list of denoising jobs. Each job loads a mesh, optionally adds noise, smooths it, measures how far
+ * the result is from the mesh as loaded, and saves it. Jobs are pipelined: loads and saves run on a small I/O thread pool while
+ * smoothing runs on a separate compute pool, so the I/O of some jobs overlaps the computation of others. The number of meshes
+ * held in memory at once is bounded.
+ *
+ * The job list is a text file with one job per line. Blank lines and lines starting with '#' are ignored. Each job is
+ *
+ * <pre>
+ *   <input mesh> <output mesh> [key=value ...]
+ * </pre>
+ *
+ * with the keys
+ *
+ * - <tt>algorithm</tt>: <tt>fleishman</tt> or <tt>jones</tt> (default <tt>fleishman</tt>). Each build of the program runs
+ *   only its own algorithm and skips the other jobs, so the same list can be passed to both builds.
+ * - <tt>sigma_c</tt>, <tt>sigma_s</tt>: the smoothing parameters (default a tenth of, and equal to, the average edge length
+ *   of the mesh as loaded, as in interactive mode).
+ * - <tt>iterations</tt>: the maximum number of smoothing passes (default 1). Multiple passes are run by
+ *   Mesh::bilateralSmoothIterative(), which refreshes normals between passes.
+ * - <tt>tolerance</tt>: stop after a pass whose mean vertex displacement is below this (default 0, never stopping early).
+ * - <tt>noise</tt>: the scale of the noise added to the vertices before smoothing (default 0, no noise). See Mesh::noiseMesh().
+ * - <tt>noise_model</tt>: <tt>gaussian</tt>, <tt>normal</tt> or <tt>impulse</tt> (default <tt>gaussian</tt>). See
+ *   Mesh::NoiseModel.
+ * - <tt>noise_seed</tt>: the seed of the noise (default 0). The noise is a function of the seed and the mesh alone, so the
+ *   same job list always produces the same noisy meshes.
+ * - <tt>noise_relative</tt>: if <tt>1</tt>, <tt>noise</tt> is a multiple of the mean edge length of the mesh (default 0).
+ * - <tt>noise_fraction</tt>: the fraction of the vertices moved by <tt>impulse</tt> noise (default 0.05).
+ * - <tt>snapshot</tt>: draw the mesh before and after smoothing (after adding noise) into square images of this many pixels
+ *   per side, saved as PNG files next to the output mesh with the extensions <tt>.before.png</tt> and <tt>.after.png</tt>
+ *   (default 0, no images). The images are drawn on the CPU by MeshRasterizer, so no display is needed.
+ * - <tt>metrics</tt>: if <tt>1</tt>, measure the mesh with MeshMetrics after adding noise and after every smoothing pass,
+ *   and save the results next to the output mesh with the extension <tt>.metrics.jsonl</tt>, one JSON object per line of
+ *   the form <tt>{"pass":k,"metrics":{...}}</tt>, with pass 0 before smoothing (default 0, no log).
+ *
+ * Per-job timings for each stage are printed as jobs finish, with the error of the smoothed mesh relative to the mesh as
+ * loaded (see MeshMetrics), followed by a summary.
+ */
+class Batch
+{
+  public:
+    /**
+     * Run the jobs in a job list file.
+     *
+     * @param job_list_path The path to the job list.
+     * @param num_threads The number of threads for smoothing. If negative, the hardware concurrency is used.
+     *
+     * @return True if every job of this build's algorithm succeeded, false if the list could not be read or any job failed.
+     */
+    static bool run(std::string const & job_list_path, long num_threads = -1);
+
+}; // class Batch
+
+#endif
@@ -2,12 +2,28 @@
 #include "MeshVertex.hpp"
 #include "MeshEdge.hpp"
 #include "MeshFace.hpp"
+#include "NeighbourhoodColoring.hpp"
+#include "DGP/BinaryInputStream.hpp"
+#include "DGP/BinaryOutputStream.hpp"
+#include "DGP/ConjugateGradient.hpp"
+#include "DGP/CounterRandom.hpp"
+#include "DGP/Crypto.hpp"
 #include "DGP/FilePath.hpp"
+#include "DGP/GaussianWeights.hpp"
+#include "DGP/MappedFile.hpp"
+#include "DGP/Matrix3Batch.hpp"
+#include "DGP/PointHashGrid3.hpp"
+#include "DGP/PointKDTree3.hpp"
+#include "DGP/Stopwatch.hpp"
+#include "DGP/TextScanner.hpp"
 #include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
-#include <unordered_map>
-#include <random>
+#include <limits>
+#include <memory>
+#include <queue>
 
 MeshEdge *
 Mesh::mergeEdges(Edge * e0, Edge * e1)
@@ -17,6 +33,8 @@ Mesh::mergeEdges(Edge * e0, Edge * e1)
 
   alwaysAssertM(e0->isCoincidentTo(*e1), std::string(getName()) + ": Edges to merge must have the same endpoints");
 
+  invalidateCore();
+
   // Transfer faces from e1 to e0
   for (Edge::FaceIterator fi = e1->facesBegin(); fi != e1->facesEnd(); ++fi)
   {
@@ -42,13 +60,7 @@ Mesh::mergeEdges(Edge * e0, Edge * e1)
 
     edges_to_remove[i]->getEndpoint(0)->removeEdge(edges_to_remove[i]);
     edges_to_remove[i]->getEndpoint(1)->removeEdge(edges_to_remove[i]);
-
-    for (EdgeIterator ej = edges.begin(); ej != edges.end(); ++ej)
-      if (&(*ej) == edges_to_remove[i])
-      {
-        edges.erase(ej);
-        break;
-      }
+    deleteElement(edges, free_edges, edges_to_remove[i]);
   }
 
   Vertex * vertices_to_remove[2] = { NULL, NULL };
@@ -56,17 +68,8 @@ Mesh::mergeEdges(Edge * e0, Edge * e1)
   if (v->numFaces() <= 0 && v->numEdges() <= 0) vertices_to_remove[1] = v;
 
   for (int i = 0; i < 2; ++i)
-  {
-    if (!vertices_to_remove[i])
-      continue;
-
-    for (VertexIterator vj = vertices.begin(); vj != vertices.end(); ++vj)
-      if (&(*vj) == vertices_to_remove[i])
-      {
-        vertices.erase(vj);
-        break;
-      }
-  }
+    if (vertices_to_remove[i] && !(i == 1 && vertices_to_remove[1] == vertices_to_remove[0]))  // u == v for a self-loop
+      deleteElement(vertices, free_vertices, vertices_to_remove[i]);
 
   return (edges_to_remove[1] == e0 ? NULL : e0);
 }
@@ -86,12 +89,15 @@ Mesh::collapseEdge(Edge * edge)
     return NULL;
   }
 
-  // Check if u is a repeated vertex in any face. If so, preferentially remove it (one copy at a time)
+  invalidateCore();
+
+  // Check if u is a repeated vertex in any face. If so, preferentially remove it (one copy at a time). Only faces incident on
+  // u can contain it.
   bool stop = false;
-  for (FaceConstIterator fi = faces.begin(); fi != faces.end(); ++fi)
+  for (Vertex::FaceConstIterator fi = u->facesBegin(); fi != u->facesEnd(); ++fi)
   {
     int num_occurrences = 0;
-    for (MeshFace::VertexConstIterator vi = fi->verticesBegin(); vi != fi->verticesEnd(); ++vi)
+    for (MeshFace::VertexConstIterator vi = (*fi)->verticesBegin(); vi != (*fi)->verticesEnd(); ++vi)
     {
       if (*vi == u)
       {
@@ -198,23 +204,12 @@ Mesh::collapseEdge(Edge * edge)
 
   // No faces reference v any more. The mesh is in a consistent state.
 
-  for (EdgeIterator ei = edges.begin(); ei != edges.end(); ++ei)
-    if (&(*ei) == edge)
-    {
-      edges.erase(ei);
-      break;
-    }
-
   u->removeEdge(edge);
+  deleteElement(edges, free_edges, edge);
 
   // No more edge. The mesh is in a consistent state
 
-  for (VertexIterator vi = vertices.begin(); vi != vertices.end(); ++vi)
-    if (&(*vi) == v)
-    {
-      vertices.erase(vi);
-      break;
-    }
+  deleteElement(vertices, free_vertices, v);
 
   // No more v. The mesh is in a consistent state.
 
@@ -229,35 +224,344 @@ Mesh::collapseEdge(Edge * edge)
 
   // All faces shrunk to zero by the edge collapse have been removed.
 
-  bool found = true;
-  while (found)
+  // Merge edges of u that now have the same endpoints, looking up earlier edges by their other endpoint. Each later edge is
+  // kept, and takes over the faces of the earlier one.
+  std::vector<Edge *> u_edges(u->edgesBegin(), u->edgesEnd());
+  edges_by_endpoint.clear();
+  for (size_t i = 0; i < u_edges.size(); ++i)
+  {
+    Edge * e = u_edges[i];
+    std::pair<std::unordered_map<Vertex const *, Edge *>::iterator, bool> ins
+        = edges_by_endpoint.insert(std::make_pair(e->getOtherEndpoint(u), e));
+    if (ins.second)
+      continue;
+
+    Edge * merged = mergeEdges(e, ins.first->second);
+    if (merged)
+      ins.first->second = merged;
+    else
+      edges_by_endpoint.erase(ins.first);
+  }
+
+  // All double edges have been collapsed to single edges (this can happen either because faces were shrunk to zero, or because
+  // the mesh has genus > 0).
+
+  return u;
+}
+
+namespace MeshInternal {
+
+// Symmetric 4x4 matrix Q such that [p 1] Q [p 1]^T is the summed (weighted) squared distance from p to a set of planes. Only
+// the upper triangle is stored, row by row.
+struct Quadric
+{
+  Quadric() { std::fill(q, q + 10, 0.0); }
+
+  // Add the plane n.p + d = 0, with unit normal n.
+  void addPlane(Vector3 const & n, double d, double weight)
+  {
+    double a = n.x(), b = n.y(), c = n.z();
+    q[0] += weight * a * a; q[1] += weight * a * b; q[2] += weight * a * c; q[3] += weight * a * d;
+                            q[4] += weight * b * b; q[5] += weight * b * c; q[6] += weight * b * d;
+                                                    q[7] += weight * c * c; q[8] += weight * c * d;
+                                                                            q[9] += weight * d * d;
+  }
+
+  Quadric & operator+=(Quadric const & rhs)
+  {
+    for (int i = 0; i < 10; ++i) q[i] += rhs.q[i];
+    return *this;
+  }
+
+  double evaluate(Vector3 const & p) const
+  {
+    double x = p.x(), y = p.y(), z = p.z();
+    double e = x * (q[0] * x + 2 * (q[1] * y + q[2] * z + q[3]))
+             + y * (q[4] * y + 2 * (q[5] * z + q[6]))
+             + z * (q[7] * z + 2 * q[8])
+             + q[9];
+    return std::max(e, 0.0);  // rounding can take it slightly below zero
+  }
+
+  // Copy the upper-left 3x3 block A, as 9 values in row-major order, for inverting with Matrix3Batch::invert().
+  void getBlock(double * a) const
+  {
+    a[0] = q[0]; a[1] = q[1]; a[2] = q[2];
+    a[3] = q[1]; a[4] = q[4]; a[5] = q[5];
+    a[6] = q[2]; a[7] = q[5]; a[8] = q[7];
+  }
+
+  // Find the point of least error, if the planes determine it, by solving A p = -b for the last column b, given the inverse
+  // and determinant of the block A from Matrix3Batch::invert(). When the planes are (close to) parallel or share a line, A
+  // is (close to) singular and false is returned.
+  bool minimize(double const * inv, double det, Vector3 & p) const
+  {
+    // The determinant is the product of the eigenvalues and the trace their sum, so this bounds the condition number
+    double trace = q[0] + q[4] + q[7];
+    if (!(trace > 0) || !(std::fabs(det) > 1.0e-6 * trace * trace * trace))
+      return false;
+
+    double x[3];
+    for (int i = 0; i < 3; ++i)
+      x[i] = -(inv[3 * i] * q[3] + inv[3 * i + 1] * q[6] + inv[3 * i + 2] * q[8]);
+
+    p = Vector3((Real)x[0], (Real)x[1], (Real)x[2]);
+    return true;
+  }
+
+  double q[10];
+};
+
+// A candidate edge collapse waiting in the decimation queue.
+struct CollapseCandidate
+{
+  double cost;        // Quadric error of the collapse.
+  Vector3 position;   // Position of the vertex left by the collapse.
+  uint32 edge;        // Index of the edge.
+  uint32 stamp;       // Evaluation count of the edge when the candidate was queued; older candidates are stale.
+
+  // Orders std::priority_queue so that the cheapest collapse is on top.
+  bool operator<(CollapseCandidate const & rhs) const { return cost > rhs.cost; }
+};
+
+} // namespace MeshInternal
+
+long
+Mesh::decimateQuadricEdgeCollapse(DecimationOptions const & options, DecimationStats * stats)
+{
+  using namespace MeshInternal;
+
+  DecimationStats st;
+
+  // Vertices and edges are looked up in the arrays below by index. Collapses only ever remove elements, so the indices of the
+  // remaining ones stay valid throughout.
+  numberElements();
+
+  std::vector<Edge *> indexed_edges;
+  indexed_edges.reserve(edges.size());
+  for (EdgeIterator ei = edges.begin(); ei != edges.end(); ++ei)
+    indexed_edges.push_back(&(*ei));
+
+  // Initial quadrics, from the planes of the faces around each vertex
+  std::vector<Quadric> quadrics(vertices.size());
+  for (FaceIterator fi = faces.begin(); fi != faces.end(); ++fi)
+  {
+    fi->updateNormal();
+    Vector3 const & n = fi->getNormal();
+    double d = -n.dot((*fi->verticesBegin())->getPosition());
+    for (Face::VertexConstIterator fvi = fi->verticesBegin(); fvi != fi->verticesEnd(); ++fvi)
+      quadrics[(*fvi)->index].addPlane(n, d, 1);
+  }
+
+  // Constrain boundary edges to planes perpendicular to their faces, so the boundary does not shrink
+  if (options.boundary_weight > 0)
+  {
+    for (EdgeIterator ei = edges.begin(); ei != edges.end(); ++ei)
+    {
+      if (ei->numFaces() != 1)
+        continue;
+
+      Vertex * e0 = ei->getEndpoint(0), * e1 = ei->getEndpoint(1);
+      Vector3 n = (e1->getPosition() - e0->getPosition()).cross((*ei->facesBegin())->getNormal()).unit();
+      double d = -n.dot(e0->getPosition());
+      quadrics[e0->index].addPlane(n, d, options.boundary_weight);
+      quadrics[e1->index].addPlane(n, d, options.boundary_weight);
+    }
+  }
+
+  // Queue every edge. Re-evaluating an edge bumps its stamp, which invalidates its earlier entries in the queue.
+  std::vector<uint32> stamps(indexed_edges.size(), 0);
+  std::priority_queue<CollapseCandidate> queue;
+
+  // Edges are evaluated in batches, so that the 3x3 blocks of their summed quadrics are inverted together
+  std::vector<Quadric> batch_quadrics;
+  std::vector<double> blocks, inverses, dets;
+
+  auto enqueue = [&](std::vector<Edge *> const & batch)
   {
-    found = false;
+    size_t n = batch.size();
+    if (n == 0)
+      return;
+
+    batch_quadrics.resize(n);
+    blocks.resize(9 * n);
+    inverses.resize(9 * n);
+    dets.resize(n);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+      Quadric & q = batch_quadrics[i];
+      q = quadrics[batch[i]->getEndpoint(0)->index];
+      q += quadrics[batch[i]->getEndpoint(1)->index];
+      q.getBlock(&blocks[9 * i]);
+    }
+
+    Matrix3Batch::invert((long)n, &blocks[0], &inverses[0], &dets[0]);
 
-    for (Vertex::EdgeIterator vei = u->edgesBegin(); vei != u->edgesEnd(); ++vei)
+    for (size_t i = 0; i < n; ++i)
     {
-      for (Vertex::EdgeIterator vej = u->edgesBegin(); vej != vei; ++vej)
-        if ((*vei)->isCoincidentTo(**vej))
+      Edge * edge = batch[i];
+      Quadric const & q = batch_quadrics[i];
+
+      CollapseCandidate c;
+      if (q.minimize(&inverses[9 * i], dets[i], c.position))
+        c.cost = q.evaluate(c.position);
+      else
+      {
+        // Fall back to the best of the endpoints and the midpoint
+        Vector3 const & pu = edge->getEndpoint(0)->getPosition(), & pv = edge->getEndpoint(1)->getPosition();
+        Vector3 pm = 0.5f * (pu + pv);
+        double cu = q.evaluate(pu), cv = q.evaluate(pv), cm = q.evaluate(pm);
+        if (cm <= cu && cm <= cv) { c.position = pm; c.cost = cm; }
+        else if (cu <= cv)        { c.position = pu; c.cost = cu; }
+        else                      { c.position = pv; c.cost = cv; }
+      }
+
+      c.edge = edge->index;
+      c.stamp = ++stamps[edge->index];
+      queue.push(c);
+    }
+  };
+
+  // Would collapsing an edge, leaving its vertex at a given position, keep the surface manifold and every face facing the
+  // same way?
+  auto isValidCollapse = [&](Edge * edge, Vector3 const & position) -> bool
+  {
+    Vertex * u = edge->getEndpoint(0), * v = edge->getEndpoint(1);
+
+    // Collapsing an edge of a tetrahedron leaves two faces glued back to back
+    if (u->degree() <= 3 && v->degree() <= 3)
+      return false;
+
+    // An interior edge between two boundary vertices would pinch the boundary
+    if (!edge->isBoundary() && u->isBoundary() && v->isBoundary())
+      return false;
+
+    // Link condition: the only vertices adjacent to both endpoints must be the apexes of the triangles on the edge
+    int num_triangles = 0;
+    for (Edge::FaceConstIterator efi = edge->facesBegin(); efi != edge->facesEnd(); ++efi)
+      if ((*efi)->numVertices() == 3)
+        num_triangles++;
+
+    int num_common = 0;
+    for (Vertex::EdgeConstIterator vei = u->edgesBegin(); vei != u->edgesEnd(); ++vei)
+    {
+      Vertex const * w = (*vei)->getOtherEndpoint(u);
+      if (w != v && w->hasEdgeTo(v))
+        num_common++;
+    }
+
+    if (num_common != num_triangles)
+      return false;
+
+    // No face that survives the collapse may turn by more than 90 degrees or become degenerate
+    for (int i = 0; i < 2; ++i)
+    {
+      Vertex * w = (i == 0 ? u : v);
+      for (Vertex::FaceConstIterator vfi = w->facesBegin(); vfi != w->facesEnd(); ++vfi)
+      {
+        Face const * face = *vfi;
+        if (face->hasVertex(u) && face->hasVertex(v))
+          continue;
+
+        Vector3 sum_cross = Vector3::zero();
+        Face::VertexConstIterator vi0 = face->verticesBegin(), vi1 = vi0, vi2;
+        for ( ; vi0 != face->verticesEnd(); ++vi0)
         {
-          mergeEdges(*vei, *vej);
-          found = true;
-          break;
+          if (++vi1 == face->verticesEnd()) vi1 = face->verticesBegin();
+          vi2 = vi1;
+          if (++vi2 == face->verticesEnd()) vi2 = face->verticesBegin();
+
+          Vector3 p0 = (*vi0 == w ? position : (*vi0)->getPosition());
+          Vector3 p1 = (*vi1 == w ? position : (*vi1)->getPosition());
+          Vector3 p2 = (*vi2 == w ? position : (*vi2)->getPosition());
+          sum_cross += (p2 - p1).cross(p0 - p1);
+
+          if (face->numVertices() == 3)
+            break;
         }
 
-      if (found)
-        break;
+        if (!(sum_cross.dot(face->getNormal()) > 0))
+          return false;
+      }
+    }
+
+    return true;
+  };
+
+  enqueue(indexed_edges);
+
+  long target_faces = std::max(options.target_faces, 0L);
+  double max_cost = (options.max_error >= 0 ? options.max_error * options.max_error : -1);
+
+  std::vector<Edge *> w_edges;
+  while (!queue.empty() && numFaces() > target_faces)
+  {
+    CollapseCandidate c = queue.top();
+    queue.pop();
+
+    Edge * edge = indexed_edges[c.edge];
+    if (edge->isRemoved() || c.stamp != stamps[c.edge])
+    {
+      st.num_stale++;
+      continue;
+    }
+
+    if (max_cost >= 0 && c.cost > max_cost)
+      break;
+
+    // A rejected candidate is dropped. It is queued again if a later collapse changes one of its endpoints.
+    if (!isValidCollapse(edge, c.position))
+    {
+      st.num_rejected++;
+      continue;
     }
+
+    Quadric q = quadrics[edge->getEndpoint(0)->index];
+    q += quadrics[edge->getEndpoint(1)->index];
+
+    Vertex * w = collapseEdge(edge);
+    if (!w)
+      break;
+
+    w->setPosition(c.position);
+    quadrics[w->index] = q;
+
+    st.num_collapses++;
+    st.max_error = std::max(st.max_error, std::sqrt(c.cost));
+
+    // Only the faces around the moved vertex change shape
+    for (Vertex::FaceIterator vfi = w->facesBegin(); vfi != w->facesEnd(); ++vfi)
+      (*vfi)->updateNormal();
+
+    w->updateNormal();
+    for (Vertex::FaceIterator vfi = w->facesBegin(); vfi != w->facesEnd(); ++vfi)
+      for (Face::VertexIterator fvi = (*vfi)->verticesBegin(); fvi != (*vfi)->verticesEnd(); ++fvi)
+        if (*fvi != w && !(*fvi)->hasPrecomputedNormal())
+          (*fvi)->updateNormal();
+
+    // Only the edges of the moved vertex have a new quadric sum
+    w_edges.assign(w->edgesBegin(), w->edgesEnd());
+    enqueue(w_edges);
   }
 
-  // All double edges have been collapsed to single edges (this can happen either because faces were shrunk to zero, or because
-  // the mesh has genus > 0).
+  updateBounds();
+  invalidateCore();
 
-  return u;
+  if (stats) *stats = st;
+  return st.num_collapses;
 }
 
 void
-Mesh::draw(Graphics::RenderSystem & render_system, bool draw_edges, bool use_vertex_data, bool send_colors) const
+Mesh::draw(Graphics::RenderSystem & render_system, bool draw_edges, bool use_vertex_data, bool send_colors,
+           bool use_buffers) const
 {
+  if (use_buffers && use_vertex_data && !send_colors)
+  {
+    render_buffer.draw(*this, render_system, draw_edges);
+    return;
+  }
+
   // Three separate passes over the faces is probably faster than using Primitive::POLYGON for each face
 
   if (draw_edges)
@@ -314,24 +618,23 @@ Mesh::draw(Graphics::RenderSystem & render_system, bool draw_edges, bool use_ver
 bool
 Mesh::loadOFF(std::string const & path)
 {
-  std::ifstream in(path.c_str());
-  if (!in)
-  {
-    DGP_ERROR << "Could not open '" << path << "' for reading";
+  MappedFile file;
+  if (!file.open(path))
     return false;
-  }
 
   clear();
 
+  TextScanner in(file.getData(), file.getData() + file.getSize());
+
   std::string magic;
-  if (!(in >> magic) || magic != "OFF")
+  if (!in.readWord(magic) || magic != "OFF")
   {
     DGP_ERROR << "Header string OFF not found at beginning of file '" << path << '\'';
     return false;
   }
 
   long nv, nf, ne;
-  if (!(in >> nv >> nf >> ne))
+  if (!in.readInteger(nv) || !in.readInteger(nf) || !in.readInteger(ne))
   {
     DGP_ERROR << "Could not read element counts from OFF file '" << path << '\'';
     return false;
@@ -343,60 +646,141 @@ Mesh::loadOFF(std::string const & path)
     return false;
   }
 
-  std::vector<Vertex *> indexed_vertices;
+  // The counts come from the file, so don't trust them to size the arrays beyond what the file could possibly hold
+  long max_elems = (long)(file.getSize() / 2) + 1;
+  std::vector<Vector3> positions;
+  positions.reserve((size_t)std::min(nv, max_elems));
+
   Vector3 p;
   for (long i = 0; i < nv; ++i)
   {
-    if (!(in >> p[0] >> p[1] >> p[2]))
+    if (!in.readReal(p[0]) || !in.readReal(p[1]) || !in.readReal(p[2]))
     {
-      DGP_ERROR << "Could not read vertex " << indexed_vertices.size() << " from '" << path << '\'';
+      DGP_ERROR << "Could not read vertex " << i << " from '" << path << '\'';
       return false;
     }
 
-    Vertex * v = addVertex(p);
-    if (!v)
-      return false;
-
-    indexed_vertices.push_back(v);
+    positions.push_back(p);
   }
 
-  std::vector<Vertex *> face_vertices;
+  std::vector<uint32> face_offsets, face_indices;
+  face_offsets.reserve((size_t)std::min(nf, max_elems) + 1);
+  face_indices.reserve(3 * (size_t)std::min(nf, max_elems));
+  face_offsets.push_back(0);
+
   long num_face_vertices, vertex_index;
   for (long i = 0; i < nf; ++i)
   {
-    if (!(in >> num_face_vertices) || num_face_vertices < 0)
+    if (!in.readInteger(num_face_vertices) || num_face_vertices < 0)
     {
-      DGP_ERROR << "Could not read valid vertex count of face " << faces.size() << " from '" << path << '\'';
+      DGP_ERROR << "Could not read valid vertex count of face " << i << " from '" << path << '\'';
       return false;
     }
 
-    face_vertices.resize(num_face_vertices);
-    for (size_t j = 0; j < face_vertices.size(); ++j)
+    for (long j = 0; j < num_face_vertices; ++j)
     {
-      if (!(in >> vertex_index))
+      if (!in.readInteger(vertex_index))
       {
-        DGP_ERROR << "Could not read vertex " << j << " of face " << faces.size() << " from '" << path << '\'';
+        DGP_ERROR << "Could not read vertex " << j << " of face " << i << " from '" << path << '\'';
         return false;
       }
 
-      if (vertex_index < 0 || vertex_index >= (long)vertices.size())
+      if (vertex_index < 0 || vertex_index >= nv)
       {
-        DGP_ERROR << "Out-of-bounds index " << vertex_index << " of vertex " << j << " of face " << faces.size() << " from '"
-                  << path << '\'';
+        DGP_ERROR << "Out-of-bounds index " << vertex_index << " of vertex " << j << " of face " << i << " from '" << path
+                  << '\'';
         return false;
       }
 
-      face_vertices[j] = indexed_vertices[(size_t)vertex_index];
+      face_indices.push_back((uint32)vertex_index);
     }
 
-    addFace(face_vertices.begin(), face_vertices.end());  // ok if this fails, just skip the face with a warning
+    face_offsets.push_back((uint32)face_indices.size());
   }
 
+  setFromArrays(nv, positions.empty() ? NULL : &positions[0], nf, &face_offsets[0],
+                face_indices.empty() ? NULL : &face_indices[0]);
   setName(FilePath::objectName(path));
 
   return true;
 }
 
+void
+Mesh::setFromArrays(long num_vertices, Vector3 const * positions, long num_faces, uint32 const * face_offsets,
+                    uint32 const * face_indices)
+{
+  clear();
+
+  std::vector<Vertex *> indexed_vertices((size_t)num_vertices);
+  for (long i = 0; i < num_vertices; ++i)
+    indexed_vertices[(size_t)i] = addVertex(positions[i]);
+
+  // Open-addressed table from the (sorted) endpoint indices of each edge to the edge. There are at most as many edges as face
+  // corners, so a table with at least twice as many slots stays at most half full.
+  size_t num_slots = 16;
+  while (num_slots < 2 * (size_t)face_offsets[num_faces]) num_slots <<= 1;
+
+  uint64 const EMPTY = ~(uint64)0;
+  std::vector<uint64> edge_keys(num_slots, EMPTY);
+  std::vector<Edge *> edge_values(num_slots, NULL);
+  int shift = 64;
+  for (size_t n = num_slots; n > 1; n >>= 1) --shift;
+
+  for (long f = 0; f < num_faces; ++f)
+  {
+    uint32 const * fv = face_indices + face_offsets[f];
+    int n = (int)(face_offsets[f + 1] - face_offsets[f]);
+    if (n < 3)
+    {
+      DGP_WARNING << getName() << ": Skipping face -- too few vertices (" << n << ')';
+      continue;
+    }
+
+    Face * face = newElement(faces, free_faces, Face());
+
+    // Same sequence of operations as addFace()
+    for (int i = 0; i < n; ++i)
+    {
+      Vertex * vi = indexed_vertices[fv[i]];
+      Vertex * vnext = indexed_vertices[fv[(i + 1) % n]];
+
+      face->addVertex(vi);
+      vi->addFace(face, false);
+
+      // getEdgeTo() never finds a self-loop, so each one gets a new edge
+      Edge * edge = NULL;
+      size_t slot = 0;
+      if (vi != vnext)
+      {
+        uint32 a = std::min(fv[i], fv[(i + 1) % n]), b = std::max(fv[i], fv[(i + 1) % n]);
+        uint64 key = ((uint64)a << 32) | b;
+        for (slot = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> shift); ; slot = (slot + 1) & (num_slots - 1))
+        {
+          if (edge_keys[slot] == key) { edge = edge_values[slot]; break; }
+          if (edge_keys[slot] == EMPTY) { edge_keys[slot] = key; break; }
+        }
+      }
+
+      if (!edge)
+      {
+        edge = newElement(edges, free_edges, Edge(vi, vnext));
+
+        vi->addEdge(edge);
+        vnext->addEdge(edge);
+
+        if (vi != vnext) edge_values[slot] = edge;
+      }
+
+      edge->addFace(face);
+      face->addEdge(edge);
+    }
+
+    face->updateNormal();
+    for (Face::VertexIterator fvi = face->verticesBegin(); fvi != face->verticesEnd(); ++fvi)
+      (*fvi)->addFaceNormal(face->getNormal());
+  }
+}
+
 bool
 Mesh::saveOFF(std::string const & path) const
 {
@@ -410,15 +794,12 @@ Mesh::saveOFF(std::string const & path) const
   out << "OFF\n";
   out << numVertices() << ' ' << numFaces() << " 0\n";
 
-  typedef std::unordered_map<Vertex const *, long> VertexIndexMap;
-  VertexIndexMap vertex_indices;
-  long index = 0;
-  for (VertexConstIterator vi = vertices.begin(); vi != vertices.end(); ++vi, ++index)
+  numberElements();
+
+  for (VertexConstIterator vi = vertices.begin(); vi != vertices.end(); ++vi)
   {
     Vector3 const & p = vi->getPosition();
     out << p[0] << ' ' << p[1] << ' ' << p[2] << '\n';
-
-    vertex_indices[&(*vi)] = index;
   }
 
   for (FaceConstIterator fi = faces.begin(); fi != faces.end(); ++fi)
@@ -426,23 +807,345 @@ Mesh::saveOFF(std::string const & path) const
     out << fi->numVertices();
 
     for (Face::VertexConstIterator vi = fi->verticesBegin(); vi != fi->verticesEnd(); ++vi)
+      out << ' ' << (*vi)->index;
+
+    out << '\n';
+  }
+
+  return true;
+}
+
+void
+Mesh::numberElements() const
+{
+  uint32 index = 0;
+  for (VertexConstIterator vi = vertices.begin(); vi != vertices.end(); ++vi, ++index)
+    vi->index = index;
+
+  index = 0;
+  for (EdgeConstIterator ei = edges.begin(); ei != edges.end(); ++ei, ++index)
+    ei->index = index;
+
+  index = 0;
+  for (FaceConstIterator fi = faces.begin(); fi != faces.end(); ++fi, ++index)
+    fi->index = index;
+}
+
+namespace MeshInternal {
+
+// Binary mesh file layout (all values little-endian):
+//
+//   magic "DGPBMESH", uint32 version, uint32 flags, uint32 #vertices, uint32 #edges, uint32 #faces
+//   vertex positions (3 x float32 each)
+//   edge endpoints (2 x uint32 each)
+//   index lists, each as (#elements + 1) uint32 offsets followed by the concatenated uint32 indices:
+//     face vertices, face edges, edge faces, vertex edges, vertex faces
+//   if flags & HAS_NORMALS: vertex normals (3 x float32), vertex normal factors (float32), vertex normal-is-precomputed flags
+//     (uint8), face normals (3 x float32)
+//   CRC32 of all preceding bytes (uint32)
+//
+// Bump the version whenever the layout changes: files with any other version are rejected.
+char const BINARY_MESH_MAGIC[8] = { 'D', 'G', 'P', 'B', 'M', 'E', 'S', 'H' };
+uint32 const BINARY_MESH_VERSION = 1;
+uint32 const BINARY_MESH_HAS_NORMALS = 0x01;
+int64 const BINARY_MESH_HEADER_SIZE = 8 + 5 * 4;
+
+// Write a set of index lists in CSR form, and reset the arrays for the next set.
+void
+writeIndexLists(BinaryOutputStream & out, std::vector<uint32> & offsets, std::vector<uint32> & indices)
+{
+  out.writeUInt32((int64)offsets.size(), &offsets[0]);
+  if (!indices.empty()) out.writeUInt32((int64)indices.size(), &indices[0]);
+
+  offsets.assign(1, 0);
+  indices.clear();
+}
+
+// Read a set of index lists in CSR form, checking that the offsets are consistent and the indices are in range.
+bool
+readIndexLists(BinaryInputStream & in, uint32 num_lists, uint32 num_targets, std::vector<uint32> & offsets,
+               std::vector<uint32> & indices)
+{
+  if ((int64)num_lists + 1 > (in.size() - in.getPosition()) / 4)
+    return false;
+
+  offsets.resize((size_t)num_lists + 1);
+  in.readUInt32((int64)offsets.size(), &offsets[0]);
+  if (offsets[0] != 0)
+    return false;
+
+  for (uint32 i = 0; i < num_lists; ++i)
+    if (offsets[i + 1] < offsets[i])
+      return false;
+
+  uint32 n = offsets[num_lists];
+  if ((int64)n > (in.size() - in.getPosition()) / 4)
+    return false;
+
+  indices.resize((size_t)n);
+  if (n > 0) in.readUInt32((int64)n, &indices[0]);
+
+  for (uint32 i = 0; i < n; ++i)
+    if (indices[i] >= num_targets)
+      return false;
+
+  return true;
+}
+
+} // namespace MeshInternal
+
+bool
+Mesh::loadBinary(std::string const & path)
+{
+  using namespace MeshInternal;
+
+  MappedFile file;
+  if (!file.open(path))
+    return false;
+
+  clear();
+
+  uint8 const * data = reinterpret_cast<uint8 const *>(file.getData());
+  int64 size = file.getSize();
+  if (size < BINARY_MESH_HEADER_SIZE + 4 || std::memcmp(data, BINARY_MESH_MAGIC, sizeof(BINARY_MESH_MAGIC)) != 0)
+  {
+    DGP_ERROR << "File '" << path << "' is not a binary mesh";
+    return false;
+  }
+
+  BinaryInputStream in(data, size, Endianness::LITTLE, BinaryInputStream::NO_COPY);
+
+  in.setPosition(size - 4);
+  if (in.readUInt32() != Crypto::crc32(data, (size_t)(size - 4)))
+  {
+    DGP_ERROR << "Checksum mismatch in binary mesh '" << path << "', the file is corrupt";
+    return false;
+  }
+
+  in.setPosition(sizeof(BINARY_MESH_MAGIC));
+  uint32 version = in.readUInt32();
+  if (version != BINARY_MESH_VERSION)
+  {
+    DGP_ERROR << "Binary mesh '" << path << "' has version " << version << ", expected " << BINARY_MESH_VERSION;
+    return false;
+  }
+
+  uint32 flags = in.readUInt32();
+  uint32 nv = in.readUInt32();
+  uint32 ne = in.readUInt32();
+  uint32 nf = in.readUInt32();
+
+  // The checksum guards against corruption but not against a buggy writer, so make sure every array fits in the file
+  int64 body_size = size - 4 - BINARY_MESH_HEADER_SIZE;
+  if ((int64)nv * 12 + (int64)ne * 8 > body_size)
+  {
+    DGP_ERROR << "Element counts in binary mesh '" << path << "' exceed the file size";
+    return false;
+  }
+
+  std::vector<Vector3> positions((size_t)nv);
+  if (nv > 0) in.readVector3((int64)nv, &positions[0]);
+
+  std::vector<uint32> endpoints(2 * (size_t)ne);
+  if (ne > 0) in.readUInt32(2 * (int64)ne, &endpoints[0]);
+
+  for (size_t i = 0; i < endpoints.size(); ++i)
+    if (endpoints[i] >= nv)
     {
-      VertexIndexMap::const_iterator existing = vertex_indices.find(*vi);
-      if (existing == vertex_indices.end())
-      {
-        DGP_ERROR << "Face references vertex absent from mesh '" << path << '\'';
-        return false;
-      }
+      DGP_ERROR << "Out-of-range edge endpoint in binary mesh '" << path << '\'';
+      return false;
+    }
 
-      out << ' ' << existing->second;
+  // Relations, in file order: face vertices, face edges, edge faces, vertex edges, vertex faces
+  uint32 const num_lists[5]   = { nf, nf, ne, nv, nv };
+  uint32 const num_targets[5] = { nv, ne, nf, ne, nf };
+  std::vector<uint32> offsets[5], indices[5];
+  for (int r = 0; r < 5; ++r)
+    if (!readIndexLists(in, num_lists[r], num_targets[r], offsets[r], indices[r]))
+    {
+      DGP_ERROR << "Invalid adjacency data in binary mesh '" << path << '\'';
+      return false;
     }
 
-    out << '\n';
+  bool has_normals = ((flags & BINARY_MESH_HAS_NORMALS) != 0);
+  std::vector<Vector3> vertex_normals, face_normals;
+  std::vector<float32> normal_factors;
+  std::vector<uint8> precomputed_normals;
+  if (has_normals)
+  {
+    if ((int64)nv * 17 + (int64)nf * 12 != in.size() - 4 - in.getPosition())
+    {
+      DGP_ERROR << "Invalid normal data in binary mesh '" << path << '\'';
+      return false;
+    }
+
+    vertex_normals.resize((size_t)nv);
+    normal_factors.resize((size_t)nv);
+    precomputed_normals.resize((size_t)nv);
+    face_normals.resize((size_t)nf);
+    if (nv > 0)
+    {
+      in.readVector3((int64)nv, &vertex_normals[0]);
+      in.readFloat32((int64)nv, &normal_factors[0]);
+      in.readUInt8((int64)nv, &precomputed_normals[0]);
+    }
+
+    if (nf > 0) in.readVector3((int64)nf, &face_normals[0]);
+  }
+
+  // Create the elements, then link them exactly as listed in the file
+  std::vector<Vertex *> vertex_refs((size_t)nv);
+  for (uint32 v = 0; v < nv; ++v)
+    vertex_refs[v] = addVertex(positions[v]);
+
+  std::vector<Edge *> edge_refs((size_t)ne);
+  for (uint32 e = 0; e < ne; ++e)
+  {
+    edge_refs[e] = newElement(edges, free_edges, Edge(vertex_refs[endpoints[2 * e]], vertex_refs[endpoints[2 * e + 1]]));
+  }
+
+  std::vector<Face *> face_refs((size_t)nf);
+  for (uint32 f = 0; f < nf; ++f)
+  {
+    face_refs[f] = newElement(faces, free_faces, Face());
+  }
+
+  for (uint32 f = 0; f < nf; ++f)
+  {
+    for (uint32 i = offsets[0][f]; i < offsets[0][f + 1]; ++i) face_refs[f]->addVertex(vertex_refs[indices[0][i]]);
+    for (uint32 i = offsets[1][f]; i < offsets[1][f + 1]; ++i) face_refs[f]->addEdge(edge_refs[indices[1][i]]);
   }
 
+  for (uint32 e = 0; e < ne; ++e)
+    for (uint32 i = offsets[2][e]; i < offsets[2][e + 1]; ++i) edge_refs[e]->addFace(face_refs[indices[2][i]]);
+
+  for (uint32 v = 0; v < nv; ++v)
+  {
+    for (uint32 i = offsets[3][v]; i < offsets[3][v + 1]; ++i) vertex_refs[v]->addEdge(edge_refs[indices[3][i]]);
+    for (uint32 i = offsets[4][v]; i < offsets[4][v + 1]; ++i) vertex_refs[v]->addFace(face_refs[indices[4][i]], false);
+  }
+
+  if (has_normals)
+  {
+    for (uint32 v = 0; v < nv; ++v)
+    {
+      vertex_refs[v]->normal = vertex_normals[v];
+      vertex_refs[v]->normal_normalization_factor = normal_factors[v];
+      vertex_refs[v]->has_precomputed_normal = (precomputed_normals[v] != 0);
+    }
+
+    for (uint32 f = 0; f < nf; ++f)
+      face_refs[f]->setNormal(face_normals[f]);
+  }
+  else
+  {
+    // Same accumulation as addFace()
+    for (uint32 f = 0; f < nf; ++f)
+    {
+      Face * face = face_refs[f];
+      if (face->numVertices() < 3)
+        continue;
+
+      face->updateNormal();
+      for (Face::VertexIterator fvi = face->verticesBegin(); fvi != face->verticesEnd(); ++fvi)
+        (*fvi)->addFaceNormal(face->getNormal());
+    }
+  }
+
+  setName(FilePath::objectName(path));
+
   return true;
 }
 
+bool
+Mesh::saveBinary(std::string const & path) const
+{
+  using namespace MeshInternal;
+
+  if (vertices.size() >= 0xFFFFFFFF || edges.size() >= 0xFFFFFFFF || faces.size() >= 0xFFFFFFFF)
+  {
+    DGP_ERROR << "Mesh '" << getName() << "' is too large to save in binary format";
+    return false;
+  }
+
+  numberElements();
+
+  // Assemble the file in memory so the checksum can be computed over it
+  BinaryOutputStream body(Endianness::LITTLE);
+  body.writeBytes(sizeof(BINARY_MESH_MAGIC), BINARY_MESH_MAGIC);
+  body.writeUInt32(BINARY_MESH_VERSION);
+  body.writeUInt32(BINARY_MESH_HAS_NORMALS);
+  body.writeUInt32((uint32)vertices.size());
+  body.writeUInt32((uint32)edges.size());
+  body.writeUInt32((uint32)faces.size());
+
+  for (VertexConstIterator vi = vertices.begin(); vi != vertices.end(); ++vi)
+    body.writeVector3(vi->getPosition());
+
+  for (EdgeConstIterator ei = edges.begin(); ei != edges.end(); ++ei)
+  {
+    body.writeUInt32(ei->getEndpoint(0)->index);
+    body.writeUInt32(ei->getEndpoint(1)->index);
+  }
+
+  std::vector<uint32> offsets(1, 0), indices;
+
+  for (FaceConstIterator fi = faces.begin(); fi != faces.end(); ++fi)
+  {
+    for (Face::VertexConstIterator j = fi->verticesBegin(); j != fi->verticesEnd(); ++j) indices.push_back((*j)->index);
+    offsets.push_back((uint32)indices.size());
+  }
+  writeIndexLists(body, offsets, indices);
+
+  for (FaceConstIterator fi = faces.begin(); fi != faces.end(); ++fi)
+  {
+    for (Face::EdgeConstIterator j = fi->edgesBegin(); j != fi->edgesEnd(); ++j) indices.push_back((*j)->index);
+    offsets.push_back((uint32)indices.size());
+  }
+  writeIndexLists(body, offsets, indices);
+
+  for (EdgeConstIterator ei = edges.begin(); ei != edges.end(); ++ei)
+  {
+    for (Edge::FaceConstIterator j = ei->facesBegin(); j != ei->facesEnd(); ++j) indices.push_back((*j)->index);
+    offsets.push_back((uint32)indices.size());
+  }
+  writeIndexLists(body, offsets, indices);
+
+  for (VertexConstIterator vi = vertices.begin(); vi != vertices.end(); ++vi)
+  {
+    for (Vertex::EdgeConstIterator j = vi->edgesBegin(); j != vi->edgesEnd(); ++j) indices.push_back((*j)->index);
+    offsets.push_back((uint32)indices.size());
+  }
+  writeIndexLists(body, offsets, indices);
+
+  for (VertexConstIterator vi = vertices.begin(); vi != vertices.end(); ++vi)
+  {
+    for (Vertex::FaceConstIterator j = vi->facesBegin(); j != vi->facesEnd(); ++j) indices.push_back((*j)->index);
+    offsets.push_back((uint32)indices.size());
+  }
+  writeIndexLists(body, offsets, indices);
+
+  for (VertexConstIterator vi = vertices.begin(); vi != vertices.end(); ++vi) body.writeVector3(vi->getNormal());
+  for (VertexConstIterator vi = vertices.begin(); vi != vertices.end(); ++vi) body.writeFloat32(vi->normal_normalization_factor);
+  for (VertexConstIterator vi = vertices.begin(); vi != vertices.end(); ++vi) body.writeUInt8(vi->hasPrecomputedNormal() ? 1 : 0);
+  for (FaceConstIterator fi = faces.begin(); fi != faces.end(); ++fi) body.writeVector3(fi->getNormal());
+
+  std::vector<uint8> bytes((size_t)body.size());
+  static_cast<BinaryOutputStream const &>(body).commit(&bytes[0]);  // the non-const overload commits to a file
+
+  BinaryOutputStream out(path, Endianness::LITTLE);
+  if (!out.ok())
+  {
+    DGP_ERROR << "Could not open '" << path << "' for writing";
+    return false;
+  }
+
+  out.writeBytes((int64)bytes.size(), &bytes[0]);
+  out.writeUInt32(Crypto::crc32(&bytes[0], bytes.size()));
+
+  return out.commit();
+}
+
 bool
 Mesh::load(std::string const & path)
 {
@@ -450,6 +1153,8 @@ Mesh::load(std::string const & path)
   bool status = false;
   if (endsWith(path_lc, ".off"))
     status = loadOFF(path);
+  else if (endsWith(path_lc, ".bmesh"))
+    status = loadBinary(path);
   else
   {
     DGP_ERROR << "Unsupported mesh format: " << path;
@@ -464,95 +1169,586 @@ Mesh::save(std::string const & path) const
   std::string path_lc = toLower(path);
   if (endsWith(path_lc, ".off"))
     return saveOFF(path);
+  else if (endsWith(path_lc, ".bmesh"))
+    return saveBinary(path);
 
   DGP_ERROR << "Unsupported mesh format: " << path;
   return false;
 }
 
-void
-Mesh::bilateralSmooth(double sigma_c, double sigma_s)
+MeshCore &
+Mesh::getCore()
+{
+  if (core_needs_rebuild)
+  {
+    core.build(*this);
+    core_needs_rebuild = false;
+  }
+  else
+    core.readAttributes();
+
+  return core;
+}
+
+MeshStatistics const &
+Mesh::getStatistics(ThreadPool * pool)
+{
+  if (statistics_dirty)
+  {
+    statistics = MeshStatistics::compute(getCore(), pool);
+    statistics_dirty = false;
+  }
+
+  return statistics;
+}
+
+MeshPicker const &
+Mesh::getPicker()
+{
+  if (picker.needsUpdate())
+    picker.update(getCore());
+
+  return picker;
+}
+
+MeshVertex *
+Mesh::pickVertex(Camera const & camera, Vector2 const & screen_pos)
+{
+  MeshCore::Index v = getPicker().pickVertex(MeshPicker::computeRay(camera, screen_pos));
+  return v == MeshCore::NONE ? NULL : core.getVertex(v);
+}
+
+// Create an empty spatial index of the given type.
+static PointIndex3 *
+createPointIndex(Mesh::SpatialIndexType type)
+{
+  switch (type)
+  {
+    case Mesh::SpatialIndexType::KD_TREE: return new PointKDTree3;
+    default:                              return new PointHashGrid3;
+  }
+}
+
+// Gather the neighbourhood of a vertex from the positions currently stored in the core. If \a index is non-null, the
+// neighbourhood is the Euclidean ball found with the index, else it is found by searching the mesh graph.
+static void
+gatherNeighbours(MeshCore const & c, MeshCore::Index p, double sigma_c, PointIndex3 const * index,
+                 MeshCore::Scratch & scratch, std::vector<MeshCore::Index> & neighbours)
+{
+  if (index)
+    c.findNeighbourVertices(p, (Real)(2 * sigma_c), *index, scratch, neighbours);
+  else
+    c.findNeighbourVertices(p, 2 * sigma_c, scratch, neighbours);
+}
+
+// Per-thread arrays for evaluating the weights of a whole neighbourhood with GaussianWeights.
+struct WeightBuffers
 {
-  VertexIterator p = vertices.begin();
-  std::list<MeshVertex*> neighbours;
+  std::vector<float> sq_dist;  // squared distance of each neighbour from the vertex
+  std::vector<float> height;   // signed distance of each neighbour from the tangent plane
+  std::vector<float> weights;  // product of the closeness and similarity weights
+};
+
+// Compute the bilateral update of a vertex with a given normal and neighbourhood, from the positions currently stored in the
+// core. If \a buffers is non-null, the weights are evaluated in a batch in single precision, else one at a time in double
+// precision.
+static Vector3
+bilateralStep(MeshCore const & c, MeshCore::Index p, Vector3 const & normal, std::vector<MeshCore::Index> const & neighbours,
+              double sigma_c, double sigma_s, WeightBuffers * buffers = NULL)
+{
+  Vector3 oldP = c.getPosition(p);
+
+  if (buffers && !neighbours.empty())
+  {
+    size_t n = neighbours.size();
+    buffers->sq_dist.resize(n);
+    buffers->height.resize(n);
+    buffers->weights.resize(n);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+      Vector3 d = c.getPosition(neighbours[i]) - oldP;
+      buffers->sq_dist[i] = d.squaredLength();
+      buffers->height[i] = normal.dot(d);
+    }
 
-  while(p != vertices.end()){
-    neighbours = (*p).findNeighbours(sigma_c);
-    p->isCovered = false;
-    Vector3 oldP = p->getPosition();
-    Vector3 normal;
-    if(p->hasPrecomputedNormal()){ normal = p->getNormal(); }
-    else{ p->updateNormal(); normal = p->getNormal(); }
+    GaussianWeights::evaluate((long)n, &buffers->sq_dist[0], &buffers->height[0], (float)(1 / (2 * sigma_c * sigma_c)),
+                              (float)(1 / (2 * sigma_s * sigma_s)), &buffers->weights[0]);
 
     double sum = 0;
     double normalizer = 0;
-    std::list<MeshVertex*>::iterator i = neighbours.begin();
-    while(i != neighbours.end()){
-      double t = ((*i)->getPosition() - oldP).length();
-      double h = normal.dot((*i)->getPosition() - oldP);
-      double wc = exp((-t*t)/(2*sigma_c*sigma_c));
-      double ws = exp((-h*h)/(2*sigma_s*sigma_s));
-      sum += wc*ws*h;
-      normalizer += wc*ws;
-      (*i)->isCovered = false;
-      i++;
+    for (size_t i = 0; i < n; ++i)
+    {
+      sum += buffers->weights[i] * buffers->height[i];
+      normalizer += buffers->weights[i];
     }
 
-    Vector3 newP = oldP + normal*(sum/normalizer);
-    p->setPosition(newP);
-    p++;
-    neighbours.clear();
+    return oldP + normal*(sum/normalizer);
+  }
+
+  double sum = 0;
+  double normalizer = 0;
+  for (size_t i = 0; i < neighbours.size(); ++i)
+  {
+    Vector3 const & q = c.getPosition(neighbours[i]);
+    double t = (q - oldP).length();
+    double h = normal.dot(q - oldP);
+    double wc = exp((-t*t)/(2*sigma_c*sigma_c));
+    double ws = exp((-h*h)/(2*sigma_s*sigma_s));
+    sum += wc*ws*h;
+    normalizer += wc*ws;
   }
+
+  return oldP + normal*(sum/normalizer);
+}
+
+// Compute the bilateral update of a single vertex from the positions and normals currently stored in the core, gathering its
+// neighbourhood as gatherNeighbours() does.
+static Vector3
+bilateralUpdate(MeshCore const & c, MeshCore::Index p, double sigma_c, double sigma_s, PointIndex3 const * index,
+                MeshCore::Scratch & scratch, std::vector<MeshCore::Index> & neighbours, WeightBuffers * buffers)
+{
+  gatherNeighbours(c, p, sigma_c, index, scratch, neighbours);
+  return bilateralStep(c, p, c.getNormal(p), neighbours, sigma_c, sigma_s, buffers);
+}
+
+void
+Mesh::updateNormals(NormalWeighting weighting, ThreadPool * pool)
+{
+  MeshCore & c = getCore();
+  c.updateNormals(weighting, pool);
+  c.writeAttributes();
+  invalidateVertexData();
 }
 
 void
-Mesh::noiseMesh(double sigma)
+Mesh::bilateralSmooth(double sigma_c, double sigma_s, SmoothingOptions const & options)
 {
-  std::default_random_engine generator;
-  std::normal_distribution<double> distribution(0.0,sigma);
+  MeshCore & c = getCore();
+  long nv = c.numVertices();
+  ThreadPool & pool = (options.thread_pool ? *options.thread_pool : ThreadPool::common());
+
+  // Normals are fixed for the pass, so they are all computed up front instead of as each vertex is reached
+  c.updateNormals(options.normal_weighting, &pool);
 
-  VertexIterator v = vertices.begin();
-  while(v != vertices.end()){
-    Vector3 position = v->getPosition();
-    position.set(position.x()+distribution(generator), position.y()+distribution(generator), position.z()+distribution(generator));
-    v->setPosition(position);
-    v++;
+  std::unique_ptr<PointIndex3> index;
+  if (options.neighbourhood == NeighbourhoodType::EUCLIDEAN)
+  {
+    index.reset(createPointIndex(options.spatial_index));
+    index->build(c.getPositions(), nv, (Real)(2 * sigma_c));
   }
+
+  uint8 const * mask = options.vertex_mask;
+
+  if (options.update_mode == UpdateMode::JACOBI)
+  {
+    // Every vertex reads the positions in the core, which stay fixed for the whole pass, and writes its result to a separate
+    // buffer, so vertices can be processed in any order.
+    std::vector<MeshCore::Scratch> scratch((size_t)pool.maxParticipants());
+    std::vector< std::vector<MeshCore::Index> > neighbours((size_t)pool.maxParticipants());
+    std::vector<WeightBuffers> buffers((size_t)pool.maxParticipants());
+    std::vector<Vector3> new_positions((size_t)nv);
+
+    pool.parallelFor(0, nv, [&](long lo, long hi, long t) {
+      for (long p = lo; p < hi; ++p)
+        new_positions[(size_t)p] = (mask && !mask[p] ? c.getPosition((MeshCore::Index)p)
+                                                     : bilateralUpdate(c, (MeshCore::Index)p, sigma_c, sigma_s, index.get(),
+                                                                       scratch[(size_t)t], neighbours[(size_t)t],
+                                                                       (options.fast_weights ? &buffers[(size_t)t] : NULL)));
+    });
+
+    c.swapPositions(new_positions);
+  }
+  else if (options.update_mode == UpdateMode::COLORED)
+  {
+    // Neighbourhoods are gathered up front, since the coloring must know them before any vertex moves. Vertices that do not
+    // move keep empty neighbourhoods, which never conflict with a color.
+    std::vector<MeshCore::Scratch> scratch((size_t)pool.maxParticipants());
+    std::vector<WeightBuffers> buffers((size_t)pool.maxParticipants());
+    std::vector< std::vector<MeshCore::Index> > neighbours((size_t)nv);
+
+    pool.parallelFor(0, nv, [&](long lo, long hi, long t) {
+      for (long p = lo; p < hi; ++p)
+        if (!mask || mask[p])
+          gatherNeighbours(c, (MeshCore::Index)p, sigma_c, index.get(), scratch[(size_t)t], neighbours[(size_t)p]);
+    });
+
+    NeighbourhoodColoring coloring;
+    coloring.build(neighbours);
+
+    // No vertex of a color reads the position of another, so the vertices of a color can be moved in place concurrently
+    for (long k = 0; k < coloring.numColors(); ++k)
+    {
+      MeshCore::Index const * color_vertices = coloring.colorVertices(k);
+      pool.parallelFor(0, coloring.numColorVertices(k), [&](long lo, long hi, long t) {
+        for (long i = lo; i < hi; ++i)
+        {
+          MeshCore::Index p = color_vertices[i];
+          if (mask && !mask[p]) continue;
+
+          c.setPosition(p, bilateralStep(c, p, c.getNormal(p), neighbours[p], sigma_c, sigma_s,
+                                         (options.fast_weights ? &buffers[(size_t)t] : NULL)));
+        }
+      });
+    }
+  }
+  else
+  {
+    MeshCore::Scratch scratch;
+    std::vector<MeshCore::Index> neighbours;
+    WeightBuffers buffers;
+
+    for (long p = 0; p < nv; ++p)
+      if (!mask || mask[p])
+        c.setPosition((MeshCore::Index)p, bilateralUpdate(c, (MeshCore::Index)p, sigma_c, sigma_s, index.get(), scratch,
+                                                          neighbours, (options.fast_weights ? &buffers : NULL)));
+  }
+
+  c.updateNormals(options.normal_weighting, &pool);
+  c.writeAttributes();
+  invalidateVertexData();
 }
 
-Real
-Mesh::getAverageDistance()
+long
+Mesh::bilateralSmoothIterative(double sigma_c, double sigma_s, IterationOptions const & iteration_options,
+                               SmoothingOptions const & options, IterationStats * stats)
 {
-  VertexIterator v = vertices.begin();
-  Real total = 0;
-  long n = 1;
-  while(v != vertices.end()){
-    MeshVertex::EdgeIterator i = v->edgesBegin();
-    while(i != v->edgesEnd()){
-      total += ((v->getPosition() - (*i)->getOtherEndpoint(&(*v))->getPosition()).length() - total)/n;
-      n++;
-      i++;
+  MeshCore & c = getCore();
+  long nv = c.numVertices();
+  bool jacobi = (options.update_mode == UpdateMode::JACOBI);
+  bool colored = (options.update_mode == UpdateMode::COLORED);
+  ThreadPool & pool = (options.thread_pool ? *options.thread_pool : ThreadPool::common());
+  long num_participants = (jacobi || colored ? pool.maxParticipants() : 1);
+
+  uint8 const * mask = options.vertex_mask;
+  long num_moving = nv;
+  if (mask)
+    num_moving = (long)std::count_if(mask, mask + nv, [](uint8 m) { return m != 0; });
+
+  IterationStats st;
+  std::vector<MeshCore::Scratch> scratch((size_t)num_participants);
+  std::vector<long> pass_gathers((size_t)num_participants);
+  std::vector<WeightBuffers> buffers((size_t)num_participants);
+  std::vector<Vector3> new_positions;
+  std::unique_ptr<PointIndex3> index;
+  if (options.neighbourhood == NeighbourhoodType::EUCLIDEAN)
+    index.reset(createPointIndex(options.spatial_index));
+
+  // Each neighbourhood is kept across passes along with how far each of its vertices, and the center vertex, had travelled
+  // in total when it was gathered. It is reused while none of them has since travelled further than the reuse distance.
+  std::vector< std::vector<MeshCore::Index> > neighbours((size_t)nv);
+  std::vector< std::vector<Real> > neighbour_travel((size_t)nv);
+  std::vector<Real> center_travel((size_t)nv, 0);
+  std::vector<Real> travel((size_t)nv, 0);        // total distance travelled by each vertex
+  std::vector<Real> displacement((size_t)nv, 0);  // distance moved by each vertex in the current pass
+  Real reuse_dist = (Real)(iteration_options.reuse_fraction * sigma_c);
+
+  // With colored updates, the coloring is kept across passes and repaired around the neighbourhoods gathered by each pass
+  NeighbourhoodColoring coloring;
+  std::vector<char> nbrs_changed;
+  std::vector<MeshCore::Index> changed;
+  std::vector< std::vector<MeshCore::Index> > previous((size_t)(colored ? num_participants : 0));
+
+  // Vertices moved by a pass, whose faces need new normals
+  std::vector<MeshCore::Index> moved;
+  long num_free_normals = 0;
+  for (long p = 0; p < nv; ++p)
+    if (!c.hasPrecomputedNormal((MeshCore::Index)p))
+      num_free_normals++;
+
+  // The first pass uses the normals bilateralSmooth() would
+  c.updateNormals(options.normal_weighting, &pool);
+
+  for (long iter = 0; iter < iteration_options.max_iterations; ++iter)
+  {
+    if (index) index->build(c.getPositions(), nv, (Real)(2 * sigma_c));
+
+    // Same update order as bilateralSmooth(). In place, each neighbourhood is gathered just before its vertex is updated.
+    std::fill(pass_gathers.begin(), pass_gathers.end(), 0);
+    // Returns true if the neighbourhood was gathered. With colored updates, only if it was also different from before.
+    auto refresh = [&](long p, long t) {
+      if (mask && !mask[p]) return false;
+
+      std::vector<MeshCore::Index> & nbrs = neighbours[(size_t)p];
+      std::vector<Real> & nbr_travel = neighbour_travel[(size_t)p];
+
+      bool gather = (iter == 0 || !(travel[(size_t)p] - center_travel[(size_t)p] < reuse_dist));
+      for (size_t i = 0; i < nbrs.size() && !gather; ++i)
+        gather = !(travel[nbrs[i]] - nbr_travel[i] < reuse_dist);
+
+      if (gather)
+      {
+        if (colored) previous[(size_t)t].swap(nbrs);
+        gatherNeighbours(c, (MeshCore::Index)p, sigma_c, index.get(), scratch[(size_t)t], nbrs);
+        nbr_travel.resize(nbrs.size());
+        for (size_t i = 0; i < nbrs.size(); ++i)
+          nbr_travel[i] = travel[nbrs[i]];
+
+        center_travel[(size_t)p] = travel[(size_t)p];
+        pass_gathers[(size_t)t]++;
+
+        if (colored && nbrs == previous[(size_t)t])
+          return false;
+      }
+
+      return gather;
+    };
+
+    auto step = [&](long p, long t) {
+      MeshCore::Index pi = (MeshCore::Index)p;
+      Vector3 const & old_pos = c.getPosition(pi);
+      if (mask && !mask[p])
+      {
+        displacement[(size_t)p] = -1;
+        if (jacobi) new_positions[(size_t)p] = old_pos;
+        return;
+      }
+
+      Vector3 new_pos = bilateralStep(c, pi, c.getNormal(pi), neighbours[(size_t)p], sigma_c, sigma_s,
+                                      (options.fast_weights ? &buffers[(size_t)t] : NULL));
+      displacement[(size_t)p] = (new_pos != old_pos ? (new_pos - old_pos).length() : -1);  // negative if unmoved
+
+      if (jacobi) new_positions[(size_t)p] = new_pos;
+      else        c.setPosition(pi, new_pos);
+    };
+
+    auto update = [&](long lo, long hi, long t) {
+      for (long p = lo; p < hi; ++p)
+      {
+        refresh(p, t);
+        step(p, t);
+      }
+    };
+
+    if (jacobi)
+    {
+      new_positions.resize((size_t)nv);
+      pool.parallelFor(0, nv, update);
+      c.swapPositions(new_positions);
+    }
+    else if (colored)
+    {
+      // Gather from the positions at the start of the pass, then repair the coloring where neighbourhoods changed
+      nbrs_changed.assign((size_t)nv, 0);
+      pool.parallelFor(0, nv, [&](long lo, long hi, long t) {
+        for (long p = lo; p < hi; ++p)
+          nbrs_changed[(size_t)p] = refresh(p, t);
+      });
+
+      if (iter == 0)
+      {
+        coloring.build(neighbours);
+        st.num_colorings++;
+      }
+      else
+      {
+        changed.clear();
+        for (long p = 0; p < nv; ++p)
+          if (nbrs_changed[(size_t)p])
+            changed.push_back((MeshCore::Index)p);
+
+        long num_recolored = coloring.update(neighbours, changed.empty() ? NULL : &changed[0], (long)changed.size());
+        if (num_recolored >= nv && nv > 0) st.num_colorings++;
+        else                               st.num_recolored += num_recolored;
+      }
+
+      for (long k = 0; k < coloring.numColors(); ++k)
+      {
+        MeshCore::Index const * color_vertices = coloring.colorVertices(k);
+        pool.parallelFor(0, coloring.numColorVertices(k), [&](long lo, long hi, long t) {
+          for (long i = lo; i < hi; ++i)
+            step((long)color_vertices[i], t);
+        });
+      }
+    }
+    else
+      update(0, nv, 0);
+
+    // Travel is only updated between passes, so every vertex of a pass sees the same values
+    double total_displacement = 0;
+    for (long p = 0; p < nv; ++p)
+      if (displacement[(size_t)p] > 0)
+      {
+        total_displacement += displacement[(size_t)p];
+        travel[(size_t)p] += displacement[(size_t)p];
+      }
+
+    for (size_t t = 0; t < pass_gathers.size(); ++t)
+      st.num_gathers += pass_gathers[t];
+
+    // Refresh the normals of faces around moved vertices, then of the vertices of those faces
+    if (iteration_options.incremental_normals)
+    {
+      moved.clear();
+      for (long p = 0; p < nv; ++p)
+        if (displacement[(size_t)p] >= 0)
+          moved.push_back((MeshCore::Index)p);
+
+      st.num_normal_updates += c.updateNormals(moved.empty() ? NULL : &moved[0], (long)moved.size(),
+                                               options.normal_weighting, &pool);
     }
-    v++;
+    else
+    {
+      c.updateNormals(options.normal_weighting, &pool);
+      st.num_normal_updates += num_free_normals;
+    }
+
+    st.num_iterations++;
+    st.mean_displacement = (num_moving > 0 ? total_displacement / num_moving : 0);
+
+    if (iteration_options.pass_callback)
+      iteration_options.pass_callback(c, st);
+
+    if (st.mean_displacement < iteration_options.tolerance)
+      break;
   }
-  return total;
+
+  c.writeAttributes();
+  invalidateVertexData();  // the first pass refreshes every vertex normal
+
+  if (stats) *stats = st;
+  return st.num_iterations;
 }
 
-Real
-Mesh::getdifference()
+bool
+Mesh::fairImplicit(double lambda, FairingOptions const & options, FairingStats * stats)
 {
-  Mesh m;
-  m.load("./orig.off");
+  MeshCore & c = getCore();
+  long nv = c.numVertices();
+  ThreadPool & pool = (options.thread_pool ? *options.thread_pool : ThreadPool::common());
 
-  Real total = 0;
-  long n = 1;
+  // Cotangent weights make lambda an area, so it is scaled to the mesh
+  double step = lambda;
+  if (options.weighting == LaplacianWeighting::COTANGENT)
+  {
+    double d = getStatistics(&pool).mean_edge_length;
+    step *= d * d;
+  }
 
-  VertexIterator v1 = vertices.begin();
-  VertexIterator v2 = m.verticesBegin();
-  while(v1 != vertices.end()){
-    total += ((v1->getPosition() - v2->getPosition()).length() - total)/n;
-    n++;
-    v1++; v2++;
+  ConjugateGradient::Options cg_options;
+  cg_options.max_iterations = options.max_iterations;
+  cg_options.tolerance = options.tolerance;
+  cg_options.thread_pool = &pool;
+
+  MeshLaplacian::Matrix a;
+  std::vector<double> masses, b((size_t)(3 * nv)), x((size_t)(3 * nv));
+  double assembly_time = 0, solve_time = 0, max_residual = 0;
+  long num_iterations = 0;
+  bool converged = true;
+  Stopwatch timer;
+  for (long step_index = 0; step_index < options.num_steps; ++step_index)
+  {
+    // The pattern of the matrix depends only on the connectivity, so later steps just recompute its values
+    timer.tick();
+      if (step_index == 0)
+        MeshLaplacian::assemble(c, options.weighting, step, a, masses, &pool);
+      else
+        MeshLaplacian::update(c, options.weighting, step, a, masses, &pool);
+    timer.tock();
+    assembly_time += timer.elapsedTime();
+
+    if (nv <= 0)
+      break;
+
+    // Solve for the three coordinates at once, from the current positions: (M - lambda C) X = M X0
+    timer.tick();
+      for (long v = 0; v < nv; ++v)
+        for (int j = 0; j < 3; ++j)
+        {
+          x[(size_t)(3 * v + j)] = c.getPosition((MeshCore::Index)v)[j];
+          b[(size_t)(3 * v + j)] = masses[(size_t)v] * x[(size_t)(3 * v + j)];
+        }
+
+      ConjugateGradient::Result result = ConjugateGradient::solve(a, 3, &b[0], &x[0], cg_options);
+
+      for (long v = 0; v < nv; ++v)
+        c.setPosition((MeshCore::Index)v, Vector3((Real)x[(size_t)(3 * v)], (Real)x[(size_t)(3 * v + 1)],
+                                                  (Real)x[(size_t)(3 * v + 2)]));
+    timer.tock();
+    solve_time += timer.elapsedTime();
+
+    num_iterations += result.num_iterations;
+    max_residual = std::max(max_residual, result.max_residual);
+    converged = converged && result.converged;
+  }
+
+  c.updateNormals(options.normal_weighting, &pool);
+  c.writeAttributes();
+  invalidateVertexData();
+
+  if (stats)
+  {
+    stats->num_nonzeros = a.numSetElements();
+    stats->num_iterations = num_iterations;
+    stats->residual = max_residual;
+    stats->assembly_time = assembly_time;
+    stats->solve_time = solve_time;
   }
 
-  return std::sqrt(total);
-}
\ No newline at end of file
+  return converged;
+}
+
+void
+Mesh::noiseMesh(double sigma, NoiseOptions const & options)
+{
+  MeshCore & c = getCore();
+  long nv = c.numVertices();
+  ThreadPool & pool = (options.thread_pool ? *options.thread_pool : ThreadPool::common());
+
+  // The statistics are cached, and sum their edge lengths in fixed blocks, so sigma does not depend on the threads
+  if (options.relative)
+    sigma *= getStatistics(&pool).mean_edge_length;
+
+  // Each vertex reads the first block of its own stream of a counter-based generator, so any vertex can be processed by any
+  // thread in any order
+  Real s = (Real)sigma;
+  Real fraction = (Real)options.impulse_fraction;
+  uint64 seed = options.seed;
+  NoiseModel model = options.model;
+
+  pool.parallelFor(0, nv, [&](long lo, long hi, long t) {
+    for (long v = lo; v < hi; ++v)
+    {
+      MeshCore::Index i = (MeshCore::Index)v;
+      Vector3 p = c.getPosition(i);
+      switch (model)
+      {
+        case NoiseModel::NORMAL:
+        {
+          Real g[4];
+          CounterRandom::gaussians(seed, (uint64)v, 0, g);
+          p += (s * g[0]) * c.getNormal(i);
+          break;
+        }
+
+        case NoiseModel::IMPULSE:
+        {
+          uint32 w[4];
+          CounterRandom::block(seed, (uint64)v, 0, w);
+          if (CounterRandom::toUniform01(w[0]) >= fraction)
+            continue;
+
+          // Uniformly random direction from a uniform height and azimuth (Archimedes' hat-box theorem)
+          Real z = 2 * CounterRandom::toUniform01(w[1]) - 1;
+          Real phi = (Real)(2 * Math::pi()) * CounterRandom::toUniform01(w[2]);
+          Real r = std::sqrt(std::max(1 - z * z, (Real)0));
+          p += s * Vector3(r * std::cos(phi), r * std::sin(phi), z);
+          break;
+        }
+
+        default:
+        {
+          Real g[4];
+          CounterRandom::gaussians(seed, (uint64)v, 0, g);
+          p += s * Vector3(g[0], g[1], g[2]);
+        }
+      }
+
+      c.setPosition(i, p);
+    }
+  });
+
+  c.updateNormals(NormalWeighting::UNIFORM, &pool);
+  c.writeAttributes();
+  invalidateVertexData();
+}
@@ -0,0 +1,163 @@
+#include "MeshLaplacian.hpp"
+#include "MeshCore.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace MeshLaplacianInternal {
+
+typedef MeshCore::Index Index;
+
+// Call a function with the three corners of each triangle that has a vertex as a corner, in the fan triangulation of a face
+// from its first vertex. The vertex is passed first, followed by the other two corners in the order of the face.
+template <typename Func>
+void
+forEachTriangle(MeshCore const & core, Index v, Index f, Func func)
+{
+  Index const * fv = core.faceVertices(f);
+  int n = core.numFaceVertices(f);
+  for (int t = 1; t + 1 < n; ++t)
+  {
+    if (fv[0] == v)          func(fv[0], fv[t], fv[t + 1]);
+    else if (fv[t] == v)     func(fv[t], fv[t + 1], fv[0]);
+    else if (fv[t + 1] == v) func(fv[t + 1], fv[0], fv[t]);
+  }
+}
+
+// Cotangent of the angle at corner c of a triangle with corners a, b, c, or zero if the triangle is degenerate.
+double
+cotangent(Vector3 const & a, Vector3 const & b, Vector3 const & c)
+{
+  Vector3 u = a - c, w = b - c;
+  double sin_len = (double)u.cross(w).length();
+  return sin_len > 0 ? (double)u.dot(w) / sin_len : 0;
+}
+
+// Collect the columns of the row of a vertex, in ascending order: the vertex and its neighbours under a weighting.
+void
+rowColumns(MeshCore const & core, MeshLaplacian::Weighting weighting, Index v, std::vector<Index> & cols)
+{
+  cols.clear();
+  cols.push_back(v);
+
+  if (weighting == MeshLaplacian::Weighting::UNIFORM)
+    cols.insert(cols.end(), core.vertexNeighbours(v), core.vertexNeighbours(v) + core.numVertexNeighbours(v));
+  else
+  {
+    Index const * vf = core.vertexFaces(v);
+    for (int i = 0, n = core.numVertexFaces(v); i < n; ++i)
+      forEachTriangle(core, v, vf[i], [&](Index, Index b, Index c) { cols.push_back(b); cols.push_back(c); });
+  }
+
+  std::sort(cols.begin(), cols.end());
+  cols.erase(std::unique(cols.begin(), cols.end()), cols.end());
+}
+
+// Set the values of the matrix M - lambda C and the masses, given the pattern of the matrix.
+void
+fillValues(MeshCore const & core, MeshLaplacian::Weighting weighting, double lambda, MeshLaplacian::Matrix & matrix,
+           std::vector<double> & masses, ThreadPool & pool)
+{
+  long nv = core.numVertices();
+  std::vector<long> const & row_start = matrix.getRowIndices();
+  std::vector<int> const & cols = matrix.getColumnIndices();
+  std::vector<double> & values = matrix.getValues();
+  masses.resize((size_t)nv);
+
+  pool.parallelFor(0, nv, [&](long lo, long hi, long) {
+    for (long v = lo; v < hi; ++v)
+    {
+      int const * row_cols = &cols[0] + row_start[(size_t)v];
+      int const * row_end = &cols[0] + row_start[(size_t)v + 1];
+      double * row_values = &values[0] + row_start[(size_t)v];
+      std::fill(row_values, row_values + (row_end - row_cols), 0.0);
+
+      // Add an edge weight to the row, as -lambda w off the diagonal and +lambda w on it
+      size_t diag = (size_t)(std::lower_bound(row_cols, row_end, (int)v) - row_cols);
+      auto addWeight = [&](Index u, double w) {
+        row_values[(size_t)(std::lower_bound(row_cols, row_end, (int)u) - row_cols)] -= lambda * w;
+        row_values[diag] += lambda * w;
+      };
+
+      double mass = 0;
+      if (weighting == MeshLaplacian::Weighting::UNIFORM)
+      {
+        Index const * nbrs = core.vertexNeighbours((Index)v);
+        for (int i = 0, n = core.numVertexNeighbours((Index)v); i < n; ++i)
+          addWeight(nbrs[i], 1);
+
+        mass = core.numVertexNeighbours((Index)v);
+      }
+      else
+      {
+        Index const * vf = core.vertexFaces((Index)v);
+        for (int i = 0, n = core.numVertexFaces((Index)v); i < n; ++i)
+          forEachTriangle(core, (Index)v, vf[i], [&](Index a, Index b, Index c) {
+            Vector3 const & pa = core.getPosition(a);
+            Vector3 const & pb = core.getPosition(b);
+            Vector3 const & pc = core.getPosition(c);
+
+            // The edge to each other corner is weighted by the cotangent of the angle opposite it
+            addWeight(b, 0.5 * cotangent(pa, pb, pc));
+            addWeight(c, 0.5 * cotangent(pa, pc, pb));
+            mass += (double)(pb - pa).cross(pc - pa).length() / 6;
+          });
+      }
+
+      masses[(size_t)v] = (mass > 0 ? mass : 1);
+      row_values[diag] += masses[(size_t)v];
+    }
+  });
+}
+
+} // namespace MeshLaplacianInternal
+
+void
+MeshLaplacian::assemble(MeshCore const & core, Weighting weighting, double lambda, Matrix & matrix,
+                        std::vector<double> & masses, ThreadPool * pool_)
+{
+  using namespace MeshLaplacianInternal;
+
+  ThreadPool & pool = (pool_ ? *pool_ : ThreadPool::common());
+  long nv = core.numVertices();
+  std::vector< std::vector<Index> > scratch((size_t)pool.maxParticipants());
+
+  // Size the rows, then write their columns, each from its own vertex
+  matrix.resize(nv, nv);
+  std::vector<long> & row_start = matrix.getRowIndices();
+  pool.parallelFor(0, nv, [&](long lo, long hi, long t) {
+    for (long v = lo; v < hi; ++v)
+    {
+      rowColumns(core, weighting, (Index)v, scratch[(size_t)t]);
+      row_start[(size_t)v + 1] = (long)scratch[(size_t)t].size();
+    }
+  });
+
+  row_start[0] = 0;
+  for (long v = 0; v < nv; ++v)
+    row_start[(size_t)v + 1] += row_start[(size_t)v];
+
+  std::vector<int> & cols = matrix.getColumnIndices();
+  cols.resize((size_t)row_start[(size_t)nv]);
+  matrix.getValues().resize((size_t)row_start[(size_t)nv]);
+
+  pool.parallelFor(0, nv, [&](long lo, long hi, long t) {
+    std::vector<Index> & row_cols = scratch[(size_t)t];
+    for (long v = lo; v < hi; ++v)
+    {
+      rowColumns(core, weighting, (Index)v, row_cols);
+      std::copy(row_cols.begin(), row_cols.end(), cols.begin() + row_start[(size_t)v]);
+    }
+  });
+
+  fillValues(core, weighting, lambda, matrix, masses, pool);
+}
+
+void
+MeshLaplacian::update(MeshCore const & core, Weighting weighting, double lambda, Matrix & matrix,
+                      std::vector<double> & masses, ThreadPool * pool)
+{
+  alwaysAssertM(matrix.numRows() == core.numVertices() && matrix.numColumns() == core.numVertices() && matrix.isValid(),
+                "MeshLaplacian: Matrix was not assembled for this mesh");
+
+  MeshLaplacianInternal::fillValues(core, weighting, lambda, matrix, masses, (pool ? *pool : ThreadPool::common()));
+}
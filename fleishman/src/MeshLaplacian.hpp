@@ -0,0 +1,77 @@
+#ifndef __A3_MeshLaplacian_hpp__
+#define __A3_MeshLaplacian_hpp__
+
+#include "Common.hpp"
+#include "DGP/CompressedSparseMatrix.hpp"
+#include "DGP/ThreadPool.hpp"
+#include <vector>
+
+// Forward declarations
+class MeshCore;
+
+/**
+ * Assembly of the linear system of an implicit fairing step (Desbrun et al., "Implicit Fairing of Irregular Meshes using
+ * Diffusion and Curvature Flow", SIGGRAPH 1999). A step moves the vertices from positions X0 to the positions X solving
+ *
+ * <pre>
+ *   (I - lambda L) X = X0,    with L = M^-1 C,
+ * </pre>
+ *
+ * where C is a symmetric matrix of edge weights (the stiffness matrix) and M a diagonal matrix of vertex masses. The system is
+ * assembled multiplied through by M, as <tt>(M - lambda C) X = M X0</tt>, whose matrix is symmetric and positive definite, so
+ * it can be solved by ConjugateGradient.
+ *
+ * The matrix is assembled directly in compressed row form: every row is built on its own, from the faces around its vertex, in
+ * a parallel loop over the rows, so the result does not depend on the number of threads. When only the vertex positions
+ * change, update() overwrites the values and keeps the pattern.
+ */
+class MeshLaplacian
+{
+  public:
+    /** Sparse matrix type of the system. */
+    typedef CompressedRowMatrix<double, int, long> Matrix;
+
+    /** Weights of the Laplacian (enum class). */
+    struct Weighting
+    {
+      /** Supported values. */
+      enum Value
+      {
+        UNIFORM,   /**< The umbrella operator: every edge has weight 1 and every vertex a mass equal to its number of
+                        neighbours, so L moves a vertex towards the mean of its neighbours. Depends on the connectivity as
+                        well as the shape, and lambda is a number of umbrella steps. */
+        COTANGENT  /**< Half the sum of the cotangents of the angles opposite an edge, with a third of the area of each
+                        incident triangle as vertex mass, so L approximates the mean curvature normal and lambda is an area.
+                        Faces with more than 3 vertices are split into a fan of triangles from their first vertex. */
+      };
+
+      DGP_ENUM_CLASS_BODY(Weighting)
+    };
+
+    /**
+     * Assemble the matrix <tt>M - lambda C</tt> of a fairing step, and the masses on its diagonal. Vertices without mass
+     * (isolated, or with only degenerate faces) get unit mass and no edge weights, so they stay in place.
+     *
+     * @param core The mesh.
+     * @param weighting The weights of the Laplacian.
+     * @param lambda The size of the step.
+     * @param matrix Used to return the matrix, with a row per vertex. Its previous contents are replaced.
+     * @param masses Used to return the mass of each vertex.
+     * @param pool Threads to use. If null, ThreadPool::common() is used.
+     */
+    static void assemble(MeshCore const & core, Weighting weighting, double lambda, Matrix & matrix,
+                         std::vector<double> & masses, ThreadPool * pool = NULL);
+
+    /**
+     * Recompute the values of a matrix assembled by assemble(), and the masses, keeping its pattern. This skips computing the
+     * columns of each row, so it is cheaper when the positions of the vertices change but not the connectivity of the mesh, as
+     * in repeated fairing steps. The matrix must have been assembled for the same connectivity and weighting.
+     *
+     * @see assemble()
+     */
+    static void update(MeshCore const & core, Weighting weighting, double lambda, Matrix & matrix,
+                       std::vector<double> & masses, ThreadPool * pool = NULL);
+
+}; // class MeshLaplacian
+
+#endif
@@ -0,0 +1,226 @@
+#include "MeshMetrics.hpp"
+#include "Mesh.hpp"
+#include "MeshCore.hpp"
+#include "DGP/Math.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace MeshMetricsInternal {
+
+// Append a named number to a JSON object under construction.
+void
+appendJSON(std::string & json, char const * name, double value)
+{
+  char buf[64];
+  if (Math::isFinite(value))
+    std::snprintf(buf, sizeof(buf), "%.9g", value);
+  else
+    std::snprintf(buf, sizeof(buf), "null");
+
+  json += (json.size() > 1 ? ",\"" : "\"");
+  json += name;
+  json += "\":";
+  json += buf;
+}
+
+// Sum and maximum of an array, accumulated in order in double precision so the result does not depend on the number of
+// threads. A NaN anywhere makes the maximum NaN.
+void
+sumAndMax(std::vector<Real> const & values, double & sum, double & max_value)
+{
+  sum = 0;
+  max_value = 0;
+  for (size_t i = 0; i < values.size(); ++i)
+  {
+    sum += values[i];
+
+    // Once the maximum is NaN, no comparison can replace it
+    if (Math::isNaN(values[i]) || values[i] > max_value) max_value = values[i];
+  }
+}
+
+} // namespace MeshMetricsInternal
+
+std::string
+MeshMetrics::Result::toJSON() const
+{
+  using namespace MeshMetricsInternal;
+
+  std::string json = "{";
+  appendJSON(json, "vertices", (double)num_vertices);
+
+  if (corresponding)
+  {
+    appendJSON(json, "rms_error", rms_error);
+    appendJSON(json, "mean_error", mean_error);
+    appendJSON(json, "max_error", max_error);
+    appendJSON(json, "mean_normal_deviation", mean_normal_deviation);
+    appendJSON(json, "max_normal_deviation", max_normal_deviation);
+  }
+
+  if (has_surface_distances)
+  {
+    appendJSON(json, "mean_distance_to_reference", mean_distance_to_reference);
+    appendJSON(json, "max_distance_to_reference", max_distance_to_reference);
+    appendJSON(json, "mean_distance_from_reference", mean_distance_from_reference);
+    appendJSON(json, "max_distance_from_reference", max_distance_from_reference);
+    appendJSON(json, "mean_surface_distance", mean_surface_distance);
+    appendJSON(json, "hausdorff_distance", hausdorff_distance);
+  }
+
+  appendJSON(json, "reference_diagonal", reference_diagonal);
+  json += '}';
+
+  return json;
+}
+
+void
+MeshMetrics::setReference(Mesh & ref)
+{
+  setReference(ref.getCore());
+}
+
+void
+MeshMetrics::setReference(MeshCore const & ref)
+{
+  long nv = ref.numVertices();
+  ref_positions.resize((size_t)nv);
+  ref_normals.resize((size_t)nv);
+  for (long i = 0; i < nv; ++i)
+  {
+    ref_positions[(size_t)i] = ref.getPosition((MeshCore::Index)i);
+    ref_normals[(size_t)i] = ref.getNormal((MeshCore::Index)i);
+  }
+
+  triangulate(ref, triangles);
+  ref_bvh.build(ref.getPositions(), triangles.empty() ? NULL : &triangles[0], (long)triangles.size() / 3);
+
+  AxisAlignedBox3 bounds;
+  for (long i = 0; i < nv; ++i)
+    bounds.merge(ref_positions[(size_t)i]);
+
+  ref_diagonal = (nv > 0 ? bounds.getExtent().length() : 0);
+}
+
+void
+MeshMetrics::triangulate(MeshCore const & mesh, std::vector<uint32> & indices)
+{
+  indices.clear();
+  for (long f = 0; f < mesh.numFaces(); ++f)
+  {
+    MeshCore::Index const * fv = mesh.faceVertices((MeshCore::Index)f);
+    int n = mesh.numFaceVertices((MeshCore::Index)f);
+    for (int i = 2; i < n; ++i)
+    {
+      indices.push_back(fv[0]);
+      indices.push_back(fv[i - 1]);
+      indices.push_back(fv[i]);
+    }
+  }
+}
+
+void
+MeshMetrics::surfaceDistances(TriangleBVH3 const & bvh, Vector3 const * points, long num_points, ThreadPool & pool,
+                              std::vector<Real> & distances)
+{
+  distances.resize((size_t)num_points);
+  if (bvh.numTriangles() <= 0)
+  {
+    // No surface to measure against
+    std::fill(distances.begin(), distances.end(), std::numeric_limits<Real>::infinity());
+    return;
+  }
+
+  pool.parallelFor(0, num_points, [&](long lo, long hi, long /* participant */) {
+    Vector3 closest;
+    Real sqdist = 0;
+    for (long i = lo; i < hi; ++i)
+    {
+      bvh.closestPoint(points[i], closest, sqdist);
+      distances[(size_t)i] = std::sqrt(sqdist);
+    }
+  });
+}
+
+MeshMetrics::Result
+MeshMetrics::compute(Mesh & mesh, Options const & options)
+{
+  return compute(mesh.getCore(), options);
+}
+
+MeshMetrics::Result
+MeshMetrics::compute(MeshCore const & mesh, Options const & options)
+{
+  using namespace MeshMetricsInternal;
+
+  alwaysAssertM(hasReference(), "MeshMetrics: No reference mesh has been set");
+
+  ThreadPool & pool = (options.thread_pool ? *options.thread_pool : ThreadPool::common());
+  long nv = mesh.numVertices();
+
+  Result result;
+  result.num_vertices = nv;
+  result.reference_diagonal = ref_diagonal;
+  result.corresponding = (nv == numReferenceVertices());
+
+  if (result.corresponding)
+  {
+    vertex_errors.resize((size_t)nv);
+    normal_angles.resize((size_t)nv);
+
+    pool.parallelFor(0, nv, [&](long lo, long hi, long /* participant */) {
+      for (long i = lo; i < hi; ++i)
+      {
+        MeshCore::Index v = (MeshCore::Index)i;
+        vertex_errors[(size_t)i] = (mesh.getPosition(v) - ref_positions[(size_t)i]).length();
+
+        // Angle between the normals, which need not be unit length. Zero normals count as matching.
+        Vector3 const & n = mesh.getNormal(v);
+        Vector3 const & rn = ref_normals[(size_t)i];
+        double len2 = (double)n.squaredLength() * rn.squaredLength();
+        double cos_angle = (len2 > 0 ? n.dot(rn) / std::sqrt(len2) : 1.0);
+        normal_angles[(size_t)i] = (Real)Math::radiansToDegrees(std::acos(Math::clamp(cos_angle, -1.0, 1.0)));
+      }
+    });
+
+    double sum_error = 0, sum_sqerror = 0, sum_angle = 0;
+    sumAndMax(vertex_errors, sum_error, result.max_error);
+    sumAndMax(normal_angles, sum_angle, result.max_normal_deviation);
+    for (long i = 0; i < nv; ++i)
+      sum_sqerror += (double)vertex_errors[(size_t)i] * vertex_errors[(size_t)i];
+
+    if (nv > 0)
+    {
+      result.rms_error = std::sqrt(sum_sqerror / nv);
+      result.mean_error = sum_error / nv;
+      result.mean_normal_deviation = sum_angle / nv;
+    }
+  }
+  else
+    vertex_errors.clear();
+
+  if (options.surface_distances)
+  {
+    TriangleBVH3::Options bvh_opts;
+    bvh_opts.thread_pool = &pool;
+
+    triangulate(mesh, triangles);
+    mesh_bvh.build(mesh.getPositions(), triangles.empty() ? NULL : &triangles[0], (long)triangles.size() / 3, bvh_opts);
+
+    surfaceDistances(ref_bvh, mesh.getPositions(), nv, pool, to_reference);
+    surfaceDistances(mesh_bvh, &ref_positions[0], numReferenceVertices(), pool, from_reference);
+
+    double sum_to = 0, sum_from = 0;
+    sumAndMax(to_reference, sum_to, result.max_distance_to_reference);
+    sumAndMax(from_reference, sum_from, result.max_distance_from_reference);
+
+    result.has_surface_distances = true;
+    result.mean_distance_to_reference = (nv > 0 ? sum_to / nv : 0);
+    result.mean_distance_from_reference = sum_from / numReferenceVertices();
+    result.mean_surface_distance = 0.5 * (result.mean_distance_to_reference + result.mean_distance_from_reference);
+    result.hausdorff_distance = std::max(result.max_distance_to_reference, result.max_distance_from_reference);
+  }
+
+  return result;
+}
@@ -0,0 +1,91 @@
+#include "MeshPicker.hpp"
+
+void
+MeshPicker::update(MeshCore const & core, ThreadPool * pool)
+{
+  if (topology_dirty || bvh.numTriangles() != (long)tri_faces.size())
+  {
+    // Split the polygons into fans around their first vertices
+    triangles.clear();
+    tri_faces.clear();
+    for (long f = 0; f < core.numFaces(); ++f)
+    {
+      MeshCore::Index const * fv = core.faceVertices((MeshCore::Index)f);
+      int n = core.numFaceVertices((MeshCore::Index)f);
+      for (int i = 2; i < n; ++i)
+      {
+        triangles.push_back(fv[0]);
+        triangles.push_back(fv[i - 1]);
+        triangles.push_back(fv[i]);
+        tri_faces.push_back((MeshCore::Index)f);
+      }
+    }
+
+    TriangleBVH3::Options options;
+    options.thread_pool = pool;
+    bvh.build(core.getPositions(), triangles.empty() ? NULL : &triangles[0], (long)tri_faces.size(), options);
+    num_builds++;
+  }
+  else if (vertices_dirty)
+  {
+    if (!triangles.empty())
+      bvh.refit(core.getPositions(), &triangles[0], pool);
+
+    num_refits++;
+  }
+
+  topology_dirty = vertices_dirty = false;
+}
+
+Ray3
+MeshPicker::computeRay(Camera const & camera, Vector2 const & screen_pos)
+{
+  // The far plane is often so distant that unprojecting a point on it loses all precision in single precision, so the
+  // direction is taken from a point at depth 0 in projection space instead
+  Vector3 near_point = camera.unproject(Vector3(screen_pos.x(), screen_pos.y(), -1));
+  Vector3 mid_point = camera.unproject(Vector3(screen_pos.x(), screen_pos.y(), 0));
+
+  return Ray3(near_point, (mid_point - near_point).unit());
+}
+
+MeshCore::Index
+MeshPicker::pickFace(Ray3 const & ray, Vector3 * hit_point) const
+{
+  Real time = -1;
+  long tri = bvh.rayCast(ray, time);
+  if (tri < 0)
+    return MeshCore::NONE;
+
+  if (hit_point)
+    *hit_point = ray.getPoint(time);
+
+  return tri_faces[(size_t)tri];
+}
+
+MeshCore::Index
+MeshPicker::pickVertex(Ray3 const & ray) const
+{
+  Real time = -1;
+  long tri = bvh.rayCast(ray, time);
+  if (tri < 0)
+    return MeshCore::NONE;
+
+  // The triangle's vertices are read from the copy in the hierarchy, so the mesh is not needed
+  Vector3 p = ray.getPoint(time);
+  uint32 const * tv = &triangles[3 * (size_t)tri];
+  LocalTriangle3 const & t = bvh.getTriangle(tri);
+
+  int best = 0;
+  Real best_sqdist = (t.getVertex(0) - p).squaredLength();
+  for (int i = 1; i < 3; ++i)
+  {
+    Real sqdist = (t.getVertex(i) - p).squaredLength();
+    if (sqdist < best_sqdist)
+    {
+      best = i;
+      best_sqdist = sqdist;
+    }
+  }
+
+  return tv[best];
+}
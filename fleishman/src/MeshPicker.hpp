@@ -0,0 +1,80 @@
+#ifndef __A3_MeshPicker_hpp__
+#define __A3_MeshPicker_hpp__
+
+#include "Common.hpp"
+#include "MeshCore.hpp"
+#include "DGP/Camera.hpp"
+#include "DGP/Noncopyable.hpp"
+#include "DGP/Ray3.hpp"
+#include "DGP/ThreadPool.hpp"
+#include "DGP/TriangleBVH3.hpp"
+#include "DGP/Vector2.hpp"
+#include <vector>
+
+/**
+ * Finds the mesh element under a point of the screen, by casting a ray into a bounding volume hierarchy over the triangles of
+ * the mesh (larger polygons are split into fans). The hierarchy is kept up to date the same way as MeshRenderBuffer: it is
+ * rebuilt only when the topology changes, and when just vertex positions change it is refitted to them, which is several
+ * times faster than a rebuild. Queries read only the hierarchy, so they need no access to the mesh once it is up to date.
+ */
+class MeshPicker : private Noncopyable
+{
+  public:
+    /** Constructor. The hierarchy is built by the first call to update(). */
+    MeshPicker() : topology_dirty(true), vertices_dirty(true), num_builds(0), num_refits(0) {}
+
+    /** Note that the topology of the mesh has changed, so the hierarchy is rebuilt by the next update. */
+    void invalidateTopology() { topology_dirty = true; }
+
+    /** Note that vertex positions have changed, so the hierarchy is refitted by the next update. */
+    void invalidateVertices() { vertices_dirty = true; }
+
+    /** Check if the hierarchy must be updated before the next query. */
+    bool needsUpdate() const { return topology_dirty || vertices_dirty; }
+
+    /** Bring the hierarchy up to date with the compact representation of the mesh, if needed. */
+    void update(MeshCore const & core, ThreadPool * pool = NULL);
+
+    /**
+     * Get the world-space ray under a screen position in normalized coordinates ([-1, 1]^2, with Y increasing in the projected
+     * Y direction of the camera), by unprojecting points at two depths along the line of sight. The ray starts on the near
+     * plane and its direction has unit length.
+     */
+    static Ray3 computeRay(Camera const & camera, Vector2 const & screen_pos);
+
+    /**
+     * Find the first face hit by a ray, as of the last update. Returns its index in the compact representation, or
+     * MeshCore::NONE if there is no hit.
+     *
+     * @param ray The ray.
+     * @param hit_point If non-null, used to return the point where the ray hits the face.
+     */
+    MeshCore::Index pickFace(Ray3 const & ray, Vector3 * hit_point = NULL) const;
+
+    /**
+     * Find the vertex closest to the point where a ray first hits the mesh, among the vertices of the triangle that is hit, as
+     * of the last update. Returns its index in the compact representation, or MeshCore::NONE if there is no hit.
+     */
+    MeshCore::Index pickVertex(Ray3 const & ray) const;
+
+    /** Get the hierarchy over the triangles. */
+    TriangleBVH3 const & getBVH() const { return bvh; }
+
+    /** Get the number of times the hierarchy has been built. */
+    long numBuilds() const { return num_builds; }
+
+    /** Get the number of times the hierarchy has been refitted. */
+    long numRefits() const { return num_refits; }
+
+  private:
+    TriangleBVH3 bvh;                          ///< Hierarchy over the triangles.
+    std::vector<uint32> triangles;             ///< Vertex indices of the triangles, three per triangle.
+    std::vector<MeshCore::Index> tri_faces;    ///< Face containing each triangle.
+    bool topology_dirty;                       ///< Does the hierarchy need to be rebuilt?
+    bool vertices_dirty;                       ///< Does the hierarchy need to be refitted?
+    long num_builds;                           ///< Number of builds so far.
+    long num_refits;                           ///< Number of refits so far.
+
+}; // class MeshPicker
+
+#endif
@@ -0,0 +1,392 @@
+#include "MeshRasterizer.hpp"
+#include "Mesh.hpp"
+#include "MeshCore.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace MeshRasterizerInternal {
+
+// Number of consecutive faces set up and binned together. Fixed, so the order in which a tile visits triangles, and hence the
+// image, does not depend on the number of threads.
+long const FACES_PER_BATCH = 2048;
+
+// Lighting coefficients of the viewer's mesh shader.
+Real const AMBIENT = 0.2f;
+Real const DIFFUSE = 0.6f;
+
+// Shade a camera-space normal.
+Vector3
+shade(Vector3 const & n, Vector3 const & light_dir, MeshRasterizer::Options const & options)
+{
+  Real len = n.length();
+  Vector3 un = (len > 0 ? n / len : Vector3(0, 0, 1));
+
+  if (options.shading == MeshRasterizer::Shading::NORMALS)
+    return 0.5f * (un + Vector3(1, 1, 1));
+
+  Real intensity = AMBIENT + DIFFUSE * std::fabs(un.dot(light_dir));
+  return intensity * Vector3(options.color.r(), options.color.g(), options.color.b());
+}
+
+// Convert a color channel in [0, 1] to a byte.
+inline uint8
+toByte(Real c)
+{
+  return (uint8)(c <= 0 ? 0 : (c >= 1 ? 255 : (int)(255 * c + 0.5f)));
+}
+
+} // namespace MeshRasterizerInternal
+
+Camera
+MeshRasterizer::frameCamera(AxisAlignedBox3 const & bbox, int width, int height)
+{
+  static Real const DIST = 10;
+  static Real const NEAR = 1.7f;
+
+  Real aspect_ratio = (width / (Real)std::max(height, 1));
+  Real left, right, bottom, top;
+  if (aspect_ratio > 1)
+  {
+    left = -aspect_ratio;
+    right = aspect_ratio;
+    bottom = -1;
+    top = 1;
+  }
+  else
+  {
+    left = -1;
+    right = 1;
+    bottom = -1.0f / aspect_ratio;
+    top = 1.0f / aspect_ratio;
+  }
+
+  Camera camera;
+  Real scale = bbox.getExtent().length();
+  Real camera_separation = DIST * scale;
+  CoordinateFrame3 cframe = camera.getFrame();
+  cframe.setTranslation(bbox.getCenter() - camera_separation * camera.getLookDirection());
+
+  camera.set(cframe, Camera::ProjectionType::PERSPECTIVE, (left / DIST) * scale, (right / DIST) * scale,
+             (bottom / DIST) * scale, (top / DIST) * scale, NEAR * scale, camera_separation + 1000 * scale,
+             Camera::ProjectedYDirection::UP);
+
+  return camera;
+}
+
+void
+MeshRasterizer::render(Mesh & mesh, Camera const & camera, Image & image, Options const & options, Stats * stats)
+{
+  render(mesh.getCore(), camera, image, options, stats);
+}
+
+void
+MeshRasterizer::render(MeshCore const & core, Camera const & camera, Image & image, Options const & options, Stats * stats)
+{
+  using namespace MeshRasterizerInternal;
+
+  alwaysAssertM(image.isValid(), "MeshRasterizer: Image must have non-zero dimensions");
+  alwaysAssertM(options.tile_size > 0, "MeshRasterizer: Tile size must be positive");
+
+  int width = image.getWidth(), height = image.getHeight();
+  if (image.getType() != Image::Type::RGB_8U)
+    image.resize(Image::Type::RGB_8U, width, height);
+
+  ThreadPool & pool = (options.thread_pool ? *options.thread_pool : ThreadPool::common());
+  int tile_size = options.tile_size;
+  int num_tiles_x = (width + tile_size - 1) / tile_size;
+  int num_tiles_y = (height + tile_size - 1) / tile_size;
+  long num_tiles = (long)num_tiles_x * num_tiles_y;
+
+  CoordinateFrame3 const & frame = camera.getFrame();
+  Matrix4 proj = camera.getProjectionTransform();
+  Vector3 light_dir = options.light_dir.unit();
+
+  // Transform and shade the vertices
+  long nv = core.numVertices();
+  clip_positions.resize((size_t)nv);
+  vertex_colors.resize((size_t)nv);
+  pool.parallelFor(0, nv, [&](long lo, long hi, long /* participant */) {
+    for (long v = lo; v < hi; ++v)
+    {
+      MeshCore::Index vi = (MeshCore::Index)v;
+      clip_positions[(size_t)v] = proj * Vector4(frame.pointToObjectSpace(core.getPosition(vi)), 1);
+      if (options.smooth)
+        vertex_colors[(size_t)v] = shade(frame.vectorToObjectSpace(core.getNormal(vi)), light_dir, options);
+    }
+  });
+
+  // Split the faces into triangles, clip them, and sort them into tiles, one block of faces per task
+  long nf = core.numFaces();
+  long num_batches = (nf + FACES_PER_BATCH - 1) / FACES_PER_BATCH;
+  batches.resize((size_t)num_batches);
+  pool.parallelFor(0, num_batches, [&](long lo, long hi, long /* participant */) {
+    for (long b = lo; b < hi; ++b)
+    {
+      Batch & batch = batches[(size_t)b];
+      batch.triangles.clear();
+      batch.num_triangles = 0;
+
+      long f_end = std::min((b + 1) * FACES_PER_BATCH, nf);
+      for (long f = b * FACES_PER_BATCH; f < f_end; ++f)
+      {
+        MeshCore::Index fi = (MeshCore::Index)f;
+        MeshCore::Index const * fv = core.faceVertices(fi);
+        int n = core.numFaceVertices(fi);
+
+        Vector3 face_color;
+        if (!options.smooth)
+          face_color = shade(frame.vectorToObjectSpace(core.getFaceNormal(fi)), light_dir, options);
+
+        ClipVertex tri[3];
+        for (int i = 2; i < n; ++i)
+        {
+          MeshCore::Index corners[3] = { fv[0], fv[i - 1], fv[i] };
+          for (int j = 0; j < 3; ++j)
+          {
+            tri[j].position = clip_positions[corners[j]];
+            tri[j].color = (options.smooth ? vertex_colors[corners[j]] : face_color);
+          }
+
+          setupTriangle(tri, width, height, batch);
+          batch.num_triangles++;
+        }
+      }
+
+      // Counting sort of the triangles by tile, keeping their order within each tile
+      batch.tile_counts.assign((size_t)num_tiles, 0);
+      for (size_t t = 0; t < batch.triangles.size(); ++t)
+      {
+        Triangle const & tri = batch.triangles[t];
+        for (int ty = tri.y0 / tile_size; ty <= tri.y1 / tile_size; ++ty)
+          for (int tx = tri.x0 / tile_size; tx <= tri.x1 / tile_size; ++tx)
+            batch.tile_counts[(size_t)(ty * num_tiles_x + tx)]++;
+      }
+
+      batch.tile_offsets.resize((size_t)num_tiles + 1);
+      batch.tile_offsets[0] = 0;
+      for (long t = 0; t < num_tiles; ++t)
+      {
+        batch.tile_offsets[(size_t)t + 1] = batch.tile_offsets[(size_t)t] + batch.tile_counts[(size_t)t];
+        batch.tile_counts[(size_t)t] = batch.tile_offsets[(size_t)t];
+      }
+
+      batch.tile_triangles.resize(batch.tile_offsets[(size_t)num_tiles]);
+      for (size_t t = 0; t < batch.triangles.size(); ++t)
+      {
+        Triangle const & tri = batch.triangles[t];
+        for (int ty = tri.y0 / tile_size; ty <= tri.y1 / tile_size; ++ty)
+          for (int tx = tri.x0 / tile_size; tx <= tri.x1 / tile_size; ++tx)
+            batch.tile_triangles[batch.tile_counts[(size_t)(ty * num_tiles_x + tx)]++] = (uint32)t;
+      }
+    }
+  }, 1);
+
+  // Fill the tiles. Tiles do not overlap, so each writes its own pixels of the image.
+  depths.resize((size_t)pool.maxParticipants());
+  std::vector<long> fragments((size_t)pool.maxParticipants(), 0);
+  pool.parallelFor(0, num_tiles, [&](long lo, long hi, long participant) {
+    std::vector<float> & depth = depths[(size_t)participant];
+    depth.resize((size_t)(tile_size * tile_size));
+
+    for (long t = lo; t < hi; ++t)
+      fragments[(size_t)participant] += rasterizeTile((int)(t % num_tiles_x), (int)(t / num_tiles_x), width, height,
+                                                      tile_size, num_tiles_x, options, depth, image);
+  }, 1);
+
+  if (stats)
+  {
+    *stats = Stats();
+    for (size_t b = 0; b < batches.size(); ++b)
+    {
+      stats->num_triangles += batches[b].num_triangles;
+      stats->num_culled += batches[b].num_triangles - (long)batches[b].triangles.size();
+      stats->num_bin_entries += (long)batches[b].tile_triangles.size();
+    }
+
+    for (size_t i = 0; i < fragments.size(); ++i)
+      stats->num_fragments += fragments[i];
+  }
+}
+
+void
+MeshRasterizer::setupTriangle(ClipVertex const * v, int width, int height, Batch & batch) const
+{
+  // Reject triangles entirely outside one of the planes of the view volume
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    bool all_below = true, all_above = true;
+    for (int i = 0; i < 3; ++i)
+    {
+      Vector4 const & p = v[i].position;
+      if (p[axis] >= -p.w()) all_below = false;
+      if (p[axis] <= p.w()) all_above = false;
+    }
+
+    if (all_below || all_above)
+      return;
+  }
+
+  // Clip to the near plane z = -w, giving a polygon of up to four vertices
+  ClipVertex poly[4];
+  int n = 0;
+  for (int i = 0; i < 3; ++i)
+  {
+    ClipVertex const & a = v[i];
+    ClipVertex const & b = v[(i + 1) % 3];
+    Real da = a.position.z() + a.position.w();
+    Real db = b.position.z() + b.position.w();
+
+    if (da >= 0)
+      poly[n++] = a;
+
+    if ((da >= 0) != (db >= 0))
+    {
+      Real s = da / (da - db);
+      poly[n].position = a.position + s * (b.position - a.position);
+      poly[n].color = a.color + s * (b.color - a.color);
+      n++;
+    }
+  }
+
+  for (int k = 2; k < n; ++k)
+  {
+    ClipVertex const * corners[3] = { &poly[0], &poly[k - 1], &poly[k] };
+
+    Triangle tri;
+    float x[3], y[3];
+    for (int i = 0; i < 3; ++i)
+    {
+      Vector4 const & p = corners[i]->position;
+      float inv_w = 1.0f / p.w();
+      x[i] = 0.5f * (p.x() * inv_w + 1) * width;
+      y[i] = 0.5f * (1 - p.y() * inv_w) * height;  // image rows run top to bottom
+      tri.z[i] = p.z() * inv_w;
+      tri.inv_w[i] = inv_w;
+      tri.color[i] = inv_w * corners[i]->color;
+    }
+
+    // Orient the triangle so its edge functions are positive inside. Faces are drawn from both sides.
+    double area = ((double)x[1] - x[0]) * ((double)y[2] - y[0]) - ((double)y[1] - y[0]) * ((double)x[2] - x[0]);
+    if (!(area != 0))
+      continue;
+
+    if (area < 0)
+    {
+      std::swap(x[1], x[2]);
+      std::swap(y[1], y[2]);
+      std::swap(tri.z[1], tri.z[2]);
+      std::swap(tri.inv_w[1], tri.inv_w[2]);
+      std::swap(tri.color[1], tri.color[2]);
+    }
+
+    // Each edge function is computed from the endpoints in a fixed order, and negated if needed, so triangles sharing an edge
+    // get exactly opposite values along it. A pixel center exactly on an edge belongs to the triangle for which the edge runs
+    // downwards, or leftwards if horizontal, so it is drawn exactly once.
+    for (int i = 0; i < 3; ++i)
+    {
+      int i0 = (i + 1) % 3, i1 = (i + 2) % 3;
+      float dx = x[i1] - x[i0], dy = y[i1] - y[i0];
+      tri.owner[i] = (dy > 0 || (dy == 0 && dx < 0));
+
+      bool flip = (x[i1] < x[i0] || (x[i1] == x[i0] && y[i1] < y[i0]));
+      int j0 = (flip ? i1 : i0), j1 = (flip ? i0 : i1);
+      float cdx = x[j1] - x[j0], cdy = y[j1] - y[j0];
+      float sign = (flip ? -1.0f : 1.0f);
+      tri.a[i] = sign * -cdy;
+      tri.b[i] = sign * cdx;
+      tri.c[i] = sign * (cdy * x[j0] - cdx * y[j0]);
+    }
+
+    tri.inv_sum = (float)(1.0 / std::fabs(area));
+
+    // Pixels with centers inside the bounding box, clamped to the screen
+    float min_x = std::min(x[0], std::min(x[1], x[2])), max_x = std::max(x[0], std::max(x[1], x[2]));
+    float min_y = std::min(y[0], std::min(y[1], y[2])), max_y = std::max(y[0], std::max(y[1], y[2]));
+    tri.x0 = (int)std::max(std::ceil(min_x - 0.5f), 0.0f);
+    tri.x1 = (int)std::min(std::floor(max_x - 0.5f), (float)(width - 1));
+    tri.y0 = (int)std::max(std::ceil(min_y - 0.5f), 0.0f);
+    tri.y1 = (int)std::min(std::floor(max_y - 0.5f), (float)(height - 1));
+    if (tri.x0 > tri.x1 || tri.y0 > tri.y1)
+      continue;
+
+    batch.triangles.push_back(tri);
+  }
+}
+
+long
+MeshRasterizer::rasterizeTile(int tx, int ty, int width, int height, int tile_size, int num_tiles_x, Options const & options,
+                              std::vector<float> & depth, Image & image) const
+{
+  using namespace MeshRasterizerInternal;
+
+  int tile_x0 = tx * tile_size, tile_x1 = std::min(tile_x0 + tile_size, width) - 1;
+  int tile_y0 = ty * tile_size, tile_y1 = std::min(tile_y0 + tile_size, height) - 1;
+  size_t tile = (size_t)(ty * num_tiles_x + tx);
+
+  std::fill(depth.begin(), depth.end(), 1.0f);  // the far plane
+
+  uint8 * pixels = (uint8 *)image.getData();
+  long scan_width = image.getScanWidth();
+
+  uint8 bg[3] = { toByte(options.background.r()), toByte(options.background.g()), toByte(options.background.b()) };
+  for (int y = tile_y0; y <= tile_y1; ++y)
+  {
+    uint8 * row = pixels + y * scan_width;
+    for (int x = tile_x0; x <= tile_x1; ++x)
+    {
+      row[3 * x    ] = bg[0];
+      row[3 * x + 1] = bg[1];
+      row[3 * x + 2] = bg[2];
+    }
+  }
+
+  long num_fragments = 0;
+  for (size_t b = 0; b < batches.size(); ++b)
+  {
+    Batch const & batch = batches[b];
+    for (uint32 k = batch.tile_offsets[tile]; k < batch.tile_offsets[tile + 1]; ++k)
+    {
+      // A local copy, which stores to the image cannot alias, so the compiler keeps it in registers
+      Triangle const tri = batch.triangles[batch.tile_triangles[k]];
+
+      int px0 = std::max(tri.x0, tile_x0), px1 = std::min(tri.x1, tile_x1);
+      int py0 = std::max(tri.y0, tile_y0), py1 = std::min(tri.y1, tile_y1);
+
+      for (int y = py0; y <= py1; ++y)
+      {
+        float cy = y + 0.5f;
+        float row_e[3] = { tri.b[0] * cy + tri.c[0], tri.b[1] * cy + tri.c[1], tri.b[2] * cy + tri.c[2] };
+        uint8 * row = pixels + y * scan_width;
+        float * depth_row = &depth[(size_t)((y - tile_y0) * tile_size)];
+
+        for (int x = px0; x <= px1; ++x)
+        {
+          float cx = x + 0.5f;
+          float e0 = tri.a[0] * cx + row_e[0], e1 = tri.a[1] * cx + row_e[1], e2 = tri.a[2] * cx + row_e[2];
+          if (!(e0 > 0 || (e0 == 0 && tri.owner[0])) || !(e1 > 0 || (e1 == 0 && tri.owner[1]))
+           || !(e2 > 0 || (e2 == 0 && tri.owner[2])))
+            continue;
+
+          float w0 = e0 * tri.inv_sum, w1 = e1 * tri.inv_sum, w2 = e2 * tri.inv_sum;
+          float z = w0 * tri.z[0] + w1 * tri.z[1] + w2 * tri.z[2];
+          float & d = depth_row[x - tile_x0];
+          if (!(z < d))
+            continue;
+
+          d = z;
+
+          // Interpolate color/w and 1/w linearly in screen space, for perspective-correct colors
+          float w = 1.0f / (w0 * tri.inv_w[0] + w1 * tri.inv_w[1] + w2 * tri.inv_w[2]);
+          Vector3 color = (w0 * w) * tri.color[0] + (w1 * w) * tri.color[1] + (w2 * w) * tri.color[2];
+
+          row[3 * x    ] = toByte(color[0]);
+          row[3 * x + 1] = toByte(color[1]);
+          row[3 * x + 2] = toByte(color[2]);
+          num_fragments++;
+        }
+      }
+    }
+  }
+
+  return num_fragments;
+}
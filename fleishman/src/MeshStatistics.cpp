@@ -0,0 +1,214 @@
+#include "MeshStatistics.hpp"
+#include "MeshCore.hpp"
+#include "DGP/Math.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+namespace MeshStatisticsInternal {
+
+// Number of elements in each block of the parallel loop. Blocks are the same whatever the number of threads.
+static long const BLOCK_SIZE = 4096;
+
+// Statistics of one block of edges, vertices or faces.
+struct Partial
+{
+  Partial()
+  : sum_length(0), min_length(std::numeric_limits<double>::max()), max_length(0), num_boundary(0), num_nonmanifold(0),
+    area(0)
+  {}
+
+  double sum_length, min_length, max_length;
+  long num_boundary, num_nonmanifold;
+  std::vector<long> valences;
+  AxisAlignedBox3 bounds;
+  double area;
+};
+
+// Count the faces that have an edge as a side, by searching the loops of the faces around one endpoint.
+int
+countEdgeFaces(MeshCore const & mesh, MeshCore::Index a, MeshCore::Index b)
+{
+  int count = 0;
+  MeshCore::Index const * vf = mesh.vertexFaces(a);
+  for (int i = 0, n = mesh.numVertexFaces(a); i < n; ++i)
+  {
+    MeshCore::Index const * fv = mesh.faceVertices(vf[i]);
+    int m = mesh.numFaceVertices(vf[i]);
+    for (int j = 0; j < m; ++j)
+      if (fv[j] == a && (fv[(j + 1) % m] == b || fv[(j + m - 1) % m] == b))
+      {
+        count++;
+        break;
+      }
+  }
+
+  return count;
+}
+
+// Area of a face, with the same arithmetic as MeshCore::updateNormals().
+double
+faceArea(MeshCore const & mesh, MeshCore::Index f)
+{
+  MeshCore::Index const * fv = mesh.faceVertices(f);
+  int n = mesh.numFaceVertices(f);
+  if (n == 3)
+  {
+    Vector3 e1 = mesh.getPosition(fv[0]) - mesh.getPosition(fv[1]);
+    Vector3 e2 = mesh.getPosition(fv[2]) - mesh.getPosition(fv[1]);
+    return 0.5 * e2.cross(e1).length();
+  }
+
+  Vector3 vector_area = Vector3::zero();
+  for (int j = 0; j < n; ++j)
+    vector_area += mesh.getPosition(fv[j]).cross(mesh.getPosition(fv[(j + 1) % n]));
+
+  return 0.5 * vector_area.length();
+}
+
+// Append a named number to a JSON object under construction.
+void
+appendJSON(std::string & json, char const * name, double value)
+{
+  char buf[64];
+  if (Math::isFinite(value))
+    std::snprintf(buf, sizeof(buf), "%.9g", value);
+  else
+    std::snprintf(buf, sizeof(buf), "null");
+
+  json += (json.size() > 1 ? ",\"" : "\"");
+  json += name;
+  json += "\":";
+  json += buf;
+}
+
+} // namespace MeshStatisticsInternal
+
+MeshStatistics
+MeshStatistics::compute(MeshCore const & mesh, ThreadPool * pool_)
+{
+  using namespace MeshStatisticsInternal;
+
+  ThreadPool & pool = (pool_ ? *pool_ : ThreadPool::common());
+  long nv = mesh.numVertices(), ne = mesh.numEdges(), nf = mesh.numFaces();
+
+  // Blocks of edges come first, then blocks of vertices, then blocks of faces
+  long ne_blocks = (ne + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  long nv_blocks = (nv + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  long nf_blocks = (nf + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  std::vector<Partial> partials((size_t)(ne_blocks + nv_blocks + nf_blocks));
+  std::vector<Real> lengths((size_t)ne);
+
+  pool.parallelFor(0, (long)partials.size(), [&](long lo, long hi, long) {
+    for (long b = lo; b < hi; ++b)
+    {
+      Partial & part = partials[(size_t)b];
+      if (b < ne_blocks)
+      {
+        for (long e = b * BLOCK_SIZE, end = std::min(e + BLOCK_SIZE, ne); e < end; ++e)
+        {
+          MeshCore::Index v0 = mesh.getEdgeEndpoint((MeshCore::Index)e, 0);
+          MeshCore::Index v1 = mesh.getEdgeEndpoint((MeshCore::Index)e, 1);
+          Real length = (mesh.getPosition(v1) - mesh.getPosition(v0)).length();
+          lengths[(size_t)e] = length;
+          part.sum_length += length;
+          part.min_length = std::min(part.min_length, (double)length);
+          part.max_length = std::max(part.max_length, (double)length);
+
+          int num_edge_faces = countEdgeFaces(mesh, v0, v1);
+          if (num_edge_faces <= 1)     part.num_boundary++;
+          else if (num_edge_faces > 2) part.num_nonmanifold++;
+        }
+      }
+      else if (b < ne_blocks + nv_blocks)
+      {
+        long first = (b - ne_blocks) * BLOCK_SIZE;
+        for (long v = first, end = std::min(first + BLOCK_SIZE, nv); v < end; ++v)
+        {
+          size_t valence = (size_t)mesh.numVertexNeighbours((MeshCore::Index)v);
+          if (valence >= part.valences.size())
+            part.valences.resize(valence + 1, 0);
+
+          part.valences[valence]++;
+          part.bounds.merge(mesh.getPosition((MeshCore::Index)v));
+        }
+      }
+      else
+      {
+        long first = (b - ne_blocks - nv_blocks) * BLOCK_SIZE;
+        for (long f = first, end = std::min(first + BLOCK_SIZE, nf); f < end; ++f)
+          part.area += faceArea(mesh, (MeshCore::Index)f);
+      }
+    }
+  }, 1);
+
+  MeshStatistics stats;
+  stats.num_vertices = nv;
+  stats.num_edges = ne;
+  stats.num_faces = nf;
+
+  double sum_length = 0, min_length = std::numeric_limits<double>::max();
+  for (size_t b = 0; b < partials.size(); ++b)
+  {
+    Partial const & part = partials[b];
+    sum_length += part.sum_length;
+    min_length = std::min(min_length, part.min_length);
+    stats.max_edge_length = std::max(stats.max_edge_length, part.max_length);
+    stats.num_boundary_edges += part.num_boundary;
+    stats.num_nonmanifold_edges += part.num_nonmanifold;
+    stats.surface_area += part.area;
+    stats.bounds.merge(part.bounds);
+
+    if (part.valences.size() > stats.valence_histogram.size())
+      stats.valence_histogram.resize(part.valences.size(), 0);
+
+    for (size_t k = 0; k < part.valences.size(); ++k)
+      stats.valence_histogram[k] += part.valences[k];
+  }
+
+  if (ne > 0)
+  {
+    stats.min_edge_length = min_length;
+    stats.mean_edge_length = sum_length / ne;
+
+    // The upper middle length, and for an even count the largest length below it
+    size_t mid = (size_t)(ne / 2);
+    std::nth_element(lengths.begin(), lengths.begin() + mid, lengths.end());
+    stats.median_edge_length = lengths[mid];
+    if (ne % 2 == 0)
+      stats.median_edge_length = 0.5 * (stats.median_edge_length + *std::max_element(lengths.begin(), lengths.begin() + mid));
+  }
+
+  return stats;
+}
+
+std::string
+MeshStatistics::toJSON() const
+{
+  using namespace MeshStatisticsInternal;
+
+  std::string json = "{";
+  appendJSON(json, "vertices", (double)num_vertices);
+  appendJSON(json, "edges", (double)num_edges);
+  appendJSON(json, "faces", (double)num_faces);
+  appendJSON(json, "min_edge_length", min_edge_length);
+  appendJSON(json, "max_edge_length", max_edge_length);
+  appendJSON(json, "mean_edge_length", mean_edge_length);
+  appendJSON(json, "median_edge_length", median_edge_length);
+  appendJSON(json, "surface_area", surface_area);
+  appendJSON(json, "boundary_edges", (double)num_boundary_edges);
+  appendJSON(json, "nonmanifold_edges", (double)num_nonmanifold_edges);
+  appendJSON(json, "bounds_diagonal", bounds.isNull() ? 0.0 : (double)bounds.getExtent().length());
+
+  json += ",\"valence_histogram\":[";
+  for (size_t k = 0; k < valence_histogram.size(); ++k)
+  {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), (k > 0 ? ",%ld" : "%ld"), valence_histogram[k]);
+    json += buf;
+  }
+
+  json += "]}";
+  return json;
+}
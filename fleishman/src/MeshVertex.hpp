@@ -43,17 +43,17 @@ class MeshVertex
     /** Default constructor. */
     MeshVertex()
     : position(Vector3::zero()), normal(Vector3::zero()), color(ColorRGBA(1, 1, 1, 1)), has_precomputed_normal(false),
-      normal_normalization_factor(0){}
+      normal_normalization_factor(0), index(0), handle(), removed(false) {}
 
     /** Sets the vertex to have a given location. */
     explicit MeshVertex(Vector3 const & p)
     : position(p), normal(Vector3::zero()), color(ColorRGBA(1, 1, 1, 1)), has_precomputed_normal(false),
-      normal_normalization_factor(0)
+      normal_normalization_factor(0), index(0), handle(), removed(false)
     {}
 
     /** Sets the vertex to have a location, normal and color. */
     MeshVertex(Vector3 const & p, Vector3 const & n, ColorRGBA const & c = ColorRGBA(1, 1, 1, 1))
-    : position(p), normal(n), color(c), has_precomputed_normal(true), normal_normalization_factor(0)
+    : position(p), normal(n), color(c), has_precomputed_normal(true), normal_normalization_factor(0), index(0), handle(), removed(false)
     {}
 
     /**
@@ -160,8 +160,16 @@ class MeshVertex
     /** get Neighbours of a vertex. */
     std::list<MeshVertex*> findNeighbours(double sigma_c);
 
+    /**
+     * Check if the vertex has been removed from its mesh. The memory of a removed vertex is kept for reuse by the mesh, so
+     * pointers to it stay valid, but it has no adjacencies and must not be used otherwise.
+     */
+    bool isRemoved() const { return removed; }
+
   private:
     friend class Mesh;
+    friend class MeshCore;
+    friend class MeshRenderBuffer;
 
     /** Add a reference to an edge incident at this vertex. */
     void addEdge(Edge * edge) { edges.push_back(edge); }
@@ -240,6 +248,9 @@ class MeshVertex
     FaceList faces;
     bool has_precomputed_normal;
     float normal_normalization_factor;
+    mutable uint32 index;  ///< Position of the vertex in the vertex list of the mesh, assigned by MeshCore and when saving.
+    std::list<MeshVertex>::iterator handle;  ///< Position of the vertex in the vertex list of the mesh, for constant-time removal.
+    bool removed;  ///< Has the vertex been removed from its mesh?
 
 }; // class MeshVertex
 
@@ -0,0 +1,187 @@
+#include "NeighbourhoodColoring.hpp"
+#include <algorithm>
+
+void
+NeighbourhoodColoring::build(std::vector< std::vector<Index> > const & neighbourhoods)
+{
+  long nv = (long)neighbourhoods.size();
+
+  // Symmetric adjacencies of the conflict graph, in compressed rows. Duplicates are harmless.
+  std::vector<long> adj_offsets((size_t)nv + 1, 0);
+  for (long p = 0; p < nv; ++p)
+  {
+    std::vector<Index> const & nbrs = neighbourhoods[(size_t)p];
+    for (size_t i = 0; i < nbrs.size(); ++i)
+      if (nbrs[i] != (Index)p)
+      {
+        adj_offsets[(size_t)p + 1]++;
+        adj_offsets[(size_t)nbrs[i] + 1]++;
+      }
+  }
+
+  for (long p = 0; p < nv; ++p)
+    adj_offsets[(size_t)p + 1] += adj_offsets[(size_t)p];
+
+  std::vector<Index> adj((size_t)adj_offsets[(size_t)nv]);
+  std::vector<long> fill(adj_offsets.begin(), adj_offsets.end() - 1);
+  for (long p = 0; p < nv; ++p)
+  {
+    std::vector<Index> const & nbrs = neighbourhoods[(size_t)p];
+    for (size_t i = 0; i < nbrs.size(); ++i)
+      if (nbrs[i] != (Index)p)
+      {
+        adj[(size_t)fill[(size_t)p]++] = nbrs[i];
+        adj[(size_t)fill[(size_t)nbrs[i]]++] = (Index)p;
+      }
+  }
+
+  std::vector<Index> vertices((size_t)nv);
+  for (long p = 0; p < nv; ++p)
+    vertices[(size_t)p] = (Index)p;
+
+  colors.assign((size_t)nv, 0);
+  colorGreedy(vertices.empty() ? NULL : &vertices[0], nv, adj_offsets, adj, 0);
+
+  num_built_colors = (nv > 0 ? *std::max_element(colors.begin(), colors.end()) + 1 : 0);
+  groupByColor(num_built_colors);
+}
+
+long
+NeighbourhoodColoring::update(std::vector< std::vector<Index> > const & neighbourhoods, Index const * changed, long num_changed)
+{
+  long nv = (long)neighbourhoods.size();
+  if (nv != numVertices())
+  {
+    build(neighbourhoods);
+    return nv;
+  }
+
+  // Changed vertices that now have a vertex of their own color in their neighbourhood. A conflict through the neighbourhood of
+  // an unchanged vertex was already there when it was colored, so it cannot arise.
+  std::vector<Index> conflicting;
+  for (long i = 0; i < num_changed; ++i)
+  {
+    Index p = changed[i];
+    std::vector<Index> const & nbrs = neighbourhoods[p];
+    for (size_t j = 0; j < nbrs.size(); ++j)
+      if (nbrs[j] != p && colors[nbrs[j]] == colors[p])
+      {
+        conflicting.push_back(p);
+        break;
+      }
+  }
+
+  if (conflicting.empty())
+    return 0;
+
+  std::sort(conflicting.begin(), conflicting.end());
+  conflicting.erase(std::unique(conflicting.begin(), conflicting.end()), conflicting.end());
+  long n = (long)conflicting.size();
+
+  // The conflicting vertices get colors no other vertex has, so they only need to be colored apart from each other. Every
+  // conflict between two of them is in the neighbourhood of one of them.
+  std::vector<long> local((size_t)nv, -1);
+  for (long i = 0; i < n; ++i)
+    local[conflicting[(size_t)i]] = i;
+
+  std::vector< std::pair<Index, Index> > edges;
+  for (long i = 0; i < n; ++i)
+  {
+    std::vector<Index> const & nbrs = neighbourhoods[conflicting[(size_t)i]];
+    for (size_t j = 0; j < nbrs.size(); ++j)
+    {
+      long k = local[nbrs[j]];
+      if (k >= 0 && k != i)
+      {
+        edges.push_back(std::make_pair((Index)i, (Index)k));
+        edges.push_back(std::make_pair((Index)k, (Index)i));
+      }
+    }
+  }
+
+  std::sort(edges.begin(), edges.end());
+  std::vector<long> adj_offsets((size_t)n + 1, 0);
+  std::vector<Index> adj(edges.size());
+  for (size_t e = 0; e < edges.size(); ++e)
+  {
+    adj_offsets[(size_t)edges[e].first + 1]++;
+    adj[e] = edges[e].second;
+  }
+
+  for (long i = 0; i < n; ++i)
+    adj_offsets[(size_t)i + 1] += adj_offsets[(size_t)i];
+
+  long num_colors = numColors();
+  colorGreedy(&conflicting[0], n, adj_offsets, adj, num_colors);
+  for (long i = 0; i < n; ++i)
+    num_colors = std::max(num_colors, colors[conflicting[(size_t)i]] + 1);
+
+  if (num_colors > 2 * num_built_colors)
+  {
+    build(neighbourhoods);
+    return nv;
+  }
+
+  groupByColor(num_colors);
+  return n;
+}
+
+bool
+NeighbourhoodColoring::isValid(std::vector< std::vector<Index> > const & neighbourhoods) const
+{
+  if ((long)neighbourhoods.size() != numVertices())
+    return false;
+
+  for (size_t p = 0; p < neighbourhoods.size(); ++p)
+  {
+    std::vector<Index> const & nbrs = neighbourhoods[p];
+    for (size_t i = 0; i < nbrs.size(); ++i)
+      if (nbrs[i] != (Index)p && colors[nbrs[i]] == colors[p])
+        return false;
+  }
+
+  return true;
+}
+
+void
+NeighbourhoodColoring::colorGreedy(Index const * vertices, long num_vertices, std::vector<long> const & adj_offsets,
+                                   std::vector<Index> const & adj, long first_color)
+{
+  // last_user[c] is the last vertex that saw color c among its colored neighbours. The adjacencies index \a vertices.
+  std::vector<long> last_user;
+  std::vector<long> assigned((size_t)num_vertices, -1);
+  for (long i = 0; i < num_vertices; ++i)
+  {
+    for (long j = adj_offsets[(size_t)i]; j < adj_offsets[(size_t)i + 1]; ++j)
+    {
+      long nbr_color = assigned[adj[(size_t)j]];
+      if (nbr_color < 0) continue;
+
+      if (nbr_color >= (long)last_user.size()) last_user.resize((size_t)nbr_color + 1, -1);
+      last_user[(size_t)nbr_color] = i;
+    }
+
+    long c = 0;
+    while (c < (long)last_user.size() && last_user[(size_t)c] == i)
+      ++c;
+
+    assigned[(size_t)i] = c;
+    colors[vertices[i]] = first_color + c;
+  }
+}
+
+void
+NeighbourhoodColoring::groupByColor(long num_colors)
+{
+  color_offsets.assign((size_t)num_colors + 1, 0);
+  for (size_t v = 0; v < colors.size(); ++v)
+    color_offsets[(size_t)colors[v] + 1]++;
+
+  for (long c = 0; c < num_colors; ++c)
+    color_offsets[(size_t)c + 1] += color_offsets[(size_t)c];
+
+  ordered.resize(colors.size());
+  std::vector<long> fill(color_offsets.begin(), color_offsets.end() - 1);
+  for (size_t v = 0; v < colors.size(); ++v)
+    ordered[(size_t)fill[(size_t)colors[v]]++] = (Index)v;
+}
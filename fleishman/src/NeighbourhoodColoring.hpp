@@ -0,0 +1,79 @@
+#ifndef __A3_NeighbourhoodColoring_hpp__
+#define __A3_NeighbourhoodColoring_hpp__
+
+#include "Common.hpp"
+#include "MeshCore.hpp"
+#include <vector>
+
+/**
+ * A coloring of the conflict graph of vertex neighbourhoods: two vertices conflict if either one is in the neighbourhood of the
+ * other. No two vertices of the same color conflict, so a smoothing pass in which each vertex reads the positions of its
+ * neighbourhood and writes only its own position can update all the vertices of a color at once, in parallel, while colors run
+ * one after the other and each sees the positions written by the colors before it (Gauss-Seidel order by color).
+ *
+ * The coloring is greedy, in ascending order of vertex index, so it does not depend on the number of threads. When some
+ * neighbourhoods change, update() repairs the coloring instead of recomputing it, so it can be kept across smoothing passes.
+ */
+class NeighbourhoodColoring
+{
+  public:
+    typedef MeshCore::Index Index;  ///< Index of a vertex.
+
+    /** Constructor. The coloring is empty. */
+    NeighbourhoodColoring() : num_built_colors(0) {}
+
+    /**
+     * Color the vertices from scratch.
+     *
+     * @param neighbourhoods The neighbourhood of each vertex. May include the vertex itself.
+     */
+    void build(std::vector< std::vector<Index> > const & neighbourhoods);
+
+    /**
+     * Repair the coloring after the neighbourhoods of some vertices have changed. Those of the changed vertices that now
+     * conflict with a vertex of the same color are moved to new colors. Once repairs have doubled the number of colors since
+     * the last build(), the vertices are colored from scratch instead, since fewer vertices per color leave less to do in
+     * parallel.
+     *
+     * @param neighbourhoods The neighbourhood of each vertex, as passed to build() except for the changed vertices.
+     * @param changed The vertices whose neighbourhoods have changed.
+     * @param num_changed The number of changed vertices.
+     *
+     * @return The number of vertices whose color changed, or the number of vertices if they were colored from scratch.
+     */
+    long update(std::vector< std::vector<Index> > const & neighbourhoods, Index const * changed, long num_changed);
+
+    /** Get the number of vertices. */
+    long numVertices() const { return (long)colors.size(); }
+
+    /** Get the number of colors. */
+    long numColors() const { return (long)color_offsets.size() - 1; }
+
+    /** Get the color of a vertex. */
+    long getColor(Index v) const { return colors[v]; }
+
+    /** Get the number of vertices of a color. */
+    long numColorVertices(long c) const { return color_offsets[(size_t)c + 1] - color_offsets[(size_t)c]; }
+
+    /** Get the vertices of a color, in ascending order of index. */
+    Index const * colorVertices(long c) const { return ordered.data() + color_offsets[(size_t)c]; }
+
+    /** Check that no vertex has the color of a vertex in its neighbourhood, for testing. */
+    bool isValid(std::vector< std::vector<Index> > const & neighbourhoods) const;
+
+  private:
+    /** Color a set of vertices greedily, in order, with colors from \a first_color up, given their symmetric adjacencies. */
+    void colorGreedy(Index const * vertices, long num_vertices, std::vector<long> const & adj_offsets,
+                     std::vector<Index> const & adj, long first_color);
+
+    /** List the vertices of each color, from the color of each vertex. */
+    void groupByColor(long num_colors);
+
+    std::vector<long> colors;         ///< Color of each vertex.
+    std::vector<long> color_offsets;  ///< Where the vertices of each color start in #ordered, plus the number of vertices.
+    std::vector<Index> ordered;       ///< Vertices sorted by color, then by index.
+    long num_built_colors;            ///< Number of colors after the last build().
+
+}; // class NeighbourhoodColoring
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef __A3_TiledMesh_hpp__
+#define __A3_TiledMesh_hpp__
+
+#include "Common.hpp"
+#include "Mesh.hpp"
+#include "DGP/AxisAlignedBox3.hpp"
+#include "DGP/MappedFile.hpp"
+#include "DGP/Noncopyable.hpp"
+#include "DGP/ThreadPool.hpp"
+#include <string>
+#include <vector>
+
+/**
+ * A mesh stored on disk as spatial tiles, for smoothing meshes too large to load into a Mesh. The bounding box is divided into
+ * a grid of tiles, each owning the vertices that fall in it. Alongside its vertices, each tile stores every face with a vertex
+ * within a <em>halo</em> distance of the tile, so a tile can be loaded into a Mesh of its own and smoothed with the usual
+ * kernel (Mesh::bilateralSmooth()), and its vertices see the same neighbourhoods as in the whole mesh. The vertices of a tile
+ * are stored contiguously, so the smoothed positions of a tile are written back in one block.
+ *
+ * A tiled mesh is built from an OFF file by build(), read through a memory-mapped view by open(), smoothed into a new tiled
+ * mesh by smooth(), and converted back to OFF by saveOFF(). Building needs 8 bytes of memory per vertex. Smoothing processes
+ * as many tiles at once as the thread pool has participants, so its memory use depends on the size of the tiles and not of the
+ * mesh.
+ *
+ * Each tile is smoothed from the positions at the start of the pass, as loaded from the input file, so the result does not
+ * depend on the order or number of threads. Only the vertices owned by the tile are smoothed (see
+ * Mesh::SmoothingOptions::vertex_mask), and the halo keeps its loaded positions. With an update mode that reads only the
+ * positions at the start of the pass (Jacobi), the result is the same as for the whole mesh in memory. With in-place updates,
+ * owned vertices near the border of a tile see the halo at its old positions, where in the whole mesh they would see some of
+ * it updated, so the result differs near tile borders.
+ *
+ * The file format is little-endian, and only supported on little-endian machines.
+ */
+class TiledMesh : private Noncopyable
+{
+  public:
+    /** %Options controlling build(). */
+    struct BuildOptions
+    {
+      long vertices_per_tile;  /**< Target average number of vertices per tile, which sets the size of the grid (default
+                                    131072). Tiles over dense parts of the mesh hold more than this. */
+
+      /** Constructor. */
+      BuildOptions() : vertices_per_tile(131072) {}
+
+      /** Get the default set of build options. */
+      static BuildOptions const & defaults() { static BuildOptions const def; return def; }
+
+    }; // struct BuildOptions
+
+    /** %Options controlling smooth(). */
+    struct SmoothingOptions
+    {
+      Mesh::SmoothingOptions kernel;  /**< Options for the smoothing of each tile (default Mesh::SmoothingOptions::defaults()).
+                                           Its vertex mask is replaced by the vertices owned by the tile. */
+      ThreadPool * thread_pool;       /**< Threads that smooth tiles concurrently, one tile per participant at a time (default
+                                           null, indicating ThreadPool::common()). */
+
+      /** Constructor. */
+      SmoothingOptions() : thread_pool(NULL) {}
+
+      /** Get the default set of smoothing options. */
+      static SmoothingOptions const & defaults() { static SmoothingOptions const def; return def; }
+
+    }; // struct SmoothingOptions
+
+    /** Statistics of a run of smooth(). */
+    struct SmoothingStats
+    {
+      long num_tiles;                ///< Number of non-empty tiles smoothed.
+      long max_tile_vertices;        ///< Largest number of vertices in a loaded tile, including its halo.
+      long total_halo_vertices;      ///< Total number of halo vertices loaded, read by the smoothing but not moved.
+      long max_vertices_in_flight;   ///< Largest number of vertices in tiles loaded at the same time.
+
+      /** Constructor. */
+      SmoothingStats() : num_tiles(0), max_tile_vertices(0), total_halo_vertices(0), max_vertices_in_flight(0) {}
+
+    }; // struct SmoothingStats
+
+    /** Constructor. No file is open. */
+    TiledMesh();
+
+    /**
+     * Build a tiled mesh from an OFF file, streaming the vertices and faces from the file instead of loading it as a Mesh.
+     *
+     * @param off_path The path of the OFF file.
+     * @param tiled_path The path of the tiled mesh to write. A temporary file with the suffix <tt>.tmp</tt> is also created
+     *   and deleted next to it.
+     * @param radius The radius of the neighbourhoods that smoothing will gather, such as 2 sigma_c. The halo of each tile is
+     *   this plus the length of the longest edge, so it also holds the faces whose centroids are within the radius.
+     * @param options Options controlling the tiles.
+     *
+     * @return True on success, false on error.
+     */
+    static bool build(std::string const & off_path, std::string const & tiled_path, double radius,
+                      BuildOptions const & options = BuildOptions::defaults());
+
+    /** Open a tiled mesh, closing the current one if any. Prints an error and returns false on failure. */
+    bool open(std::string const & path);
+
+    /** Close the tiled mesh. */
+    void close();
+
+    /** Check if a tiled mesh is open. */
+    bool isOpen() const { return file.getData() != NULL; }
+
+    /** Get the number of vertices. */
+    long numVertices() const { return (long)num_vertices; }
+
+    /** Get the number of faces. */
+    long numFaces() const { return (long)num_faces; }
+
+    /** Get the number of tiles. */
+    long numTiles() const { return (long)num_tiles; }
+
+    /** Get the bounding box of the vertices. */
+    AxisAlignedBox3 const & getBounds() const { return bounds; }
+
+    /** Get the radius of the neighbourhoods the tiles support (see build()). */
+    double getRadius() const { return halo - max_edge_length; }
+
+    /** Get the distance from a tile within which faces are stored with it. */
+    double getHalo() const { return halo; }
+
+    /** Get the length of the longest edge. */
+    double getMaxEdgeLength() const { return max_edge_length; }
+
+    /** Get the number of vertices owned by a tile, excluding its halo. */
+    long numTileVertices(long tile) const;
+
+    /**
+     * Load a tile with its halo into a mesh. The vertices are in the order of the original mesh, as are the faces.
+     *
+     * @param tile The index of the tile.
+     * @param mesh Used to return the mesh. Its previous contents are replaced.
+     * @param vertex_indices Used to return the index of each vertex of the mesh within the tiled mesh. The vertices owned by
+     *   the tile have indices in [getFirstVertex(tile), getFirstVertex(tile) + numTileVertices(tile)).
+     */
+    void loadTile(long tile, Mesh & mesh, std::vector<uint32> & vertex_indices) const;
+
+    /** Get the index within the tiled mesh of the first vertex owned by a tile. */
+    long getFirstVertex(long tile) const;
+
+    /** Get the position of a vertex, given its index in the original mesh. */
+    Vector3 getPosition(long vertex) const;
+
+    /**
+     * Apply a pass of bilateral smoothing to the mesh, tile by tile, and write the result to a new tiled mesh with the same
+     * tiles. The sigmas are those of Mesh::bilateralSmooth(). Passes are repeated by smoothing the result in turn.
+     *
+     * @return True on success, false if the tiles were built for a smaller radius than 2 sigma_c, or on error.
+     */
+    bool smooth(std::string const & out_path, double sigma_c, double sigma_s,
+                SmoothingOptions const & options = SmoothingOptions::defaults(), SmoothingStats * stats = NULL) const;
+
+    /** Write the mesh to an OFF file, with the vertices and faces in their original order. */
+    bool saveOFF(std::string const & path) const;
+
+  private:
+    /** Get a pointer to a byte of the file. */
+    uint8 const * at(uint64 offset) const { return reinterpret_cast<uint8 const *>(file.getData()) + offset; }
+
+    MappedFile file;               ///< The open file.
+    std::string path;              ///< The path of the open file.
+    uint32 num_tiles;              ///< Number of tiles.
+    uint64 num_vertices;           ///< Number of vertices.
+    uint64 num_faces;              ///< Number of faces.
+    AxisAlignedBox3 bounds;        ///< Bounding box of the vertices.
+    double halo;                   ///< Distance from a tile within which faces are stored with it.
+    double max_edge_length;        ///< Length of the longest edge.
+    std::vector<uint64> sections;  ///< Offset of each section of the file.
+
+}; // class TiledMesh
+
+#endif
@@ -1,5 +1,6 @@
 #include "Viewer.hpp"
 #include "Mesh.hpp"
+#include "MeshMetrics.hpp"
 #include "DGP/Graphics/RenderSystem.hpp"
 #include "DGP/Graphics/Shader.hpp"
 
@@ -13,6 +14,7 @@ Graphics::RenderSystem * Viewer::render_system = NULL;
 Mesh * Viewer::mesh = NULL;
 double Viewer::sigma_c = 0;
 double Viewer::sigma_s = 0;
+MeshMetrics * Viewer::metrics = NULL;
 int Viewer::width = 640;
 int Viewer::height = 480;
 Camera Viewer::camera;
@@ -25,6 +27,7 @@ int Viewer::drag_start_x = -1;
 int Viewer::drag_start_y = -1;
 bool Viewer::show_bbox = false;
 bool Viewer::show_edges = false;
+bool Viewer::smooth_shading = true;
 MeshVertex const * Viewer::highlighted_vertex = NULL;
 
 void
@@ -35,6 +38,12 @@ Viewer::setObject(Mesh * o, double sigmaC, double sigmaS)
   sigma_s = sigmaS;
 }
 
+void
+Viewer::setMetrics(MeshMetrics * m)
+{
+  metrics = m;
+}
+
 void
 Viewer::launch(int argc, char * argv[])
 {
@@ -54,6 +63,7 @@ Viewer::launch(int argc, char * argv[])
   glutKeyboardFunc(keyPress);
   glutMouseFunc(mousePress);
   glutMotionFunc(mouseMotion);
+  glutPassiveMotionFunc(mousePassiveMotion);
 
   // Start event processing loop
   glutMainLoop();
@@ -189,7 +199,8 @@ Viewer::draw()
 
         render_system->setShader(mesh_shader);
         render_system->setColor(ColorRGB(1, 1, 1));
-        mesh->draw(*render_system, /* draw_edges = */ show_edges, /* use_vertex_data = */ false, /* send_colors = */ false);
+        mesh->draw(*render_system, /* draw_edges = */ show_edges, /* use_vertex_data = */ smooth_shading,
+                   /* send_colors = */ false);
 
         if (show_bbox)
         {
@@ -271,6 +282,13 @@ zoomTransform(Real zoom, Real camera_separation, Vector3 const & zoom_dir)
   return AffineTransform3(Matrix3::identity(), trn);
 }
 
+void
+Viewer::printMetrics()
+{
+  if (metrics)
+    std::cout << metrics->compute(*mesh).toJSON() << std::endl;
+}
+
 void
 Viewer::keyPress(unsigned char key, int x, int y)
 {
@@ -288,6 +306,11 @@ Viewer::keyPress(unsigned char key, int x, int y)
     show_edges = !show_edges;
     glutPostRedisplay();
   }
+  else if (key == 'g' || key == 'G')
+  {
+    smooth_shading = !smooth_shading;
+    glutPostRedisplay();
+  }
   else if (key == 'f' || key == 'F')
   {
     fitCameraToObject();
@@ -295,25 +318,79 @@ Viewer::keyPress(unsigned char key, int x, int y)
   }
   else if (key == 'o' || key == 'O')
   {
-    mesh->load("./orig.off");
+    mesh->load("./orig.bmesh");
+    highlighted_vertex = NULL;
     glutPostRedisplay();
   }
   else if (key == 'n' || key == 'N')
   {
-    mesh->load("./noisy.off");
+    mesh->load("./noisy.bmesh");
+    highlighted_vertex = NULL;
     glutPostRedisplay();
   }
   else if (key == 's' || key == 'S')
   {
     mesh->bilateralSmooth(sigma_c, sigma_s);
-    std::cout << mesh->getdifference() << std::endl;
+    printMetrics();
+    glutPostRedisplay();
+  }
+  else if (key == 'j' || key == 'J')
+  {
+    Mesh::SmoothingOptions options;
+    options.update_mode = Mesh::UpdateMode::JACOBI;
+    mesh->bilateralSmooth(sigma_c, sigma_s, options);
+    printMetrics();
+    glutPostRedisplay();
+  }
+  else if (key == 'c' || key == 'C')
+  {
+    Mesh::SmoothingOptions options;
+    options.update_mode = Mesh::UpdateMode::COLORED;
+    mesh->bilateralSmooth(sigma_c, sigma_s, options);
+    printMetrics();
+    glutPostRedisplay();
+  }
+  else if (key == 'l' || key == 'L')
+  {
+    mesh->fairImplicit(1.0);
+    printMetrics();
+    glutPostRedisplay();
+  }
+  else if (key == 'u' || key == 'U')
+  {
+    Mesh::SmoothingOptions options;
+    options.neighbourhood = Mesh::NeighbourhoodType::EUCLIDEAN;
+    mesh->bilateralSmooth(sigma_c, sigma_s, options);
+    printMetrics();
+    glutPostRedisplay();
+  }
+  else if (key == 'i' || key == 'I')
+  {
+    // Measure every pass
+    Mesh::IterationOptions iteration_options;
+    if (metrics)
+    {
+      iteration_options.pass_callback = [](MeshCore const & core, Mesh::IterationStats const & st) {
+        std::cout << "{\"pass\":" << st.num_iterations << ",\"metrics\":" << metrics->compute(core).toJSON() << '}'
+                  << std::endl;
+      };
+    }
+
+    Mesh::IterationStats stats;
+    mesh->bilateralSmoothIterative(sigma_c, sigma_s, iteration_options, Mesh::SmoothingOptions::defaults(), &stats);
+    std::cout << stats.num_iterations << " passes, mean displacement " << stats.mean_displacement << std::endl;
+    glutPostRedisplay();
+  }
+  else if (key == 'd' || key == 'D')
+  {
+    // Halve the number of faces
+    Mesh::DecimationOptions options;
+    options.target_faces = mesh->numFaces() / 2;
+    mesh->decimateQuadricEdgeCollapse(options);
+    highlighted_vertex = NULL;  // may have been removed
+    std::cout << mesh->numVertices() << " vertices, " << mesh->numFaces() << " faces" << std::endl;
     glutPostRedisplay();
   }
-  // else if (key == 'd' || key == 'd')
-  // {
-  //   highlighted_vertex = mesh->decimateQuadricEdgeCollapse();
-  //   glutPostRedisplay();
-  // }
 }
 
 void
@@ -379,6 +456,21 @@ Viewer::mouseMotion(int x, int y)
   glutPostRedisplay();
 }
 
+void
+Viewer::mousePassiveMotion(int x, int y)
+{
+  if (!mesh)
+    return;
+
+  Vector2 screen_pos(2 * x / (Real)width - 1, 1 - 2 * y / (Real)height);
+  MeshVertex const * v = mesh->pickVertex(camera, screen_pos);
+  if (v != highlighted_vertex)
+  {
+    highlighted_vertex = v;
+    glutPostRedisplay();
+  }
+}
+
 void
 Viewer::drawOutlineBox(AxisAlignedBox3 const & bbox)
 {
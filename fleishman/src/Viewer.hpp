@@ -9,6 +9,7 @@
 
 // Forward declaration
 class Mesh;
+class MeshMetrics;
 class MeshVertex;
 
 /* Displays an object using OpenGL and GLUT. */
@@ -19,6 +20,7 @@ class Viewer
     static Mesh * mesh;
     static double sigma_c;
     static double sigma_s;
+    static MeshMetrics * metrics;
 
     static int width;
     static int height;
@@ -30,12 +32,19 @@ class Viewer
     static int drag_start_x, drag_start_y;
     static bool show_bbox;
     static bool show_edges;
+    static bool smooth_shading;
     static MeshVertex const * highlighted_vertex;
 
   public:
     /** Set the object to be displayed. The object must persist as long as the viewer does. */
     static void setObject(Mesh * o, double sigma_c, double sigma_s);
 
+    /**
+     * Set the metrics, holding a reference mesh, with which to measure the object after each smoothing command (null for
+     * none). The metrics must persist as long as the viewer does.
+     */
+    static void setMetrics(MeshMetrics * m);
+
     /**
      * Call this function to launch the viewer. It will not return under normal circumstances, so make sure stuff is set up
      * before you call it!
@@ -49,6 +58,9 @@ class Viewer
     /** Callback when window is resized. */
     static void reshape(int w, int h);
 
+    /** Print the metrics of the object as a line of JSON, if metrics have been set. */
+    static void printMetrics();
+
     /** Callback when a key is pressed. */
     static void keyPress(unsigned char key, int x, int y);
 
@@ -58,6 +70,9 @@ class Viewer
     /** Callback when the mouse moves with a button pressed. */
     static void mouseMotion(int x, int y);
 
+    /** Callback when the mouse moves with no button pressed. Highlights the vertex under the cursor. */
+    static void mousePassiveMotion(int x, int y);
+
     /** Draw a bounding box as an outline. */
     static void drawOutlineBox(AxisAlignedBox3 const & bbox);
 
@@ -0,0 +1,474 @@
+#include "Batch.hpp"
+#include "Mesh.hpp"
+#include "MeshMetrics.hpp"
+#include "MeshRasterizer.hpp"
+#include "DGP/BasicStringAlg.hpp"
+#include "DGP/FilePath.hpp"
+#include "DGP/Image.hpp"
+#include "DGP/Stopwatch.hpp"
+#include "DGP/StringAlg.hpp"
+#include "DGP/System.hpp"
+#include "DGP/ThreadPool.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace BatchInternal {
+
+// The algorithm implemented by this build.
+char const * const ALGORITHM = "jones";
+
+// A job read from the job list.
+struct Job
+{
+  Job() : line(0), sigma_c(-1), sigma_s(-1), iterations(1), tolerance(0), noise(0), snapshot_size(0), log_metrics(false) {}
+
+  long line;               // Line of the job list the job came from.
+  std::string in_path;     // Mesh to load.
+  std::string out_path;    // Path to save the smoothed mesh to.
+  std::string algorithm;   // Smoothing algorithm.
+  double sigma_c;          // Smoothing parameter, or negative to use the default.
+  double sigma_s;          // Smoothing parameter, or negative to use the default.
+  long iterations;         // Maximum number of smoothing passes.
+  double tolerance;        // Mean displacement below which smoothing stops early.
+  double noise;            // Standard deviation of noise added before smoothing.
+  Mesh::NoiseOptions noise_options;  // Model and seed of the noise.
+  long snapshot_size;      // Width and height of the before and after images, or zero for none.
+  bool log_metrics;        // Measure every pass and save the results?
+};
+
+// A job in flight, with its mesh and results.
+struct JobState
+{
+  JobState()
+  : ok(false), num_passes(0), load_time(0), smooth_time(0), render_time(0), metric_time(0), save_time(0), rms_error(0),
+    max_error(0), hausdorff_distance(0)
+  {}
+
+  Job job;
+  Mesh mesh;
+  MeshMetrics metrics;             // Holds the mesh as loaded.
+  std::vector<std::string> log;    // Metrics of each pass as JSON, if requested.
+  Image before, after;             // Snapshots of the mesh before and after smoothing.
+  bool ok;
+  std::string error;
+  long num_passes;  // Smoothing passes run.
+  double load_time, smooth_time, render_time, metric_time, save_time;  // In seconds.
+  double rms_error, max_error, hausdorff_distance;
+};
+
+// Parse a non-negative real number.
+bool
+parseReal(std::string const & s, double & value)
+{
+  char * end = NULL;
+  errno = 0;
+  value = std::strtod(s.c_str(), &end);
+  return !s.empty() && *end == 0 && errno == 0 && value >= 0;
+}
+
+// Parse a boolean flag.
+bool
+parseFlag(std::string const & s, bool & value)
+{
+  std::string t = toLower(s);
+  if (t == "1" || t == "true" || t == "yes") { value = true;  return true; }
+  if (t == "0" || t == "false" || t == "no") { value = false; return true; }
+  return false;
+}
+
+// Parse a non-negative 64-bit integer.
+bool
+parseSeed(std::string const & s, uint64 & value)
+{
+  char * end = NULL;
+  errno = 0;
+  value = (uint64)std::strtoull(s.c_str(), &end, 10);
+  return !s.empty() && s[0] != '-' && *end == 0 && errno == 0;
+}
+
+// Parse a positive integer.
+bool
+parseCount(std::string const & s, long & value)
+{
+  char * end = NULL;
+  errno = 0;
+  value = std::strtol(s.c_str(), &end, 10);
+  return !s.empty() && *end == 0 && errno == 0 && value > 0;
+}
+
+// Read the job list. Returns false with an error message on a malformed line.
+bool
+readJobList(std::string const & path, std::vector<Job> & jobs)
+{
+  std::ifstream in(path.c_str());
+  if (!in)
+  {
+    DGP_ERROR << "Could not open job list '" << path << '\'';
+    return false;
+  }
+
+  std::string line;
+  std::vector<std::string> fields;
+  for (long line_num = 1; std::getline(in, line); ++line_num)
+  {
+    line = trimWhitespace(line);
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    stringSplit(line, " \t", fields, true);
+    if (fields.size() < 2)
+    {
+      DGP_ERROR << path << ':' << line_num << ": Expected an input and an output mesh";
+      return false;
+    }
+
+    Job job;
+    job.line = line_num;
+    job.in_path = fields[0];
+    job.out_path = fields[1];
+    job.algorithm = ALGORITHM;
+
+    for (size_t i = 2; i < fields.size(); ++i)
+    {
+      size_t eq = fields[i].find('=');
+      std::string key = fields[i].substr(0, eq);
+      std::string value = (eq == std::string::npos ? "" : fields[i].substr(eq + 1));
+
+      bool ok = true;
+      if (key == "algorithm")
+      {
+        job.algorithm = toLower(value);
+        ok = (job.algorithm == "fleishman" || job.algorithm == "jones");
+      }
+      else if (key == "sigma_c")
+        ok = parseReal(value, job.sigma_c) && job.sigma_c > 0;
+      else if (key == "sigma_s")
+        ok = parseReal(value, job.sigma_s) && job.sigma_s > 0;
+      else if (key == "iterations")
+        ok = parseCount(value, job.iterations);
+      else if (key == "tolerance")
+        ok = parseReal(value, job.tolerance);
+      else if (key == "noise")
+        ok = parseReal(value, job.noise);
+      else if (key == "noise_model")
+      {
+        std::string model = toLower(value);
+        if (model == "gaussian")      job.noise_options.model = Mesh::NoiseModel::GAUSSIAN;
+        else if (model == "normal")   job.noise_options.model = Mesh::NoiseModel::NORMAL;
+        else if (model == "impulse")  job.noise_options.model = Mesh::NoiseModel::IMPULSE;
+        else ok = false;
+      }
+      else if (key == "noise_seed")
+        ok = parseSeed(value, job.noise_options.seed);
+      else if (key == "noise_relative")
+        ok = parseFlag(value, job.noise_options.relative);
+      else if (key == "noise_fraction")
+        ok = parseReal(value, job.noise_options.impulse_fraction) && job.noise_options.impulse_fraction <= 1;
+      else if (key == "snapshot")
+        ok = parseCount(value, job.snapshot_size);
+      else if (key == "metrics")
+        ok = parseFlag(value, job.log_metrics);
+      else
+      {
+        DGP_ERROR << path << ':' << line_num << ": Unknown job parameter '" << key << '\'';
+        return false;
+      }
+
+      if (!ok)
+      {
+        DGP_ERROR << path << ':' << line_num << ": Invalid value for job parameter '" << key << "': '" << value << '\'';
+        return false;
+      }
+    }
+
+    jobs.push_back(job);
+  }
+
+  return true;
+}
+
+// Load the input mesh of a job.
+void
+loadStage(JobState & state)
+{
+  Stopwatch timer;
+  timer.tick();
+    state.ok = state.mesh.load(state.job.in_path);
+  timer.tock();
+  state.load_time = timer.elapsedTime();
+
+  if (!state.ok)
+    state.error = "could not load '" + state.job.in_path + '\'';
+}
+
+// Draw a snapshot of a mesh, returning the time taken in seconds.
+double
+renderSnapshot(Mesh & mesh, Camera const & camera, long size, Image & image)
+{
+  Stopwatch timer;
+  timer.tick();
+    image.resize(Image::Type::RGB_8U, (int)size, (int)size);
+    MeshRasterizer rasterizer;
+    rasterizer.render(mesh, camera, image);
+  timer.tock();
+
+  return timer.elapsedTime();
+}
+
+// Measure the current state of a job's mesh against the mesh as loaded, and log the result as a line of JSON. Returns the
+// time taken in seconds.
+double
+logPass(JobState & state, MeshCore const & core, long pass)
+{
+  Stopwatch timer;
+  timer.tick();
+    state.log.push_back(format("{\"pass\":%ld,\"metrics\":", pass) + state.metrics.compute(core).toJSON() + '}');
+  timer.tock();
+
+  return timer.elapsedTime();
+}
+
+// Add noise, smooth, and compare against the mesh as loaded. Snapshots are drawn before and after smoothing, from the same
+// viewpoint.
+void
+smoothStage(JobState & state)
+{
+  Job const & job = state.job;
+  Mesh & mesh = state.mesh;
+
+  Stopwatch timer;
+  timer.tick();
+
+    Stopwatch metric_timer;
+    metric_timer.tick();
+      state.metrics.setReference(mesh);
+    metric_timer.tock();
+    state.metric_time = metric_timer.elapsedTime();
+
+    double sigma_c = (job.sigma_c > 0 ? job.sigma_c : 0.005);
+    double sigma_s = (job.sigma_s > 0 ? job.sigma_s : 0.05);
+
+    Camera camera;
+    if (job.snapshot_size > 0)
+      camera = MeshRasterizer::frameCamera(mesh.getAABB(), (int)job.snapshot_size, (int)job.snapshot_size);
+
+    if (job.noise > 0)
+      mesh.noiseMesh(job.noise, job.noise_options);
+
+    if (job.snapshot_size > 0)
+      state.render_time += renderSnapshot(mesh, camera, job.snapshot_size, state.before);
+
+    if (job.log_metrics)
+      state.metric_time += logPass(state, mesh.getCore(), 0);
+
+    std::vector<Vector3> last_positions;
+    for (long i = 0; i < job.iterations; ++i)
+    {
+      if (job.tolerance > 0)
+      {
+        last_positions.clear();
+        for (Mesh::VertexConstIterator vi = mesh.verticesBegin(); vi != mesh.verticesEnd(); ++vi)
+          last_positions.push_back(vi->getPosition());
+      }
+
+      mesh.bilateralSmooth(sigma_c, sigma_s);
+      state.num_passes++;
+
+      if (job.log_metrics)
+        state.metric_time += logPass(state, mesh.getCore(), state.num_passes);
+
+      if (job.tolerance > 0)
+      {
+        double total_displacement = 0;
+        size_t k = 0;
+        for (Mesh::VertexConstIterator vi = mesh.verticesBegin(); vi != mesh.verticesEnd(); ++vi, ++k)
+          total_displacement += (vi->getPosition() - last_positions[k]).length();
+
+        if (k == 0 || total_displacement / k < job.tolerance)
+          break;
+      }
+    }
+
+    if (job.snapshot_size > 0)
+      state.render_time += renderSnapshot(mesh, camera, job.snapshot_size, state.after);
+
+  timer.tock();
+  state.smooth_time = timer.elapsedTime() - state.render_time - state.metric_time;
+
+  timer.tick();
+    MeshMetrics::Result result = state.metrics.compute(mesh);
+    state.rms_error = result.rms_error;
+    state.max_error = result.max_error;
+    state.hausdorff_distance = result.hausdorff_distance;
+  timer.tock();
+  state.metric_time += timer.elapsedTime();
+}
+
+// Save the smoothed mesh.
+void
+saveStage(JobState & state)
+{
+  std::string log_path = FilePath::changeExtension(state.job.out_path, "metrics.jsonl");
+
+  Stopwatch timer;
+  timer.tick();
+    state.ok = state.mesh.save(state.job.out_path);
+    if (!state.ok)
+      state.error = "could not save '" + state.job.out_path + '\'';
+
+    if (state.ok && state.job.log_metrics)
+    {
+      std::ofstream out(log_path.c_str());
+      for (size_t i = 0; i < state.log.size(); ++i)
+        out << state.log[i] << '\n';
+
+      state.ok = (bool)out;
+      if (!state.ok)
+        state.error = "could not save '" + log_path + '\'';
+    }
+
+    // Image::save() throws on failure
+    if (state.ok && state.job.snapshot_size > 0)
+    {
+      state.before.save(FilePath::changeExtension(state.job.out_path, "before.png"));
+      state.after.save(FilePath::changeExtension(state.job.out_path, "after.png"));
+    }
+  timer.tock();
+  state.save_time = timer.elapsedTime();
+}
+
+} // namespace BatchInternal
+
+bool
+Batch::run(std::string const & job_list_path, long num_threads)
+{
+  using namespace BatchInternal;
+
+  std::vector<Job> jobs;
+  if (!readJobList(job_list_path, jobs))
+    return false;
+
+  if (num_threads < 0)
+    num_threads = System::concurrency();
+
+  num_threads = std::max(num_threads, 1L);
+  long num_io_threads = 2;
+  long max_in_flight = num_threads + num_io_threads;  // enough to keep every thread busy
+
+  DGP_CONSOLE << "Running " << jobs.size() << " job(s) from '" << job_list_path << "' on " << num_threads
+              << " compute thread(s) and " << num_io_threads << " I/O thread(s)";
+
+  std::vector< std::unique_ptr<JobState> > states(jobs.size());
+  std::mutex mutex;
+  std::condition_variable job_finished;
+  long num_in_flight = 0, num_finished = 0, num_failed = 0, num_skipped = 0;
+  double total_stage_time = 0;
+
+  // Called when a job leaves the pipeline, successfully or not
+  auto finish = [&](size_t i)
+  {
+    JobState & state = *states[i];
+    std::string name = FilePath::objectName(state.job.in_path);
+    if (state.ok)
+    {
+      DGP_CONSOLE << "Job " << i + 1 << " (" << name << " -> " << state.job.out_path << "): "
+                  << state.mesh.numVertices() << " vertices, " << state.mesh.numFaces() << " faces, "
+                  << state.num_passes << " pass(es); load "
+                  << 1000 * state.load_time << " ms, smooth " << 1000 * state.smooth_time << " ms, render "
+                  << 1000 * state.render_time << " ms, metric " << 1000 * state.metric_time << " ms, save "
+                  << 1000 * state.save_time << " ms; RMS error "
+                  << state.rms_error << ", max error " << state.max_error << ", Hausdorff distance "
+                  << state.hausdorff_distance;
+    }
+    else
+      DGP_ERROR << "Job " << i + 1 << " (" << name << ", line " << state.job.line << ") failed: " << state.error;
+
+    std::lock_guard<std::mutex> guard(mutex);
+    if (!state.ok) num_failed++;
+    total_stage_time += state.load_time + state.smooth_time + state.render_time + state.metric_time
+                      + state.save_time;
+    states[i].reset();  // free the mesh
+    num_in_flight--;
+    num_finished++;
+    job_finished.notify_all();
+  };
+
+  Stopwatch wall_timer;
+  wall_timer.tick();
+
+  {
+    // Declared after the shared state above, so the workers are joined before it is destroyed
+    ThreadPool io_pool(num_io_threads);
+    ThreadPool compute_pool(num_threads);
+
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+      if (jobs[i].algorithm != ALGORITHM)
+      {
+        DGP_CONSOLE << "Job " << i + 1 << " (line " << jobs[i].line << ") skipped: the " << jobs[i].algorithm
+                    << " algorithm is run by the " << jobs[i].algorithm << " build";
+
+        std::lock_guard<std::mutex> guard(mutex);
+        num_skipped++;
+        num_finished++;
+        continue;
+      }
+
+      // Bound the number of meshes in memory
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        job_finished.wait(lock, [&]() { return num_in_flight < max_in_flight; });
+        num_in_flight++;
+      }
+
+      states[i].reset(new JobState);
+      states[i]->job = jobs[i];
+
+      io_pool.enqueue([&, i]()
+      {
+        JobState & state = *states[i];
+        try { loadStage(state); }
+        catch (std::exception & e) { state.ok = false; state.error = e.what(); }
+
+        if (!state.ok) { finish(i); return; }
+
+        compute_pool.enqueue([&, i]()
+        {
+          JobState & state = *states[i];
+          try { smoothStage(state); }
+          catch (std::exception & e) { state.ok = false; state.error = e.what(); }
+
+          if (!state.ok) { finish(i); return; }
+
+          io_pool.enqueue([&, i]()
+          {
+            JobState & state = *states[i];
+            try { saveStage(state); }
+            catch (std::exception & e) { state.ok = false; state.error = e.what(); }
+
+            finish(i);
+          });
+        });
+      });
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    job_finished.wait(lock, [&]() { return num_finished == (long)jobs.size(); });
+  }
+
+  wall_timer.tock();
+
+  DGP_CONSOLE << "Finished " << jobs.size() - num_skipped << " job(s) (" << num_failed << " failed, " << num_skipped
+              << " skipped) in " << wall_timer.elapsedTime() << " s; the stages took " << total_stage_time
+              << " s in total, " << (wall_timer.elapsedTime() > 0 ? total_stage_time / wall_timer.elapsedTime() : 0)
+              << "x the wall time";
+
+  return num_failed == 0;
+}
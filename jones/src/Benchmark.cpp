@@ -0,0 +1,3051 @@
+#include "Benchmark.hpp"
+#include "FaceGeometryCache.hpp"
+#include "Mesh.hpp"
+#include "MeshLaplacian.hpp"
+#include "MeshMetrics.hpp"
+#include "MeshRasterizer.hpp"
+#include "MeshStatistics.hpp"
+#include "TiledMesh.hpp"
+#include "DGP/Graphics/GLCaps.hpp"
+#include "DGP/Graphics/RenderSystem.hpp"
+#include "DGP/Camera.hpp"
+#include "DGP/ConjugateGradient.hpp"
+#include "DGP/CounterRandom.hpp"
+#include "DGP/PointHashGrid3.hpp"
+#include "DGP/PointKDTree3.hpp"
+#include "DGP/RandomStreams.hpp"
+#include "DGP/SVD.hpp"
+#include "DGP/SparseTriplets.hpp"
+#include "DGP/FileSystem.hpp"
+#include "DGP/GaussianWeights.hpp"
+#include "DGP/Image.hpp"
+#include "DGP/MappedMatrix.hpp"
+#include "DGP/Matrix3.hpp"
+#include "DGP/Matrix3Batch.hpp"
+#include "DGP/Stopwatch.hpp"
+#include "DGP/TriangleBVH3.hpp"
+#include "DGP/System.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <random>
+
+#ifdef DGP_OSX
+#  include <GLUT/glut.h>
+#else
+#  include <GL/glut.h>
+#endif
+
+// Reference mollification over the linked mesh elements, as Mesh::mollify did before the compact core.
+void
+listMollify(Mesh & mesh, double sigma_f, double sigma_c)
+{
+  std::list<MeshFace *> neigh;
+
+  for (Mesh::VertexIterator it = mesh.verticesBegin(); it != mesh.verticesEnd(); ++it)
+  {
+    neigh = it->findNeighbourPlanes(sigma_c);
+    it->isCovered = false;
+
+    Vector3 sum(0,0,0);
+    double normalizer = 0;
+    for (std::list<MeshFace *>::iterator i = neigh.begin(); i != neigh.end(); ++i)
+    {
+      Vector3 centroid = (*i)->getCentroid();
+      double t = (it->getPosition() - centroid).length();
+      double wc = exp((-t*t)/(2*sigma_f*sigma_f));
+      sum += wc*centroid;
+      normalizer += wc;
+      (*i)->isCovered = false;
+    }
+
+    it->setNormal(sum/normalizer);
+  }
+}
+
+// Reference smoothing pass over the linked mesh elements, as Mesh::bilateralSmooth did before the compact core, with face
+// planes fitted by Matrix3Batch as the core now fits them.
+void
+listBilateralSmooth(Mesh & mesh, double sigma_c, double sigma_s)
+{
+  std::list<MeshFace *> neighbourPlanes;
+
+  listMollify(mesh, sigma_s/2, sigma_c);
+
+  for (Mesh::VertexIterator p = mesh.verticesBegin(); p != mesh.verticesEnd(); ++p)
+  {
+    neighbourPlanes = p->findNeighbourPlanes(sigma_c);
+    p->isCovered = false;
+
+    Vector3 oldP = p->getPosition();
+    if (!p->hasPrecomputedNormal()) { p->updateNormal(); }
+
+    Vector3 sum(0,0,0);
+    double normalizer = 0;
+    for (std::list<MeshFace *>::iterator i = neighbourPlanes.begin(); i != neighbourPlanes.end(); ++i)
+    {
+      Vector3 centroid = (*i)->getCentroid();
+
+      std::vector<Vector3> points;
+      for (MeshFace::VertexIterator it = (*i)->verticesBegin(); it != (*i)->verticesEnd(); ++it)
+        points.push_back((*it)->getPosition());
+
+      // The least-squares plane, as the core's face cache fits it, so the passes stay comparable
+      Plane3 pl;
+      long point_start[2] = { 0, (long)points.size() };
+      Matrix3Batch::fitPlanes(1, &points[0], point_start, &pl);
+
+      double t = (centroid - oldP).length();
+      double h = pl.distance(oldP);
+      double wc = exp((-t*t)/(2*sigma_s*sigma_s));
+      double ws = exp((-h*h)/(2*sigma_c*sigma_c));
+      sum += wc*ws*centroid;
+      normalizer += wc*ws;
+      (*i)->isCovered = false;
+    }
+
+    p->setPosition(sum/normalizer);
+  }
+}
+
+// Reference noise over the linked mesh elements, as Mesh::noiseMesh did before counter-based generation.
+void
+listNoiseMesh(Mesh & mesh, double sigma)
+{
+  std::default_random_engine generator;
+  std::normal_distribution<double> distribution(0.0, sigma);
+
+  for (Mesh::VertexIterator v = mesh.verticesBegin(); v != mesh.verticesEnd(); ++v)
+  {
+    Vector3 p = v->getPosition();
+    p.set(p.x() + distribution(generator), p.y() + distribution(generator), p.z() + distribution(generator));
+    v->setPosition(p);
+  }
+
+  mesh.updateNormals();
+}
+
+// Reference mean edge length, as Mesh::getAverageDistance() computed it before MeshStatistics: a running mean over the edge
+// list of every vertex, so each edge is visited twice.
+Real
+listAverageDistance(Mesh & mesh)
+{
+  Real total = 0;
+  long n = 1;
+  for (Mesh::VertexIterator v = mesh.verticesBegin(); v != mesh.verticesEnd(); ++v)
+    for (MeshVertex::EdgeIterator i = v->edgesBegin(); i != v->edgesEnd(); ++i, ++n)
+      total += ((v->getPosition() - (*i)->getOtherEndpoint(&(*v))->getPosition()).length() - total) / n;
+
+  return total;
+}
+
+// Reference OFF loader, reading through iostreams and adding faces one at a time, as Mesh::loadOFF did before memory mapping.
+bool
+streamLoadOFF(Mesh & mesh, std::string const & path)
+{
+  std::ifstream in(path.c_str());
+  if (!in)
+    return false;
+
+  mesh.clear();
+
+  std::string magic;
+  long nv, nf, ne;
+  if (!(in >> magic) || magic != "OFF" || !(in >> nv >> nf >> ne) || nv < 0 || nf < 0 || ne < 0)
+    return false;
+
+  std::vector<MeshVertex *> indexed_vertices;
+  Vector3 p;
+  for (long i = 0; i < nv; ++i)
+  {
+    if (!(in >> p[0] >> p[1] >> p[2]))
+      return false;
+
+    indexed_vertices.push_back(mesh.addVertex(p));
+  }
+
+  std::vector<MeshVertex *> face_vertices;
+  long num_face_vertices, vertex_index;
+  for (long i = 0; i < nf; ++i)
+  {
+    if (!(in >> num_face_vertices) || num_face_vertices < 0)
+      return false;
+
+    face_vertices.resize((size_t)num_face_vertices);
+    for (size_t j = 0; j < face_vertices.size(); ++j)
+    {
+      if (!(in >> vertex_index) || vertex_index < 0 || vertex_index >= nv)
+        return false;
+
+      face_vertices[j] = indexed_vertices[(size_t)vertex_index];
+    }
+
+    mesh.addFace(face_vertices.begin(), face_vertices.end());
+  }
+
+  return true;
+}
+
+// Maximum distance between corresponding vertices of two meshes with the same vertex order.
+double
+maxDeviation(Mesh const & m0, Mesh const & m1)
+{
+  double max_dev = 0;
+  Mesh::VertexConstIterator v1 = m1.verticesBegin();
+  for (Mesh::VertexConstIterator v0 = m0.verticesBegin(); v0 != m0.verticesEnd() && v1 != m1.verticesEnd(); ++v0, ++v1)
+    max_dev = std::max(max_dev, (double)(v0->getPosition() - v1->getPosition()).length());
+
+  return max_dev;
+}
+
+// Check that the adjacencies of a mesh are mutually consistent and reference no removed elements.
+bool
+checkTopology(Mesh const & mesh)
+{
+  for (Mesh::FaceConstIterator fi = mesh.facesBegin(); fi != mesh.facesEnd(); ++fi)
+  {
+    if (fi->isRemoved() || fi->numVertices() < 3 || fi->numVertices() != fi->numEdges())
+      return false;
+
+    for (MeshFace::VertexConstIterator fvi = fi->verticesBegin(); fvi != fi->verticesEnd(); ++fvi)
+      if ((*fvi)->isRemoved() || !(*fvi)->hasIncidentFace(&(*fi)))
+        return false;
+
+    for (MeshFace::EdgeConstIterator fei = fi->edgesBegin(); fei != fi->edgesEnd(); ++fei)
+      if ((*fei)->isRemoved() || !(*fei)->hasIncidentFace(&(*fi)))
+        return false;
+  }
+
+  for (Mesh::EdgeConstIterator ei = mesh.edgesBegin(); ei != mesh.edgesEnd(); ++ei)
+  {
+    if (ei->isRemoved())
+      return false;
+
+    for (int i = 0; i < 2; ++i)
+      if (ei->getEndpoint(i)->isRemoved() || !ei->getEndpoint(i)->hasIncidentEdge(&(*ei)))
+        return false;
+  }
+
+  for (Mesh::VertexConstIterator vi = mesh.verticesBegin(); vi != mesh.verticesEnd(); ++vi)
+    if (vi->isRemoved())
+      return false;
+
+  return true;
+}
+
+// Draw a mesh once with fixed-function lighting, so that normals affect the image, and read back the pixels.
+void
+renderFrame(Mesh const & mesh, Graphics::RenderSystem & render_system, bool use_buffers, int width, int height,
+            std::vector<uint8> * pixels = NULL)
+{
+  render_system.clear();
+  mesh.draw(render_system, /* draw_edges = */ false, /* use_vertex_data = */ true, /* send_colors = */ false, use_buffers);
+
+  if (pixels)
+  {
+    pixels->resize((size_t)(4 * width * height));
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &(*pixels)[0]);
+  }
+}
+
+// Count the pixels that differ by more than one level in any channel.
+long
+countDifferentPixels(std::vector<uint8> const & p0, std::vector<uint8> const & p1)
+{
+  long count = 0;
+  for (size_t i = 0; i + 3 < p0.size() && i + 3 < p1.size(); i += 4)
+    for (size_t j = i; j < i + 4; ++j)
+      if (std::abs((int)p0[j] - (int)p1[j]) > 1) { count++; break; }
+
+  return count;
+}
+
+// Check if two 8-bit RGB images have the same dimensions and pixels.
+bool
+sameImage(Image const & a, Image const & b)
+{
+  if (a.getType() != Image::Type::RGB_8U || b.getType() != Image::Type::RGB_8U || a.getWidth() != b.getWidth()
+   || a.getHeight() != b.getHeight())
+    return false;
+
+  for (int y = 0; y < a.getHeight(); ++y)
+    if (std::memcmp(a.getScanLine(y), b.getScanLine(y), (size_t)(3 * a.getWidth())) != 0)
+      return false;
+
+  return true;
+}
+
+// Frame a mesh with a perspective camera as the viewer does, with a square viewport.
+Camera
+frameMesh(Mesh const & mesh)
+{
+  AxisAlignedBox3 const & bbox = mesh.getAABB();
+  Real scale = bbox.getExtent().length();
+  Camera camera;
+  CoordinateFrame3 cframe = camera.getFrame();
+  cframe.setTranslation(bbox.getCenter() - 10 * scale * camera.getLookDirection());
+  camera.set(cframe, Camera::ProjectionType::PERSPECTIVE, -0.1f * scale, 0.1f * scale, -0.1f * scale, 0.1f * scale,
+             1.7f * scale, 1010 * scale, Camera::ProjectedYDirection::UP);
+
+  return camera;
+}
+
+// Pick the vertex under a ray by testing every triangle of every face, for reference. Returns the distance from the hit point
+// to the picked vertex, or a negative value if the mesh is not hit.
+Real
+brutePickVertex(MeshCore const & core, Ray3 const & ray)
+{
+  Real best_time = -1;
+  Vector3 best_vertices[3];
+  for (long f = 0; f < core.numFaces(); ++f)
+  {
+    MeshCore::Index const * fv = core.faceVertices((MeshCore::Index)f);
+    for (int i = 2; i < core.numFaceVertices((MeshCore::Index)f); ++i)
+    {
+      LocalTriangle3 tri(core.getPosition(fv[0]), core.getPosition(fv[i - 1]), core.getPosition(fv[i]));
+      Real t = tri.rayIntersectionTime(ray);
+      if (t >= 0 && (best_time < 0 || t < best_time))
+      {
+        best_time = t;
+        for (int j = 0; j < 3; ++j)
+          best_vertices[j] = tri.getVertex(j);
+      }
+    }
+  }
+
+  if (best_time < 0)
+    return -1;
+
+  Vector3 p = ray.getPoint(best_time);
+  return std::min((best_vertices[0] - p).length(), std::min((best_vertices[1] - p).length(), (best_vertices[2] - p).length()));
+}
+
+// Time picking vertices on a mesh at random screen positions, before and after every vertex moves, and check a sample of the
+// picks against a brute-force search.
+bool
+timePicking(Mesh & mesh, long num_picks, long num_checks)
+{
+  Camera camera = frameMesh(mesh);
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<Real> coord(-0.8f, 0.8f);  // some positions miss the mesh
+  std::vector<Vector2> screen_pos((size_t)num_picks);
+  for (long i = 0; i < num_picks; ++i)
+    screen_pos[(size_t)i] = Vector2(coord(rng), coord(rng));
+
+  long num_mismatches = 0;
+  Stopwatch timer;
+  for (int pass = 0; pass < 2; ++pass)
+  {
+    if (pass == 1)
+    {
+      mesh.noiseMesh(mesh.getStatistics().mean_edge_length / 10);
+
+      // A fresh hierarchy, for comparison with the refit
+      MeshCore & core = mesh.getCore();
+      MeshPicker rebuilt;
+      timer.tick();
+        rebuilt.update(core);
+      timer.tock();
+      DGP_CONSOLE << "  Rebuild after moving every vertex: " << 1000 * timer.elapsedTime() << " ms";
+    }
+
+    // The first pick brings the hierarchy up to date
+    timer.tick();
+      mesh.getPicker();
+    timer.tock();
+    double update_time = timer.elapsedTime();
+
+    long num_hits = 0;
+    timer.tick();
+      for (long i = 0; i < num_picks; ++i)
+        if (mesh.pickVertex(camera, screen_pos[(size_t)i]))
+          num_hits++;
+    timer.tock();
+    double pick_time = timer.elapsedTime() / std::max(num_picks, 1L);
+
+    DGP_CONSOLE << "  " << (pass == 0 ? "Build: " : "Refit: ") << 1000 * update_time << " ms, then "
+                << 1e6 * pick_time << " us/pick (" << num_hits << " of " << num_picks << " hit), "
+                << mesh.getPicker().numBuilds() << " build(s), " << mesh.getPicker().numRefits() << " refit(s) so far";
+
+    // Compare the distance from the hit point to the picked vertex, so ties between vertices don't count as mismatches
+    MeshCore & core = mesh.getCore();
+    double tolerance = 1e-5 * mesh.getStatistics().mean_edge_length;
+    for (long i = 0; i < num_checks && i < num_picks; ++i)
+    {
+      Ray3 ray = MeshPicker::computeRay(camera, screen_pos[(size_t)i]);
+      Real expected = brutePickVertex(core, ray);
+
+      Vector3 hit;
+      MeshPicker const & picker = mesh.getPicker();
+      MeshCore::Index v = picker.pickVertex(ray);
+      if ((v == MeshCore::NONE) != (expected < 0))
+        num_mismatches++;
+      else if (v != MeshCore::NONE && picker.pickFace(ray, &hit) != MeshCore::NONE
+            && std::fabs((core.getPosition(v) - hit).length() - expected) > tolerance)
+        num_mismatches++;
+    }
+  }
+
+  DGP_CONSOLE << "  Mismatches against brute force in " << 2 * std::min(num_checks, num_picks) << " picks: "
+              << num_mismatches;
+  return num_mismatches == 0;
+}
+
+// Pack a mapped matrix into compressed rows through a sorted map, as the CompressedSparseMatrix converting constructor did
+// before bucketing.
+void
+mapCompress(MappedMatrix<double> const & src, MeshLaplacian::Matrix & m)
+{
+  typedef std::map<MappedMatrix<double>::IndexPair, double> EntryMap;
+  EntryMap src_entries;
+  for (MappedMatrix<double>::ConstIterator si = src.begin(); si != src.end(); ++si)
+    if (si->second != 0)
+      src_entries[si->first] = si->second;
+
+  m.resize(src.numRows(), src.numColumns());
+  std::vector<long> & row_start = m.getRowIndices();
+  std::vector<int> & cols = m.getColumnIndices();
+  std::vector<double> & values = m.getValues();
+  cols.resize(src_entries.size());
+  values.resize(src_entries.size());
+
+  long last_row = -1;
+  size_t curr_pos = 0;
+  for (EntryMap::const_iterator ei = src_entries.begin(); ei != src_entries.end(); ++ei, ++curr_pos)
+  {
+    for (long k = last_row + 1; k <= ei->first.first; ++k)
+      row_start[(size_t)k] = (long)curr_pos;
+
+    last_row = std::max(last_row, ei->first.first);
+    cols[curr_pos] = (int)ei->first.second;
+    values[curr_pos] = ei->second;
+  }
+
+  for (long k = last_row + 1; k <= src.numRows(); ++k)
+    row_start[(size_t)k] = (long)curr_pos;
+}
+
+// Add the cotangent Laplacian system of MeshLaplacian as triplets, face by face: four per edge of each triangle of the fan
+// triangulation of a face, and one per corner for its mass.
+void
+laplacianTriplets(MeshCore const & core, double lambda, SparseTriplets<double> & triplets)
+{
+  typedef MeshCore::Index Index;
+
+  triplets.clear();
+  for (long f = 0; f < core.numFaces(); ++f)
+  {
+    Index const * fv = core.faceVertices((Index)f);
+    for (int t = 1; t + 1 < core.numFaceVertices((Index)f); ++t)
+    {
+      Index tri[3] = { fv[0], fv[t], fv[t + 1] };
+      Vector3 p[3] = { core.getPosition(tri[0]), core.getPosition(tri[1]), core.getPosition(tri[2]) };
+      double mass = (double)(p[1] - p[0]).cross(p[2] - p[0]).length() / 6;
+      for (int i = 0; i < 3; ++i)
+      {
+        // The edge opposite corner i
+        int j = (i + 1) % 3, k = (i + 2) % 3;
+        Vector3 u = p[j] - p[i], w = p[k] - p[i];
+        double sin_len = (double)u.cross(w).length();
+        double weight = lambda * 0.5 * (sin_len > 0 ? (double)u.dot(w) / sin_len : 0);
+
+        triplets.add(tri[j], tri[k], -weight);
+        triplets.add(tri[k], tri[j], -weight);
+        triplets.add(tri[j], tri[j], weight);
+        triplets.add(tri[k], tri[k], weight);
+        triplets.add(tri[i], tri[i], mass);
+      }
+    }
+  }
+}
+
+// Check if two compressed row matrices have the same pattern, and values within a tolerance relative to the largest value.
+bool
+sameMatrix(MeshLaplacian::Matrix const & a, MeshLaplacian::Matrix const & b, double tolerance)
+{
+  if (a.getRowIndices() != b.getRowIndices() || a.getColumnIndices() != b.getColumnIndices())
+    return false;
+
+  double max_value = 0, max_diff = 0;
+  for (size_t e = 0; e < a.getValues().size(); ++e)
+  {
+    max_value = std::max(max_value, std::fabs(a.getValues()[e]));
+    max_diff = std::max(max_diff, std::fabs(a.getValues()[e] - b.getValues()[e]));
+  }
+
+  return max_diff <= tolerance * max_value;
+}
+
+// Random symmetric 3x3 matrices Q diag(e) Q^T, 6 values each, with a random rotation Q and eigenvalues e in [-1, 1]. Every
+// third matrix has two eigenvalues equal to within 1e-9, and every third one (offset by one) has a zero eigenvalue, as the
+// covariance of a planar set of points does. The eigenvalues of each matrix are returned in ascending order.
+void
+randomSymmetric(long n, std::vector<double> & sym, std::vector<double> & eigenvalues)
+{
+  std::mt19937 generator(3);
+  std::normal_distribution<double> normal(0.0, 1.0);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+  sym.resize(6 * (size_t)n);
+  eigenvalues.resize(3 * (size_t)n);
+  for (long i = 0; i < n; ++i)
+  {
+    // A random unit quaternion gives a uniformly distributed rotation
+    double w = normal(generator), x = normal(generator), y = normal(generator), z = normal(generator);
+    double len = std::sqrt(w * w + x * x + y * y + z * z);
+    w /= len; x /= len; y /= len; z /= len;
+    double q[3][3] = { { 1 - 2 * (y * y + z * z), 2 * (x * y - w * z), 2 * (x * z + w * y) },
+                       { 2 * (x * y + w * z), 1 - 2 * (x * x + z * z), 2 * (y * z - w * x) },
+                       { 2 * (x * z - w * y), 2 * (y * z + w * x), 1 - 2 * (x * x + y * y) } };
+
+    double * e = &eigenvalues[3 * (size_t)i];
+    e[0] = uniform(generator); e[1] = uniform(generator); e[2] = uniform(generator);
+    if (i % 3 == 1) e[1] = e[0] * (1 + 1e-9);
+    if (i % 3 == 2) e[2] = 0;
+    std::sort(e, e + 3);
+
+    double * s = &sym[6 * (size_t)i];
+    int const rows[6] = { 0, 0, 0, 1, 1, 2 }, cols[6] = { 0, 1, 2, 1, 2, 2 };
+    for (int k = 0; k < 6; ++k)
+      s[k] = q[rows[k]][0] * e[0] * q[cols[k]][0] + q[rows[k]][1] * e[1] * q[cols[k]][1] + q[rows[k]][2] * e[2] * q[cols[k]][2];
+  }
+}
+
+bool
+Benchmark::run(std::string const & name, std::string const & mesh_path)
+{
+  if (name == "core")
+    return benchmarkCore(mesh_path);
+  else if (name == "cache")
+    return benchmarkCache(mesh_path);
+  else if (name == "collapse")
+    return benchmarkCollapse(mesh_path);
+  else if (name == "decimate")
+    return benchmarkDecimate(mesh_path);
+  else if (name == "load")
+    return benchmarkLoad(mesh_path);
+  else if (name == "render")
+    return benchmarkRender(mesh_path);
+  else if (name == "raster")
+    return benchmarkRaster(mesh_path);
+  else if (name == "neighbourhood")
+    return benchmarkNeighbourhood(mesh_path);
+  else if (name == "normals")
+    return benchmarkNormals(mesh_path);
+  else if (name == "weights")
+    return benchmarkWeights(mesh_path);
+  else if (name == "metrics")
+    return benchmarkMetrics(mesh_path);
+  else if (name == "bvh")
+    return benchmarkBVH(mesh_path);
+  else if (name == "pick")
+    return benchmarkPick(mesh_path);
+  else if (name == "noise")
+    return benchmarkNoise(mesh_path);
+  else if (name == "random")
+    return benchmarkRandom(mesh_path);
+  else if (name == "stats")
+    return benchmarkStats(mesh_path);
+  else if (name == "tiled")
+    return benchmarkTiled(mesh_path);
+  else if (name == "fair")
+    return benchmarkFair(mesh_path);
+  else if (name == "assemble")
+    return benchmarkAssemble(mesh_path);
+  else if (name == "matrix3")
+    return benchmarkMatrix3(mesh_path);
+
+  DGP_ERROR << "Unknown benchmark: " << name;
+  return false;
+}
+
+bool
+Benchmark::benchmarkCore(std::string const & mesh_path)
+{
+  Mesh list_mesh, core_mesh;
+  if (!list_mesh.load(mesh_path) || !core_mesh.load(mesh_path))
+    return false;
+
+  double sigma_c = 0.005;  // same parameters as the viewer
+  double sigma_s = 0.05;
+  long nv = list_mesh.numVertices();
+
+  DGP_CONSOLE << "Mesh '" << list_mesh.getName() << "': " << nv << " vertices, " << list_mesh.numFaces() << " faces, sigma_c = "
+              << sigma_c << ", sigma_s = " << sigma_s;
+
+  Stopwatch timer;
+  long list_count = 0;
+  timer.tick();
+    for (Mesh::VertexIterator vi = list_mesh.verticesBegin(); vi != list_mesh.verticesEnd(); ++vi)
+    {
+      std::list<MeshFace *> neighbours = vi->findNeighbourPlanes(sigma_c);
+      for (std::list<MeshFace *>::iterator ni = neighbours.begin(); ni != neighbours.end(); ++ni)
+        (*ni)->isCovered = false;
+
+      list_count += (long)neighbours.size();
+    }
+  timer.tock();
+  double list_gather_time = timer.elapsedTime();
+
+  timer.tick();
+    MeshCore & core = core_mesh.getCore();
+  timer.tock();
+  double build_time = timer.elapsedTime();
+
+  long core_count = 0;
+  timer.tick();
+    MeshCore::Scratch scratch;
+    std::vector<MeshCore::Index> neighbours;
+    for (MeshCore::Index v = 0; v < (MeshCore::Index)core.numVertices(); ++v)
+    {
+      core.findNeighbourFaces(v, 2 * sigma_c, scratch, neighbours);
+      core_count += (long)neighbours.size();
+    }
+  timer.tock();
+  double core_gather_time = timer.elapsedTime();
+
+  timer.tick();
+    listBilateralSmooth(list_mesh, sigma_c, sigma_s);
+  timer.tock();
+  double list_smooth_time = timer.elapsedTime();
+
+  timer.tick();
+    core_mesh.bilateralSmooth(sigma_c, sigma_s);
+  timer.tock();
+  double core_smooth_time = timer.elapsedTime();
+
+  DGP_CONSOLE << "Core build:              " << 1000 * build_time << " ms";
+  DGP_CONSOLE << "Neighbourhoods (list):   " << 1000 * list_gather_time << " ms, " << list_count << " neighbours";
+  DGP_CONSOLE << "Neighbourhoods (core):   " << 1000 * core_gather_time << " ms, " << core_count << " neighbours ("
+              << list_gather_time / std::max(core_gather_time, 1e-9) << "x)";
+  DGP_CONSOLE << "Smoothing pass (list):   " << 1000 * list_smooth_time << " ms";
+  DGP_CONSOLE << "Smoothing pass (core):   " << 1000 * core_smooth_time << " ms ("
+              << list_smooth_time / std::max(core_smooth_time, 1e-9) << "x)";
+  DGP_CONSOLE << "Max deviation list/core: " << maxDeviation(list_mesh, core_mesh);
+
+  return list_count == core_count;
+}
+
+bool
+Benchmark::benchmarkRender(std::string const & mesh_path)
+{
+  // Create a GL context via a GLUT window. Without a display, run under a virtual X server, e.g. with
+  // LIBGL_ALWAYS_SOFTWARE=1 xvfb-run to use Mesa's software renderer.
+  int const WIDTH = 512, HEIGHT = 512;
+  int argc = 1;
+  char arg0[] = "meshdesc";
+  char * argv[] = { arg0, NULL };
+  glutInit(&argc, argv);
+  glutInitDisplayMode(GLUT_SINGLE | GLUT_RGBA | GLUT_DEPTH);
+  glutInitWindowSize(WIDTH, HEIGHT);
+  glutCreateWindow("A2::Benchmark");
+
+  Graphics::RenderSystem render_system("RenderSystem");
+  DGP_CONSOLE << render_system.describeSystem();
+  DGP_CONSOLE << "Vertex buffers in " << (DGP_SUPPORTS(ARB_vertex_buffer_object) ? "GPU" : "main") << " memory";
+
+  // Declared after the render system, so its buffers are released before the render system is destroyed
+  Mesh mesh;
+  if (!mesh.load(mesh_path))
+    return false;
+
+  DGP_CONSOLE << "Mesh '" << mesh.getName() << "': " << mesh.numVertices() << " vertices, " << mesh.numFaces() << " faces";
+
+  glViewport(0, 0, WIDTH, HEIGHT);
+  render_system.setColorClearValue(ColorRGB(0, 0, 0));
+
+  // Frame the mesh as the viewer does
+  AxisAlignedBox3 const & bbox = mesh.getAABB();
+  Real scale = bbox.getExtent().length();
+  Camera camera;
+  CoordinateFrame3 cframe = camera.getFrame();
+  cframe.setTranslation(bbox.getCenter() - 10 * scale * camera.getLookDirection());
+  camera.set(cframe, Camera::ProjectionType::PERSPECTIVE, -0.1f * scale, 0.1f * scale, -0.1f * scale, 0.1f * scale,
+             1.7f * scale, 1010 * scale, Camera::ProjectedYDirection::UP);
+  render_system.setCamera(camera);
+
+  GLfloat const light_dir[] = { 0.3f, 0.5f, 1.0f, 0.0f };
+  glEnable(GL_LIGHTING);
+  glEnable(GL_LIGHT0);
+  glLightfv(GL_LIGHT0, GL_POSITION, light_dir);
+  glEnable(GL_NORMALIZE);
+
+  // Immediate mode sends every face each frame. The buffered path uploads everything on the first frame and nothing after.
+  long const NUM_FRAMES = 20;
+  std::vector<uint8> pixels[2];
+  double frame_time[2];
+  Stopwatch timer;
+  for (int i = 0; i < 2; ++i)
+  {
+    bool use_buffers = (i == 1);
+    renderFrame(mesh, render_system, use_buffers, WIDTH, HEIGHT, &pixels[i]);
+
+    timer.tick();
+      for (long f = 0; f < NUM_FRAMES; ++f)
+        renderFrame(mesh, render_system, use_buffers, WIDTH, HEIGHT);
+
+      glFinish();
+    timer.tock();
+
+    frame_time[i] = std::max(timer.elapsedTime() / NUM_FRAMES, 1e-9);
+    DGP_CONSOLE << (use_buffers ? "Buffered: " : "Immediate: ") << 1000 * frame_time[i] << " ms/frame ("
+                << 1 / frame_time[i] << " fps, " << mesh.numFaces() / frame_time[i] << " faces/s)";
+  }
+
+  long uploaded = mesh.getRenderBuffer().numBytesUploaded();
+  long diff = countDifferentPixels(pixels[0], pixels[1]);
+  DGP_CONSOLE << "Speedup " << frame_time[0] / frame_time[1] << "x; " << uploaded << " bytes uploaded; " << diff
+              << " pixels differ";
+
+  // After smoothing, only the vertex attributes are sent again
+  double d = mesh.getStatistics().mean_edge_length;
+  mesh.bilateralSmooth(d, 2 * d);
+
+  timer.tick();
+    renderFrame(mesh, render_system, true, WIDTH, HEIGHT, &pixels[1]);
+  timer.tock();
+
+  long reuploaded = mesh.getRenderBuffer().numBytesUploaded() - uploaded;
+  long expected = 2 * mesh.numVertices() * (long)sizeof(Vector3);
+  renderFrame(mesh, render_system, false, WIDTH, HEIGHT, &pixels[0]);
+  long smoothed_diff = countDifferentPixels(pixels[0], pixels[1]);
+
+  DGP_CONSOLE << "After smoothing: " << reuploaded << " bytes uploaded (positions and normals are " << expected
+              << " bytes), first frame " << 1000 * timer.elapsedTime() << " ms; " << smoothed_diff << " pixels differ";
+
+  // Edit a range of vertices directly, and send just that range
+  long begin = mesh.numVertices() / 4, end = mesh.numVertices() / 2;
+  Mesh::VertexIterator vi = mesh.verticesBegin();
+  std::advance(vi, begin);
+  for (long i = begin; i < end; ++i, ++vi)
+    vi->setPosition(vi->getPosition() + 0.01f * scale * vi->getNormal());
+
+  mesh.invalidateVertexData(begin, end);
+  uploaded = mesh.getRenderBuffer().numBytesUploaded();
+  renderFrame(mesh, render_system, true, WIDTH, HEIGHT, &pixels[1]);
+  long range_uploaded = mesh.getRenderBuffer().numBytesUploaded() - uploaded;
+  long range_expected = 2 * (end - begin) * (long)sizeof(Vector3);
+  renderFrame(mesh, render_system, false, WIDTH, HEIGHT, &pixels[0]);
+  long edited_diff = countDifferentPixels(pixels[0], pixels[1]);
+
+  DGP_CONSOLE << "After editing vertices " << begin << " to " << end - 1 << ": " << range_uploaded << " bytes uploaded ("
+              << range_expected << " expected); " << edited_diff << " pixels differ";
+
+  // Polygons are split differently in the two paths, so allow a few differing pixels along their diagonals
+  long tolerance = WIDTH * HEIGHT / 1000;
+  return diff <= tolerance && smoothed_diff <= tolerance && edited_diff <= tolerance && reuploaded == expected
+      && range_uploaded == range_expected;
+}
+
+bool
+Benchmark::benchmarkRaster(std::string const & mesh_path)
+{
+  int const WIDTH = 1024, HEIGHT = 1024;
+  long const NUM_FRAMES = 10;
+
+  Mesh mesh;
+  if (!mesh.load(mesh_path))
+    return false;
+
+  DGP_CONSOLE << "Mesh '" << mesh.getName() << "': " << mesh.numVertices() << " vertices, " << mesh.numFaces() << " faces; "
+              << WIDTH << 'x' << HEIGHT << " pixels";
+
+  Camera camera = MeshRasterizer::frameCamera(mesh.getAABB(), WIDTH, HEIGHT);
+  mesh.getCore();  // build outside the timed frames
+
+  // Time the same frames on increasing numbers of threads. The images must not depend on the thread count.
+  Image reference;
+  bool deterministic = true;
+  double single_thread_time = 0;
+  Stopwatch timer;
+  long max_threads = std::max(System::concurrency(), 1L);
+  for (long num_threads = 1; ; num_threads = std::min(2 * num_threads, max_threads))
+  {
+    ThreadPool pool(num_threads - 1);
+    MeshRasterizer::Options options;
+    options.thread_pool = &pool;
+
+    MeshRasterizer rasterizer;
+    MeshRasterizer::Stats stats;
+    Image image(Image::Type::RGB_8U, WIDTH, HEIGHT);
+    rasterizer.render(mesh, camera, image, options, &stats);  // allocate scratch space outside the timed frames
+
+    timer.tick();
+      for (long f = 0; f < NUM_FRAMES; ++f)
+        rasterizer.render(mesh, camera, image, options);
+    timer.tock();
+
+    double frame_time = std::max(timer.elapsedTime() / NUM_FRAMES, 1e-9);
+    if (num_threads == 1)
+    {
+      single_thread_time = frame_time;
+      DGP_CONSOLE << stats.num_triangles << " triangles, " << stats.num_culled << " culled, " << stats.num_bin_entries
+                  << " tile entries, " << stats.num_fragments << " fragments";
+    }
+
+    if (!reference.isValid())
+      reference = image;
+    else if (!sameImage(image, reference))
+      deterministic = false;
+
+    DGP_CONSOLE << num_threads << " thread(s): " << 1000 * frame_time << " ms/frame, " << stats.num_triangles / frame_time
+                << " triangles/s (" << single_thread_time / frame_time << "x 1 thread)";
+
+    if (num_threads >= max_threads)
+      break;
+  }
+
+  DGP_CONSOLE << "Images identical across thread counts: " << (deterministic ? "yes" : "NO");
+
+  // Tile size trades binning work against load balance
+  for (int tile_size = 16; tile_size <= 128; tile_size *= 2)
+  {
+    MeshRasterizer::Options options;
+    options.tile_size = tile_size;
+
+    MeshRasterizer rasterizer;
+    Image image(Image::Type::RGB_8U, WIDTH, HEIGHT);
+    rasterizer.render(mesh, camera, image, options);
+
+    timer.tick();
+      for (long f = 0; f < NUM_FRAMES; ++f)
+        rasterizer.render(mesh, camera, image, options);
+    timer.tock();
+
+    double frame_time = std::max(timer.elapsedTime() / NUM_FRAMES, 1e-9);
+    bool same = sameImage(image, reference);
+    DGP_CONSOLE << tile_size << 'x' << tile_size << " tiles, " << max_threads << " thread(s): " << 1000 * frame_time
+                << " ms/frame; same image: " << (same ? "yes" : "NO");
+
+    deterministic = deterministic && same;
+  }
+
+  // Write the snapshot through the PNG codec and read it back
+  std::string snapshot_path = "./benchmark_raster.png";
+  reference.save(snapshot_path);
+  Image reloaded(snapshot_path);
+  bool round_trip = sameImage(reloaded, reference);
+  DGP_CONSOLE << "Saved '" << snapshot_path << "'; reloaded image identical: " << (round_trip ? "yes" : "NO");
+
+  return deterministic && round_trip;
+}
+
+bool
+Benchmark::benchmarkNormals(std::string const & mesh_path)
+{
+  long const NUM_REPEATS = 10;
+
+  Mesh mesh;
+  if (!mesh.load(mesh_path))
+    return false;
+
+  Real d = mesh.getStatistics().mean_edge_length;
+  mesh.noiseMesh(d / 5);
+
+  MeshCore & core = mesh.getCore();
+  long nv = core.numVertices(), nf = core.numFaces();
+  DGP_CONSOLE << "Mesh '" << mesh.getName() << "': " << nv << " vertices, " << nf << " faces";
+
+  auto normals = [&]() {
+    std::vector<Vector3> result;
+    for (long f = 0; f < nf; ++f) result.push_back(core.getFaceNormal((MeshCore::Index)f));
+    for (long v = 0; v < nv; ++v) result.push_back(core.getNormal((MeshCore::Index)v));
+    return result;
+  };
+
+  // One face, then one vertex, at a time, as the smoothing passes used to
+  Stopwatch timer;
+  timer.tick();
+    for (long i = 0; i < NUM_REPEATS; ++i)
+    {
+      for (long f = 0; f < nf; ++f) core.updateFaceNormal((MeshCore::Index)f);
+      for (long v = 0; v < nv; ++v) core.updateNormal((MeshCore::Index)v);
+    }
+  timer.tock();
+  double element_time = timer.elapsedTime() / NUM_REPEATS;
+  std::vector<Vector3> reference = normals();
+  DGP_CONSOLE << "Per element:                 " << 1000 * element_time << " ms";
+
+  bool identical = true;
+  double bulk_time = 0;
+  long max_threads = std::max(System::concurrency(), 1L);
+  for (long num_threads = 1; ; num_threads = std::min(2 * num_threads, max_threads))
+  {
+    ThreadPool pool(num_threads - 1);
+    timer.tick();
+      for (long i = 0; i < NUM_REPEATS; ++i)
+        core.updateNormals(MeshCore::NormalWeighting::UNIFORM, &pool);
+    timer.tock();
+
+    bulk_time = timer.elapsedTime() / NUM_REPEATS;
+    bool same = (normals() == reference);
+    DGP_CONSOLE << "Bulk, uniform, " << num_threads << " thread(s): " << 1000 * bulk_time << " ms ("
+                << element_time / std::max(bulk_time, 1e-9) << "x), identical: " << (same ? "yes" : "NO");
+
+    identical = identical && same;
+    if (num_threads >= max_threads)
+      break;
+  }
+
+  // Weighted normals, and how far they turn from the uniform ones
+  MeshCore::NormalWeighting const WEIGHTINGS[] = { MeshCore::NormalWeighting::AREA, MeshCore::NormalWeighting::ANGLE };
+  char const * const WEIGHTING_NAMES[] = { "area:  ", "angle: " };
+  for (size_t w = 0; w < sizeof(WEIGHTINGS) / sizeof(WEIGHTINGS[0]); ++w)
+  {
+    timer.tick();
+      for (long i = 0; i < NUM_REPEATS; ++i)
+        core.updateNormals(WEIGHTINGS[w]);
+    timer.tock();
+
+    double sum_angles = 0;
+    for (long v = 0; v < nv; ++v)
+    {
+      double cos_angle = core.getNormal((MeshCore::Index)v).dot(reference[(size_t)(nf + v)]);
+      sum_angles += std::acos(std::min(std::max(cos_angle, -1.0), 1.0));
+    }
+
+    DGP_CONSOLE << "Bulk, " << WEIGHTING_NAMES[w] << "              " << 1000 * timer.elapsedTime() / NUM_REPEATS
+                << " ms, mean deviation from uniform " << Math::radiansToDegrees(sum_angles / std::max(nv, 1L)) << " degrees";
+  }
+
+  // Move a few vertices and refresh only around them
+  core.updateNormals(MeshCore::NormalWeighting::AREA);
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<long> pick(0, std::max(nv - 1, 0L));
+  std::normal_distribution<double> offset(0.0, d / 10);
+  std::vector<MeshCore::Index> moved;
+  for (long i = 0; i < (nv + 99) / 100; ++i)
+  {
+    MeshCore::Index v = (MeshCore::Index)pick(rng);
+    core.setPosition(v, core.getPosition(v) + Vector3((Real)offset(rng), (Real)offset(rng), (Real)offset(rng)));
+    moved.push_back(v);
+  }
+
+  long num_refreshed = 0;
+  timer.tick();
+    for (long i = 0; i < NUM_REPEATS; ++i)
+      num_refreshed = core.updateNormals(&moved[0], (long)moved.size(), MeshCore::NormalWeighting::AREA);
+  timer.tock();
+  std::vector<Vector3> incremental = normals();
+  core.updateNormals(MeshCore::NormalWeighting::AREA);
+  bool incremental_ok = (normals() == incremental);
+  identical = identical && incremental_ok;
+  DGP_CONSOLE << "Incremental, " << moved.size() << " moved vertices: " << 1000 * timer.elapsedTime() / NUM_REPEATS << " ms, "
+              << num_refreshed << " vertex normals refreshed, identical to bulk: " << (incremental_ok ? "yes" : "NO");
+
+  // Compare against a whole smoothing pass
+  core.writeAttributes();
+  timer.tick();
+    mesh.bilateralSmooth(d, d);
+  timer.tock();
+  DGP_CONSOLE << "Smoothing pass:              " << 1000 * timer.elapsedTime() << " ms; bulk normals are "
+              << 100 * bulk_time / std::max(timer.elapsedTime(), 1e-9) << "% of a pass";
+
+  return identical;
+}
+
+bool
+Benchmark::benchmarkWeights(std::string const & mesh_path)
+{
+  long const NUM_REPEATS = 10;
+
+  Mesh mesh;
+  if (!mesh.load(mesh_path))
+    return false;
+
+  Real d = mesh.getStatistics().mean_edge_length;
+  double sigma_c = d, sigma_s = d;
+  mesh.noiseMesh(d / 5);
+
+  // Collect the distances and heights of the neighbours of every vertex, as a smoothing pass sees them
+  MeshCore & core = mesh.getCore();
+  MeshCore::Scratch scratch;
+  std::vector<MeshCore::Index> neighbours;
+  std::vector<float> sq_dist, height;
+  for (MeshCore::Index v = 0; v < (MeshCore::Index)core.numVertices(); ++v)
+  {
+    core.findNeighbourVertices(v, 2 * sigma_c, scratch, neighbours);
+    for (size_t i = 0; i < neighbours.size(); ++i)
+    {
+      Vector3 diff = core.getPosition(neighbours[i]) - core.getPosition(v);
+      sq_dist.push_back(diff.squaredLength());
+      height.push_back(core.getNormal(v).dot(diff));
+    }
+  }
+
+  long n = (long)sq_dist.size();
+  float a = (float)(1 / (2 * sigma_c * sigma_c)), b = (float)(1 / (2 * sigma_s * sigma_s));
+  DGP_CONSOLE << "Mesh '" << mesh.getName() << "': " << core.numVertices() << " vertices, " << n << " neighbours; best "
+              << "instruction set: " << GaussianWeights::name(GaussianWeights::supported());
+
+  // Two exponentials per weight in double precision, as the smoothing passes compute them by default
+  std::vector<double> exact((size_t)n);
+  Stopwatch timer;
+  timer.tick();
+    for (long r = 0; r < NUM_REPEATS; ++r)
+      for (long i = 0; i < n; ++i)
+        exact[(size_t)i] = std::exp(-(double)sq_dist[(size_t)i] / (2 * sigma_c * sigma_c))
+                         * std::exp(-(double)height[(size_t)i] * height[(size_t)i] / (2 * sigma_s * sigma_s));
+  timer.tock();
+  double exact_time = std::max(timer.elapsedTime() / NUM_REPEATS, 1e-9);
+  DGP_CONSOLE << "Double precision:  " << 1e9 * exact_time / std::max(n, 1L) << " ns/weight";
+
+  bool accurate = true;
+  std::vector<float> weights((size_t)n);
+  for (int s = GaussianWeights::InstructionSet::SCALAR; s <= (int)GaussianWeights::supported(); ++s)
+  {
+    GaussianWeights::InstructionSet set(s);
+    timer.tick();
+      for (long r = 0; r < NUM_REPEATS; ++r)
+        GaussianWeights::evaluate(set, n, &sq_dist[0], &height[0], a, b, &weights[0]);
+    timer.tock();
+    double batch_time = std::max(timer.elapsedTime() / NUM_REPEATS, 1e-9);
+
+    // Error relative to the bound, for weights whose exponent is not clamped
+    double max_ratio = 0;
+    for (long i = 0; i < n; ++i)
+    {
+      double exponent = -((double)a * sq_dist[(size_t)i] + (double)b * height[(size_t)i] * height[(size_t)i]);
+      if (exponent < -87)
+        continue;
+
+      double rel_error = std::fabs(weights[(size_t)i] - exact[(size_t)i]) / exact[(size_t)i];
+      max_ratio = std::max(max_ratio, rel_error / GaussianWeights::maxRelativeError(exponent));
+    }
+
+    DGP_CONSOLE << GaussianWeights::name(set) << ":" << std::string(17 - std::strlen(GaussianWeights::name(set)), ' ')
+                << 1e9 * batch_time / std::max(n, 1L) << " ns/weight (" << exact_time / batch_time << "x), max error "
+                << max_ratio << " of bound";
+
+    accurate = accurate && (max_ratio <= 1);
+  }
+
+  // Compare whole passes on each instruction set against the default double-precision pass. This is for information only: the
+  // in-place passes feed every result into later neighbourhood searches, so a tiny difference can move a neighbour across the
+  // search radius and change a few vertices by much more than the error of the weights.
+  auto positions = [&]() {
+    std::vector<Vector3> result;
+    for (Mesh::VertexConstIterator vi = mesh.verticesBegin(); vi != mesh.verticesEnd(); ++vi)
+      result.push_back(vi->getPosition());
+    return result;
+  };
+
+  std::vector<Vector3> noisy = positions();
+  auto reset = [&]() {
+    MeshCore & c = mesh.getCore();
+    for (size_t v = 0; v < noisy.size(); ++v)
+      c.setPosition((MeshCore::Index)v, noisy[v]);
+
+    c.writeAttributes();
+  };
+
+  timer.tick();
+    mesh.bilateralSmooth(sigma_c, sigma_s);
+  timer.tock();
+  double exact_pass_time = std::max(timer.elapsedTime(), 1e-9);
+  std::vector<Vector3> reference = positions();
+  DGP_CONSOLE << "Pass, double precision: " << 1000 * exact_pass_time << " ms";
+
+  Mesh::SmoothingOptions options;
+  options.fast_weights = true;
+  GaussianWeights::InstructionSet old_limit = GaussianWeights::active();
+  for (int s = GaussianWeights::InstructionSet::SCALAR; s <= (int)GaussianWeights::supported(); ++s)
+  {
+    GaussianWeights::InstructionSet set = GaussianWeights::setLimit(GaussianWeights::InstructionSet(s));
+    reset();
+
+    timer.tick();
+      mesh.bilateralSmooth(sigma_c, sigma_s, options);
+    timer.tock();
+
+    std::vector<Vector3> result = positions();
+    double max_dev = 0, sum_sq_dev = 0;
+    for (size_t v = 0; v < result.size(); ++v)
+    {
+      double dev = (result[v] - reference[v]).length();
+      max_dev = std::max(max_dev, dev);
+      sum_sq_dev += dev * dev;
+    }
+
+    DGP_CONSOLE << "Pass, " << GaussianWeights::name(set) << ": " << 1000 * timer.elapsedTime() << " ms ("
+                << exact_pass_time / std::max(timer.elapsedTime(), 1e-9) << "x), deviation in edge lengths: RMS "
+                << std::sqrt(sum_sq_dev / std::max(result.size(), (size_t)1)) / d << ", max " << max_dev / d;
+  }
+
+  GaussianWeights::setLimit(old_limit);
+
+  DGP_CONSOLE << "Weights within error bound: " << (accurate ? "yes" : "NO");
+  return accurate;
+}
+
+bool
+Benchmark::benchmarkMetrics(std::string const & mesh_path)
+{
+  long const NUM_REPEATS = 5;
+  long const NUM_CHECKS = 500;
+
+  Mesh mesh;
+  if (!mesh.load(mesh_path))
+    return false;
+
+  MeshMetrics metrics;
+  Stopwatch timer;
+  timer.tick();
+    metrics.setReference(mesh);
+  timer.tock();
+  DGP_CONSOLE << "Mesh '" << mesh.getName() << "': " << mesh.numVertices() << " vertices, " << mesh.numFaces()
+              << " faces; reference set up in " << 1000 * timer.elapsedTime() << " ms";
+
+  // The reference measured against itself
+  MeshMetrics::Result self = metrics.compute(mesh);
+  // Projecting a vertex onto the plane of its own triangle may leave a tiny rounding error
+  bool self_ok = (self.rms_error == 0 && self.max_normal_deviation == 0
+               && self.hausdorff_distance <= 1e-6 * self.reference_diagonal);
+  DGP_CONSOLE << "Against itself: " << self.toJSON() << (self_ok ? "" : " (NOT ZERO)");
+
+  Real d = mesh.getStatistics().mean_edge_length;
+  mesh.noiseMesh(d / 5);
+  MeshCore & core = mesh.getCore();
+  long nv = core.numVertices();
+
+  // As the viewer used to measure: reload the reference from disk and compare positions serially
+  timer.tick();
+    double serial_rms = 0;
+    for (long i = 0; i < NUM_REPEATS; ++i)
+    {
+      Mesh ref;
+      if (!ref.load(mesh_path))
+        return false;
+
+      double sum_sqdist = 0;
+      Mesh::VertexConstIterator ri = ref.verticesBegin();
+      for (Mesh::VertexConstIterator vi = mesh.verticesBegin(); vi != mesh.verticesEnd(); ++vi, ++ri)
+        sum_sqdist += (vi->getPosition() - ri->getPosition()).squaredLength();
+
+      serial_rms = std::sqrt(sum_sqdist / std::max(nv, 1L));
+    }
+  timer.tock();
+  double reload_time = timer.elapsedTime() / NUM_REPEATS;
+  DGP_CONSOLE << "Reload and compare serially: " << 1000 * reload_time << " ms, RMS error " << serial_rms;
+
+  MeshMetrics::Options options;
+  MeshMetrics::Result result;
+  bool deterministic = true;
+  std::string first_json;
+  long max_threads = std::max(System::concurrency(), 1L);
+  for (long num_threads = 1; ; num_threads = std::min(2 * num_threads, max_threads))
+  {
+    ThreadPool pool(num_threads - 1);
+    options.thread_pool = &pool;
+
+    options.surface_distances = false;
+    timer.tick();
+      for (long i = 0; i < NUM_REPEATS; ++i)
+        result = metrics.compute(core, options);
+    timer.tock();
+    double vertex_time = timer.elapsedTime() / NUM_REPEATS;
+
+    options.surface_distances = true;
+    timer.tick();
+      for (long i = 0; i < NUM_REPEATS; ++i)
+        result = metrics.compute(core, options);
+    timer.tock();
+    double full_time = timer.elapsedTime() / NUM_REPEATS;
+
+    DGP_CONSOLE << num_threads << " thread(s): per-vertex " << 1000 * vertex_time << " ms, with surface distances "
+                << 1000 * full_time << " ms (" << reload_time / std::max(full_time, 1e-9) << "x)";
+
+    std::string json = result.toJSON();
+    if (first_json.empty()) first_json = json;
+    deterministic = deterministic && (json == first_json);
+
+    if (num_threads >= max_threads)
+      break;
+  }
+
+  DGP_CONSOLE << "Metrics: " << result.toJSON();
+
+  // Check distances to the reference surface against a brute-force search over all reference triangles, for a sample of
+  // vertices. The same closest-point routine is used, so the distances should match exactly.
+  Mesh ref;
+  if (!ref.load(mesh_path))
+    return false;
+
+  MeshCore & ref_core = ref.getCore();
+  std::vector<LocalTriangle3> ref_triangles;
+  for (long f = 0; f < ref_core.numFaces(); ++f)
+  {
+    MeshCore::Index const * fv = ref_core.faceVertices((MeshCore::Index)f);
+    for (int i = 2; i < ref_core.numFaceVertices((MeshCore::Index)f); ++i)
+      ref_triangles.push_back(LocalTriangle3(ref_core.getPosition(fv[0]), ref_core.getPosition(fv[i - 1]),
+                                             ref_core.getPosition(fv[i])));
+  }
+
+  TriangleBVH3 bvh;
+  timer.tick();
+    bvh.build(ref_triangles.empty() ? NULL : &ref_triangles[0], (long)ref_triangles.size());
+  timer.tock();
+  DGP_CONSOLE << "Hierarchy over " << ref_triangles.size() << " triangles built in " << 1000 * timer.elapsedTime() << " ms";
+
+  long num_mismatches = 0;
+  double brute_time = 0, bvh_time = 0;
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<long> pick(0, std::max(nv - 1, 0L));
+  for (long i = 0; i < NUM_CHECKS && nv > 0; ++i)
+  {
+    Vector3 p = core.getPosition((MeshCore::Index)pick(rng));
+
+    timer.tick();
+      Real brute_sqdist = std::numeric_limits<Real>::max();
+      for (size_t t = 0; t < ref_triangles.size(); ++t)
+        brute_sqdist = std::min(brute_sqdist, (ref_triangles[t].closestPoint(p) - p).squaredLength());
+    timer.tock();
+    brute_time += timer.elapsedTime();
+
+    Vector3 closest;
+    Real sqdist = -1;
+    timer.tick();
+      bvh.closestPoint(p, closest, sqdist);
+    timer.tock();
+    bvh_time += timer.elapsedTime();
+
+    if (sqdist != brute_sqdist)
+      num_mismatches++;
+  }
+
+  DGP_CONSOLE << "Closest points for " << NUM_CHECKS << " vertices: brute force " << 1e6 * brute_time / NUM_CHECKS
+              << " us/query, hierarchy " << 1e6 * bvh_time / NUM_CHECKS << " us/query ("
+              << brute_time / std::max(bvh_time, 1e-9) << "x), mismatches: " << num_mismatches;
+
+  bool rms_ok = (std::fabs(result.rms_error - serial_rms) <= 1e-5 * std::max(serial_rms, 1e-30));
+  DGP_CONSOLE << "RMS error matches serial comparison: " << (rms_ok ? "yes" : "NO") << ", same on every thread count: "
+              << (deterministic ? "yes" : "NO");
+
+  return self_ok && rms_ok && deterministic && num_mismatches == 0;
+}
+
+bool
+Benchmark::benchmarkBVH(std::string const & mesh_path)
+{
+  long const NUM_REPEATS = 5;
+  long const NUM_QUERIES = 20000;
+  long const NUM_CHECKS = 300;
+
+  Mesh mesh;
+  if (!mesh.load(mesh_path))
+    return false;
+
+  MeshCore & core = mesh.getCore();
+  std::vector<uint32> indices;
+  std::vector<LocalTriangle3> triangles;
+  for (long f = 0; f < core.numFaces(); ++f)
+  {
+    MeshCore::Index const * fv = core.faceVertices((MeshCore::Index)f);
+    for (int i = 2; i < core.numFaceVertices((MeshCore::Index)f); ++i)
+    {
+      indices.push_back(fv[0]); indices.push_back(fv[i - 1]); indices.push_back(fv[i]);
+      triangles.push_back(LocalTriangle3(core.getPosition(fv[0]), core.getPosition(fv[i - 1]), core.getPosition(fv[i])));
+    }
+  }
+
+  long nt = (long)triangles.size();
+  DGP_CONSOLE << "Mesh '" << mesh.getName() << "': " << core.numVertices() << " vertices, " << nt << " triangles";
+  if (nt <= 0)
+    return false;
+
+  // Build with each split method on increasing numbers of threads. The hierarchy should not depend on the thread count.
+  TriangleBVH3 bvh[2];
+  TriangleBVH3::SplitMethod methods[2] = { TriangleBVH3::SplitMethod::MEDIAN, TriangleBVH3::SplitMethod::SAH };
+  char const * method_names[2] = { "median", "SAH" };
+  bool deterministic = true;
+  long max_threads = std::max(System::concurrency(), 1L);
+  Stopwatch timer;
+  for (int m = 0; m < 2; ++m)
+  {
+    TriangleBVH3::Options options;
+    options.split_method = methods[m];
+    long ref_nodes = -1;
+    Vector3 ref_closest;
+
+    for (long num_threads = 1; ; num_threads = std::min(2 * num_threads, max_threads))
+    {
+      ThreadPool pool(num_threads - 1);
+      options.thread_pool = &pool;
+
+      timer.tick();
+        for (long i = 0; i < NUM_REPEATS; ++i)
+          bvh[m].build(core.getPositions(), &indices[0], nt, options);
+      timer.tock();
+      double build_time = timer.elapsedTime() / NUM_REPEATS;
+
+      DGP_CONSOLE << method_names[m] << " build, " << num_threads << " thread(s): " << 1000 * build_time << " ms ("
+                  << 1e-6 * nt / std::max(build_time, 1e-9) << "M triangles/s), " << bvh[m].numNodes() << " nodes, depth "
+                  << bvh[m].depth();
+
+      // Compare the layout through a query that visits many nodes
+      Vector3 closest;
+      Real sqdist;
+      bvh[m].closestPoint(bvh[m].getBounds().getHigh(), closest, sqdist);
+      if (ref_nodes < 0) { ref_nodes = bvh[m].numNodes(); ref_closest = closest; }
+      deterministic = deterministic && bvh[m].numNodes() == ref_nodes && closest == ref_closest;
+
+      if (num_threads >= max_threads)
+        break;
+    }
+  }
+
+  // Query points and rays around the mesh
+  AxisAlignedBox3 bounds = bvh[1].getBounds();
+  Vector3 center = bounds.getCenter();
+  Real diagonal = bounds.getExtent().length();
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<Real> unit(-1, 1);
+  std::vector<Vector3> points((size_t)NUM_QUERIES);
+  std::vector<Ray3> rays((size_t)NUM_QUERIES);
+  for (long i = 0; i < NUM_QUERIES; ++i)
+  {
+    Vector3 offset(unit(rng), unit(rng), unit(rng));
+    points[(size_t)i] = center + (Real)0.6 * diagonal * offset;
+    Vector3 target = center + (Real)0.2 * diagonal * Vector3(unit(rng), unit(rng), unit(rng));
+    rays[(size_t)i] = Ray3(points[(size_t)i], (target - points[(size_t)i]).unit());
+  }
+
+  Real query_radius = (Real)0.02 * diagonal;
+  std::vector<uint32> found;
+  for (int m = 0; m < 2; ++m)
+  {
+    double sum = 0;  // keeps the queries from being optimized away
+    Vector3 closest;
+    Real sqdist = 0, time = 0;
+
+    timer.tick();
+      for (long i = 0; i < NUM_QUERIES; ++i)
+        if (bvh[m].closestPoint(points[(size_t)i], closest, sqdist) >= 0) sum += sqdist;
+    timer.tock();
+    double closest_time = timer.elapsedTime();
+
+    long num_hits = 0;
+    timer.tick();
+      for (long i = 0; i < NUM_QUERIES; ++i)
+        if (bvh[m].rayCast(rays[(size_t)i], time) >= 0) { sum += time; num_hits++; }
+    timer.tock();
+    double ray_time = timer.elapsedTime();
+
+    long num_found = 0;
+    timer.tick();
+      for (long i = 0; i < NUM_QUERIES; ++i)
+      {
+        Vector3 half(query_radius, query_radius, query_radius);
+        bvh[m].boxQuery(AxisAlignedBox3(points[(size_t)i] - half, points[(size_t)i] + half), found);
+        num_found += (long)found.size();
+      }
+    timer.tock();
+    double box_time = timer.elapsedTime();
+
+    timer.tick();
+      for (long i = 0; i < NUM_QUERIES; ++i)
+      {
+        bvh[m].ballQuery(Ball3(points[(size_t)i], query_radius), found);
+        num_found += (long)found.size();
+      }
+    timer.tock();
+    double ball_time = timer.elapsedTime();
+
+    DGP_CONSOLE << method_names[m] << " queries (us/query): closest point " << 1e6 * closest_time / NUM_QUERIES
+                << ", ray cast " << 1e6 * ray_time / NUM_QUERIES << " (" << num_hits << " hits), box "
+                << 1e6 * box_time / NUM_QUERIES << ", ball " << 1e6 * ball_time / NUM_QUERIES << " (" << num_found
+                << " triangles found, checksum " << sum << ")";
+  }
+
+  // Check each query against a brute-force search over all triangles, on a sample of the queries. The same triangle routines
+  // are used, so the results should match exactly.
+  long num_mismatches = 0;
+  double brute_time = 0;
+  std::vector<uint32> expected;
+  for (long i = 0; i < NUM_CHECKS; ++i)
+  {
+    Vector3 const & p = points[(size_t)i];
+    Ray3 const & ray = rays[(size_t)i];
+    Vector3 half(query_radius, query_radius, query_radius);
+    AxisAlignedBox3 box(p - half, p + half);
+    Ball3 ball(p, query_radius);
+
+    timer.tick();
+      Real brute_sqdist = std::numeric_limits<Real>::max(), brute_time_hit = -1;
+      for (long t = 0; t < nt; ++t)
+      {
+        brute_sqdist = std::min(brute_sqdist, (triangles[(size_t)t].closestPoint(p) - p).squaredLength());
+        Real th = triangles[(size_t)t].rayIntersectionTime(ray);
+        if (th >= 0 && (brute_time_hit < 0 || th < brute_time_hit)) brute_time_hit = th;
+      }
+    timer.tock();
+    brute_time += timer.elapsedTime();
+
+    for (int m = 0; m < 2; ++m)
+    {
+      Vector3 closest;
+      Real sqdist = -1;
+      bvh[m].closestPoint(p, closest, sqdist);
+      if (sqdist != brute_sqdist) num_mismatches++;
+      if (bvh[m].rayIntersectionTime(ray) != brute_time_hit) num_mismatches++;
+      if (bvh[m].rayIntersects(ray) != (brute_time_hit >= 0)) num_mismatches++;
+
+      for (int q = 0; q < 2; ++q)
+      {
+        expected.clear();
+        for (long t = 0; t < nt; ++t)
+          if (q == 0 ? triangles[(size_t)t].intersects(box) : triangles[(size_t)t].intersects(ball))
+            expected.push_back((uint32)t);
+
+        if (q == 0) bvh[m].boxQuery(box, found);
+        else        bvh[m].ballQuery(ball, found);
+
+        std::sort(found.begin(), found.end());
+        if (found != expected) num_mismatches++;
+      }
+    }
+  }
+
+  DGP_CONSOLE << "Brute force: " << 1e6 * brute_time / NUM_CHECKS << " us per closest point and ray cast; mismatches in "
+              << NUM_CHECKS << " checks: " << num_mismatches << ", same hierarchy on every thread count: "
+              << (deterministic ? "yes" : "NO");
+
+  return deterministic && num_mismatches == 0;
+}
+
+bool
+Benchmark::benchmarkPick(std::string const & mesh_path)
+{
+  long const NUM_PICKS = 10000;
+  long const NUM_CHECKS = 100;
+  long const GRID_SIZE = 708;  // a grid of this many squares per side, split into triangles, has about a million faces
+
+  Mesh mesh;
+  if (!mesh.load(mesh_path))
+    return false;
+
+  DGP_CONSOLE << "Mesh '" << mesh.getName() << "': " << mesh.numVertices() << " vertices, " << mesh.numFaces() << " faces";
+  bool ok = timePicking(mesh, NUM_PICKS, NUM_CHECKS);
+
+  // A bumpy height field, to show how picking scales
+  std::vector<Vector3> positions;
+  std::vector<uint32> face_offsets, face_indices;
+  for (long y = 0; y <= GRID_SIZE; ++y)
+    for (long x = 0; x <= GRID_SIZE; ++x)
+      positions.push_back(Vector3(x, y, 3 * std::sin(0.05 * x) * std::cos(0.07 * y)));
+
+  for (long y = 0; y < GRID_SIZE; ++y)
+    for (long x = 0; x < GRID_SIZE; ++x)
+    {
+      uint32 v = (uint32)(y * (GRID_SIZE + 1) + x);
+      uint32 quad[6] = { v, v + 1, v + (uint32)GRID_SIZE + 2, v, v + (uint32)GRID_SIZE + 2, v + (uint32)GRID_SIZE + 1 };
+      for (int i = 0; i < 6; ++i)
+      {
+        if (i % 3 == 0) face_offsets.push_back((uint32)face_indices.size());
+        face_indices.push_back(quad[i]);
+      }
+    }
+
+  face_offsets.push_back((uint32)face_indices.size());
+
+  Mesh grid("Grid");
+  grid.setFromArrays((long)positions.size(), &positions[0], (long)face_offsets.size() - 1, &face_offsets[0],
+                     &face_indices[0]);
+  DGP_CONSOLE << "Grid: " << grid.numVertices() << " vertices, " << grid.numFaces() << " faces";
+  ok = timePicking(grid, NUM_PICKS, NUM_CHECKS / 10) && ok;
+
+  return ok;
+}
+
+bool
+Benchmark::benchmarkNoise(std::string const & mesh_path)
+{
+  long const NUM_REPEATS = 10;
+  long const NUM_CHECKS = 1000;
+  uint64 const SEED = 1234;
+
+  Mesh mesh;
+  if (!mesh.load(mesh_path))
+    return false;
+
+  // Scaled as noiseMesh() scales relative noise, so the relative and absolute runs below get the same sigma
+  double d = mesh.getStatistics().mean_edge_length;
+  double sigma = 0.2 * d;
+  MeshCore & core = mesh.getCore();
+  long nv = core.numVertices();
+  DGP_CONSOLE << "Mesh '" << mesh.getName() << "': " << nv << " vertices, sigma = " << sigma;
+
+  std::vector<Vector3> original(core.getPositions(), core.getPositions() + nv), original_normals;
+  for (long v = 0; v < nv; ++v) original_normals.push_back(core.getNormal((MeshCore::Index)v));
+
+  auto restore = [&]() {
+    std::vector<Vector3> positions = original;
+    core.swapPositions(positions);
+    core.updateNormals();
+    core.writeAttributes();
+  };
+
+  auto positions = [&]() {
+    MeshCore const & c = mesh.getCore();
+    return std::vector<Vector3>(c.getPositions(), c.getPositions() + nv);
+  };
+
+  // Restoring the positions between repeats is not timed
+  Stopwatch timer;
+  auto time = [&](std::function<void ()> const & add_noise) {
+    double total = 0;
+    for (long i = 0; i < NUM_REPEATS; ++i)
+    {
+      restore();
+      timer.tick();
+        add_noise();
+      timer.tock();
+      total += timer.elapsedTime();
+    }
+
+    return total / NUM_REPEATS;
+  };
+
+  // Sequential reference
+  double list_time = time([&]() { listNoiseMesh(mesh, sigma); });
+  DGP_CONSOLE << "Sequential, std::default_random_engine: " << 1000 * list_time << " ms ("
+              << 1e-6 * nv / std::max(list_time, 1e-9) << " M vertices/s)";
+
+  // Each model on increasing numbers of threads, checking the result does not change
+  Mesh::NoiseModel const MODELS[] = { Mesh::NoiseModel::GAUSSIAN, Mesh::NoiseModel::NORMAL, Mesh::NoiseModel::IMPULSE };
+  char const * const MODEL_NAMES[] = { "gaussian", "normal  ", "impulse " };
+  std::vector< std::vector<Vector3> > results;
+  bool identical = true;
+  long max_threads = std::max(System::concurrency(), 1L);
+  for (size_t m = 0; m < sizeof(MODELS) / sizeof(MODELS[0]); ++m)
+  {
+    Mesh::NoiseOptions options;
+    options.model = MODELS[m];
+    options.seed = SEED;
+
+    std::vector<Vector3> reference;
+    for (long num_threads = 1; ; num_threads = std::min(2 * num_threads, max_threads))
+    {
+      ThreadPool pool(num_threads - 1);
+      options.thread_pool = &pool;
+
+      double noise_time = time([&]() { mesh.noiseMesh(sigma, options); });
+      std::vector<Vector3> result = positions();
+      bool same = true;
+      if (reference.empty())
+        reference = result;
+      else
+        same = (result == reference);
+
+      DGP_CONSOLE << "Counter-based, " << MODEL_NAMES[m] << ", " << num_threads << " thread(s): " << 1000 * noise_time
+                  << " ms (" << list_time / std::max(noise_time, 1e-9) << "x, " << 1e-6 * nv / std::max(noise_time, 1e-9)
+                  << " M vertices/s), identical: " << (same ? "yes" : "NO");
+
+      identical = identical && same;
+      if (num_threads >= max_threads)
+        break;
+    }
+
+    results.push_back(reference);
+  }
+
+  // Each vertex's noise is a function of the seed and its index alone
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<long> pick(0, std::max(nv - 1, 0L));
+  long num_mismatches = 0;
+  for (long i = 0; i < NUM_CHECKS && nv > 0; ++i)
+  {
+    long v = pick(rng);
+    Real g[4];
+    CounterRandom::gaussians(SEED, (uint64)v, 0, g);
+    if (results[0][(size_t)v] != original[(size_t)v] + (Real)sigma * Vector3(g[0], g[1], g[2]))
+      num_mismatches++;
+  }
+
+  Mesh::NoiseOptions reseeded;
+  reseeded.seed = SEED + 1;
+  restore();
+  mesh.noiseMesh(sigma, reseeded);
+  bool reseeded_differs = (positions() != results[0]);
+  DGP_CONSOLE << "Per-vertex noise mismatches against the generator: " << num_mismatches << " of " << std::min(NUM_CHECKS, nv)
+              << ", another seed differs: " << (reseeded_differs ? "yes" : "NO");
+
+  // Sample statistics of each model. The tolerances are several standard errors of the estimates.
+  double n = (double)std::max(nv, 1L);
+  bool stats_ok = true;
+
+  double sum = 0, sum_sq = 0;
+  for (long v = 0; v < nv; ++v)
+  {
+    Vector3 e = results[0][(size_t)v] - original[(size_t)v];
+    for (int j = 0; j < 3; ++j) { sum += e[j]; sum_sq += e[j] * e[j]; }
+  }
+
+  double mean = sum / (3 * n), stddev = std::sqrt(sum_sq / (3 * n));
+  bool ok = (std::fabs(mean) <= 5 * sigma / std::sqrt(3 * n) && std::fabs(stddev / sigma - 1) <= 5 / std::sqrt(6 * n) + 0.01);
+  DGP_CONSOLE << "Gaussian: mean " << mean / sigma << " sigma, standard deviation " << stddev / sigma << " sigma: "
+              << (ok ? "ok" : "WRONG");
+  stats_ok = stats_ok && ok;
+
+  double max_off_normal = 0;
+  sum = sum_sq = 0;
+  for (long v = 0; v < nv; ++v)
+  {
+    Vector3 e = results[1][(size_t)v] - original[(size_t)v];
+    Vector3 const & normal = original_normals[(size_t)v];
+    double h = e.dot(normal);
+    max_off_normal = std::max(max_off_normal, (double)(e - (Real)h * normal).length());
+    sum += h;
+    sum_sq += h * h;
+  }
+
+  mean = sum / n;
+  stddev = std::sqrt(sum_sq / n);
+  ok = (std::fabs(mean) <= 5 * sigma / std::sqrt(n) && std::fabs(stddev / sigma - 1) <= 5 / std::sqrt(2 * n) + 0.01
+     && max_off_normal <= 1e-3 * sigma + 1e-6 * mesh.getAABB().getExtent().length());
+  DGP_CONSOLE << "Normal:   mean " << mean / sigma << " sigma, standard deviation " << stddev / sigma
+              << " sigma, max distance off the normal " << max_off_normal / sigma << " sigma: " << (ok ? "ok" : "WRONG");
+  stats_ok = stats_ok && ok;
+
+  double fraction = Mesh::NoiseOptions::defaults().impulse_fraction, max_length_error = 0;
+  long num_moved = 0;
+  Vector3 direction_sum = Vector3::zero();
+  for (long v = 0; v < nv; ++v)
+  {
+    Vector3 e = results[2][(size_t)v] - original[(size_t)v];
+    if (e == Vector3::zero()) continue;
+
+    num_moved++;
+    direction_sum += e / (Real)sigma;
+    max_length_error = std::max(max_length_error, std::fabs(e.length() / sigma - 1));
+  }
+
+  double moved = num_moved / n;
+  ok = (std::fabs(moved - fraction) <= 5 * std::sqrt(fraction * (1 - fraction) / n) && max_length_error <= 1e-2
+     && direction_sum.length() <= 5 * std::sqrt((double)std::max(num_moved, 1L)));
+  DGP_CONSOLE << "Impulse:  " << 100 * moved << "% of vertices moved (expected " << 100 * fraction
+              << "%), max displacement error " << max_length_error << " sigma, mean direction "
+              << direction_sum.length() / std::max(num_moved, 1L) << ": " << (ok ? "ok" : "WRONG");
+  stats_ok = stats_ok && ok;
+
+  // Relative noise is scaled by the mean edge length
+  Mesh::NoiseOptions relative;
+  relative.model = Mesh::NoiseModel::NORMAL;
+  relative.seed = SEED;
+  relative.relative = true;
+  restore();
+  mesh.noiseMesh(0.2, relative);
+  double max_diff = 0;
+  std::vector<Vector3> scaled = positions();
+  for (long v = 0; v < nv; ++v)
+  {
+    Vector3 e0 = results[1][(size_t)v] - original[(size_t)v], e1 = scaled[(size_t)v] - original[(size_t)v];
+    max_diff = std::max(max_diff, (double)(e1 - e0).length());
+  }
+
+  DGP_CONSOLE << "Relative noise of 0.2 mean edge lengths vs absolute noise of 0.2 d: max difference " << max_diff / sigma
+              << " sigma";
+
+  return identical && num_mismatches == 0 && reseeded_differs && stats_ok && max_diff == 0;
+}
+
+bool
+Benchmark::benchmarkRandom(std::string const & mesh_path)
+{
+  (void)mesh_path;  // the generators do not depend on the mesh
+
+  long const NUM_NUMBERS = 1L << 22;
+  long const MAX_THREADS = 64;
+  long const GRAIN = 1L << 14;
+  long const NUM_CHECKS = 1L << 16;
+  uint64 const SEED = 1234;
+
+  std::vector<Real> out((size_t)NUM_NUMBERS);
+  Stopwatch timer;
+
+  // A bulk fill gives the same numbers as calls to uniform() on the same stream, starting from any word of a block
+  bool consistent = true;
+  {
+    CounterRandom a(SEED, 7), b(SEED, 7);
+    a.bits(); b.bits();
+    std::vector<Real> filled((size_t)NUM_CHECKS), called((size_t)NUM_CHECKS);
+    a.fillUniform(-1, 2, &filled[0], NUM_CHECKS - 1);
+    for (long i = 0; i < NUM_CHECKS - 1; ++i) called[(size_t)i] = b.uniform(-1, 2);
+    consistent = (filled == called && a.bits() == b.bits());
+
+    double sum = 0, sum_sq = 0;
+    a.fillGaussian(0, 1, &filled[0], NUM_CHECKS);
+    for (long i = 0; i < NUM_CHECKS; ++i) { sum += filled[(size_t)i]; sum_sq += filled[(size_t)i] * filled[(size_t)i]; }
+
+    double mean = sum / NUM_CHECKS, stddev = std::sqrt(sum_sq / NUM_CHECKS - mean * mean);
+    bool normal = (std::fabs(mean) <= 5 / std::sqrt((double)NUM_CHECKS)
+                && std::fabs(stddev - 1) <= 5 / std::sqrt(2.0 * NUM_CHECKS));
+    DGP_CONSOLE << "Bulk uniform fill matches calls: " << (consistent ? "yes" : "NO") << "; bulk Gaussian fill: mean " << mean
+                << ", standard deviation " << stddev << ": " << (normal ? "ok" : "WRONG");
+
+    consistent = consistent && normal;
+  }
+
+  // Throughput, in millions of numbers per second, with the numbers split among the threads in chunks
+  for (long num_threads = 1; num_threads <= MAX_THREADS; num_threads *= 2)
+  {
+    ThreadPool pool(num_threads - 1);
+    Random shared(1234, true);
+    double rates[5];
+
+    auto time = [&](int path, std::function<void (long, long, long)> const & body) {
+      timer.tick();
+        pool.parallelFor(0, NUM_NUMBERS, [&](long lo, long hi, long t) { body(lo, hi, t); }, GRAIN);
+      timer.tock();
+      rates[path] = 1e-6 * NUM_NUMBERS / std::max(timer.elapsedTime(), 1e-9);
+    };
+
+    // The locked path: every thread draws from one threadsafe generator, as from Random::common()
+    time(0, [&](long lo, long hi, long t) { (void)t; for (long i = lo; i < hi; ++i) out[(size_t)i] = shared.uniform01(); });
+
+    RandomStreams streams(SEED, pool.maxParticipants());
+    time(1, [&](long lo, long hi, long t) {
+      CounterRandom & r = streams[t];
+      for (long i = lo; i < hi; ++i) out[(size_t)i] = r.uniform01();
+    });
+    time(2, [&](long lo, long hi, long t) { streams[t].fillUniform(0, 1, &out[(size_t)lo], hi - lo); });
+    time(3, [&](long lo, long hi, long t) { (void)t; for (long i = lo; i < hi; ++i) out[(size_t)i] = shared.gaussian(0, 1); });
+    time(4, [&](long lo, long hi, long t) { streams[t].fillGaussian(0, 1, &out[(size_t)lo], hi - lo); });
+
+    DGP_CONSOLE << num_threads << " thread(s), M numbers/s: locked uniform " << rates[0] << ", per-thread uniform " << rates[1]
+                << " (" << rates[1] / rates[0] << "x), per-thread fill " << rates[2] << " (" << rates[2] / rates[0]
+                << "x); locked Gaussian " << rates[3] << ", per-thread Gaussian fill " << rates[4] << " ("
+                << rates[4] / rates[3] << "x)";
+  }
+
+  return consistent;
+}
+
+bool
+Benchmark::benchmarkStats(std::string const & mesh_path)
+{
+  long const NUM_REPEATS = 10;
+
+  Mesh mesh;
+  if (!mesh.load(mesh_path))
+    return false;
+
+  DGP_CONSOLE << "Mesh '" << mesh.getName() << "': " << mesh.numVertices() << " vertices, " << mesh.numEdges() << " edges, "
+              << mesh.numFaces() << " faces";
+
+  // The serial incremental mean over the edges of every vertex
+  Real list_mean = 0;
+  Stopwatch timer;
+  timer.tick();
+    for (long i = 0; i < NUM_REPEATS; ++i)
+      list_mean = listAverageDistance(mesh);
+  timer.tock();
+  double list_time = timer.elapsedTime() / NUM_REPEATS;
+  DGP_CONSOLE << "Average distance over vertex edge lists: " << 1000 * list_time << " ms, mean edge length " << list_mean;
+
+  // All statistics in one pass, on increasing numbers of threads
+  MeshCore & core = mesh.getCore();
+  std::string reference;
+  bool identical = true;
+  long max_threads = std::max(System::concurrency(), 1L);
+  for (long num_threads = 1; ; num_threads = std::min(2 * num_threads, max_threads))
+  {
+    ThreadPool pool(num_threads - 1);
+    MeshStatistics stats;
+    timer.tick();
+      for (long i = 0; i < NUM_REPEATS; ++i)
+        stats = MeshStatistics::compute(core, &pool);
+    timer.tock();
+
+    double time = timer.elapsedTime() / NUM_REPEATS;
+    std::string json = stats.toJSON();
+    bool same = true;
+    if (reference.empty())
+      reference = json;
+    else
+      same = (json == reference);
+
+    DGP_CONSOLE << "MeshStatistics, " << num_threads << " thread(s): " << 1000 * time << " ms ("
+                << list_time / std::max(time, 1e-9) << "x), identical: " << (same ? "yes" : "NO");
+
+    identical = identical && same;
+    if (num_threads >= max_threads)
+      break;
+  }
+
+  DGP_CONSOLE << "Statistics: " << reference;
+
+  // Check against the mesh elements
+  MeshStatistics const & stats = mesh.getStatistics();
+  double sum_length = 0, min_length = std::numeric_limits<double>::max(), max_length = 0;
+  long num_boundary = 0, num_nonmanifold = 0;
+  for (Mesh::EdgeConstIterator ei = mesh.edgesBegin(); ei != mesh.edgesEnd(); ++ei)
+  {
+    double length = (ei->getEndpoint(1)->getPosition() - ei->getEndpoint(0)->getPosition()).length();
+    sum_length += length;
+    min_length = std::min(min_length, length);
+    max_length = std::max(max_length, length);
+    if (ei->numFaces() <= 1)     num_boundary++;
+    else if (ei->numFaces() > 2) num_nonmanifold++;
+  }
+
+  std::vector<long> valences;
+  for (Mesh::VertexConstIterator vi = mesh.verticesBegin(); vi != mesh.verticesEnd(); ++vi)
+  {
+    size_t valence = (size_t)vi->numEdges();
+    if (valence >= valences.size()) valences.resize(valence + 1, 0);
+    valences[valence]++;
+  }
+
+  // Fan triangulation of each face, which gives the same area as MeshStatistics for planar faces
+  double area = 0;
+  for (Mesh::FaceConstIterator fi = mesh.facesBegin(); fi != mesh.facesEnd(); ++fi)
+  {
+    std::vector<Vector3> p;
+    for (MeshFace::VertexConstIterator fvi = fi->verticesBegin(); fvi != fi->verticesEnd(); ++fvi)
+      p.push_back((*fvi)->getPosition());
+
+    for (size_t j = 2; j < p.size(); ++j)
+      area += 0.5 * (p[j - 1] - p[0]).cross(p[j] - p[0]).length();
+  }
+
+  long ne = std::max(mesh.numEdges(), 1L);
+  bool matches = (std::fabs(stats.mean_edge_length - sum_length / ne) <= 1e-6 * stats.mean_edge_length
+               && stats.min_edge_length == min_length && stats.max_edge_length == max_length
+               && stats.num_boundary_edges == num_boundary && stats.num_nonmanifold_edges == num_nonmanifold
+               && stats.valence_histogram == valences && std::fabs(stats.surface_area - area) <= 1e-4 * area
+               && stats.bounds.getLow() == mesh.getAABB().getLow() && stats.bounds.getHigh() == mesh.getAABB().getHigh()
+               && stats.min_edge_length <= stats.median_edge_length && stats.median_edge_length <= stats.max_edge_length);
+  DGP_CONSOLE << "Matches the mesh elements: " << (matches ? "yes" : "NO") << "; relative difference of the mean from the "
+              << "incremental average distance: " << std::fabs(stats.mean_edge_length - list_mean) / stats.mean_edge_length;
+
+  // Cached until the mesh changes
+  timer.tick();
+    double cached_mean = mesh.getStatistics().mean_edge_length;
+  timer.tock();
+  double cached_time = timer.elapsedTime();
+
+  mesh.noiseMesh(cached_mean / 5);
+  timer.tick();
+    double noisy_mean = mesh.getStatistics().mean_edge_length;
+  timer.tock();
+
+  bool invalidated = (noisy_mean != cached_mean);
+  DGP_CONSOLE << "Cached statistics: " << 1e6 * cached_time << " us; after adding noise, recomputed in "
+              << 1000 * timer.elapsedTime() << " ms, mean edge length " << noisy_mean << " (changed: "
+              << (invalidated ? "yes" : "NO") << ")";
+
+  return identical && matches && invalidated;
+}
+
+bool
+Benchmark::benchmarkTiled(std::string const & mesh_path)
+{
+  std::string off_path = "./benchmark_tiled.off", tiles_path = "./benchmark_tiled.tiles";
+  std::string smoothed_path = "./benchmark_tiled_smoothed.tiles", out_path = "./benchmark_tiled_smoothed.off";
+
+  // Smooth a noisy copy, written as OFF and reloaded so the tiles and the in-memory mesh start from the same positions
+  Mesh noisy;
+  if (!noisy.load(mesh_path))
+    return false;
+
+  double sigma_c = noisy.getStatistics().mean_edge_length;
+  double sigma_s = sigma_c;
+  noisy.noiseMesh(sigma_c / 5);
+  bool ok = noisy.save(off_path);
+
+  Mesh mesh;
+  ok = ok && mesh.load(off_path);
+  long nv = mesh.numVertices();
+
+  Stopwatch timer;
+  TiledMesh::BuildOptions build_opts;
+  build_opts.vertices_per_tile = std::max(nv / 16, 1L);
+  timer.tick();
+    ok = ok && TiledMesh::build(off_path, tiles_path, 2 * sigma_c, build_opts);
+  timer.tock();
+  double build_time = timer.elapsedTime();
+
+  TiledMesh tiled;
+  if (!ok || !tiled.open(tiles_path))
+  {
+    std::remove(off_path.c_str());
+    std::remove(tiles_path.c_str());
+    return false;
+  }
+
+  DGP_CONSOLE << "Mesh '" << mesh.getName() << "': " << nv << " vertices, sigma_c = " << sigma_c << ", sigma_s = " << sigma_s;
+  DGP_CONSOLE << "Built " << tiled.numTiles() << " tiles in " << 1000 * build_time << " ms, halo " << tiled.getHalo()
+              << ", file " << FileSystem::fileSize(tiles_path) / (1024.0 * 1024.0) << " MB";
+
+  // Tiles see the positions of their halos from the start of the pass instead of updated ones, so the result differs near
+  // tile borders
+  bool deterministic = true;
+  long max_threads = std::max(System::concurrency(), 1L);
+
+  timer.tick();
+    mesh.bilateralSmooth(sigma_c, sigma_s);
+  timer.tock();
+  double memory_time = timer.elapsedTime();
+  DGP_CONSOLE << "Pass in memory: " << 1000 * memory_time << " ms";
+
+  double mean_move = 0;
+  {
+    Mesh::VertexConstIterator vi = mesh.verticesBegin();
+    for (long v = 0; v < nv; ++v, ++vi)
+      mean_move += (vi->getPosition() - tiled.getPosition(v)).length() / std::max(nv, 1L);
+  }
+
+  std::vector<Vector3> reference;
+  for (long num_threads = 1; ok; num_threads = std::min(2 * num_threads, max_threads))
+  {
+    ThreadPool pool(num_threads - 1);
+    TiledMesh::SmoothingOptions tiled_opts;
+    tiled_opts.thread_pool = &pool;
+
+    TiledMesh::SmoothingStats stats;
+    timer.tick();
+      ok = tiled.smooth(smoothed_path, sigma_c, sigma_s, tiled_opts, &stats);
+    timer.tock();
+
+    TiledMesh smoothed;
+    ok = ok && smoothed.open(smoothed_path);
+    if (!ok) break;
+
+    std::vector<Vector3> result((size_t)nv);
+    for (long v = 0; v < nv; ++v)
+      result[(size_t)v] = smoothed.getPosition(v);
+
+    if (reference.empty())
+      reference = result;
+    else if (result != reference)
+      deterministic = false;
+
+    double max_dev = 0, sum_dev = 0;
+    Mesh::VertexConstIterator vi = mesh.verticesBegin();
+    for (long v = 0; v < nv; ++v, ++vi)
+    {
+      double dev = (result[(size_t)v] - vi->getPosition()).length();
+      max_dev = std::max(max_dev, dev);
+      sum_dev += dev;
+    }
+
+    DGP_CONSOLE << "Pass over tiles, " << num_threads << " thread(s): " << 1000 * timer.elapsedTime() << " ms ("
+                << memory_time / std::max(timer.elapsedTime(), 1e-9) << "x in memory), " << stats.num_tiles
+                << " tiles of up to " << stats.max_tile_vertices << " vertices, halo "
+                << (double)stats.total_halo_vertices / std::max(nv, 1L) << " of the mesh, " << stats.max_vertices_in_flight
+                << " vertices in flight, deviation from memory: max " << max_dev << ", mean " << sum_dev / std::max(nv, 1L)
+                << " (mean displacement " << mean_move << ")";
+
+    if (num_threads >= max_threads)
+      break;
+  }
+
+  // The OFF written back must hold the same positions in the same order
+  if (ok)
+  {
+    TiledMesh smoothed;
+    Mesh reloaded;
+    timer.tick();
+      ok = smoothed.open(smoothed_path) && smoothed.saveOFF(out_path);
+    timer.tock();
+
+    ok = ok && reloaded.load(out_path) && reloaded.numVertices() == nv && reloaded.numFaces() == mesh.numFaces();
+    long v = 0;
+    for (Mesh::VertexConstIterator vi = reloaded.verticesBegin(); ok && vi != reloaded.verticesEnd(); ++vi, ++v)
+      ok = (vi->getPosition() == smoothed.getPosition(v));
+
+    DGP_CONSOLE << "Saved as OFF in " << 1000 * timer.elapsedTime() << " ms, reloaded identically: " << (ok ? "yes" : "NO");
+  }
+
+  tiled.close();
+  std::remove(off_path.c_str());
+  std::remove(tiles_path.c_str());
+  std::remove(smoothed_path.c_str());
+  std::remove(out_path.c_str());
+
+  DGP_CONSOLE << "Results identical across thread counts: " << (deterministic ? "yes" : "NO");
+
+  return ok && deterministic;
+}
+
+bool
+Benchmark::benchmarkFair(std::string const & mesh_path)
+{
+  static double const LAMBDA = 10;  // umbrella steps, or squared mean edge lengths for cotangent weights
+  static double const MAX_EXPLICIT_STEP = 0.5;  // largest stable explicit umbrella step
+
+  Mesh mesh;
+  if (!mesh.load(mesh_path))
+    return false;
+
+  DGP_CONSOLE << "Mesh '" << mesh.getName() << "': " << mesh.numVertices() << " vertices, " << mesh.numEdges() << " edges, "
+              << mesh.numFaces() << " faces";
+
+  double mean_edge_length = mesh.getStatistics().mean_edge_length;
+  mesh.noiseMesh(mean_edge_length / 5);
+  mean_edge_length = mesh.getStatistics().mean_edge_length;
+
+  MeshCore & core = mesh.getCore();
+  long nv = core.numVertices();
+  std::vector<double> x0((size_t)(3 * nv));
+  for (long v = 0; v < nv; ++v)
+    for (int j = 0; j < 3; ++j)
+      x0[(size_t)(3 * v + j)] = core.getPosition((MeshCore::Index)v)[j];
+
+  bool ok = true;
+  long max_threads = std::max(System::concurrency(), 1L);
+  Mesh::LaplacianWeighting weightings[] = { Mesh::LaplacianWeighting::UNIFORM, Mesh::LaplacianWeighting::COTANGENT };
+  char const * weighting_names[] = { "uniform", "cotangent" };
+  std::vector<double> implicit_uniform;
+
+  for (int w = 0; w < 2; ++w)
+  {
+    double lambda = LAMBDA;
+    if (weightings[w] == Mesh::LaplacianWeighting::COTANGENT)
+      lambda *= mean_edge_length * mean_edge_length;
+
+    // Assemble and solve on increasing numbers of threads, which must give the same result
+    MeshLaplacian::Matrix ref_matrix;
+    std::vector<double> ref_x, masses;
+    bool identical = true;
+    for (long num_threads = 1; ; num_threads = std::min(2 * num_threads, max_threads))
+    {
+      ThreadPool pool(num_threads - 1);
+      MeshLaplacian::Matrix a;
+      Stopwatch timer;
+      timer.tick();
+        MeshLaplacian::assemble(core, weightings[w], lambda, a, masses, &pool);
+      timer.tock();
+      double assembly_time = timer.elapsedTime();
+
+      std::vector<double> b((size_t)(3 * nv)), x = x0;
+      for (long v = 0; v < nv; ++v)
+        for (int j = 0; j < 3; ++j)
+          b[(size_t)(3 * v + j)] = masses[(size_t)v] * x0[(size_t)(3 * v + j)];
+
+      ConjugateGradient::Options cg_options;
+      cg_options.thread_pool = &pool;
+      timer.tick();
+        ConjugateGradient::Result result = ConjugateGradient::solve(a, 3, &b[0], &x[0], cg_options);
+      timer.tock();
+      double solve_time = timer.elapsedTime();
+
+      bool same = true;
+      if (ref_x.empty())
+      {
+        ref_matrix = a;
+        ref_x = x;
+      }
+      else
+        same = (a.getRowIndices() == ref_matrix.getRowIndices() && a.getColumnIndices() == ref_matrix.getColumnIndices()
+             && a.getValues() == ref_matrix.getValues() && x == ref_x);
+
+      DGP_CONSOLE << weighting_names[w] << ", " << num_threads << " thread(s): assembly " << 1000 * assembly_time
+                  << " ms, solve " << 1000 * solve_time << " ms (" << result.num_iterations << " iterations, residual "
+                  << result.max_residual << ", converged: " << (result.converged ? "yes" : "NO") << "), identical: "
+                  << (same ? "yes" : "NO");
+
+      identical = identical && same && result.converged;
+      if (num_threads >= max_threads)
+        break;
+    }
+
+    // The matrix must be exactly symmetric
+    std::vector<long> const & row_start = ref_matrix.getRowIndices();
+    std::vector<int> const & cols = ref_matrix.getColumnIndices();
+    std::vector<double> const & values = ref_matrix.getValues();
+    bool symmetric = true;
+    for (long i = 0; i < nv && symmetric; ++i)
+      for (long e = row_start[(size_t)i]; e < row_start[(size_t)i + 1]; ++e)
+      {
+        long j = cols[(size_t)e];
+        std::vector<int>::const_iterator begin = cols.begin() + row_start[(size_t)j];
+        std::vector<int>::const_iterator end = cols.begin() + row_start[(size_t)j + 1];
+        std::vector<int>::const_iterator t = std::lower_bound(begin, end, (int)i);
+        if (t == end || *t != (int)i || values[(size_t)(t - cols.begin())] != values[(size_t)e])
+        {
+          symmetric = false;
+          break;
+        }
+      }
+
+    // The true residual, recomputed from the solution
+    std::vector<double> ax((size_t)(3 * nv));
+    ref_matrix.postmulVectors(3, &ref_x[0], &ax[0], ThreadPool::common());
+    double max_residual = 0;
+    for (int j = 0; j < 3; ++j)
+    {
+      double rr = 0, bb = 0;
+      for (long v = 0; v < nv; ++v)
+      {
+        double bv = masses[(size_t)v] * x0[(size_t)(3 * v + j)];
+        rr += (bv - ax[(size_t)(3 * v + j)]) * (bv - ax[(size_t)(3 * v + j)]);
+        bb += bv * bv;
+      }
+
+      max_residual = std::max(max_residual, bb > 0 ? std::sqrt(rr / bb) : 0);
+    }
+
+    bool accurate = (max_residual <= 2 * ConjugateGradient::Options::defaults().tolerance);
+    DGP_CONSOLE << weighting_names[w] << ": " << ref_matrix.numSetElements() << " nonzeros, symmetric: "
+                << (symmetric ? "yes" : "NO") << ", true residual " << max_residual << " (within tolerance: "
+                << (accurate ? "yes" : "NO") << ")";
+
+    ok = ok && identical && symmetric && accurate;
+    if (weightings[w] == Mesh::LaplacianWeighting::UNIFORM)
+      implicit_uniform = ref_x;
+  }
+
+  // Explicit umbrella passes covering the same step, x += dt (mean of neighbours - x), vs the one implicit step
+  long num_passes = (long)std::ceil(LAMBDA / MAX_EXPLICIT_STEP);
+  double dt = LAMBDA / num_passes;
+  std::vector<double> x = x0, x_next((size_t)(3 * nv));
+  Stopwatch timer;
+  timer.tick();
+    for (long pass = 0; pass < num_passes; ++pass)
+    {
+      ThreadPool::common().parallelFor(0, nv, [&](long lo, long hi, long) {
+        for (long v = lo; v < hi; ++v)
+        {
+          MeshCore::Index const * nbrs = core.vertexNeighbours((MeshCore::Index)v);
+          int n = core.numVertexNeighbours((MeshCore::Index)v);
+          for (int j = 0; j < 3; ++j)
+          {
+            double sum = 0;
+            for (int i = 0; i < n; ++i)
+              sum += x[(size_t)(3 * nbrs[i] + j)];
+
+            double xv = x[(size_t)(3 * v + j)];
+            x_next[(size_t)(3 * v + j)] = (n > 0 ? xv + dt * (sum / n - xv) : xv);
+          }
+        }
+      });
+
+      x.swap(x_next);
+    }
+  timer.tock();
+  double explicit_time = timer.elapsedTime();
+
+  double max_deviation = 0;
+  for (long v = 0; v < nv; ++v)
+  {
+    Vector3 d((Real)(x[(size_t)(3 * v)] - implicit_uniform[(size_t)(3 * v)]),
+              (Real)(x[(size_t)(3 * v + 1)] - implicit_uniform[(size_t)(3 * v + 1)]),
+              (Real)(x[(size_t)(3 * v + 2)] - implicit_uniform[(size_t)(3 * v + 2)]));
+    max_deviation = std::max(max_deviation, (double)d.length());
+  }
+
+  DGP_CONSOLE << num_passes << " explicit umbrella passes of " << dt << ": " << 1000 * explicit_time
+              << " ms, max deviation from the implicit step " << max_deviation / mean_edge_length << " mean edge lengths";
+
+  // The whole step through the mesh
+  Mesh::FairingStats stats;
+  timer.tick();
+    bool converged = mesh.fairImplicit(LAMBDA, Mesh::FairingOptions::defaults(), &stats);
+  timer.tock();
+
+  DGP_CONSOLE << "Mesh::fairImplicit (cotangent): " << 1000 * timer.elapsedTime() << " ms (assembly "
+              << 1000 * stats.assembly_time << " ms, solve " << 1000 * stats.solve_time << " ms, " << stats.num_iterations
+              << " iterations), converged: " << (converged ? "yes" : "NO") << ", mean edge length " << mean_edge_length
+              << " -> " << mesh.getStatistics().mean_edge_length;
+
+  return ok && converged;
+}
+
+bool
+Benchmark::benchmarkAssemble(std::string const & mesh_path)
+{
+  static long const NUM_REPEATS = 5;
+
+  Mesh mesh;
+  if (!mesh.load(mesh_path))
+    return false;
+
+  DGP_CONSOLE << "Mesh '" << mesh.getName() << "': " << mesh.numVertices() << " vertices, " << mesh.numEdges() << " edges, "
+              << mesh.numFaces() << " faces";
+
+  double mean_edge_length = mesh.getStatistics().mean_edge_length;
+  double lambda = mean_edge_length * mean_edge_length;
+  MeshCore & core = mesh.getCore();
+  long nv = core.numVertices();
+
+  SparseTriplets<double> triplets(nv, nv);
+  Stopwatch timer;
+  timer.tick();
+    laplacianTriplets(core, lambda, triplets);
+  timer.tock();
+  DGP_CONSOLE << triplets.numTriplets() << " triplets of the cotangent system, generated in " << 1000 * timer.elapsedTime()
+              << " ms";
+
+  // Through maps: accumulate into a mapped matrix, then pack it through a sorted map as before, and with the bucketing
+  // converting constructor
+  MappedMatrix<double> mapped(nv, nv);
+  std::vector<long> const & rows = triplets.getRows();
+  std::vector<long> const & cols = triplets.getColumns();
+  std::vector<double> const & values = triplets.getValues();
+  timer.tick();
+    for (long t = 0; t < triplets.numTriplets(); ++t)
+      mapped.getMutable(rows[(size_t)t], cols[(size_t)t]) += values[(size_t)t];
+  timer.tock();
+  double accumulate_time = timer.elapsedTime();
+
+  MeshLaplacian::Matrix map_matrix;
+  timer.tick();
+    for (long i = 0; i < NUM_REPEATS; ++i)
+      mapCompress(mapped, map_matrix);
+  timer.tock();
+  double map_time = timer.elapsedTime() / NUM_REPEATS;
+
+  MeshLaplacian::Matrix converted;
+  timer.tick();
+    for (long i = 0; i < NUM_REPEATS; ++i)
+      converted = MeshLaplacian::Matrix(mapped);
+  timer.tock();
+  double convert_time = timer.elapsedTime() / NUM_REPEATS;
+
+  bool same_convert = (converted.getRowIndices() == map_matrix.getRowIndices()
+                    && converted.getColumnIndices() == map_matrix.getColumnIndices()
+                    && converted.getValues() == map_matrix.getValues());
+  DGP_CONSOLE << "Accumulating into a mapped matrix: " << 1000 * accumulate_time << " ms; packing its "
+              << mapped.numSetElements() << " elements: sorted map " << 1000 * map_time
+              << " ms, bucketing constructor " << 1000 * convert_time << " ms (" << map_time / std::max(convert_time, 1e-9)
+              << "x), identical: " << (same_convert ? "yes" : "NO");
+
+  // Triplets compressed and refilled on increasing numbers of threads, against direct assembly
+  MeshLaplacian::Matrix direct;
+  std::vector<double> masses;
+  MeshLaplacian::assemble(core, MeshLaplacian::Weighting::COTANGENT, lambda, direct, masses);
+
+  MeshLaplacian::Matrix ref_matrix;
+  bool identical = true;
+  long max_threads = std::max(System::concurrency(), 1L);
+  for (long num_threads = 1; ; num_threads = std::min(2 * num_threads, max_threads))
+  {
+    ThreadPool pool(num_threads - 1);
+    MeshLaplacian::Matrix m;
+    timer.tick();
+      for (long i = 0; i < NUM_REPEATS; ++i)
+        triplets.compress(m, &pool);
+    timer.tock();
+    double compress_time = timer.elapsedTime() / NUM_REPEATS;
+
+    timer.tick();
+      for (long i = 0; i < NUM_REPEATS; ++i)
+        triplets.refill(m, &pool);
+    timer.tock();
+    double refill_time = timer.elapsedTime() / NUM_REPEATS;
+
+    timer.tick();
+      for (long i = 0; i < NUM_REPEATS; ++i)
+        MeshLaplacian::assemble(core, MeshLaplacian::Weighting::COTANGENT, lambda, direct, masses, &pool);
+    timer.tock();
+    double assemble_time = timer.elapsedTime() / NUM_REPEATS;
+
+    timer.tick();
+      for (long i = 0; i < NUM_REPEATS; ++i)
+        MeshLaplacian::update(core, MeshLaplacian::Weighting::COTANGENT, lambda, direct, masses, &pool);
+    timer.tock();
+    double update_time = timer.elapsedTime() / NUM_REPEATS;
+
+    bool same = true;
+    if (ref_matrix.numRows() == 0)
+      ref_matrix = m;
+    else
+      same = (m.getRowIndices() == ref_matrix.getRowIndices() && m.getColumnIndices() == ref_matrix.getColumnIndices()
+           && m.getValues() == ref_matrix.getValues());
+
+    DGP_CONSOLE << num_threads << " thread(s): triplets compressed in " << 1000 * compress_time << " ms ("
+                << (accumulate_time + map_time) / std::max(compress_time, 1e-9) << "x through maps), refilled in "
+                << 1000 * refill_time << " ms; MeshLaplacian assembled in " << 1000 * assemble_time << " ms, updated in "
+                << 1000 * update_time << " ms; identical: " << (same ? "yes" : "NO");
+
+    identical = identical && same;
+    if (num_threads >= max_threads)
+      break;
+  }
+
+  // The triangles are measured from different corners, in the single precision of the positions
+  bool matches_direct = sameMatrix(ref_matrix, direct, 1e-5);
+  DGP_CONSOLE << "Triplets match direct assembly: " << (matches_direct ? "yes" : "NO");
+
+  // After moving the vertices, refills must match building from scratch
+  mesh.noiseMesh(mean_edge_length / 10);
+  laplacianTriplets(core, lambda, triplets);
+  // Assigned, not copy constructed, which would drop elements that are zero
+  MeshLaplacian::Matrix refilled, compressed;
+  refilled = ref_matrix;
+  triplets.refill(refilled);
+  triplets.compress(compressed);
+
+  MeshLaplacian::Matrix updated, assembled;
+  updated = direct;
+  std::vector<double> updated_masses, assembled_masses;
+  MeshLaplacian::update(core, MeshLaplacian::Weighting::COTANGENT, lambda, updated, updated_masses);
+  MeshLaplacian::assemble(core, MeshLaplacian::Weighting::COTANGENT, lambda, assembled, assembled_masses);
+
+  bool refill_ok = (refilled.getValues() == compressed.getValues() && updated.getValues() == assembled.getValues()
+                 && updated_masses == assembled_masses && sameMatrix(compressed, assembled, 1e-5));
+  DGP_CONSOLE << "After moving the vertices, refilled values match a fresh build: " << (refill_ok ? "yes" : "NO");
+
+  return same_convert && identical && matches_direct && refill_ok;
+}
+
+bool
+Benchmark::benchmarkMatrix3(std::string const & mesh_path)
+{
+  static long const NUM_REPEATS = 5;
+  static long const NUM_RANDOM = 100000;
+
+  Mesh mesh;
+  if (!mesh.load(mesh_path))
+    return false;
+
+  MeshCore & core = mesh.getCore();
+  long nv = core.numVertices(), nf = core.numFaces();
+  Real mean_edge_length = mesh.getStatistics().mean_edge_length;
+
+  DGP_CONSOLE << "Mesh '" << mesh.getName() << "': " << nv << " vertices, " << nf << " faces; best instruction set: "
+              << Matrix3Batch::name(Matrix3Batch::supported());
+
+  Stopwatch timer;
+  int num_sets = (int)Matrix3Batch::supported() + 1;
+  bool consistent = true;
+
+  // Check a batched kernel against itself one matrix at a time and on the scalar path. The outputs of every instruction set
+  // must be identical.
+  auto sameOutputs = [](std::vector<double> const & a, std::vector<double> const & b) {
+    return a.size() == b.size() && (a.empty() || std::memcmp(&a[0], &b[0], a.size() * sizeof(double)) == 0);
+  };
+
+  //==========================================================================================================================
+  // Inverses of the 3x3 blocks of vertex quadrics, summed from the planes of the faces around each vertex as decimation sums
+  // them. Vertices on flat or creased regions give (nearly) singular blocks.
+  //==========================================================================================================================
+
+  std::vector<double> blocks(9 * (size_t)nv, 0.0);
+  for (long f = 0; f < nf; ++f)
+  {
+    MeshCore::Index const * fv = core.faceVertices((MeshCore::Index)f);
+    int n = core.numFaceVertices((MeshCore::Index)f);
+    Vector3 const & p0 = core.getPosition(fv[0]);
+    Vector3 cross_sum = Vector3::zero();
+    for (int i = 1; i + 1 < n; ++i)
+      cross_sum += (core.getPosition(fv[i]) - p0).cross(core.getPosition(fv[i + 1]) - p0);
+
+    Vector3 normal = cross_sum.unit();
+    for (int i = 0; i < n; ++i)
+      for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 3; ++c)
+          blocks[9 * (size_t)fv[i] + 3 * r + c] += (double)normal[r] * normal[c];
+  }
+
+  std::vector<double> mn_inverses(9 * (size_t)nv);
+  long mn_accepted = 0;
+  timer.tick();
+    for (long r = 0; r < NUM_REPEATS; ++r)
+    {
+      mn_accepted = 0;
+      for (long v = 0; v < nv; ++v)
+      {
+        double const * b = &blocks[9 * (size_t)v];
+        MatrixMN<3, 3, double> a(b[0], b[1], b[2], b[3], b[4], b[5], b[6], b[7], b[8]);
+        double trace = b[0] + b[4] + b[8];
+        if (trace > 0 && a.invert(1.0e-6 * trace * trace * trace))
+          mn_accepted++;
+
+        for (int k = 0; k < 9; ++k)
+          mn_inverses[9 * (size_t)v + k] = a(k / 3, k % 3);
+      }
+    }
+  timer.tock();
+  double mn_invert_time = std::max(timer.elapsedTime() / NUM_REPEATS, 1e-9);
+  DGP_CONSOLE << "Inverses of " << nv << " quadric blocks, one MatrixMN at a time: " << 1e-6 * nv / mn_invert_time
+              << " M/s, " << mn_accepted << " well-conditioned";
+
+  std::vector<double> ref_inverses, ref_dets;
+  double max_residual = 0;
+  for (int s = 0; s < num_sets; ++s)
+  {
+    Matrix3Batch::InstructionSet set(s);
+    std::vector<double> inverses(9 * (size_t)nv), dets((size_t)nv);
+    timer.tick();
+      for (long r = 0; r < NUM_REPEATS; ++r)
+        Matrix3Batch::invert(set, nv, &blocks[0], &inverses[0], &dets[0]);
+    timer.tock();
+    double batch_time = std::max(timer.elapsedTime() / NUM_REPEATS, 1e-9);
+
+    // Residual |A A^-1 - I| of the inverses that pass the test of the decimation
+    long accepted = 0;
+    for (long v = 0; v < nv; ++v)
+    {
+      double const * b = &blocks[9 * (size_t)v], * inv = &inverses[9 * (size_t)v];
+      double trace = b[0] + b[4] + b[8];
+      if (!(trace > 0) || !(std::fabs(dets[(size_t)v]) > 1.0e-6 * trace * trace * trace))
+        continue;
+
+      accepted++;
+      for (int r = 0; r < 3; ++r)
+        for (int c = 0; c < 3; ++c)
+        {
+          double sum = b[3 * r] * inv[c] + b[3 * r + 1] * inv[3 + c] + b[3 * r + 2] * inv[6 + c];
+          max_residual = std::max(max_residual, std::fabs(sum - (r == c ? 1 : 0)));
+        }
+    }
+
+    if (s == 0)
+    {
+      ref_inverses = inverses;
+      ref_dets = dets;
+    }
+
+    // The same matrices one at a time
+    std::vector<double> single_inverses(9 * (size_t)nv), single_dets((size_t)nv);
+    for (long v = 0; v < nv; ++v)
+      Matrix3Batch::invert(set, 1, &blocks[9 * (size_t)v], &single_inverses[9 * (size_t)v], &single_dets[(size_t)v]);
+
+    bool same = sameOutputs(inverses, ref_inverses) && sameOutputs(dets, ref_dets)
+             && sameOutputs(single_inverses, ref_inverses) && sameOutputs(single_dets, ref_dets);
+    consistent = consistent && same;
+
+    DGP_CONSOLE << "  " << Matrix3Batch::name(set) << ":" << std::string(8 - std::strlen(Matrix3Batch::name(set)), ' ')
+                << 1e-6 * nv / batch_time << " M/s (" << mn_invert_time / batch_time << "x), " << accepted
+                << " well-conditioned, identical to scalar and one at a time: " << (same ? "yes" : "NO");
+  }
+
+  bool inverses_ok = (max_residual <= 1e-8);
+  DGP_CONSOLE << "  Max residual of well-conditioned inverses: " << max_residual;
+
+  //==========================================================================================================================
+  // Eigendecompositions of random symmetric matrices, including repeated and zero eigenvalues
+  //==========================================================================================================================
+
+  std::vector<double> sym, expected;
+  randomSymmetric(NUM_RANDOM, sym, expected);
+
+  timer.tick();
+    for (long i = 0; i < NUM_RANDOM; ++i)
+    {
+      double const * s = &sym[6 * (size_t)i];
+      MatrixMN<3, 3, double> a(s[0], s[1], s[2], s[1], s[3], s[4], s[2], s[4], s[5]), u, v;
+      std::vector<double> d;
+      SVD::compute(a, u, d, v);
+    }
+  timer.tock();
+  double svd_time = std::max(timer.elapsedTime(), 1e-9);
+  DGP_CONSOLE << "Eigendecompositions of " << NUM_RANDOM << " symmetric matrices, SVD one MatrixMN at a time: "
+              << 1e-6 * NUM_RANDOM / svd_time << " M/s";
+
+  std::vector<double> ref_values, ref_vectors;
+  double max_eigen_residual = 0, max_orthogonality = 0, max_value_error = 0;
+  bool ascending = true;
+  for (int s = 0; s < num_sets; ++s)
+  {
+    Matrix3Batch::InstructionSet set(s);
+    std::vector<double> values(3 * (size_t)NUM_RANDOM), vectors(9 * (size_t)NUM_RANDOM);
+    timer.tick();
+      for (long r = 0; r < NUM_REPEATS; ++r)
+        Matrix3Batch::symmetricEigen(set, NUM_RANDOM, &sym[0], &values[0], &vectors[0]);
+    timer.tock();
+    double batch_time = std::max(timer.elapsedTime() / NUM_REPEATS, 1e-9);
+
+    // Residuals |A v - lambda v| and |V^T V - I|, relative to the largest eigenvalue of each matrix
+    for (long i = 0; i < NUM_RANDOM; ++i)
+    {
+      double const * sm = &sym[6 * (size_t)i], * lambda = &values[3 * (size_t)i], * vec = &vectors[9 * (size_t)i];
+      double a[3][3] = { { sm[0], sm[1], sm[2] }, { sm[1], sm[3], sm[4] }, { sm[2], sm[4], sm[5] } };
+      double const * e = &expected[3 * (size_t)i];
+      double scale = std::max(std::max(std::fabs(e[0]), std::fabs(e[2])), 1e-300);
+
+      ascending = ascending && lambda[0] <= lambda[1] && lambda[1] <= lambda[2];
+      for (int k = 0; k < 3; ++k)
+      {
+        max_value_error = std::max(max_value_error, std::fabs(lambda[k] - e[k]) / scale);
+        for (int r = 0; r < 3; ++r)
+        {
+          double av = a[r][0] * vec[3 * k] + a[r][1] * vec[3 * k + 1] + a[r][2] * vec[3 * k + 2];
+          max_eigen_residual = std::max(max_eigen_residual, std::fabs(av - lambda[k] * vec[3 * k + r]) / scale);
+        }
+
+        for (int j = 0; j < 3; ++j)
+        {
+          double dot = vec[3 * k] * vec[3 * j] + vec[3 * k + 1] * vec[3 * j + 1] + vec[3 * k + 2] * vec[3 * j + 2];
+          max_orthogonality = std::max(max_orthogonality, std::fabs(dot - (j == k ? 1 : 0)));
+        }
+      }
+    }
+
+    if (s == 0)
+    {
+      ref_values = values;
+      ref_vectors = vectors;
+    }
+
+    std::vector<double> single_values(3 * (size_t)NUM_RANDOM), single_vectors(9 * (size_t)NUM_RANDOM);
+    for (long i = 0; i < NUM_RANDOM; ++i)
+      Matrix3Batch::symmetricEigen(set, 1, &sym[6 * (size_t)i], &single_values[3 * (size_t)i],
+                                   &single_vectors[9 * (size_t)i]);
+
+    bool same = sameOutputs(values, ref_values) && sameOutputs(vectors, ref_vectors)
+             && sameOutputs(single_values, ref_values) && sameOutputs(single_vectors, ref_vectors);
+    consistent = consistent && same;
+
+    DGP_CONSOLE << "  " << Matrix3Batch::name(set) << ":" << std::string(8 - std::strlen(Matrix3Batch::name(set)), ' ')
+                << 1e-6 * NUM_RANDOM / batch_time << " M/s (" << svd_time / batch_time
+                << "x), identical to scalar and one at a time: " << (same ? "yes" : "NO");
+  }
+
+  bool eigen_ok = ascending && max_eigen_residual <= 1e-12 && max_orthogonality <= 1e-12 && max_value_error <= 1e-12;
+  DGP_CONSOLE << "  Max relative residual " << max_eigen_residual << ", eigenvalue error " << max_value_error
+              << ", deviation from orthonormality " << max_orthogonality << ", ascending: " << (ascending ? "yes" : "NO");
+
+  //==========================================================================================================================
+  // Planes of the faces of the mesh
+  //==========================================================================================================================
+
+  std::vector<Vector3> points;
+  std::vector<long> point_start(1, 0);
+  for (long f = 0; f < nf; ++f)
+  {
+    MeshCore::Index const * fv = core.faceVertices((MeshCore::Index)f);
+    for (int i = 0; i < core.numFaceVertices((MeshCore::Index)f); ++i)
+      points.push_back(core.getPosition(fv[i]));
+
+    point_start.push_back((long)points.size());
+  }
+
+  std::vector<Plane3> np_planes((size_t)nf);
+  long num_degenerate = 0;
+  timer.tick();
+    for (long f = 0; f < nf; ++f)
+    {
+      std::vector<Vector3> face_points(points.begin() + point_start[(size_t)f], points.begin() + point_start[(size_t)f + 1]);
+      try
+      {
+        np_planes[(size_t)f] = Plane3::fromNPoints(face_points);
+      }
+      catch (...)
+      {
+        num_degenerate++;
+      }
+    }
+  timer.tock();
+  double np_time = std::max(timer.elapsedTime(), 1e-9);
+  DGP_CONSOLE << "Planes of " << nf << " faces, Plane3::fromNPoints one at a time: " << 1e-6 * nf / np_time << " M/s, "
+              << num_degenerate << " failed";
+
+  std::vector<Plane3> ref_planes;
+  for (int s = 0; s < num_sets; ++s)
+  {
+    Matrix3Batch::InstructionSet set(s);
+    std::vector<Plane3> planes((size_t)nf);
+    timer.tick();
+      for (long r = 0; r < NUM_REPEATS; ++r)
+        Matrix3Batch::fitPlanes(set, nf, &points[0], &point_start[0], &planes[0]);
+    timer.tock();
+    double batch_time = std::max(timer.elapsedTime() / NUM_REPEATS, 1e-9);
+
+    if (s == 0)
+      ref_planes = planes;
+
+    bool same = true;
+    for (long f = 0; f < nf; ++f)
+    {
+      Plane3 single;
+      Matrix3Batch::fitPlanes(set, 1, &points[0], &point_start[0] + f, &single);
+      same = same && single.getEquation() == ref_planes[(size_t)f].getEquation()
+          && planes[(size_t)f].getEquation() == ref_planes[(size_t)f].getEquation();
+    }
+
+    consistent = consistent && same;
+    DGP_CONSOLE << "  " << Matrix3Batch::name(set) << ":" << std::string(8 - std::strlen(Matrix3Batch::name(set)), ' ')
+                << 1e-6 * nf / batch_time << " M/s (" << np_time / batch_time << "x), identical to scalar and one at a time: "
+                << (same ? "yes" : "NO");
+  }
+
+  // Against the planes through the first three vertices of each face, from their cross product in double precision, and
+  // (for information) Plane3::fromNPoints, whose normal may point either way. Angles are measured with atan2, since the acos
+  // of the dot product of single-precision unit vectors is only accurate to about 3e-4 near zero.
+  auto angle = [](Vector3 const & a, double const * b) {
+    double cross[3] = { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+    return std::atan2(std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]),
+                      a[0] * b[0] + a[1] * b[1] + a[2] * b[2]);
+  };
+
+  // The face cache, which fits the planes of all faces together and also computes their centroids and areas
+  FaceGeometryCache cache;
+  timer.tick();
+    for (long r = 0; r < NUM_REPEATS; ++r)
+      cache.build(core);
+  timer.tock();
+  double cache_time = std::max(timer.elapsedTime() / NUM_REPEATS, 1e-9);
+
+  double max_angle = 0, max_offset = 0, max_np_angle = 0, max_cache_angle = 0;
+  for (long f = 0; f < nf; ++f)
+  {
+    Vector3 const * p = &points[0] + point_start[(size_t)f];
+    double u[3], w[3];
+    for (int k = 0; k < 3; ++k)
+    {
+      u[k] = (double)p[1][k] - p[0][k];
+      w[k] = (double)p[2][k] - p[0][k];
+    }
+
+    double n[3] = { u[1] * w[2] - u[2] * w[1], u[2] * w[0] - u[0] * w[2], u[0] * w[1] - u[1] * w[0] };
+    double len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (!(len > 1e-6 * mean_edge_length * mean_edge_length))
+      continue;
+
+    Plane3 const & plane = ref_planes[(size_t)f];
+    max_angle = std::max(max_angle, angle(plane.getNormal(), n));
+    max_cache_angle = std::max(max_cache_angle, angle(cache.getPlane((MeshCore::Index)f).getNormal(), n));
+    for (long i = point_start[(size_t)f]; i < point_start[(size_t)f + 1]; ++i)
+      max_offset = std::max(max_offset, (double)plane.distance(points[(size_t)i]) / mean_edge_length);
+
+    Vector3 const & np_normal = np_planes[(size_t)f].getNormal();
+    double np[3] = { np_normal[0], np_normal[1], np_normal[2] };
+    double np_angle = angle(plane.getNormal(), np);
+    max_np_angle = std::max(max_np_angle, std::min(np_angle, Math::pi() - np_angle));
+  }
+
+  bool planes_ok = (max_angle <= 1e-6 && max_cache_angle <= 1e-6);
+  DGP_CONSOLE << "  Max angle to the exact normal: " << max_angle << " rad, max distance of a vertex from the plane: "
+              << max_offset << " edge lengths; max angle to the fromNPoints normal: " << max_np_angle << " rad";
+  DGP_CONSOLE << "FaceGeometryCache::build, with centroids and areas: " << 1e-6 * nf / cache_time << " M/s ("
+              << np_time / cache_time << "x), max angle to the exact normal: " << max_cache_angle << " rad";
+
+  //==========================================================================================================================
+  // Planes of the one-ring of each vertex: the vertex and the other vertices of its faces, about 7 points that are not
+  // coplanar, so they take the general path of fitPlanes() instead of the triangle one
+  //==========================================================================================================================
+
+  std::vector<Vector3> ring_points;
+  std::vector<long> ring_start(1, 0);
+  std::vector<MeshCore::Index> ring;
+  for (long v = 0; v < nv; ++v)
+  {
+    ring.assign(1, (MeshCore::Index)v);
+    MeshCore::Index const * vf = core.vertexFaces((MeshCore::Index)v);
+    for (int i = 0; i < core.numVertexFaces((MeshCore::Index)v); ++i)
+    {
+      MeshCore::Index const * fv = core.faceVertices(vf[i]);
+      for (int j = 0; j < core.numFaceVertices(vf[i]); ++j)
+        if (std::find(ring.begin(), ring.end(), fv[j]) == ring.end())
+          ring.push_back(fv[j]);
+    }
+
+    for (size_t i = 0; i < ring.size(); ++i)
+      ring_points.push_back(core.getPosition(ring[i]));
+
+    ring_start.push_back((long)ring_points.size());
+  }
+
+  std::vector<Plane3> np_ring_planes((size_t)nv);
+  num_degenerate = 0;
+  timer.tick();
+    for (long v = 0; v < nv; ++v)
+    {
+      std::vector<Vector3> ring_set(ring_points.begin() + ring_start[(size_t)v],
+                                    ring_points.begin() + ring_start[(size_t)v + 1]);
+      try
+      {
+        np_ring_planes[(size_t)v] = Plane3::fromNPoints(ring_set);
+      }
+      catch (...)
+      {
+        num_degenerate++;
+      }
+    }
+  timer.tock();
+  double np_ring_time = std::max(timer.elapsedTime(), 1e-9);
+  DGP_CONSOLE << "Planes of " << nv << " vertex rings of " << (double)ring_points.size() / std::max(nv, 1L)
+              << " points on average, Plane3::fromNPoints one at a time: " << 1e-6 * nv / np_ring_time << " M/s, "
+              << num_degenerate << " failed";
+
+  std::vector<Plane3> ref_ring_planes;
+  for (int s = 0; s < num_sets; ++s)
+  {
+    Matrix3Batch::InstructionSet set(s);
+    std::vector<Plane3> planes((size_t)nv);
+    timer.tick();
+      for (long r = 0; r < NUM_REPEATS; ++r)
+        Matrix3Batch::fitPlanes(set, nv, &ring_points[0], &ring_start[0], &planes[0]);
+    timer.tock();
+    double batch_time = std::max(timer.elapsedTime() / NUM_REPEATS, 1e-9);
+
+    if (s == 0)
+      ref_ring_planes = planes;
+
+    bool same = true;
+    for (long v = 0; v < nv; ++v)
+    {
+      Plane3 single;
+      Matrix3Batch::fitPlanes(set, 1, &ring_points[0], &ring_start[0] + v, &single);
+      same = same && single.getEquation() == ref_ring_planes[(size_t)v].getEquation()
+          && planes[(size_t)v].getEquation() == ref_ring_planes[(size_t)v].getEquation();
+    }
+
+    consistent = consistent && same;
+    DGP_CONSOLE << "  " << Matrix3Batch::name(set) << ":" << std::string(8 - std::strlen(Matrix3Batch::name(set)), ' ')
+                << 1e-6 * nv / batch_time << " M/s (" << np_ring_time / batch_time
+                << "x), identical to scalar and one at a time: " << (same ? "yes" : "NO");
+  }
+
+  // Against the eigenvector of the smallest eigenvalue from symmetricEigen(), where it is well separated from the next, since
+  // the normal is otherwise ill-defined
+  std::vector<double> ring_cov(6 * (size_t)nv), ring_values(3 * (size_t)nv), ring_vectors(9 * (size_t)nv);
+  for (long v = 0; v < nv; ++v)
+  {
+    long begin = ring_start[(size_t)v], m = ring_start[(size_t)v + 1] - begin;
+    double c[3] = { 0, 0, 0 };
+    for (long j = 0; j < m; ++j)
+      for (int k = 0; k < 3; ++k)
+        c[k] += ring_points[(size_t)(begin + j)][k] / m;
+
+    double * cov = &ring_cov[6 * (size_t)v];
+    for (long j = 0; j < m; ++j)
+    {
+      Vector3 const & p = ring_points[(size_t)(begin + j)];
+      double x = p[0] - c[0], y = p[1] - c[1], z = p[2] - c[2];
+      cov[0] += x * x; cov[1] += x * y; cov[2] += x * z;
+      cov[3] += y * y; cov[4] += y * z;
+      cov[5] += z * z;
+    }
+  }
+
+  Matrix3Batch::symmetricEigen(Matrix3Batch::InstructionSet::SCALAR, nv, &ring_cov[0], &ring_values[0], &ring_vectors[0]);
+
+  double max_ring_angle = 0;
+  long num_ring_checked = 0;
+  for (long v = 0; v < nv; ++v)
+  {
+    double const * values = &ring_values[3 * (size_t)v];
+    if (!(values[1] - values[0] > 1e-3 * (values[0] + values[1] + values[2])))
+      continue;
+
+    double ring_angle = angle(ref_ring_planes[(size_t)v].getNormal(), &ring_vectors[9 * (size_t)v]);
+    max_ring_angle = std::max(max_ring_angle, std::min(ring_angle, Math::pi() - ring_angle));
+    num_ring_checked++;
+  }
+
+  bool rings_ok = (max_ring_angle <= 1e-6);
+  DGP_CONSOLE << "  Max angle to the symmetricEigen normal, over " << num_ring_checked << " rings with distinct eigenvalues: "
+              << max_ring_angle << " rad";
+
+  DGP_CONSOLE << "All instruction sets identical, in batches and one at a time: " << (consistent ? "yes" : "NO");
+  return consistent && inverses_ok && eigen_ok && planes_ok && rings_ok;
+}
+
+bool
+Benchmark::benchmarkNeighbourhood(std::string const & mesh_path)
+{
+  Mesh mesh;
+  if (!mesh.load(mesh_path))
+    return false;
+
+  double sigma_c = 0.005;  // same parameters as the viewer
+  double sigma_s = 0.05;
+  Real radius = (Real)(2 * sigma_c);
+
+  MeshCore & core = mesh.getCore();
+  long nv = core.numVertices();
+
+  DGP_CONSOLE << "Mesh '" << mesh.getName() << "': " << nv << " vertices, " << core.numFaces() << " faces, query radius = "
+              << radius;
+
+  Stopwatch timer;
+  MeshCore::Scratch scratch;
+  std::vector<MeshCore::Index> neighbours;
+
+  long geodesic_count = 0;
+  timer.tick();
+    for (MeshCore::Index v = 0; v < (MeshCore::Index)nv; ++v)
+    {
+      core.findNeighbourFaces(v, radius, scratch, neighbours);
+      geodesic_count += (long)neighbours.size();
+    }
+  timer.tock();
+  DGP_CONSOLE << "Geodesic search:       " << 1000 * timer.elapsedTime() << " ms, " << geodesic_count << " neighbours";
+
+  FaceGeometryCache faces;
+  faces.build(core);
+
+  PointHashGrid3 grid;
+  PointKDTree3 kdtree;
+  PointIndex3 * indices[2] = { &grid, &kdtree };
+  char const * index_names[2] = { "hash grid", "k-d tree " };
+  std::vector< std::vector<MeshCore::Index> > results[2];
+
+  for (int i = 0; i < 2; ++i)
+  {
+    timer.tick();
+      indices[i]->build(faces.getCentroids(), faces.numFaces(), radius);
+    timer.tock();
+    double build_time = timer.elapsedTime();
+
+    results[i].resize((size_t)nv);
+    long count = 0;
+    timer.tick();
+      for (MeshCore::Index v = 0; v < (MeshCore::Index)nv; ++v)
+      {
+        core.findNeighbourFaces(v, radius, *indices[i], scratch, results[i][v]);
+        count += (long)results[i][v].size();
+      }
+    timer.tock();
+
+    DGP_CONSOLE << "Euclidean (" << index_names[i] << "): build " << 1000 * build_time << " ms, queries "
+                << 1000 * timer.elapsedTime() << " ms, " << count << " neighbours";
+  }
+
+  bool identical = (results[0] == results[1]);
+  DGP_CONSOLE << "Grid and k-d tree neighbourhoods identical: " << (identical ? "yes" : "NO");
+
+  Mesh::SmoothingOptions options;
+  options.neighbourhood = Mesh::NeighbourhoodType::EUCLIDEAN;
+  for (int i = 0; i < 2; ++i)
+  {
+    options.spatial_index = (i == 0 ? Mesh::SpatialIndexType::HASH_GRID : Mesh::SpatialIndexType::KD_TREE);
+
+    timer.tick();
+      mesh.bilateralSmooth(sigma_c, sigma_s, options);
+    timer.tock();
+    DGP_CONSOLE << "Euclidean pass (" << index_names[i] << "): " << 1000 * timer.elapsedTime() << " ms";
+  }
+
+  return identical;
+}
+
+bool
+Benchmark::benchmarkCollapse(std::string const & mesh_path)
+{
+  Mesh mesh;
+  if (!mesh.load(mesh_path))
+    return false;
+
+  long nf = mesh.numFaces();
+  DGP_CONSOLE << "Mesh '" << mesh.getName() << "': " << mesh.numVertices() << " vertices, " << mesh.numEdges() << " edges, "
+              << nf << " faces";
+
+  // Collapse edges in a fixed random order until half the faces are gone. Collapses only ever remove edges, so every edge
+  // still in the mesh is in the list.
+  std::vector<MeshEdge *> order;
+  for (Mesh::EdgeIterator ei = mesh.edgesBegin(); ei != mesh.edgesEnd(); ++ei)
+    order.push_back(&(*ei));
+
+  std::mt19937 rng(1234);
+  std::shuffle(order.begin(), order.end(), rng);
+
+  // Time each quarter of the faces removed separately, to show the cost of a collapse does not grow with the size of the mesh
+  long milestones[2] = { nf - nf / 4, nf - nf / 2 };
+  long num_collapses = 0, segment_collapses = 0;
+  int segment = 0;
+  Stopwatch timer;
+  timer.tick();
+  for (size_t i = 0; i < order.size() && segment < 2; ++i)
+  {
+    MeshEdge * edge = order[i];
+    if (edge->isRemoved() || edge->getEndpoint(0) == edge->getEndpoint(1))
+      continue;
+
+    mesh.collapseEdge(edge);
+    num_collapses++;
+    segment_collapses++;
+
+    if (mesh.numFaces() <= milestones[segment])
+    {
+      timer.tock();
+      DGP_CONSOLE << "Quarter " << segment + 1 << ": " << segment_collapses << " collapses in " << 1000 * timer.elapsedTime()
+                  << " ms (" << segment_collapses / std::max(timer.elapsedTime(), 1e-9) << " collapses/s)";
+
+      segment++;
+      segment_collapses = 0;
+      timer.tick();
+    }
+  }
+
+  bool ok = checkTopology(mesh);
+  DGP_CONSOLE << num_collapses << " collapses: " << mesh.numVertices() << " vertices, " << mesh.numEdges() << " edges, "
+              << mesh.numFaces() << " faces remain; topology consistent: " << (ok ? "yes" : "NO");
+
+  return ok;
+}
+
+bool
+Benchmark::benchmarkDecimate(std::string const & mesh_path)
+{
+  Mesh original;
+  if (!original.load(mesh_path))
+    return false;
+
+  long nv = original.numVertices(), ne = original.numEdges(), nf = original.numFaces();
+  long euler = nv - ne + nf;
+  DGP_CONSOLE << "Mesh '" << original.getName() << "': " << nv << " vertices, " << ne << " edges, " << nf
+              << " faces, Euler characteristic " << euler;
+
+  // Decimate fresh copies to successively smaller face targets, then to an error bound alone
+  Real d = original.getStatistics().mean_edge_length;
+  long const NUM_RUNS = 4;
+  long face_targets[NUM_RUNS] = { nf / 2, nf / 10, nf / 100, 0 };
+  double error_bounds[NUM_RUNS] = { -1, -1, -1, 0.1 * d };
+
+  bool all_ok = true;
+  for (long i = 0; i < NUM_RUNS; ++i)
+  {
+    Mesh mesh;
+    if (!mesh.load(mesh_path))
+      return false;
+
+    Mesh::DecimationOptions options;
+    options.target_faces = face_targets[i];
+    options.max_error = error_bounds[i];
+
+    Mesh::DecimationStats stats;
+    Stopwatch timer;
+    timer.tick();
+      mesh.decimateQuadricEdgeCollapse(options, &stats);
+    timer.tock();
+
+    // Collapses that pass the link condition do not change the topological type of the surface
+    bool ok = checkTopology(mesh) && mesh.numVertices() - mesh.numEdges() + mesh.numFaces() == euler;
+    all_ok = all_ok && ok;
+
+    if (options.max_error >= 0)
+      DGP_CONSOLE << "Error bound " << options.max_error << ':';
+    else
+      DGP_CONSOLE << "Target " << options.target_faces << " faces:";
+
+    DGP_CONSOLE << "  " << stats.num_collapses << " collapses in " << 1000 * timer.elapsedTime() << " ms ("
+                << stats.num_collapses / std::max(timer.elapsedTime(), 1e-9) << " collapses/s), " << stats.num_rejected
+                << " rejected, " << stats.num_stale << " stale entries; " << mesh.numVertices() << " vertices, "
+                << mesh.numFaces() << " faces remain, max error " << stats.max_error << "; topology consistent: "
+                << (ok ? "yes" : "NO");
+  }
+
+  return all_ok;
+}
+
+bool
+Benchmark::benchmarkLoad(std::string const & mesh_path)
+{
+  double mb = FileSystem::fileSize(mesh_path) / (1024.0 * 1024.0);
+
+  Mesh stream_mesh, mapped_mesh;
+  Stopwatch timer;
+  timer.tick();
+    bool stream_ok = streamLoadOFF(stream_mesh, mesh_path);
+  timer.tock();
+  double stream_time = std::max(timer.elapsedTime(), 1e-9);
+
+  timer.tick();
+    bool mapped_ok = mapped_mesh.load(mesh_path);
+  timer.tock();
+  double mapped_time = std::max(timer.elapsedTime(), 1e-9);
+
+  if (!stream_ok || !mapped_ok)
+  {
+    DGP_ERROR << "Could not load mesh '" << mesh_path << '\'';
+    return false;
+  }
+
+  // Time the topology construction on its own, from arrays extracted from the loaded mesh
+  MeshCore const & core = mapped_mesh.getCore();
+  std::vector<uint32> face_offsets(1, 0), face_indices;
+  for (MeshCore::Index f = 0; f < (MeshCore::Index)core.numFaces(); ++f)
+  {
+    face_indices.insert(face_indices.end(), core.faceVertices(f), core.faceVertices(f) + core.numFaceVertices(f));
+    face_offsets.push_back((uint32)face_indices.size());
+  }
+
+  Mesh built_mesh;
+  timer.tick();
+    built_mesh.setFromArrays(core.numVertices(), core.getPositions(), core.numFaces(), &face_offsets[0],
+                             face_indices.empty() ? NULL : &face_indices[0]);
+  timer.tock();
+  double build_time = timer.elapsedTime();
+
+  long nf = mapped_mesh.numFaces();
+  DGP_CONSOLE << "Mesh '" << mapped_mesh.getName() << "': " << mapped_mesh.numVertices() << " vertices, " << nf << " faces, "
+              << mapped_mesh.numEdges() << " edges, " << mb << " MB";
+  DGP_CONSOLE << "iostream loader: " << 1000 * stream_time << " ms, " << mb / stream_time << " MB/s, " << nf / stream_time
+              << " faces/s";
+  DGP_CONSOLE << "Mapped loader:   " << 1000 * mapped_time << " ms, " << mb / mapped_time << " MB/s, " << nf / mapped_time
+              << " faces/s (" << stream_time / mapped_time << "x)";
+  DGP_CONSOLE << "  of which building linked elements from arrays: " << 1000 * build_time << " ms";
+
+  // The loaders must build the same elements in the same order, so smoothing both gives identical results
+  bool same_counts = (stream_mesh.numVertices() == mapped_mesh.numVertices() && stream_mesh.numEdges() == mapped_mesh.numEdges()
+                   && stream_mesh.numFaces() == mapped_mesh.numFaces());
+  double load_dev = maxDeviation(stream_mesh, mapped_mesh);
+
+  double sigma_c = 0.005;  // same parameters as the viewer
+  double sigma_s = 0.05;
+  stream_mesh.bilateralSmooth(sigma_c, sigma_s);
+  mapped_mesh.bilateralSmooth(sigma_c, sigma_s);
+  double smooth_dev = maxDeviation(stream_mesh, mapped_mesh);
+
+  DGP_CONSOLE << "Max deviation after load: " << load_dev << ", after smoothing: " << smooth_dev;
+
+  return same_counts && load_dev == 0 && smooth_dev == 0;
+}
+
+bool
+Benchmark::benchmarkCache(std::string const & mesh_path)
+{
+  std::string cache_path = "./benchmark_cache.bmesh";
+
+  Mesh mesh, cached_mesh;
+  Stopwatch timer;
+  timer.tick();
+    bool ok = mesh.load(mesh_path);
+  timer.tock();
+  double off_time = timer.elapsedTime();
+
+  if (!ok)
+    return false;
+
+  timer.tick();
+    ok = mesh.save(cache_path);
+  timer.tock();
+  double save_time = timer.elapsedTime();
+
+  if (!ok)
+    return false;
+
+  timer.tick();
+    ok = cached_mesh.load(cache_path);
+  timer.tock();
+  double cache_time = std::max(timer.elapsedTime(), 1e-9);
+
+  double mb = FileSystem::fileSize(cache_path) / (1024.0 * 1024.0);
+  std::remove(cache_path.c_str());
+
+  if (!ok)
+    return false;
+
+  long nf = cached_mesh.numFaces();
+  DGP_CONSOLE << "Mesh '" << mesh.getName() << "': " << mesh.numVertices() << " vertices, " << nf << " faces";
+  DGP_CONSOLE << "OFF load:           " << 1000 * off_time << " ms";
+  DGP_CONSOLE << "Binary save:        " << 1000 * save_time << " ms, " << mb << " MB";
+  DGP_CONSOLE << "Binary load:        " << 1000 * cache_time << " ms, " << mb / cache_time << " MB/s, " << nf / cache_time
+              << " faces/s (" << off_time / cache_time << "x)";
+
+  // The reloaded mesh must have the same elements, adjacency order and normals, so smoothing gives identical results
+  bool same_counts = (mesh.numVertices() == cached_mesh.numVertices() && mesh.numEdges() == cached_mesh.numEdges()
+                   && mesh.numFaces() == cached_mesh.numFaces());
+  double load_dev = maxDeviation(mesh, cached_mesh);
+
+  double sigma_c = 0.005;  // same parameters as the viewer
+  double sigma_s = 0.05;
+  mesh.bilateralSmooth(sigma_c, sigma_s);
+  cached_mesh.bilateralSmooth(sigma_c, sigma_s);
+  double smooth_dev = maxDeviation(mesh, cached_mesh);
+
+  DGP_CONSOLE << "Max deviation after load: " << load_dev << ", after smoothing: " << smooth_dev;
+
+  return same_counts && load_dev == 0 && smooth_dev == 0;
+}
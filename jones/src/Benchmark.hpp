@@ -0,0 +1,120 @@
+#ifndef __A3_Benchmark_hpp__
+#define __A3_Benchmark_hpp__
+
+#include "Common.hpp"
+#include <string>
+
+/** Timing harness that compares alternative mesh processing code paths on a mesh loaded from disk. */
+class Benchmark
+{
+  public:
+    /**
+     * Run a named benchmark on the mesh at a given path, printing results to the console. Available benchmarks:
+     *
+     * - <tt>collapse</tt>: collapsing random edges until half the faces are gone, reporting collapses/s as the mesh shrinks.
+     * - <tt>core</tt>: neighbourhood gathering and one smoothing pass over the linked mesh elements vs the compact core.
+     * - <tt>cache</tt>: loading the OFF file vs saving and reloading it in the binary mesh format.
+     * - <tt>decimate</tt>: quadric error simplification to several face targets and to an error bound, reporting
+     *   collapses/s.
+     * - <tt>load</tt>: the iostream-based OFF loader vs the memory-mapped loader, reporting MB/s and faces/s.
+     * - <tt>render</tt>: drawing the mesh in immediate mode vs from vertex and index buffers, reporting frames/s, and the data
+     *   sent again after a smoothing pass. Needs a display; run under <tt>xvfb-run</tt> to use a virtual one.
+     * - <tt>raster</tt>: drawing the mesh into an image on the CPU on increasing numbers of threads and with several tile
+     *   sizes, reporting triangles/s, and saving the image as <tt>benchmark_raster.png</tt>. Needs no display.
+     * - <tt>neighbourhood</tt>: geodesic face neighbourhoods vs Euclidean neighbourhoods from a hash grid and a k-d tree.
+     * - <tt>normals</tt>: recomputing normals one element at a time vs the bulk update on increasing numbers of threads,
+     *   with each weighting, and incrementally around a few moved vertices.
+     * - <tt>weights</tt>: bilateral weights in double precision vs batched on each supported instruction set, reporting the
+     *   error of each path against its bound and the deviation of a smoothing pass from the double-precision pass.
+     * - <tt>metrics</tt>: measuring a noisy copy of the mesh against the original by reloading it from disk vs with MeshMetrics
+     *   on increasing numbers of threads, and closest points from a brute-force search vs the bounding volume hierarchy.
+     * - <tt>bvh</tt>: building the triangle bounding volume hierarchy with median and SAH splits on increasing numbers of
+     *   threads, and closest-point, ray, box and ball queries on each, checked against brute-force searches.
+     * - <tt>pick</tt>: picking vertices at random screen positions on the mesh and on a million-face grid, before and after
+     *   moving every vertex (refitting the hierarchy vs rebuilding it), checked against brute-force picks.
+     * - <tt>noise</tt>: adding noise sequentially vs with the counter-based generator on increasing numbers of threads, with
+     *   each noise model, checking the result does not depend on the thread count and has the expected statistics.
+     * - <tt>random</tt>: drawing random numbers from one shared, locked generator vs per-thread streams, one at a time and in
+     *   bulk, on 1 to 64 threads. The mesh is not used.
+     * - <tt>stats</tt>: the serial average edge length vs all of MeshStatistics on increasing numbers of threads, checked
+     *   against the mesh elements, and the cost of cached statistics.
+     * - <tt>tiled</tt>: building a tiled mesh from a noisy copy of the mesh and smoothing it tile by tile on increasing numbers
+     *   of threads vs smoothing it in memory, reporting the deviation near tile borders, and writing the result back as OFF.
+     * - <tt>fair</tt>: assembling and solving an implicit fairing step with each Laplacian weighting on increasing numbers
+     *   of threads, checking the result does not depend on the thread count, the matrix is symmetric and the solution within
+     *   tolerance, vs explicit umbrella passes covering the same step.
+     * - <tt>assemble</tt>: packing the cotangent system from a mapped matrix through a sorted map vs the bucketing
+     *   constructor, and from triplets compressed and refilled on increasing numbers of threads vs MeshLaplacian's direct
+     *   assembly and update, checking all give the same matrix.
+     * - <tt>matrix3</tt>: inverting the 3x3 blocks of vertex quadrics, decomposing random symmetric matrices and fitting the
+     *   planes of the faces and of the vertex rings one at a time with MatrixMN, SVD and Plane3 vs batched on each supported
+     *   instruction set, checking the residuals and that every path gives identical results in batches and one at a time.
+     *
+     * @return True on success, false if the benchmark is unknown or failed.
+     */
+    static bool run(std::string const & name, std::string const & mesh_path);
+
+  private:
+    /** Time random edge collapses, checking that the topology stays consistent. */
+    static bool benchmarkCollapse(std::string const & mesh_path);
+
+    /** Compare the linked (std::list) representation against the compact core. */
+    static bool benchmarkCore(std::string const & mesh_path);
+
+    /** Compare loading the OFF file against loading a binary mesh file written from it. */
+    static bool benchmarkCache(std::string const & mesh_path);
+
+    /** Time quadric error decimation, checking that the topology stays consistent and its type unchanged. */
+    static bool benchmarkDecimate(std::string const & mesh_path);
+
+    /** Compare OFF loading through iostreams and per-face edge searches against the memory-mapped loader. */
+    static bool benchmarkLoad(std::string const & mesh_path);
+
+    /** Compare immediate-mode drawing against drawing from vertex and index buffers, checking the images match. */
+    static bool benchmarkRender(std::string const & mesh_path);
+
+    /** Time the CPU rasterizer on 1, 2, 4... threads, checking that the image does not depend on the thread count. */
+    static bool benchmarkRaster(std::string const & mesh_path);
+
+    /** Compare geodesic neighbourhood search against Euclidean range queries on each type of spatial index. */
+    static bool benchmarkNeighbourhood(std::string const & mesh_path);
+
+    /** Compare per-element normal updates against bulk and incremental updates, checking that the normals match. */
+    static bool benchmarkNormals(std::string const & mesh_path);
+
+    /** Compare exact and batched bilateral weights on each instruction set, checking the errors are within their bounds. */
+    static bool benchmarkWeights(std::string const & mesh_path);
+
+    /** Compare reloading the reference mesh against MeshMetrics, checking the metrics and closest points are exact. */
+    static bool benchmarkMetrics(std::string const & mesh_path);
+
+    /** Time building and querying the triangle hierarchy, checking the results against brute-force searches. */
+    static bool benchmarkBVH(std::string const & mesh_path);
+
+    /** Time picking vertices with the mesh's hierarchy, and refitting it after the vertices move vs rebuilding it. */
+    static bool benchmarkPick(std::string const & mesh_path);
+
+    /** Compare sequential noise against counter-based noise, checking it is reproducible and correctly distributed. */
+    static bool benchmarkNoise(std::string const & mesh_path);
+
+    /** Compare drawing random numbers from a shared generator against per-thread streams, checking the bulk fills. */
+    static bool benchmarkRandom(std::string const & mesh_path);
+
+    /** Compare the serial average edge length against MeshStatistics, checking the statistics against the mesh elements. */
+    static bool benchmarkStats(std::string const & mesh_path);
+
+    /** Compare smoothing a tiled mesh tile by tile against smoothing it in memory, checking the result is reproducible. */
+    static bool benchmarkTiled(std::string const & mesh_path);
+
+    /** Compare implicit fairing steps on 1, 2, 4... threads against explicit passes, checking the solution. */
+    static bool benchmarkFair(std::string const & mesh_path);
+
+    /** Compare assembling a sparse matrix through maps against triplets and direct assembly, checking refills. */
+    static bool benchmarkAssemble(std::string const & mesh_path);
+
+    /** Compare one-at-a-time 3x3 inverses, eigendecompositions and plane fits against the batched kernels. */
+    static bool benchmarkMatrix3(std::string const & mesh_path);
+
+}; // class Benchmark
+
+#endif
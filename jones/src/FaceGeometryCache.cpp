@@ -0,0 +1,63 @@
+#include "FaceGeometryCache.hpp"
+#include "DGP/Matrix3Batch.hpp"
+
+void
+FaceGeometryCache::build(MeshCore const & core)
+{
+  long nf = core.numFaces();
+  centroids.resize((size_t)nf);
+  planes.resize((size_t)nf);
+  areas.resize((size_t)nf);
+
+  batch.resize((size_t)nf);
+  for (long f = 0; f < nf; ++f)
+    batch[(size_t)f] = (MeshCore::Index)f;
+
+  updateFaces(core);
+}
+
+void
+FaceGeometryCache::update(MeshCore const & core, MeshCore::Index v)
+{
+  MeshCore::Index const * vf = core.vertexFaces(v);
+  batch.assign(vf, vf + core.numVertexFaces(v));
+  updateFaces(core);
+}
+
+void
+FaceGeometryCache::updateFaces(MeshCore const & core)
+{
+  size_t n = batch.size();
+  if (n == 0)
+    return;
+
+  points.clear();
+  point_start.resize(n + 1);
+  point_start[0] = 0;
+  for (size_t i = 0; i < n; ++i)
+  {
+    MeshCore::Index const * fv = core.faceVertices(batch[i]);
+    for (int j = 0, m = core.numFaceVertices(batch[i]); j < m; ++j)
+      points.push_back(core.getPosition(fv[j]));
+
+    point_start[i + 1] = (long)points.size();
+  }
+
+  batch_planes.resize(n);
+  Matrix3Batch::fitPlanes((long)n, &points[0], &point_start[0], &batch_planes[0]);
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    MeshCore::Index f = batch[i];
+    centroids[f] = core.getFaceCentroid(f);
+    planes[f] = batch_planes[i];
+
+    // Area of a planar polygon, as half the length of the sum of the cross products of a fan of triangles
+    Vector3 const * p = &points[0] + point_start[i];
+    Vector3 cross_sum = Vector3::zero();
+    for (long j = 1; j + 1 < point_start[i + 1] - point_start[i]; ++j)
+      cross_sum += (p[j] - p[0]).cross(p[j + 1] - p[0]);
+
+    areas[f] = 0.5f * cross_sum.length();
+  }
+}
@@ -0,0 +1,59 @@
+#ifndef __A3_FaceGeometryCache_hpp__
+#define __A3_FaceGeometryCache_hpp__
+
+#include "Common.hpp"
+#include "MeshCore.hpp"
+#include "DGP/Plane3.hpp"
+#include "DGP/Vector3.hpp"
+#include <vector>
+
+/**
+ * Per-face geometry of a MeshCore (centroid, supporting plane and area) in contiguous arrays, so that smoothing passes read
+ * each face's geometry instead of recomputing it for every vertex that sees the face. After moving a vertex, call update() on
+ * it to refresh the faces incident on it. Centroids are computed exactly as MeshCore::getFaceCentroid() computes them. Planes
+ * are least-squares fits to the vertices of each face, computed together for all the faces being refreshed by
+ * Matrix3Batch::fitPlanes(), which gives a face the same plane whichever batch it is in, so reading the cache gives
+ * bit-identical results to recomputing.
+ */
+class FaceGeometryCache
+{
+  public:
+    /** Constructor. */
+    FaceGeometryCache() {}
+
+    /** Compute the geometry of every face of a core from its current vertex positions. */
+    void build(MeshCore const & core);
+
+    /** Recompute the geometry of the faces incident on a vertex of the core, after the vertex has been moved. */
+    void update(MeshCore const & core, MeshCore::Index v);
+
+    /** Get the number of faces in the cache. */
+    long numFaces() const { return (long)centroids.size(); }
+
+    /** Get the centroid of a face. */
+    Vector3 const & getCentroid(MeshCore::Index f) const { return centroids[f]; }
+
+    /** Get a pointer to the consecutive centroids of all faces. */
+    Vector3 const * getCentroids() const { return centroids.empty() ? NULL : &centroids[0]; }
+
+    /** Get the plane of a face (unit normal and offset from the origin). */
+    Plane3 const & getPlane(MeshCore::Index f) const { return planes[f]; }
+
+    /** Get the area of a face. */
+    Real getArea(MeshCore::Index f) const { return areas[f]; }
+
+  private:
+    /** Recompute the cached geometry of the faces in #batch. */
+    void updateFaces(MeshCore const & core);
+
+    std::vector<Vector3> centroids;      ///< Face centroids.
+    std::vector<Plane3> planes;          ///< Face planes.
+    std::vector<Real> areas;             ///< Face areas.
+    std::vector<MeshCore::Index> batch;  ///< Scratch buffer of the faces being refreshed.
+    std::vector<Vector3> points;         ///< Scratch buffer of the vertex positions of the faces being refreshed.
+    std::vector<long> point_start;       ///< Scratch buffer of the position in #points of each face being refreshed.
+    std::vector<Plane3> batch_planes;    ///< Scratch buffer of the planes of the faces being refreshed.
+
+}; // class FaceGeometryCache
+
+#endif
@@ -7,13 +7,20 @@
 #include "DGP/Colors.hpp"
 #include "DGP/NamedObject.hpp"
 #include "DGP/Noncopyable.hpp"
+#include "DGP/ThreadPool.hpp"
 #include "DGP/Vector3.hpp"
 #include "DGP/Plane3.hpp"
+#include "MeshCore.hpp"
 #include "MeshFace.hpp"
+#include "MeshLaplacian.hpp"
+#include "MeshPicker.hpp"
+#include "MeshRenderBuffer.hpp"
+#include "MeshStatistics.hpp"
 #include "MeshVertex.hpp"
 #include "MeshEdge.hpp"
 #include <list>
 #include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 /** A class for storing meshes with arbitrary topologies. */
@@ -37,8 +44,170 @@ class Mesh : public virtual NamedObject, private Noncopyable
     typedef typename FaceList::iterator          FaceIterator;         ///< Iterator over faces.
     typedef typename FaceList::const_iterator    FaceConstIterator;    ///< Const iterator over faces.
 
+    /** How the face neighbourhood of a vertex is gathered. */
+    struct NeighbourhoodType
+    {
+      /** Supported values. */
+      enum Value
+      {
+        GEODESIC,  ///< Breadth-first search over adjacent faces, stopping at faces whose centroids are beyond the radius.
+        EUCLIDEAN  /**< All faces whose centroids are within the radius in space, found with a spatial index, plus the incident
+                        faces. Also reaches faces across gaps and thin features that the geodesic search cannot. */
+      };
+
+      DGP_ENUM_CLASS_BODY(NeighbourhoodType)
+    };
+
+    /** Spatial index used for Euclidean neighbourhoods. */
+    struct SpatialIndexType
+    {
+      /** Supported values. */
+      enum Value
+      {
+        HASH_GRID,  ///< Hashed uniform grid with cells the size of the query radius (PointHashGrid3).
+        KD_TREE     ///< Balanced k-d tree (PointKDTree3).
+      };
+
+      DGP_ENUM_CLASS_BODY(SpatialIndexType)
+    };
+
+    /** Distribution of the displacements added by noiseMesh(). */
+    struct NoiseModel
+    {
+      /** Supported values. */
+      enum Value
+      {
+        GAUSSIAN,  ///< Each coordinate of each vertex gets normally distributed noise with standard deviation sigma.
+        NORMAL,    ///< Each vertex moves along its normal by normally distributed noise with standard deviation sigma.
+        IMPULSE    /**< A random fraction of the vertices (outliers) move by exactly sigma in a uniformly random direction, and
+                        the rest stay where they are. */
+      };
+
+      DGP_ENUM_CLASS_BODY(NoiseModel)
+    };
+
+    typedef MeshCore::NormalWeighting NormalWeighting;  ///< How face normals are weighted in vertex normals.
+
+    /** %Options controlling a smoothing pass. */
+    struct SmoothingOptions
+    {
+      NeighbourhoodType neighbourhood;  ///< How face neighbourhoods are gathered (default NeighbourhoodType::GEODESIC).
+      SpatialIndexType spatial_index;   /**< Index used for Euclidean neighbourhoods (default SpatialIndexType::HASH_GRID). The
+                                             index is built over the face centroids at the start of each pass. */
+      NormalWeighting normal_weighting; /**< How face normals are weighted in the vertex normals recomputed after a pass
+                                             (default NormalWeighting::UNIFORM). */
+      bool fast_weights;                /**< Evaluate the weights of each neighbourhood in a batch, in single precision with
+                                             vector instructions (see GaussianWeights), instead of one at a time in double
+                                             precision (default false). Positions then differ by a tiny relative amount. */
+      uint8 const * vertex_mask;        /**< If non-null, a flag for each vertex in the order of the vertex list, and only
+                                             vertices with a nonzero flag are moved (default null, moving every vertex). The
+                                             faces of the others are still mollified and weighted in the updates of moved
+                                             vertices. */
+
+      /** Constructor. */
+      SmoothingOptions()
+      : neighbourhood(NeighbourhoodType::GEODESIC), spatial_index(SpatialIndexType::HASH_GRID),
+        normal_weighting(NormalWeighting::UNIFORM), fast_weights(false), vertex_mask(NULL)
+      {}
+
+      /** Get the default set of smoothing options. */
+      static SmoothingOptions const & defaults() { static SmoothingOptions const def; return def; }
+
+    }; // struct SmoothingOptions
+
+    /** %Options controlling mesh simplification (see decimateQuadricEdgeCollapse()). */
+    struct DecimationOptions
+    {
+      long target_faces;       ///< Stop when the mesh has no more than this many faces (default 0, no face target).
+      double max_error;        /**< Stop before a collapse whose quadric error exceeds this (default -1, no error bound). The
+                                    error is the root of the summed squared distances from the new vertex to the planes of
+                                    the original faces merged into it, so it is a distance. */
+      double boundary_weight;  /**< Weight of the planes added through boundary edges, perpendicular to their faces, which keep
+                                    the boundary from shrinking (default 1000). Zero lets boundaries move freely. */
+
+      /** Constructor. */
+      DecimationOptions() : target_faces(0), max_error(-1), boundary_weight(1000) {}
+
+      /** Get the default set of decimation options. */
+      static DecimationOptions const & defaults() { static DecimationOptions const def; return def; }
+
+    }; // struct DecimationOptions
+
+    /** %Options controlling noiseMesh(). */
+    struct NoiseOptions
+    {
+      NoiseModel model;           ///< Distribution of the displacements (default NoiseModel::GAUSSIAN).
+      uint64 seed;                /**< Seed of the counter-based generator (default 0). The noise of a vertex depends only on
+                                       the seed and the index of the vertex in the vertex list, so it is the same however many
+                                       threads are used. */
+      bool relative;              /**< Treat sigma as a multiple of the mean edge length of the mesh, instead of an absolute
+                                       distance (default false). */
+      double impulse_fraction;    ///< Fraction of the vertices displaced by NoiseModel::IMPULSE noise (default 0.05).
+      ThreadPool * thread_pool;   ///< Threads to use (default null, indicating ThreadPool::common()).
+
+      /** Constructor. */
+      NoiseOptions() : model(NoiseModel::GAUSSIAN), seed(0), relative(false), impulse_fraction(0.05), thread_pool(NULL) {}
+
+      /** Get the default set of noise options. */
+      static NoiseOptions const & defaults() { static NoiseOptions const def; return def; }
+
+    }; // struct NoiseOptions
+
+    typedef MeshLaplacian::Weighting LaplacianWeighting;  ///< Weights of the Laplacian used by fairImplicit().
+
+    /** %Options controlling fairImplicit(). */
+    struct FairingOptions
+    {
+      LaplacianWeighting weighting;      ///< Weights of the Laplacian (default LaplacianWeighting::COTANGENT).
+      long num_steps;                    /**< Number of steps (default 1). After the first, the values of the matrix are
+                                              recomputed at the new positions, keeping its pattern (MeshLaplacian::update()). */
+      long max_iterations;               ///< Maximum number of conjugate gradient iterations (default 1000).
+      double tolerance;                  /**< Relative residual at which the conjugate gradient solver stops (default 1e-6).
+                                              See ConjugateGradient::Options. */
+      NormalWeighting normal_weighting;  ///< How face normals are weighted in the new vertex normals (default UNIFORM).
+      ThreadPool * thread_pool;          ///< Threads to use (default null, indicating ThreadPool::common()).
+
+      /** Constructor. */
+      FairingOptions()
+      : weighting(LaplacianWeighting::COTANGENT), num_steps(1), max_iterations(1000), tolerance(1e-6),
+        normal_weighting(NormalWeighting::UNIFORM), thread_pool(NULL)
+      {}
+
+      /** Get the default set of fairing options. */
+      static FairingOptions const & defaults() { static FairingOptions const def; return def; }
+
+    }; // struct FairingOptions
+
+    /** Statistics of a run of fairImplicit(). */
+    struct FairingStats
+    {
+      long num_nonzeros;        ///< Number of entries of the sparse matrix.
+      long num_iterations;      ///< Total number of conjugate gradient iterations over the steps.
+      double residual;          ///< Largest relative residual over the three coordinates and the steps.
+      double assembly_time;     ///< Total time taken to assemble the matrix, in seconds.
+      double solve_time;        ///< Total time taken to solve the systems, in seconds.
+
+      /** Constructor. */
+      FairingStats() : num_nonzeros(0), num_iterations(0), residual(0), assembly_time(0), solve_time(0) {}
+
+    }; // struct FairingStats
+
+    /** Statistics of a run of decimateQuadricEdgeCollapse(). */
+    struct DecimationStats
+    {
+      long num_collapses;   ///< Number of edges collapsed.
+      long num_rejected;    /**< Number of candidate collapses skipped because they would make the surface non-manifold or
+                                 fold a face over. */
+      long num_stale;       ///< Number of queue entries discarded because their edge was removed or re-evaluated.
+      double max_error;     ///< Largest quadric error of a collapse performed.
+
+      /** Constructor. */
+      DecimationStats() : num_collapses(0), num_rejected(0), num_stale(0), max_error(0) {}
+
+    }; // struct DecimationStats
+
     /** Constructor. */
-    Mesh(std::string const & name = "AnonymousMesh") : NamedObject(name) {}
+    Mesh(std::string const & name = "AnonymousMesh") : NamedObject(name), core_needs_rebuild(true), statistics_dirty(true) {}
 
     /** Get an iterator pointing to the first vertex. */
     VertexConstIterator verticesBegin() const { return vertices.begin(); }
@@ -82,7 +251,11 @@ class Mesh : public virtual NamedObject, private Noncopyable
       vertices.clear();
       edges.clear();
       faces.clear();
+      free_vertices.clear();
+      free_edges.clear();
+      free_faces.clear();
       bounds = AxisAlignedBox3();
+      invalidateCore();
     }
 
     /** True if and only if the mesh contains no objects. */
@@ -104,9 +277,10 @@ class Mesh : public virtual NamedObject, private Noncopyable
      */
     Vertex * addVertex(Vector3 const & point)
     {
-      vertices.push_back(Vertex(point));
+      Vertex * vertex = newElement(vertices, free_vertices, Vertex(point));
       bounds.merge(point);
-      return &vertices.back();
+      invalidateCore();
+      return vertex;
     }
 
     /**
@@ -116,9 +290,10 @@ class Mesh : public virtual NamedObject, private Noncopyable
      */
     Vertex * addVertex(Vector3 const & point, Vector3 const & normal, ColorRGBA const & color = ColorRGBA(1, 1, 1, 1))
     {
-      vertices.push_back(Vertex(point, normal, color));
+      Vertex * vertex = newElement(vertices, free_vertices, Vertex(point, normal, color));
       bounds.merge(point);
-      return &vertices.back();
+      invalidateCore();
+      return vertex;
     }
 
     /**
@@ -147,8 +322,8 @@ class Mesh : public virtual NamedObject, private Noncopyable
       }
 
       // Create the (initially empty) face
-      faces.push_back(Face());
-      Face * face = &(*faces.rbegin());
+      invalidateCore();
+      Face * face = newElement(faces, free_faces, Face());
 
       // Add the loop of vertices to the face
       VertexInputIterator next = vbegin;
@@ -162,8 +337,7 @@ class Mesh : public virtual NamedObject, private Noncopyable
         Edge * edge = (*vi)->getEdgeTo(*next);
         if (!edge)
         {
-          edges.push_back(Edge(*vi, *next));
-          edge = &(*edges.rbegin());
+          edge = newElement(edges, free_edges, Edge(*vi, *next));
 
           (*vi)->addEdge(edge);
           (*next)->addEdge(edge);
@@ -183,28 +357,23 @@ class Mesh : public virtual NamedObject, private Noncopyable
 
     /**
      * Remove a face of the mesh. This does NOT remove any vertices or edges. Iterators to the face list remain valid unless the
-     * iterator pointed to the removed face.
-     *
-     * This is a relatively slow operation since the face needs to be looked up in the face list
-     * (linear in number of faces). For speed, use removeFace(FaceIterator).
+     * iterator pointed to the removed face. The face is found from its handle, so this takes time proportional to the size of
+     * the face, not of the mesh.
      *
-     * @return True if the face was found and removed, else false.
+     * @return True if the face was removed, false if it had already been removed.
      */
     bool removeFace(Face * face)
     {
-      for (FaceIterator fi = faces.begin(); fi != faces.end(); ++fi)
-        if (&(*fi) == face)
-          return removeFace(fi);
+      if (!face || face->isRemoved())
+        return false;
 
-      return false;
+      return removeFace(face->handle);
     }
 
     /**
      * Remove a face of the mesh. This does NOT remove any vertices or edges. Iterators to the face list remain valid unless the
      * iterator pointed to the removed face.
      *
-     * Use this version in preference to removeFace(Face const *) where possible.
-     *
      * @return True if the face was found and removed, else false.
      */
     bool removeFace(FaceIterator face)
@@ -217,7 +386,8 @@ class Mesh : public virtual NamedObject, private Noncopyable
       for (typename Face::EdgeIterator fei = face->edges.begin(); fei != face->edges.end(); ++fei)
         (*fei)->removeFace(fp);
 
-      faces.erase(face);
+      deleteElement(faces, free_faces, fp);
+      invalidateCore();
 
       return true;
     }
@@ -232,9 +402,79 @@ class Mesh : public virtual NamedObject, private Noncopyable
      */
     Vertex * collapseEdge(Edge * edge);
 
-    /** Draw the mesh on a render_system. */
+    /**
+     * Simplify the mesh by repeatedly collapsing the edge of least quadric error (Garland and Heckbert, "Surface Simplification
+     * Using Quadric Error Metrics", SIGGRAPH 1997). Each vertex carries a quadric measuring squared distance to the planes of
+     * the faces merged into it, and the vertex left by a collapse is placed where the sum of the two endpoint quadrics is
+     * smallest. Collapses that would violate the link condition (making the surface non-manifold) or flip a face are skipped.
+     * Candidates wait in a priority queue; entries made stale by nearby collapses are discarded as they are popped, instead of
+     * being searched for and removed. The edges queued together (all edges at the start, and the edges of the vertex left by
+     * each collapse) have their quadrics solved as one batch by Matrix3Batch::invert().
+     *
+     * Runs until the face target is reached, the cheapest remaining collapse exceeds the error bound, or no valid collapse is
+     * left. Face and vertex normals are kept up to date. Vertices with precomputed normals keep them unless they are moved.
+     *
+     * @return The number of edges collapsed.
+     */
+    long decimateQuadricEdgeCollapse(DecimationOptions const & options = DecimationOptions::defaults(),
+                                     DecimationStats * stats = NULL);
+
+    /**
+     * Replace the contents of the mesh with vertices and faces given as flat arrays. The result is the same as calling clear(),
+     * then addVertex() for each vertex and addFace() for each face in order, but each edge is found in a hash table keyed by its
+     * endpoints instead of by searching the edge lists of vertices. Faces with fewer than 3 vertices are skipped with a warning.
+     *
+     * @param num_vertices The number of vertices.
+     * @param positions The positions of the vertices.
+     * @param num_faces The number of faces.
+     * @param face_offsets The position of the first vertex of each face in \a face_indices, followed by the total number of
+     *   indices (so there are \a num_faces + 1 entries).
+     * @param face_indices The vertex indices of all faces, concatenated. Must be less than \a num_vertices.
+     */
+    void setFromArrays(long num_vertices, Vector3 const * positions, long num_faces, uint32 const * face_offsets,
+                       uint32 const * face_indices);
+
+    /**
+     * Get the compact, array-based representation of the mesh. The arrays are rebuilt if the topology has changed since the
+     * last call, else only the vertex positions and normals are refreshed from the mesh elements. After modifying attributes in
+     * the core, call MeshCore::writeAttributes() to copy them back to the mesh.
+     */
+    MeshCore & getCore();
+
+    /**
+     * Draw the mesh on a render_system. If \a use_buffers, \a use_vertex_data and not \a send_colors are all true, the mesh is
+     * drawn from vertex and index buffers kept by the mesh (see MeshRenderBuffer), which are only sent again when the mesh
+     * changes. Otherwise every face is sent in immediate mode.
+     */
     void draw(Graphics::RenderSystem & render_system, bool draw_edges = false, bool use_vertex_data = false,
-              bool send_colors = false) const;
+              bool send_colors = false, bool use_buffers = true) const;
+
+    /** Get the vertex and index buffers used to draw the mesh. */
+    MeshRenderBuffer const & getRenderBuffer() const { return render_buffer; }
+
+    /**
+     * Find the vertex under a position on the screen, as seen by a camera: the vertex nearest the point where the ray through
+     * the position (see MeshPicker::computeRay()) first hits the mesh, among the vertices of the face that is hit. Returns null
+     * if the ray misses the mesh. The hierarchy used to find the face is only rebuilt when the topology changes, and refitted
+     * when vertices move, so repeated picks on an unchanged mesh do not touch the mesh elements.
+     */
+    Vertex * pickVertex(Camera const & camera, Vector2 const & screen_pos);
+
+    /** Get the hierarchy used to pick elements, updating it first if the mesh has changed. */
+    MeshPicker const & getPicker();
+
+    /**
+     * Note that the positions or normals of the vertices at positions [begin, end) of the vertex list were changed, so draw()
+     * sends them again. If \a end is negative, the range extends to the last vertex. Functions of this class that move vertices
+     * call this themselves, and topology changes are tracked automatically, so this is only needed after modifying vertices
+     * directly or through the core.
+     */
+    void invalidateVertexData(long begin = 0, long end = -1)
+    {
+      render_buffer.invalidateVertices(begin, end < 0 ? numVertices() : end);
+      picker.invalidateVertices();
+      statistics_dirty = true;
+    }
 
     /** Update the bounding box of the mesh. */
     void updateBounds()
@@ -247,24 +487,72 @@ class Mesh : public virtual NamedObject, private Noncopyable
     /** Get the bounding box of the mesh. */
     AxisAlignedBox3 const & getAABB() const { return bounds; }
 
-    /** Load the mesh from a disk file. */
+    /**
+     * Load the mesh from a disk file. The format is chosen by extension: <tt>.off</tt> for OFF, <tt>.bmesh</tt> for the binary
+     * format written by save(), which loads much faster since it stores the adjacencies as well as the geometry.
+     */
     bool load(std::string const & path);
 
-    /** Save the mesh to a disk file. */
+    /** Save the mesh to a disk file, choosing the format by extension as load() does. */
     bool save(std::string const & path) const;
 
-    /** Bilateral smooth a mesh given sigmaC and sigmaS */
-    void bilateralSmooth(double sigma_c, double sigma_s);
+    /**
+     * Recompute all face normals from the vertex positions, then all vertex normals except precomputed ones from the face
+     * normals, in parallel (see MeshCore::updateNormals()). Face and vertex normals kept up to date by adding and removing
+     * faces always use uniform weights.
+     */
+    void updateNormals(NormalWeighting weighting = NormalWeighting::UNIFORM, ThreadPool * pool = NULL);
 
-    /** noise the mesh */
-    void noiseMesh(double sigma);
+    /**
+     * Bilateral smooth a mesh given sigmaC and sigmaS. Face and vertex normals are recomputed after the pass, so the mesh is
+     * left with normals matching its new shape.
+     */
+    void bilateralSmooth(double sigma_c, double sigma_s, SmoothingOptions const & options = SmoothingOptions::defaults());
 
-    /** get average neighbour distance */
-    Real getAverageDistance();
+    /**
+     * Apply steps of implicit fairing (Desbrun et al., SIGGRAPH 1999): solve <tt>(I - lambda L) X = X0</tt> for the new
+     * vertex positions X, where X0 are the current positions and L is the Laplacian (see MeshLaplacian), then recompute all
+     * normals. A large step damps high frequencies as much as many explicit smoothing passes, at the cost of one sparse solve,
+     * without the explicit passes' limit on the step size. Like diffusion, it also shrinks the mesh.
+     *
+     * The matrix is assembled in parallel and the three coordinates are solved together by ConjugateGradient, in parallel,
+     * starting from the current positions. The result does not depend on the number of threads. Further steps
+     * (FairingOptions::num_steps) reweight the Laplacian at the new positions but reuse the pattern of the matrix.
+     *
+     * @param lambda The size of each step. With uniform weights it is a number of umbrella steps. With cotangent weights it is
+     *   in units of the squared mean edge length of the mesh, so the same value smooths meshes of any scale alike.
+     * @param options Options controlling the steps.
+     * @param stats If non-null, used to return statistics of the steps.
+     *
+     * @return True if the solver converged to the tolerance in every step, else false (the vertices are still moved to its
+     *   last estimate).
+     */
+    bool fairImplicit(double lambda, FairingOptions const & options = FairingOptions::defaults(), FairingStats * stats = NULL);
 
-    void mollify(double sigma_s, double sigma_c);
+    /**
+     * Add random noise to the vertex positions, then recompute all normals. The vertices are processed in parallel, and the
+     * result is reproducible: it depends only on the vertex list, sigma and the options, not on the number of threads.
+     *
+     * @param sigma The scale of the noise (see NoiseModel), as a distance or, if NoiseOptions::relative is set, a multiple of
+     *   the mean edge length.
+     * @param options Options controlling the noise.
+     */
+    void noiseMesh(double sigma, NoiseOptions const & options = NoiseOptions::defaults());
+
+    /**
+     * Get summary statistics of the mesh, such as its mean edge length (see MeshStatistics). They are computed in parallel on
+     * the first call, and cached until the topology changes or invalidateVertexData() is called, so choosing parameters from
+     * them again on an unchanged mesh costs nothing.
+     *
+     * @param pool Threads to compute the statistics with, if needed. If null, ThreadPool::common() is used.
+     */
+    MeshStatistics const & getStatistics(ThreadPool * pool = NULL);
+
+    void mollify(double sigma_s, double sigma_c, SmoothingOptions const & options = SmoothingOptions::defaults());
 
   private:
+    friend class MeshRenderBuffer;
+
     /**
      * Utility function to draw a face. Must be enclosed in the appropriate
      * RenderSystem::beginPrimitive()/RenderSystem::endPrimitive() block.
@@ -291,21 +579,88 @@ class Mesh : public virtual NamedObject, private Noncopyable
       }
     }
 
+    /** Mark the compact core and the render buffers as out of date after a change to the topology. */
+    void invalidateCore()
+    {
+      core_needs_rebuild = true;
+      render_buffer.invalidateTopology();
+      picker.invalidateTopology();
+      statistics_dirty = true;
+    }
+
     /** If two edges of the mesh have the same endpoints, merge them into a single edge, which is returned by the function. */
     Edge * mergeEdges(Edge * e0, Edge * e1);
 
+    /**
+     * Append an element to one of the element lists, reusing a node from the corresponding free list if it has one, and record
+     * the element's handle (its position in the list).
+     *
+     * @return A pointer to the new element.
+     */
+    template <typename T> static T * newElement(std::list<T> & list, std::list<T> & free_list, T const & value)
+    {
+      if (free_list.empty())
+        list.push_back(value);
+      else
+      {
+        list.splice(list.end(), free_list, free_list.begin());
+        list.back() = value;
+      }
+
+      T * elem = &list.back();
+      elem->handle = --list.end();
+      return elem;
+    }
+
+    /**
+     * Remove an element from one of the element lists in constant time, by moving its node to the corresponding free list. The
+     * element is reset, releasing its adjacency lists, and marked as removed; its memory stays valid until it is reused by
+     * newElement() or the mesh is cleared.
+     */
+    template <typename T> static void deleteElement(std::list<T> & list, std::list<T> & free_list, T * elem)
+    {
+      free_list.splice(free_list.begin(), list, elem->handle);
+      *elem = T();
+      elem->removed = true;
+    }
+
+    /**
+     * Set the index of every vertex, edge and face to its position in the corresponding list. This is the same numbering as
+     * MeshCore uses, so it never invalidates the core.
+     */
+    void numberElements() const;
+
     /** Load the mesh from an OFF file. */
     bool loadOFF(std::string const & path);
 
     /** Save the mesh to an OFF file. */
     bool saveOFF(std::string const & path) const;
 
+    /** Load the mesh from a binary mesh file (see saveBinary()). */
+    bool loadBinary(std::string const & path);
+
+    /**
+     * Save the mesh to a binary mesh file, which stores the positions, normals and all adjacency lists of the elements so it
+     * can be loaded without rebuilding any topology, and restores exactly the same mesh.
+     */
+    bool saveBinary(std::string const & path) const;
+
     FaceList         faces;     ///< Set of mesh faces.
     VertexList       vertices;  ///< Set of mesh vertices.
     EdgeList         edges;     ///< Set of mesh edges.
+    FaceList         free_faces;     ///< Removed faces, whose nodes are reused by new faces.
+    VertexList       free_vertices;  ///< Removed vertices, whose nodes are reused by new vertices.
+    EdgeList         free_edges;     ///< Removed edges, whose nodes are reused by new edges.
     AxisAlignedBox3  bounds;    ///< Mesh bounding box.
+    MeshCore         core;      ///< Compact array representation of the mesh.
+    bool             core_needs_rebuild;  ///< Has the topology changed since the core was last built?
+    mutable MeshRenderBuffer render_buffer;  ///< Vertex and index buffers for drawing.
+    MeshPicker       picker;    ///< Hierarchy over the faces, for picking.
+    MeshStatistics   statistics;        ///< Cached summary statistics.
+    bool             statistics_dirty;  ///< Has the mesh changed since the statistics were last computed?
 
     mutable std::vector<Vertex *> face_vertices;  ///< Internal cache of vertex pointers for a face.
+    std::unordered_map<Vertex const *, Edge *> edges_by_endpoint;  ///< Scratch table for finding duplicate edges at a vertex.
 
 }; // class Mesh
 
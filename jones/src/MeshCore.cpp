@@ -0,0 +1,468 @@
+#include "MeshCore.hpp"
+#include "Mesh.hpp"
+#include <algorithm>
+#include <cmath>
+
+MeshCore::Index const MeshCore::NONE;
+
+void
+MeshCore::clear()
+{
+  positions.clear();
+  normals.clear();
+  normal_factors.clear();
+  precomputed_normals.clear();
+  face_normals.clear();
+  face_offsets.clear();
+  face_indices.clear();
+  edge_endpoints.clear();
+  vv_offsets.clear();
+  vv_indices.clear();
+  vf_offsets.clear();
+  vf_indices.clear();
+  vf_corners.clear();
+  face_areas.clear();
+  corner_angles.clear();
+  face_marks.clear();
+  vertex_marks.clear();
+  vertex_refs.clear();
+  face_refs.clear();
+}
+
+void
+MeshCore::build(Mesh & mesh)
+{
+  clear();
+
+  size_t nv = (size_t)mesh.numVertices();
+  size_t nf = (size_t)mesh.numFaces();
+  size_t ne = (size_t)mesh.numEdges();
+
+  alwaysAssertM(nv < (size_t)NONE && nf < (size_t)NONE && ne < (size_t)NONE,
+                "MeshCore: Mesh is too large for 32-bit indices");
+
+  // Number the elements in list order
+  vertex_refs.reserve(nv);
+  Index index = 0;
+  for (Mesh::VertexIterator vi = mesh.verticesBegin(); vi != mesh.verticesEnd(); ++vi, ++index)
+  {
+    vi->index = index;
+    vertex_refs.push_back(&(*vi));
+  }
+
+  face_refs.reserve(nf);
+  index = 0;
+  for (Mesh::FaceIterator fi = mesh.facesBegin(); fi != mesh.facesEnd(); ++fi, ++index)
+  {
+    fi->index = index;
+    face_refs.push_back(&(*fi));
+  }
+
+  // Faces
+  face_offsets.reserve(nf + 1);
+  face_offsets.push_back(0);
+  for (size_t f = 0; f < nf; ++f)
+  {
+    MeshFace const * face = face_refs[f];
+    for (MeshFace::VertexConstIterator fvi = face->verticesBegin(); fvi != face->verticesEnd(); ++fvi)
+      face_indices.push_back((*fvi)->index);
+
+    face_offsets.push_back((Index)face_indices.size());
+  }
+
+  // Edges
+  edge_endpoints.reserve(2 * ne);
+  for (Mesh::EdgeConstIterator ei = mesh.edgesBegin(); ei != mesh.edgesEnd(); ++ei)
+  {
+    edge_endpoints.push_back(ei->getEndpoint(0)->index);
+    edge_endpoints.push_back(ei->getEndpoint(1)->index);
+  }
+
+  // Vertex adjacencies, preserving the order of the per-vertex lists
+  vv_offsets.reserve(nv + 1);
+  vf_offsets.reserve(nv + 1);
+  vv_indices.reserve(2 * ne);
+  vf_indices.reserve(face_indices.size());
+  vf_corners.reserve(face_indices.size());
+  vv_offsets.push_back(0);
+  vf_offsets.push_back(0);
+  for (size_t v = 0; v < nv; ++v)
+  {
+    MeshVertex * vertex = vertex_refs[v];
+
+    for (MeshVertex::EdgeConstIterator vei = vertex->edgesBegin(); vei != vertex->edgesEnd(); ++vei)
+      vv_indices.push_back((*vei)->getOtherEndpoint(vertex)->index);
+
+    for (MeshVertex::FaceConstIterator vfi = vertex->facesBegin(); vfi != vertex->facesEnd(); ++vfi)
+    {
+      Index f = (*vfi)->index;
+      Index corner = face_offsets[f];
+      while (corner + 1 < face_offsets[f + 1] && face_indices[corner] != (Index)v)
+        corner++;
+
+      vf_indices.push_back(f);
+      vf_corners.push_back(corner);
+    }
+
+    vv_offsets.push_back((Index)vv_indices.size());
+    vf_offsets.push_back((Index)vf_indices.size());
+  }
+
+  positions.resize(nv);
+  normals.resize(nv);
+  normal_factors.resize(nv);
+  precomputed_normals.resize(nv);
+  face_normals.resize(nf);
+  face_areas.resize(nf);
+
+  readAttributes();
+}
+
+void
+MeshCore::readAttributes()
+{
+  for (size_t v = 0; v < vertex_refs.size(); ++v)
+  {
+    MeshVertex const * vertex = vertex_refs[v];
+    positions[v] = vertex->getPosition();
+    normals[v] = vertex->getNormal();
+    normal_factors[v] = vertex->normal_normalization_factor;
+    precomputed_normals[v] = (vertex->hasPrecomputedNormal() ? 1 : 0);
+  }
+
+  for (size_t f = 0; f < face_refs.size(); ++f)
+    face_normals[f] = face_refs[f]->getNormal();
+}
+
+void
+MeshCore::writeAttributes() const
+{
+  for (size_t v = 0; v < vertex_refs.size(); ++v)
+  {
+    MeshVertex * vertex = vertex_refs[v];
+    vertex->setPosition(positions[v]);
+    vertex->setNormal(normals[v]);
+    vertex->normal_normalization_factor = normal_factors[v];
+    vertex->has_precomputed_normal = (precomputed_normals[v] != 0);
+  }
+
+  for (size_t f = 0; f < face_refs.size(); ++f)
+    face_refs[f]->setNormal(face_normals[f]);
+}
+
+Vector3 const &
+MeshCore::updateNormal(Index v)
+{
+  Index const * vf = vertexFaces(v);
+  int n = numVertexFaces(v);
+  if (n > 0)
+  {
+    Vector3 sum_normals = Vector3::zero();
+    for (int i = 0; i < n; ++i)
+      sum_normals += face_normals[vf[i]];
+
+    normal_factors[v] = sum_normals.length();
+    normals[v] = (normal_factors[v] < 1e-20f ? Vector3::zero() : sum_normals / normal_factors[v]);
+  }
+  else
+  {
+    normals[v] = Vector3::zero();
+    normal_factors[v] = 0;
+  }
+
+  precomputed_normals[v] = 0;
+  return normals[v];
+}
+
+Vector3 const &
+MeshCore::updateFaceNormal(Index f)
+{
+  Index const * fv = faceVertices(f);
+  int n = numFaceVertices(f);
+
+  // Assume the face is planar
+  if (n > 3)
+  {
+    // A vertex might be a concave corner -- we need to add up the cross products at all vertices
+    Vector3 sum_cross = Vector3::zero();
+    for (int i = 0; i < n; ++i)
+    {
+      Vector3 const & p1 = positions[fv[(i + 1) % n]];
+      Vector3 e1 = positions[fv[i]] - p1;
+      Vector3 e2 = positions[fv[(i + 2) % n]] - p1;
+      sum_cross += e2.cross(e1);
+    }
+
+    face_normals[f] = sum_cross.unit();
+  }
+  else
+  {
+    Vector3 e1 = positions[fv[0]] - positions[fv[1]];
+    Vector3 e2 = positions[fv[2]] - positions[fv[1]];
+    face_normals[f] = e2.cross(e1).unit();  // counter-clockwise
+  }
+
+  return face_normals[f];
+}
+
+void
+MeshCore::findNeighbourVertices(Index v, double max_dist, Scratch & scratch, std::vector<Index> & neighbours) const
+{
+  neighbours.clear();
+  scratch.begin();
+
+  std::vector<Index> & q = scratch.queue;
+  Vector3 const & p = positions[v];
+
+  scratch.visit(v);
+  q.push_back(v);
+
+  for (size_t head = 0; head < q.size(); ++head)
+  {
+    Index curr = q[head];
+    Index const * nbrs = vertexNeighbours(curr);
+    int n = numVertexNeighbours(curr);
+    for (int i = 0; i < n; ++i)
+    {
+      Index u = nbrs[i];
+      if (scratch.isVisited(u))
+        continue;
+
+      scratch.visit(u);
+      double distance = (positions[u] - p).length();
+      if (distance < max_dist)
+        q.push_back(u);
+
+      neighbours.push_back(u);
+    }
+  }
+}
+
+void
+MeshCore::findNeighbourFaces(Index v, double max_dist, Scratch & scratch, std::vector<Index> & neighbours,
+                             Vector3 const * face_centroids) const
+{
+  neighbours.clear();
+  scratch.begin();
+
+  std::vector<Index> & q = scratch.queue;
+  Vector3 const & p = positions[v];
+
+  Index const * vf = vertexFaces(v);
+  int nvf = numVertexFaces(v);
+  for (int i = 0; i < nvf; ++i)
+  {
+    q.push_back(vf[i]);
+    neighbours.push_back(vf[i]);
+    scratch.visit(vf[i]);
+  }
+
+  for (size_t head = 0; head < q.size(); ++head)
+  {
+    Index curr = q[head];
+    Index const * fv = faceVertices(curr);
+    int n = numFaceVertices(curr);
+    for (int i = 0; i < n; ++i)
+    {
+      Index const * wf = vertexFaces(fv[i]);
+      int nwf = numVertexFaces(fv[i]);
+      for (int j = 0; j < nwf; ++j)
+      {
+        Index g = wf[j];
+        if (scratch.isVisited(g))
+          continue;
+
+        double dist = (p - (face_centroids ? face_centroids[g] : getFaceCentroid(g))).length();
+        if (dist < max_dist)
+        {
+          q.push_back(g);
+          neighbours.push_back(g);
+          scratch.visit(g);
+        }
+      }
+    }
+  }
+}
+
+void
+MeshCore::findNeighbourVertices(Index v, Real radius, PointIndex3 const & index, Scratch & scratch,
+                                std::vector<Index> & neighbours) const
+{
+  index.rangeQuery(positions[v], radius, neighbours);
+
+  scratch.begin();
+  scratch.visit(v);
+
+  size_t n = 0;
+  for (size_t i = 0; i < neighbours.size(); ++i)
+    if (!scratch.isVisited(neighbours[i]))
+    {
+      scratch.visit(neighbours[i]);
+      neighbours[n++] = neighbours[i];
+    }
+
+  neighbours.resize(n);
+
+  Index const * nbrs = vertexNeighbours(v);
+  for (int i = 0, nn = numVertexNeighbours(v); i < nn; ++i)
+    if (!scratch.isVisited(nbrs[i]))
+    {
+      scratch.visit(nbrs[i]);
+      neighbours.push_back(nbrs[i]);
+    }
+
+  std::sort(neighbours.begin(), neighbours.end());
+}
+
+void
+MeshCore::findNeighbourFaces(Index v, Real radius, PointIndex3 const & index, Scratch & scratch,
+                             std::vector<Index> & neighbours) const
+{
+  index.rangeQuery(positions[v], radius, neighbours);
+
+  scratch.begin();
+  for (size_t i = 0; i < neighbours.size(); ++i)
+    scratch.visit(neighbours[i]);
+
+  Index const * vf = vertexFaces(v);
+  for (int i = 0, n = numVertexFaces(v); i < n; ++i)
+    if (!scratch.isVisited(vf[i]))
+    {
+      scratch.visit(vf[i]);
+      neighbours.push_back(vf[i]);
+    }
+
+  std::sort(neighbours.begin(), neighbours.end());
+}
+
+void
+MeshCore::updateFaceGeometry(Index const * list, long n, bool angles, ThreadPool & pool)
+{
+  if (angles) corner_angles.resize(face_indices.size());
+
+  pool.parallelFor(0, n, [&](long lo, long hi, long) {
+    for (long i = lo; i < hi; ++i)
+    {
+      Index f = (list ? list[i] : (Index)i);
+      Index first = face_offsets[f];
+      Index const * fv = &face_indices[first];
+      int nfv = (int)(face_offsets[f + 1] - first);
+
+      if (nfv == 3)
+      {
+        // Same arithmetic as updateFaceNormal(), so the normals are identical
+        Vector3 e1 = positions[fv[0]] - positions[fv[1]];
+        Vector3 e2 = positions[fv[2]] - positions[fv[1]];
+        Vector3 cross = e2.cross(e1);
+        face_normals[f] = cross.unit();
+        face_areas[f] = (Real)0.5 * cross.length();
+      }
+      else
+      {
+        Vector3 sum_cross = Vector3::zero(), vector_area = Vector3::zero();
+        for (int j = 0; j < nfv; ++j)
+        {
+          Vector3 const & p1 = positions[fv[(j + 1) % nfv]];
+          Vector3 e1 = positions[fv[j]] - p1;
+          Vector3 e2 = positions[fv[(j + 2) % nfv]] - p1;
+          sum_cross += e2.cross(e1);
+          vector_area += positions[fv[j]].cross(p1);
+        }
+
+        face_normals[f] = sum_cross.unit();
+        face_areas[f] = (Real)0.5 * vector_area.length();
+      }
+
+      if (angles)
+      {
+        for (int j = 0; j < nfv; ++j)
+        {
+          Vector3 const & p = positions[fv[j]];
+          Vector3 a = positions[fv[(j + nfv - 1) % nfv]] - p;
+          Vector3 b = positions[fv[(j + 1) % nfv]] - p;
+          corner_angles[first + j] = std::atan2(a.cross(b).length(), a.dot(b));
+        }
+      }
+    }
+  });
+}
+
+void
+MeshCore::updateVertexNormals(Index const * list, long n, NormalWeighting weighting, ThreadPool & pool)
+{
+  pool.parallelFor(0, n, [&](long lo, long hi, long) {
+    for (long i = lo; i < hi; ++i)
+    {
+      Index v = (list ? list[i] : (Index)i);
+      if (precomputed_normals[v])
+        continue;
+
+      // Summed in the order of the vertex's face list, as in updateNormal()
+      Index begin = vf_offsets[v], end = vf_offsets[v + 1];
+      Vector3 sum_normals = Vector3::zero();
+      switch (weighting)
+      {
+        case NormalWeighting::AREA:
+          for (Index j = begin; j < end; ++j)
+            sum_normals += face_areas[vf_indices[j]] * face_normals[vf_indices[j]];
+          break;
+
+        case NormalWeighting::ANGLE:
+          for (Index j = begin; j < end; ++j)
+            sum_normals += corner_angles[vf_corners[j]] * face_normals[vf_indices[j]];
+          break;
+
+        default:
+          for (Index j = begin; j < end; ++j)
+            sum_normals += face_normals[vf_indices[j]];
+      }
+
+      normal_factors[v] = sum_normals.length();
+      normals[v] = (normal_factors[v] < 1e-20f ? Vector3::zero() : sum_normals / normal_factors[v]);
+    }
+  });
+}
+
+void
+MeshCore::updateNormals(NormalWeighting weighting, ThreadPool * pool)
+{
+  ThreadPool & p = (pool ? *pool : ThreadPool::common());
+  updateFaceGeometry(NULL, numFaces(), weighting == NormalWeighting::ANGLE, p);
+  updateVertexNormals(NULL, numVertices(), weighting, p);
+}
+
+long
+MeshCore::updateNormals(Index const * moved, long num_moved, NormalWeighting weighting, ThreadPool * pool)
+{
+  ThreadPool & p = (pool ? *pool : ThreadPool::common());
+
+  // The marks are all clear between calls, so they only need to be grown when the arrays have been rebuilt
+  face_marks.resize(face_normals.size(), 0);
+  vertex_marks.resize(positions.size(), 0);
+  refresh_faces.clear();
+  refresh_vertices.clear();
+
+  for (long i = 0; i < num_moved; ++i)
+  {
+    Index const * vf = vertexFaces(moved[i]);
+    for (int j = 0, n = numVertexFaces(moved[i]); j < n; ++j)
+      if (!face_marks[vf[j]]) { face_marks[vf[j]] = 1; refresh_faces.push_back(vf[j]); }
+  }
+
+  for (size_t i = 0; i < refresh_faces.size(); ++i)
+  {
+    Index const * fv = faceVertices(refresh_faces[i]);
+    for (int j = 0, n = numFaceVertices(refresh_faces[i]); j < n; ++j)
+      if (!vertex_marks[fv[j]] && !precomputed_normals[fv[j]]) { vertex_marks[fv[j]] = 1; refresh_vertices.push_back(fv[j]); }
+  }
+
+  // Face normals are all written before any vertex normal reads them
+  updateFaceGeometry(refresh_faces.empty() ? NULL : &refresh_faces[0], (long)refresh_faces.size(),
+                     weighting == NormalWeighting::ANGLE, p);
+  updateVertexNormals(refresh_vertices.empty() ? NULL : &refresh_vertices[0], (long)refresh_vertices.size(), weighting, p);
+
+  for (size_t i = 0; i < refresh_faces.size(); ++i) face_marks[refresh_faces[i]] = 0;
+  for (size_t i = 0; i < refresh_vertices.size(); ++i) vertex_marks[refresh_vertices[i]] = 0;
+
+  return (long)refresh_vertices.size();
+}
@@ -0,0 +1,344 @@
+#ifndef __A3_MeshCore_hpp__
+#define __A3_MeshCore_hpp__
+
+#include "Common.hpp"
+#include "DGP/PointIndex3.hpp"
+#include "DGP/ThreadPool.hpp"
+#include "DGP/Vector3.hpp"
+#include <vector>
+
+// Forward declarations
+class Mesh;
+class MeshVertex;
+class MeshFace;
+
+/**
+ * Compact, index-based representation of a mesh, stored as flat arrays with 32-bit indices. Vertex attributes are kept in
+ * contiguous position/normal arrays, faces as a single index buffer with per-face offsets, and vertex-vertex and vertex-face
+ * adjacencies in compressed sparse row (CSR) form. The order of each adjacency row matches the order of the corresponding
+ * edge/face list of the MeshVertex, so traversals visit elements in exactly the same order as the linked representation.
+ *
+ * The core is owned by a Mesh, which keeps its list-based elements as the editable topology. The arrays are rebuilt when the
+ * topology changes, and attributes are copied between the two representations with readAttributes() and writeAttributes().
+ */
+class MeshCore
+{
+  public:
+    typedef uint32 Index;  ///< Index of a vertex, edge or face.
+
+    /** Sentinel value for an invalid index. */
+    static Index const NONE = 0xFFFFFFFF;
+
+    /** How the normals of the faces around a vertex are weighted to get the vertex normal (enum class). */
+    struct NormalWeighting
+    {
+      /** Supported values. */
+      enum Value
+      {
+        UNIFORM,  ///< All faces count equally, as in MeshVertex::updateNormal().
+        AREA,     ///< Each face is weighted by its area.
+        ANGLE     ///< Each face is weighted by its interior angle at the vertex.
+      };
+
+      DGP_ENUM_CLASS_BODY(NormalWeighting)
+    };
+
+    /**
+     * Scratch state for neighbourhood searches. The elements visited by a search are recorded in a small open-addressed hash
+     * set that grows with the size of the neighbourhood, not of the mesh, so the marks never live on the mesh itself and each
+     * thread can cheaply keep its own instance.
+     */
+    class Scratch
+    {
+      public:
+        /** Constructor. */
+        Scratch() : num_visited(0), shift(32 - 6) { slots.assign((size_t)1 << 6, NONE); }
+
+        /** Start a new search, unmarking all elements. */
+        void begin()
+        {
+          for (size_t i = 0; i < used.size(); ++i)
+            slots[used[i]] = NONE;
+
+          used.clear();
+          num_visited = 0;
+          queue.clear();
+        }
+
+        /** Check if an element has been visited in the current search. */
+        bool isVisited(Index i) const
+        {
+          for (size_t s = hash(i); ; s = (s + 1) & (slots.size() - 1))
+          {
+            if (slots[s] == i) return true;
+            if (slots[s] == NONE) return false;
+          }
+        }
+
+        /** Mark an element as visited in the current search. */
+        void visit(Index i)
+        {
+          if (2 * (num_visited + 1) > slots.size())
+            grow();
+
+          size_t s = hash(i);
+          while (slots[s] != NONE)
+          {
+            if (slots[s] == i) return;
+            s = (s + 1) & (slots.size() - 1);
+          }
+
+          slots[s] = i;
+          used.push_back((Index)s);
+          num_visited++;
+        }
+
+      private:
+        friend class MeshCore;
+
+        /** Fibonacci hash of an index into the slot table. */
+        size_t hash(Index i) const { return (size_t)((i * (uint32)2654435769U) >> shift); }
+
+        /** Double the size of the slot table, reinserting the current marks. */
+        void grow()
+        {
+          std::vector<Index> old_used;
+          old_used.swap(used);
+          std::vector<Index> old_slots(slots.size() * 2, NONE);
+          old_slots.swap(slots);
+          shift--;
+          num_visited = 0;
+
+          for (size_t i = 0; i < old_used.size(); ++i)
+            visit(old_slots[old_used[i]]);
+        }
+
+        std::vector<Index> slots;  ///< Open-addressed hash table of visited elements.
+        std::vector<Index> used;   ///< Occupied slots, for fast clearing.
+        size_t num_visited;        ///< Number of visited elements.
+        int shift;                 ///< Right shift mapping a 32-bit hash to a slot.
+        std::vector<Index> queue;  ///< Breadth-first search queue.
+
+    }; // class Scratch
+
+    /** Constructor. */
+    MeshCore() {}
+
+    /** Rebuild all arrays from the elements of a mesh, in the order of the mesh's vertex, edge and face lists. */
+    void build(Mesh & mesh);
+
+    /** Deletes all data. */
+    void clear();
+
+    /** Copy vertex positions and normals, and face normals, from the mesh elements into the arrays. */
+    void readAttributes();
+
+    /** Copy vertex positions and normals, and face normals, from the arrays back to the mesh elements. */
+    void writeAttributes() const;
+
+    /** Get the number of vertices. */
+    long numVertices() const { return (long)positions.size(); }
+
+    /** Get the number of edges. */
+    long numEdges() const { return (long)(edge_endpoints.size() / 2); }
+
+    /** Get the number of faces. */
+    long numFaces() const { return face_offsets.empty() ? 0 : (long)face_offsets.size() - 1; }
+
+    /** Get the position of a vertex. */
+    Vector3 const & getPosition(Index v) const { return positions[v]; }
+
+    /** Set the position of a vertex. */
+    void setPosition(Index v, Vector3 const & p) { positions[v] = p; }
+
+    /**
+     * Exchange the array of vertex positions with another array, which must have one entry per vertex. Useful for swapping in
+     * a buffer of updated positions.
+     */
+    void swapPositions(std::vector<Vector3> & other)
+    {
+      alwaysAssertM(other.size() == positions.size(), "MeshCore: Position arrays must be of the same size");
+      positions.swap(other);
+    }
+
+    /** Get the array of all vertex positions. */
+    Vector3 const * getPositions() const { return positions.empty() ? NULL : &positions[0]; }
+
+    /** Get the normal of a vertex. */
+    Vector3 const & getNormal(Index v) const { return normals[v]; }
+
+    /** Set the normal of a vertex. */
+    void setNormal(Index v, Vector3 const & n) { normals[v] = n; }
+
+    /** Check if a vertex has a precomputed normal. */
+    bool hasPrecomputedNormal(Index v) const { return precomputed_normals[v] != 0; }
+
+    /**
+     * Recompute the normal of a vertex from the normals of its incident faces, exactly as MeshVertex::updateNormal() does, and
+     * return it.
+     */
+    Vector3 const & updateNormal(Index v);
+
+    /** Get the normal of a face. */
+    Vector3 const & getFaceNormal(Index f) const { return face_normals[f]; }
+
+    /**
+     * Recompute the normal of a face from the current vertex positions, exactly as MeshFace::updateNormal() does, and return
+     * it.
+     */
+    Vector3 const & updateFaceNormal(Index f);
+
+    /** Get the number of vertices of a face. */
+    int numFaceVertices(Index f) const { return (int)(face_offsets[f + 1] - face_offsets[f]); }
+
+    /** Get a pointer to the first of the consecutive vertex indices of a face. */
+    Index const * faceVertices(Index f) const { return &face_indices[face_offsets[f]]; }
+
+    /** Get the centroid of a face, computed from the current vertex positions. */
+    Vector3 getFaceCentroid(Index f) const
+    {
+      Index const * fv = faceVertices(f);
+      int n = numFaceVertices(f);
+      Vector3 centroid(0, 0, 0);
+      for (int i = 0; i < n; ++i)
+        centroid += positions[fv[i]];
+
+      return centroid / (Real)n;
+    }
+
+    /** Get an endpoint of an edge. \a i = 0 returns the first endpoint and \a i = 1 the second. */
+    Index getEdgeEndpoint(Index e, int i) const { return edge_endpoints[2 * e + i]; }
+
+    /** Get the number of vertices adjacent to a vertex. */
+    int numVertexNeighbours(Index v) const { return (int)(vv_offsets[v + 1] - vv_offsets[v]); }
+
+    /** Get a pointer to the first of the consecutive indices of the vertices adjacent to a vertex. */
+    Index const * vertexNeighbours(Index v) const { return &vv_indices[vv_offsets[v]]; }
+
+    /** Get the number of faces incident on a vertex. */
+    int numVertexFaces(Index v) const { return (int)(vf_offsets[v + 1] - vf_offsets[v]); }
+
+    /** Get a pointer to the first of the consecutive indices of the faces incident on a vertex. */
+    Index const * vertexFaces(Index v) const { return &vf_indices[vf_offsets[v]]; }
+
+    /** Get the mesh vertex corresponding to an index. */
+    MeshVertex * getVertex(Index v) const { return vertex_refs[v]; }
+
+    /** Get the mesh face corresponding to an index. */
+    MeshFace * getFace(Index f) const { return face_refs[f]; }
+
+    /**
+     * Breadth-first search over edges for the vertices around a vertex. Every newly reached vertex is returned, but only
+     * vertices closer than \a max_dist to the seed are expanded further. The seed itself is not returned. This is the
+     * array-based equivalent of the vertex neighbourhood search of MeshVertex.
+     *
+     * @param v The seed vertex.
+     * @param max_dist The maximum distance from the seed of an expanded vertex.
+     * @param scratch Visit marks.
+     * @param neighbours Used to return the neighbouring vertices. Cleared before use.
+     */
+    void findNeighbourVertices(Index v, double max_dist, Scratch & scratch, std::vector<Index> & neighbours) const;
+
+    /**
+     * Breadth-first search over vertex-face incidences for the faces around a vertex. The faces incident on the vertex are
+     * always returned; other faces are returned (and expanded) only if their centroids are closer than \a max_dist to the
+     * vertex. This is the array-based equivalent of the face neighbourhood search of MeshVertex.
+     *
+     * @param v The seed vertex.
+     * @param max_dist The maximum distance of a face centroid from the seed.
+     * @param scratch Visit marks.
+     * @param neighbours Used to return the neighbouring faces. Cleared before use.
+     * @param face_centroids If non-null, the centroids of all faces, which are read instead of being recomputed from the vertex
+     *   positions. They must be up to date for the search to return the same faces.
+     */
+    void findNeighbourFaces(Index v, double max_dist, Scratch & scratch, std::vector<Index> & neighbours,
+                            Vector3 const * face_centroids = NULL) const;
+
+    /**
+     * Find the vertices strictly closer than \a radius to a vertex using a spatial index over the vertex positions, plus the
+     * vertices adjacent to it (so the neighbourhood is never empty). The vertex itself is not returned. The neighbours are
+     * returned in ascending order of index, so the result does not depend on the type of index.
+     *
+     * @param v The seed vertex.
+     * @param radius The radius of the neighbourhood.
+     * @param index Spatial index over the vertex positions.
+     * @param scratch Used to remove duplicates.
+     * @param neighbours Used to return the neighbouring vertices. Cleared before use.
+     */
+    void findNeighbourVertices(Index v, Real radius, PointIndex3 const & index, Scratch & scratch,
+                               std::vector<Index> & neighbours) const;
+
+    /**
+     * Find the faces whose centroids are strictly closer than \a radius to a vertex using a spatial index over the face
+     * centroids, plus the faces incident on the vertex. The faces are returned in ascending order of index.
+     *
+     * @param v The seed vertex.
+     * @param radius The radius of the neighbourhood.
+     * @param index Spatial index over the face centroids.
+     * @param scratch Used to remove duplicates.
+     * @param neighbours Used to return the neighbouring faces. Cleared before use.
+     */
+    void findNeighbourFaces(Index v, Real radius, PointIndex3 const & index, Scratch & scratch,
+                            std::vector<Index> & neighbours) const;
+
+    /**
+     * Recompute all face normals from the current vertex positions, then the normals of all vertices without precomputed
+     * normals from the face normals. Each face normal is exactly the one updateFaceNormal() computes, and with uniform weights
+     * each vertex normal is exactly the one updateNormal() computes. Faces, then vertices, are processed in parallel.
+     *
+     * @param weighting How face normals are weighted in vertex normals.
+     * @param pool Threads to use. If null, ThreadPool::common() is used.
+     */
+    void updateNormals(NormalWeighting weighting = NormalWeighting::UNIFORM, ThreadPool * pool = NULL);
+
+    /**
+     * Recompute the normals of the faces incident on a set of moved vertices, then the normals of the vertices of those faces
+     * (except precomputed ones). The result is the same as that of updateNormals() if no other vertex has moved since the
+     * normals were last computed with the same weighting.
+     *
+     * @param moved The moved vertices, in any order. Duplicates are allowed.
+     * @param num_moved The number of entries in \a moved.
+     * @param weighting How face normals are weighted in vertex normals.
+     * @param pool Threads to use. If null, ThreadPool::common() is used.
+     *
+     * @return The number of vertex normals recomputed.
+     */
+    long updateNormals(Index const * moved, long num_moved, NormalWeighting weighting = NormalWeighting::UNIFORM,
+                       ThreadPool * pool = NULL);
+
+  private:
+    /**
+     * Recompute the normal, area and (if \a angles) corner angles of each face in a list, or of faces [0, n) if \a list is
+     * null.
+     */
+    void updateFaceGeometry(Index const * list, long n, bool angles, ThreadPool & pool);
+
+    /** Recompute the normal of each vertex in a list, or of vertices [0, n) if \a list is null. */
+    void updateVertexNormals(Index const * list, long n, NormalWeighting weighting, ThreadPool & pool);
+
+    std::vector<Vector3> positions;           ///< Vertex positions.
+    std::vector<Vector3> normals;             ///< Vertex normals.
+    std::vector<float> normal_factors;        ///< Lengths of the unnormalized vertex normals.
+    std::vector<uint8> precomputed_normals;   ///< Flags for vertices with precomputed normals.
+    std::vector<Vector3> face_normals;        ///< Face normals.
+    std::vector<Index> face_offsets;          ///< Offsets of each face's run in face_indices (numFaces() + 1 entries).
+    std::vector<Index> face_indices;          ///< Concatenated vertex loops of all faces.
+    std::vector<Index> edge_endpoints;        ///< Pairs of edge endpoints.
+    std::vector<Index> vv_offsets;            ///< Offsets of each vertex's run in vv_indices.
+    std::vector<Index> vv_indices;            ///< Vertex-vertex adjacency.
+    std::vector<Index> vf_offsets;            ///< Offsets of each vertex's run in vf_indices.
+    std::vector<Index> vf_indices;            ///< Vertex-face incidence.
+    std::vector<Index> vf_corners;            ///< Position in face_indices of the vertex's corner of each vf_indices entry.
+    std::vector<Real> face_areas;             ///< Face areas, computed with the face normals by updateNormals().
+    std::vector<Real> corner_angles;          /**< Interior angle of each corner in face_indices, computed by updateNormals()
+                                                   with angle weights. */
+    std::vector<uint8> face_marks;            ///< Scratch flags for collecting the faces to refresh.
+    std::vector<uint8> vertex_marks;          ///< Scratch flags for collecting the vertices to refresh.
+    std::vector<Index> refresh_faces;         ///< Scratch list of faces to refresh.
+    std::vector<Index> refresh_vertices;      ///< Scratch list of vertices to refresh.
+    std::vector<MeshVertex *> vertex_refs;    ///< Mesh vertex for each index.
+    std::vector<MeshFace *> face_refs;        ///< Mesh face for each index.
+
+}; // class MeshCore
+
+#endif
@@ -23,7 +23,7 @@ class MeshEdge
     typedef typename FaceList::const_iterator  FaceConstIterator;  ///< Const iterator over faces.
 
     /** Construct from two endpoints. */
-    MeshEdge(Vertex * v0 = NULL, Vertex * v1 = NULL)
+    MeshEdge(Vertex * v0 = NULL, Vertex * v1 = NULL) : index(0), handle(), removed(false)
     {
       endpoints[0] = v0;
       endpoints[1] = v1;
@@ -148,6 +148,12 @@ class MeshEdge
     /** Check if this is a boundary edge, i.e. if it is adjacent to at most one face. */
     bool isBoundary() const { return numFaces() <= 1; }
 
+    /**
+     * Check if the edge has been removed from its mesh. The memory of a removed edge is kept for reuse by the mesh, so
+     * pointers to it stay valid, but it has no adjacencies and must not be used otherwise.
+     */
+    bool isRemoved() const { return removed; }
+
   private:
     friend class Mesh;
 
@@ -196,6 +202,9 @@ class MeshEdge
 
     Vertex * endpoints[2];
     FaceList faces;
+    mutable uint32 index;  ///< Position of the edge in the edge list of the mesh, assigned when the mesh is saved.
+    std::list<MeshEdge>::iterator handle;  ///< Position of the edge in the edge list of the mesh, for constant-time removal.
+    bool removed;  ///< Has the edge been removed from its mesh?
 
 }; // class MeshEdge
 
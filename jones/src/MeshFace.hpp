@@ -33,7 +33,7 @@ class MeshFace
     bool isCovered = false;
 
     /** Construct with the given normal. */
-    MeshFace(Vector3 const & normal_ = Vector3::zero()) : normal(normal_) {}
+    MeshFace(Vector3 const & normal_ = Vector3::zero()) : normal(normal_), index(0), handle(), removed(false) {}
 
     /** Check if the face has a given vertex. */
     bool hasVertex(Vertex const * vertex) const
@@ -284,8 +284,15 @@ class MeshFace
      */
     bool contains(Vector3 const & p) const;
 
+    /**
+     * Check if the face has been removed from its mesh. The memory of a removed face is kept for reuse by the mesh, so
+     * pointers to it stay valid, but it has no adjacencies and must not be used otherwise.
+     */
+    bool isRemoved() const { return removed; }
+
   private:
     friend class Mesh;
+    friend class MeshCore;
     friend class MeshEdge;
 
     /** Add a reference to a vertex of this face. */
@@ -344,6 +351,9 @@ class MeshFace
     ColorRGBA color;
     VertexList vertices;
     EdgeList edges;
+    mutable uint32 index;  ///< Position of the face in the face list of the mesh, assigned by MeshCore and when saving.
+    std::list<MeshFace>::iterator handle;  ///< Position of the face in the face list of the mesh, for constant-time removal.
+    bool removed;  ///< Has the face been removed from its mesh?
 
 }; // class MeshFace
 
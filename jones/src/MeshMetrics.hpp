@@ -0,0 +1,131 @@
+#ifndef __A3_MeshMetrics_hpp__
+#define __A3_MeshMetrics_hpp__
+
+#include "Common.hpp"
+#include "DGP/Noncopyable.hpp"
+#include "DGP/ThreadPool.hpp"
+#include "DGP/TriangleBVH3.hpp"
+#include "DGP/Vector3.hpp"
+#include <string>
+#include <vector>
+
+// Forward declarations
+class Mesh;
+class MeshCore;
+
+/**
+ * Measures how far a mesh is from a reference mesh held in memory, typically the mesh before noise was added, to report the
+ * quality of denoising. Two kinds of metric are computed, in parallel:
+ *
+ * - Per-vertex metrics, if the mesh has as many vertices as the reference, so that vertices with the same index correspond:
+ *   the distance between corresponding positions (RMS, mean and maximum) and the angle between corresponding vertex normals.
+ * - Surface distances, which need no correspondence: the distance from each vertex of the mesh to the closest point of the
+ *   reference surface, and from each reference vertex to the mesh surface, found with bounding volume hierarchies over the
+ *   triangles of both. The larger of the two maxima is the (vertex-sampled) Hausdorff distance.
+ *
+ * Polygons are split into triangle fans. Results can be written as a single-line JSON object, for logging a run one pass at a
+ * time. Scratch arrays are kept between calls, so measuring every pass of a smoothing run avoids reallocation.
+ */
+class MeshMetrics : private Noncopyable
+{
+  public:
+    /** %Options controlling measurement. */
+    struct Options
+    {
+      bool surface_distances;    ///< Compute the distances between the surfaces (default true). Else only per-vertex metrics.
+      ThreadPool * thread_pool;  ///< Threads to measure with (default null, indicating ThreadPool::common()).
+
+      /** Constructor. */
+      Options() : surface_distances(true), thread_pool(NULL) {}
+
+      /** Get the default set of options. */
+      static Options const & defaults() { static Options const def; return def; }
+
+    }; // struct Options
+
+    /** Metrics of a mesh relative to the reference. Distances are in the units of the mesh, angles in degrees. */
+    struct Result
+    {
+      long num_vertices;                    ///< Number of vertices of the mesh.
+      bool corresponding;                   /**< Does the mesh have as many vertices as the reference? Else the per-vertex
+                                                 metrics are zero. */
+      double rms_error;                     ///< Root mean square distance between corresponding vertices.
+      double mean_error;                    ///< Mean distance between corresponding vertices.
+      double max_error;                     ///< Largest distance between corresponding vertices.
+      double mean_normal_deviation;         ///< Mean angle between corresponding vertex normals.
+      double max_normal_deviation;          ///< Largest angle between corresponding vertex normals.
+      bool has_surface_distances;           ///< Were the surface distances computed? Else they are zero.
+      double mean_distance_to_reference;    ///< Mean distance from a vertex of the mesh to the reference surface.
+      double max_distance_to_reference;     ///< Largest distance from a vertex of the mesh to the reference surface.
+      double mean_distance_from_reference;  ///< Mean distance from a reference vertex to the surface of the mesh.
+      double max_distance_from_reference;   ///< Largest distance from a reference vertex to the surface of the mesh.
+      double mean_surface_distance;         ///< Mean of the two mean surface distances.
+      double hausdorff_distance;            ///< Larger of the two largest surface distances.
+      double reference_diagonal;            ///< Length of the diagonal of the reference's bounding box, for normalization.
+
+      /** Constructor. */
+      Result()
+      : num_vertices(0), corresponding(false), rms_error(0), mean_error(0), max_error(0), mean_normal_deviation(0),
+        max_normal_deviation(0), has_surface_distances(false), mean_distance_to_reference(0), max_distance_to_reference(0),
+        mean_distance_from_reference(0), max_distance_from_reference(0), mean_surface_distance(0), hausdorff_distance(0),
+        reference_diagonal(0)
+      {}
+
+      /**
+       * Get the metrics as a JSON object on a single line. Metrics that were not computed are omitted, and values that are
+       * not finite (from degenerate geometry) are written as null.
+       */
+      std::string toJSON() const;
+
+    }; // struct Result
+
+    /** Constructor. There is no reference until setReference() is called. */
+    MeshMetrics() : ref_diagonal(0) {}
+
+    /** Copy the positions, normals and triangles of a mesh to use as the reference. */
+    void setReference(Mesh & ref);
+
+    /** Copy the positions, normals and triangles of the compact representation of a mesh to use as the reference. */
+    void setReference(MeshCore const & ref);
+
+    /** Check if a reference has been set. */
+    bool hasReference() const { return !ref_positions.empty(); }
+
+    /** Get the number of vertices of the reference. */
+    long numReferenceVertices() const { return (long)ref_positions.size(); }
+
+    /** Measure a mesh relative to the reference, using its compact representation (see Mesh::getCore()). */
+    Result compute(Mesh & mesh, Options const & options = Options::defaults());
+
+    /** Measure the compact representation of a mesh relative to the reference. */
+    Result compute(MeshCore const & mesh, Options const & options = Options::defaults());
+
+    /**
+     * Get the distance of each vertex from its corresponding reference vertex, as of the last call to compute(). Empty if the
+     * vertices did not correspond.
+     */
+    std::vector<Real> const & getVertexErrors() const { return vertex_errors; }
+
+  private:
+    /** Split the faces of a mesh into triangle fans, as consecutive triples of vertex indices. */
+    static void triangulate(MeshCore const & mesh, std::vector<uint32> & indices);
+
+    /** Find the distance from each of a set of points to the closest point of the triangles in a hierarchy, in parallel. */
+    static void surfaceDistances(TriangleBVH3 const & bvh, Vector3 const * points, long num_points, ThreadPool & pool,
+                                 std::vector<Real> & distances);
+
+    std::vector<Vector3> ref_positions;   ///< Reference vertex positions.
+    std::vector<Vector3> ref_normals;     ///< Reference vertex normals.
+    TriangleBVH3 ref_bvh;                 ///< Hierarchy over the reference triangles.
+    Real ref_diagonal;                    ///< Length of the diagonal of the reference's bounding box.
+
+    TriangleBVH3 mesh_bvh;                ///< Hierarchy over the triangles of the last mesh measured.
+    std::vector<uint32> triangles;        ///< Scratch space for triangle vertex indices.
+    std::vector<Real> vertex_errors;      ///< Distance of each vertex from its corresponding reference vertex.
+    std::vector<Real> normal_angles;      ///< Angle between each vertex normal and the corresponding reference normal.
+    std::vector<Real> to_reference;       ///< Distance of each vertex from the reference surface.
+    std::vector<Real> from_reference;     ///< Distance of each reference vertex from the mesh surface.
+
+}; // class MeshMetrics
+
+#endif
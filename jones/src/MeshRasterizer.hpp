@@ -0,0 +1,150 @@
+#ifndef __A3_MeshRasterizer_hpp__
+#define __A3_MeshRasterizer_hpp__
+
+#include "Common.hpp"
+#include "DGP/AxisAlignedBox3.hpp"
+#include "DGP/Camera.hpp"
+#include "DGP/ColorRGB.hpp"
+#include "DGP/Image.hpp"
+#include "DGP/Noncopyable.hpp"
+#include "DGP/ThreadPool.hpp"
+#include "DGP/Vector3.hpp"
+#include "DGP/Vector4.hpp"
+#include <vector>
+
+// Forward declarations
+class Mesh;
+class MeshCore;
+
+/**
+ * Software renderer that draws a mesh into an image on the CPU, for snapshots on machines without a display or GPU. Vertices
+ * are transformed by the camera's projection, triangles are clipped to the near plane and sorted into square screen tiles,
+ * and the tiles are then filled in parallel, each with its own depth buffer. Polygons are split into triangle fans.
+ *
+ * Shading follows the viewer: an ambient term plus a two-sided Lambert term for a light fixed relative to the camera.
+ * Alternatively the camera-space normal can be shown directly as a color. The output does not depend on the number of
+ * threads.
+ *
+ * Scratch arrays are kept between calls, so rendering a sequence of frames with the same object avoids reallocation.
+ */
+class MeshRasterizer : private Noncopyable
+{
+  public:
+    /** How surfaces are colored (enum class). */
+    struct Shading
+    {
+      /** Supported values. */
+      enum Value
+      {
+        LAMBERT,  ///< Ambient plus two-sided diffuse lighting, as in the viewer.
+        NORMALS   ///< The camera-space normal, with components mapped from [-1, 1] to [0, 1].
+      };
+
+      DGP_ENUM_CLASS_BODY(Shading)
+    };
+
+    /** %Options controlling rendering. */
+    struct Options
+    {
+      Shading shading;          ///< How surfaces are colored (default Shading::LAMBERT).
+      bool smooth;              /**< Interpolate vertex normals across faces (default true). Else each face is shaded with
+                                     its own normal. */
+      ColorRGB color;           ///< Surface color (default white).
+      ColorRGB background;      ///< Color of pixels not covered by the mesh (default black).
+      Vector3 light_dir;        /**< Direction of the light in camera space, pointing towards the object (default
+                                     (-1, -1, -2)). */
+      int tile_size;            ///< Width and height of a screen tile in pixels (default 32).
+      ThreadPool * thread_pool; ///< Threads for the parallel stages (default null, indicating ThreadPool::common()).
+
+      /** Constructor. */
+      Options()
+      : shading(Shading::LAMBERT), smooth(true), color(1, 1, 1), background(0, 0, 0), light_dir(-1, -1, -2), tile_size(32),
+        thread_pool(NULL)
+      {}
+
+      /** Get the default set of options. */
+      static Options const & defaults() { static Options const def; return def; }
+
+    }; // struct Options
+
+    /** Statistics of a call to render(). */
+    struct Stats
+    {
+      long num_triangles;     ///< Number of triangles after splitting polygons.
+      long num_culled;        ///< Number of triangles entirely outside the view volume, or with zero screen area.
+      long num_bin_entries;   ///< Total number of (triangle, tile) pairs rasterized.
+      long num_fragments;     ///< Number of pixels written, including those later overwritten by nearer triangles.
+
+      /** Constructor. */
+      Stats() : num_triangles(0), num_culled(0), num_bin_entries(0), num_fragments(0) {}
+
+    }; // struct Stats
+
+    /** Constructor. */
+    MeshRasterizer() {}
+
+    /**
+     * Draw a mesh into an image, using the compact representation returned by Mesh::getCore(). The image keeps its size and
+     * is converted to Image::Type::RGB_8U if it has a different type. Pixel rows are stored top to bottom.
+     */
+    void render(Mesh & mesh, Camera const & camera, Image & image, Options const & options = Options::defaults(),
+                Stats * stats = NULL);
+
+    /** Draw the compact representation of a mesh into an image. See render(Mesh &, ...). */
+    void render(MeshCore const & core, Camera const & camera, Image & image, Options const & options = Options::defaults(),
+                Stats * stats = NULL);
+
+    /**
+     * Get a perspective camera framing a bounding box, as the viewer frames an object when it starts, for an image of the
+     * given dimensions.
+     */
+    static Camera frameCamera(AxisAlignedBox3 const & bbox, int width, int height);
+
+  private:
+    /** A vertex of a clipped triangle. */
+    struct ClipVertex
+    {
+      Vector4 position;  ///< Position in clip space.
+      Vector3 color;     ///< Shaded color.
+    };
+
+    /**
+     * A triangle set up for rasterization. Edge i is opposite vertex i, and its edge function a * x + b * y + c is positive
+     * inside the triangle.
+     */
+    struct Triangle
+    {
+      float a[3], b[3], c[3];  ///< Coefficients of the edge functions.
+      bool owner[3];           ///< Do pixel centers exactly on each edge belong to this triangle?
+      float inv_sum;           ///< Reciprocal of the sum of the edge functions, which is the same at every point.
+      float z[3];              ///< Normalized device depths of the vertices.
+      float inv_w[3];          ///< Reciprocals of the clip-space w coordinates of the vertices.
+      Vector3 color[3];        ///< Colors of the vertices, divided by their w coordinates.
+      int x0, y0, x1, y1;      ///< Range of pixels whose centers may be covered, inclusive and clamped to the screen.
+    };
+
+    /** Triangles set up from a contiguous block of faces, and the tiles each one covers. */
+    struct Batch
+    {
+      std::vector<Triangle> triangles;        ///< Triangles of the block that are at least partly visible.
+      std::vector<uint32> tile_offsets;       ///< Start of each tile's list in tile_triangles, plus the total.
+      std::vector<uint32> tile_triangles;     ///< Indices into triangles, grouped by tile.
+      std::vector<uint32> tile_counts;        ///< Scratch space for counting the triangles of each tile.
+      long num_triangles;                     ///< Number of triangles in the block before culling.
+    };
+
+    /** Clip a triangle to the near plane and add the pieces to a batch. */
+    void setupTriangle(ClipVertex const * v, int width, int height, Batch & batch) const;
+
+    /** Fill one screen tile. Returns the number of pixels written. */
+    long rasterizeTile(int tx, int ty, int width, int height, int tile_size, int num_tiles_x, Options const & options,
+                       std::vector<float> & depth, Image & image) const;
+
+    std::vector<Vector4> clip_positions;        ///< Clip-space vertex positions.
+    std::vector<Vector3> vertex_colors;         ///< Shaded vertex colors.
+    std::vector<Batch> batches;                 ///< Triangles and tile lists of each block of faces.
+    std::vector< std::vector<float> > depths;   ///< Depth buffer of a tile, for each thread.
+
+}; // class MeshRasterizer
+
+#endif
@@ -0,0 +1,181 @@
+#include "MeshRenderBuffer.hpp"
+#include "Mesh.hpp"
+#include "DGP/Graphics/GLCaps.hpp"
+#include <limits>
+
+MeshRenderBuffer::MeshRenderBuffer()
+: render_system(NULL), vertex_area(NULL), index_area(NULL), positions(NULL), normals(NULL), indices(NULL), num_vertices(0),
+  num_triangle_indices(0), num_edge_indices(0), topology_dirty(true), dirty_begin(std::numeric_limits<long>::max()),
+  dirty_end(0), num_bytes_uploaded(0)
+{}
+
+MeshRenderBuffer::~MeshRenderBuffer()
+{
+  release();
+}
+
+void
+MeshRenderBuffer::release()
+{
+  if (!render_system)
+    return;
+
+  // Destroying an area frees the storage of the arrays in it, but not the array objects themselves
+  if (vertex_area)
+  {
+    vertex_area->destroyArray(positions);
+    vertex_area->destroyArray(normals);
+    render_system->destroyVARArea(vertex_area);
+  }
+
+  if (index_area)
+  {
+    index_area->destroyArray(indices);
+    render_system->destroyVARArea(index_area);
+  }
+
+  render_system = NULL;
+  vertex_area = index_area = NULL;
+  positions = normals = indices = NULL;
+  num_vertices = num_triangle_indices = num_edge_indices = 0;
+  topology_dirty = true;
+}
+
+void
+MeshRenderBuffer::rebuild(Mesh const & mesh, Graphics::RenderSystem & render_system_)
+{
+  release();
+
+  mesh.numberElements();
+
+  std::vector<uint32> index_data;
+  for (Mesh::FaceConstIterator fi = mesh.facesBegin(); fi != mesh.facesEnd(); ++fi)
+  {
+    // Split the polygon into a fan around its first vertex
+    MeshFace::VertexConstIterator fvi = fi->verticesBegin();
+    uint32 first = (*fvi)->index;
+    uint32 prev = (*(++fvi))->index;
+    for (++fvi; fvi != fi->verticesEnd(); ++fvi)
+    {
+      uint32 curr = (*fvi)->index;
+      index_data.push_back(first);
+      index_data.push_back(prev);
+      index_data.push_back(curr);
+      prev = curr;
+    }
+  }
+
+  num_triangle_indices = (long)index_data.size();
+
+  for (Mesh::EdgeConstIterator ei = mesh.edgesBegin(); ei != mesh.edgesEnd(); ++ei)
+  {
+    index_data.push_back(ei->getEndpoint(0)->index);
+    index_data.push_back(ei->getEndpoint(1)->index);
+  }
+
+  num_edge_indices = (long)index_data.size() - num_triangle_indices;
+  num_vertices = mesh.numVertices();
+
+  if (num_vertices <= 0 || index_data.empty())
+    return;
+
+  render_system = &render_system_;
+  bool gpu_memory = DGP_SUPPORTS(ARB_vertex_buffer_object);
+  long vertex_bytes = num_vertices * (long)sizeof(Vector3);
+  long index_bytes = (long)index_data.size() * (long)sizeof(uint32);
+
+  vertex_area = render_system->createVARArea("Mesh vertices", 2 * vertex_bytes, Graphics::VARArea::Usage::WRITE_OCCASIONALLY,
+                                             gpu_memory);
+  positions = vertex_area->createArray(vertex_bytes);
+  normals = vertex_area->createArray(vertex_bytes);
+
+  index_area = render_system->createVARArea("Mesh indices", index_bytes, Graphics::VARArea::Usage::WRITE_ONCE, gpu_memory);
+  indices = index_area->createArray(index_bytes);
+  indices->updateIndices(0, (long)index_data.size(), &index_data[0]);
+  num_bytes_uploaded += index_bytes;
+
+  dirty_begin = 0;
+  dirty_end = num_vertices;
+  uploadVertices(mesh);
+
+  topology_dirty = false;
+}
+
+void
+MeshRenderBuffer::uploadVertices(Mesh const & mesh)
+{
+  if (dirty_end > num_vertices) dirty_end = num_vertices;
+  if (dirty_begin >= dirty_end)
+  {
+    dirty_begin = std::numeric_limits<long>::max();
+    dirty_end = 0;
+    return;
+  }
+
+  long n = dirty_end - dirty_begin;
+  scratch.resize((size_t)n);
+
+  Mesh::VertexConstIterator first = mesh.verticesBegin();
+  std::advance(first, dirty_begin);
+
+  Mesh::VertexConstIterator vi = first;
+  for (long i = 0; i < n; ++i, ++vi)
+    scratch[(size_t)i] = vi->getPosition();
+
+  positions->updateVectors(dirty_begin, n, &scratch[0]);
+
+  vi = first;
+  for (long i = 0; i < n; ++i, ++vi)
+    scratch[(size_t)i] = vi->getNormal();
+
+  normals->updateVectors(dirty_begin, n, &scratch[0]);
+
+  num_bytes_uploaded += 2 * n * (long)sizeof(Vector3);
+  dirty_begin = std::numeric_limits<long>::max();
+  dirty_end = 0;
+}
+
+void
+MeshRenderBuffer::draw(Mesh const & mesh, Graphics::RenderSystem & render_system_, bool draw_edges)
+{
+  if (topology_dirty || render_system != &render_system_)
+    rebuild(mesh, render_system_);
+  else if (dirty_begin < dirty_end)
+    uploadVertices(mesh);
+
+  if (!indices)
+    return;
+
+  if (draw_edges)
+  {
+    render_system->pushShapeFlags();
+    render_system->setPolygonOffset(true, 1);
+  }
+
+  render_system->beginIndexedPrimitives();
+    render_system->setVertexArray(positions);
+    render_system->setNormalArray(normals);
+    render_system->setIndexArray(indices);
+    render_system->sendIndicesFromArray(Graphics::RenderSystem::Primitive::TRIANGLES, 0, num_triangle_indices);
+  render_system->endIndexedPrimitives();
+
+  if (draw_edges)
+  {
+    render_system->popShapeFlags();
+
+    render_system->pushShader();
+    render_system->pushColorFlags();
+
+      render_system->setShader(NULL);
+      render_system->setColor(ColorRGBA(0.2, 0.3, 0.7, 1));  // set default edge color
+
+      render_system->beginIndexedPrimitives();
+        render_system->setVertexArray(positions);
+        render_system->setIndexArray(indices);
+        render_system->sendIndicesFromArray(Graphics::RenderSystem::Primitive::LINES, num_triangle_indices, num_edge_indices);
+      render_system->endIndexedPrimitives();
+
+    render_system->popColorFlags();
+    render_system->popShader();
+  }
+}
@@ -0,0 +1,80 @@
+#ifndef __A3_MeshRenderBuffer_hpp__
+#define __A3_MeshRenderBuffer_hpp__
+
+#include "Common.hpp"
+#include "DGP/Graphics/RenderSystem.hpp"
+#include "DGP/Noncopyable.hpp"
+#include "DGP/Vector3.hpp"
+#include <vector>
+
+// Forward declarations
+class Mesh;
+
+/**
+ * Copy of a mesh in vertex and index buffers, for retained-mode drawing. Vertex positions and normals are stored in the order
+ * of the mesh's vertex list, and faces as a 32-bit index buffer of triangles (larger polygons are split into fans), followed by
+ * the endpoint pairs of the edges. The buffers are in GPU memory if the render system supports vertex buffer objects, else in
+ * main memory.
+ *
+ * The index buffer is rebuilt only when the topology changes. When just vertex positions or normals change, only the range of
+ * vertices marked as changed is sent again.
+ */
+class MeshRenderBuffer : private Noncopyable
+{
+  public:
+    /** Constructor. The buffers are created on the first call to draw(). */
+    MeshRenderBuffer();
+
+    /** Destructor. Releases the buffers. */
+    ~MeshRenderBuffer();
+
+    /** Note that the topology of the mesh has changed, so all buffers are rebuilt before the next draw. */
+    void invalidateTopology() { topology_dirty = true; }
+
+    /**
+     * Note that the positions or normals of the vertices at positions [begin, end) of the mesh's vertex list have changed, so
+     * they are sent again before the next draw. Successive ranges are merged into the smallest range containing them all.
+     */
+    void invalidateVertices(long begin, long end)
+    {
+      if (begin >= end) return;
+      if (begin < dirty_begin) dirty_begin = begin;
+      if (end > dirty_end) dirty_end = end;
+    }
+
+    /**
+     * Bring the buffers up to date with a mesh and draw it, with vertex normals. The buffers belong to the render system they
+     * were created on, which must outlive them unless release() is called first.
+     */
+    void draw(Mesh const & mesh, Graphics::RenderSystem & render_system, bool draw_edges);
+
+    /** Destroy the buffers. They are recreated, on whichever render system is passed, by the next call to draw(). */
+    void release();
+
+    /** Get the total number of bytes sent to the buffers so far. */
+    long numBytesUploaded() const { return num_bytes_uploaded; }
+
+  private:
+    /** Create the buffers and fill them from the mesh. */
+    void rebuild(Mesh const & mesh, Graphics::RenderSystem & render_system);
+
+    /** Send the positions and normals of the dirty range of vertices to the vertex buffers. */
+    void uploadVertices(Mesh const & mesh);
+
+    Graphics::RenderSystem * render_system;  ///< Render system that owns the buffers.
+    Graphics::VARArea * vertex_area;         ///< Storage for the vertex positions and normals.
+    Graphics::VARArea * index_area;          ///< Storage for the face and edge indices.
+    Graphics::VAR * positions;               ///< Vertex positions.
+    Graphics::VAR * normals;                 ///< Vertex normals.
+    Graphics::VAR * indices;                 ///< Triangle indices, followed by edge indices.
+    long num_vertices;                       ///< Number of vertices in the buffers.
+    long num_triangle_indices;               ///< Number of triangle indices at the start of the index buffer.
+    long num_edge_indices;                   ///< Number of edge indices following the triangle indices.
+    bool topology_dirty;                     ///< Does the index buffer need to be rebuilt?
+    long dirty_begin, dirty_end;             ///< Range of vertices whose attributes need to be sent again.
+    long num_bytes_uploaded;                 ///< Total bytes sent to the buffers.
+    std::vector<Vector3> scratch;            ///< Staging array for vertex attributes.
+
+}; // class MeshRenderBuffer
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef __A3_MeshStatistics_hpp__
+#define __A3_MeshStatistics_hpp__
+
+#include "Common.hpp"
+#include "DGP/AxisAlignedBox3.hpp"
+#include "DGP/ThreadPool.hpp"
+#include <string>
+#include <vector>
+
+// Forward declarations
+class MeshCore;
+
+/**
+ * Summary statistics of the geometry and connectivity of a mesh: edge lengths, vertex valences, bounding box, surface area and
+ * boundary edges, typically used to choose parameters relative to the scale of the mesh. They are computed from the compact
+ * representation (MeshCore) in a single parallel loop over fixed-size blocks of the edge, vertex and face arrays, whose partial
+ * results are combined in order, so the statistics do not depend on the number of threads. Mesh::getStatistics() caches them
+ * until the mesh changes.
+ */
+struct MeshStatistics
+{
+  long num_vertices;                    ///< Number of vertices.
+  long num_edges;                       ///< Number of edges.
+  long num_faces;                       ///< Number of faces.
+  double min_edge_length;               ///< Length of the shortest edge.
+  double max_edge_length;               ///< Length of the longest edge.
+  double mean_edge_length;              ///< Mean edge length.
+  double median_edge_length;            ///< Median edge length (the mean of the two middle lengths for an even count).
+  std::vector<long> valence_histogram;  ///< Number of vertices with each number of neighbours, indexed by the number.
+  AxisAlignedBox3 bounds;               ///< Bounding box of the vertices.
+  double surface_area;                  ///< Total area of the faces.
+  long num_boundary_edges;              ///< Number of edges with at most one incident face.
+  long num_nonmanifold_edges;           ///< Number of edges with more than two incident faces.
+
+  /** Constructor. All statistics are zero. */
+  MeshStatistics()
+  : num_vertices(0), num_edges(0), num_faces(0), min_edge_length(0), max_edge_length(0), mean_edge_length(0),
+    median_edge_length(0), surface_area(0), num_boundary_edges(0), num_nonmanifold_edges(0)
+  {}
+
+  /**
+   * Compute the statistics of the compact representation of a mesh.
+   *
+   * @param mesh The mesh.
+   * @param pool Threads to use. If null, ThreadPool::common() is used.
+   */
+  static MeshStatistics compute(MeshCore const & mesh, ThreadPool * pool = NULL);
+
+  /** Get the mean number of neighbours of a vertex. */
+  double meanValence() const { return num_vertices > 0 ? 2.0 * num_edges / num_vertices : 0.0; }
+
+  /** Get the statistics as a JSON object on a single line. The valence histogram is written as an array. */
+  std::string toJSON() const;
+
+}; // struct MeshStatistics
+
+#endif
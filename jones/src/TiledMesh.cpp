@@ -0,0 +1,856 @@
+#include "TiledMesh.hpp"
+#include "MeshCore.hpp"
+#include "DGP/System.hpp"
+#include "DGP/TextScanner.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <mutex>
+
+namespace TiledMeshInternal {
+
+// Tiled mesh file layout (all values little-endian):
+//
+//   magic "DGPTILES", uint32 version, uint32 #tiles, uint64 #vertices, uint64 #faces, float32 bounds (low, then high corner),
+//   float64 halo, float64 longest edge length, uint64 offset of each section, zero padding up to HEADER_SIZE bytes
+//
+// Sections, in file order:
+//   POSITIONS       vertex positions (3 x float32 each), grouped by tile, in original order within a tile
+//   TILED_INDEX     the index in POSITIONS of each vertex of the original mesh (uint32)
+//   ORIGINAL_INDEX  the index in the original mesh of each vertex in POSITIONS (uint32)
+//   TILES           for each tile, its first vertex in POSITIONS, its number of vertices, the offset of its record and the
+//                   number of faces in the record (4 x uint64)
+//   FACES           the faces of the original mesh, each as a uint32 vertex count followed by original vertex indices
+//   RECORDS         for each tile, the faces (of at least 3 vertices) with a vertex within the halo of the tile, in original
+//                   order, each as a uint32 vertex count followed by POSITIONS indices
+//
+// Bump the version whenever the layout changes: files with any other version are rejected.
+char const MAGIC[8] = { 'D', 'G', 'P', 'T', 'I', 'L', 'E', 'S' };
+uint32 const VERSION = 1;
+uint64 const HEADER_SIZE = 256;
+uint64 const TILE_ENTRY_SIZE = 4 * 8;
+size_t const IO_BUFFER_SIZE = (size_t)1 << 20;  // bytes, a multiple of 4
+size_t const RECORD_BUFFER_WORDS = 4096;         // per tile, while the records are written
+long const MAX_TILES = 1L << 20;
+
+enum Section { POSITIONS, TILED_INDEX, ORIGINAL_INDEX, TILES, FACES, RECORDS, NUM_SECTIONS };
+
+// Read a value from possibly unaligned memory.
+template <typename T>
+T
+load(uint8 const * p)
+{
+  T value;
+  std::memcpy(&value, p, sizeof(T));
+  return value;
+}
+
+// Buffered sequential writer to part of a file. It seeks before every write, so other parts of the same file can be written
+// in between.
+class BufferedWriter
+{
+  public:
+    BufferedWriter(std::fstream & out_, uint64 offset) : out(out_), pos(offset) { buffer.reserve(IO_BUFFER_SIZE); }
+
+    template <typename T> void write(T const & value) { write(&value, sizeof(T)); }
+
+    void write(void const * data, size_t num_bytes)
+    {
+      char const * bytes = static_cast<char const *>(data);
+      buffer.insert(buffer.end(), bytes, bytes + num_bytes);
+      if (buffer.size() >= IO_BUFFER_SIZE)
+        flush();
+    }
+
+    void pad(uint64 alignment)
+    {
+      while (getPosition() % alignment != 0)
+        write((uint8)0);
+    }
+
+    void flush()
+    {
+      if (buffer.empty()) return;
+
+      out.seekp((std::streamoff)pos);
+      out.write(&buffer[0], (std::streamsize)buffer.size());
+      pos += buffer.size();
+      buffer.clear();
+    }
+
+    uint64 getPosition() const { return pos + buffer.size(); }
+
+  private:
+    std::fstream & out;
+    uint64 pos;
+    std::vector<char> buffer;
+
+}; // class BufferedWriter
+
+// Buffered reader of the 32-bit words in part of a file. The part must start at a multiple of 4 bytes.
+class WordReader
+{
+  public:
+    WordReader(std::ifstream & in_, uint64 begin, uint64 end_) : in(in_), pos(begin), end(end_), next(0) {}
+
+    bool read(uint32 & value)
+    {
+      if (next >= buffer.size())
+      {
+        size_t num_words = (size_t)std::min((uint64)(IO_BUFFER_SIZE / 4), (end - pos) / 4);
+        if (num_words == 0) return false;
+
+        buffer.resize(num_words);
+        in.seekg((std::streamoff)pos);
+        if (!in.read(reinterpret_cast<char *>(&buffer[0]), (std::streamsize)(4 * num_words))) return false;
+
+        pos += 4 * num_words;
+        next = 0;
+      }
+
+      value = buffer[next++];
+      return true;
+    }
+
+    // Read a face: a vertex count, then that many vertex indices.
+    bool readFace(std::vector<uint32> & face)
+    {
+      uint32 n;
+      if (!read(n)) return false;
+
+      face.resize(n);
+      for (uint32 j = 0; j < n; ++j)
+        if (!read(face[j])) return false;
+
+      return true;
+    }
+
+  private:
+    std::ifstream & in;
+    uint64 pos, end;
+    std::vector<uint32> buffer;
+    size_t next;
+
+}; // class WordReader
+
+// Uniform grid of tiles over a bounding box.
+struct Grid
+{
+  Vector3 low;
+  Vector3 cell_size;
+  long dims[3];
+
+  // Choose the dimensions so that there are at least \a target_tiles roughly cubical tiles.
+  Grid(AxisAlignedBox3 const & bounds, long target_tiles)
+  {
+    Vector3 extent = (bounds.isNull() ? Vector3::zero() : bounds.getExtent());
+    low = (bounds.isNull() ? Vector3::zero() : bounds.getLow());
+    dims[0] = dims[1] = dims[2] = 1;
+
+    while (dims[0] * dims[1] * dims[2] < target_tiles)
+    {
+      int axis = 0;
+      for (int a = 1; a < 3; ++a)
+        if (extent[a] / dims[a] > extent[axis] / dims[axis]) axis = a;
+
+      if (!(extent[axis] > 0)) break;
+      dims[axis]++;
+    }
+
+    for (int a = 0; a < 3; ++a)
+      cell_size[a] = (extent[a] > 0 ? extent[a] / dims[a] : 1);
+  }
+
+  long numTiles() const { return dims[0] * dims[1] * dims[2]; }
+
+  long coord(double x, int axis) const
+  {
+    double c = std::floor((x - low[axis]) / cell_size[axis]);
+    return (long)std::max(0.0, std::min((double)(dims[axis] - 1), c));
+  }
+
+  long tile(long x, long y, long z) const { return (z * dims[1] + y) * dims[0] + x; }
+
+  long tileOf(Vector3 const & p) const { return tile(coord(p[0], 0), coord(p[1], 1), coord(p[2], 2)); }
+
+  // Append the tiles whose boxes are within \a dist of a point (in the max norm).
+  void appendNearbyTiles(Vector3 const & p, double dist, std::vector<uint32> & tiles) const
+  {
+    long lo[3], hi[3];
+    for (int a = 0; a < 3; ++a)
+    {
+      lo[a] = coord(p[a] - dist, a);
+      hi[a] = coord(p[a] + dist, a);
+    }
+
+    for (long z = lo[2]; z <= hi[2]; ++z)
+      for (long y = lo[1]; y <= hi[1]; ++y)
+        for (long x = lo[0]; x <= hi[0]; ++x)
+          tiles.push_back((uint32)tile(x, y, z));
+  }
+
+}; // struct Grid
+
+// Deletes a file when it goes out of scope.
+struct TemporaryFile
+{
+  TemporaryFile(std::string const & path_) : path(path_) {}
+  ~TemporaryFile() { std::remove(path.c_str()); }
+
+  std::string path;
+
+}; // struct TemporaryFile
+
+// Position of a vertex in an array of float32 triples.
+Vector3
+loadPosition(uint8 const * positions, uint64 v)
+{
+  uint8 const * p = positions + 12 * v;
+  return Vector3(load<float32>(p), load<float32>(p + 4), load<float32>(p + 8));
+}
+
+bool
+checkEndianness()
+{
+  if (System::endianness() != Endianness::LITTLE)
+  {
+    DGP_ERROR << "TiledMesh: Tiled meshes are only supported on little-endian machines";
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace TiledMeshInternal
+
+TiledMesh::TiledMesh()
+: num_tiles(0), num_vertices(0), num_faces(0), halo(0), max_edge_length(0)
+{}
+
+bool
+TiledMesh::build(std::string const & off_path, std::string const & tiled_path, double radius, BuildOptions const & options)
+{
+  using namespace TiledMeshInternal;
+
+  if (!checkEndianness())
+    return false;
+
+  MappedFile off;
+  if (!off.open(off_path))
+    return false;
+
+  TextScanner in(off.getData(), off.getData() + off.getSize());
+
+  std::string magic;
+  if (!in.readWord(magic) || magic != "OFF")
+  {
+    DGP_ERROR << "Header string OFF not found at beginning of file '" << off_path << '\'';
+    return false;
+  }
+
+  long nv, nf, ne;
+  if (!in.readInteger(nv) || !in.readInteger(nf) || !in.readInteger(ne) || nv < 0 || nf < 0 || ne < 0)
+  {
+    DGP_ERROR << "Could not read valid element counts from OFF file '" << off_path << '\'';
+    return false;
+  }
+
+  if ((uint64)nv >= 0xFFFFFFFF)
+  {
+    DGP_ERROR << "OFF file '" << off_path << "' has too many vertices for a tiled mesh";
+    return false;
+  }
+
+  // Stream the vertices to a binary file in original order, to be read back in tile order
+  TemporaryFile tmp(tiled_path + ".tmp");
+  AxisAlignedBox3 bounds;
+  {
+    std::ofstream tmp_out(tmp.path.c_str(), std::ios::binary);
+    if (!tmp_out)
+    {
+      DGP_ERROR << "Could not open '" << tmp.path << "' for writing";
+      return false;
+    }
+
+    std::vector<float32> buffer;
+    buffer.reserve(IO_BUFFER_SIZE / 4);
+
+    Vector3 p;
+    for (long i = 0; i < nv; ++i)
+    {
+      if (!in.readReal(p[0]) || !in.readReal(p[1]) || !in.readReal(p[2]))
+      {
+        DGP_ERROR << "Could not read vertex " << i << " from '" << off_path << '\'';
+        return false;
+      }
+
+      bounds.merge(p);
+      buffer.push_back(p[0]); buffer.push_back(p[1]); buffer.push_back(p[2]);
+      if (buffer.size() + 3 > buffer.capacity() || i + 1 == nv)
+      {
+        tmp_out.write(reinterpret_cast<char const *>(&buffer[0]), (std::streamsize)(4 * buffer.size()));
+        buffer.clear();
+      }
+    }
+
+    if (!tmp_out)
+    {
+      DGP_ERROR << "Could not write vertices to '" << tmp.path << '\'';
+      return false;
+    }
+  }
+
+  MappedFile tmp_file;
+  if (nv > 0 && !tmp_file.open(tmp.path))
+    return false;
+
+  uint8 const * original_positions = reinterpret_cast<uint8 const *>(tmp_file.getData());
+
+  // Assign the vertices to tiles, and order them by tile and then by original index
+  long vertices_per_tile = std::max(options.vertices_per_tile, 1L);
+  Grid grid(bounds, std::min(MAX_TILES, std::max(1L, (nv + vertices_per_tile - 1) / vertices_per_tile)));
+  long nt = grid.numTiles();
+
+  std::vector<uint64> tile_first((size_t)nt + 1, 0);
+  for (long i = 0; i < nv; ++i)
+    tile_first[(size_t)grid.tileOf(loadPosition(original_positions, (uint64)i)) + 1]++;
+
+  for (long t = 0; t < nt; ++t)
+    tile_first[(size_t)t + 1] += tile_first[(size_t)t];
+
+  std::vector<uint32> tiled_index((size_t)nv), original_index((size_t)nv);
+  {
+    std::vector<uint64> cursor(tile_first.begin(), tile_first.end() - 1);
+    for (long i = 0; i < nv; ++i)
+    {
+      uint64 k = cursor[(size_t)grid.tileOf(loadPosition(original_positions, (uint64)i))]++;
+      tiled_index[(size_t)i] = (uint32)k;
+      original_index[(size_t)k] = (uint32)i;
+    }
+  }
+
+  std::fstream out(tiled_path.c_str(), std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+  if (!out)
+  {
+    DGP_ERROR << "Could not open '" << tiled_path << "' for writing";
+    return false;
+  }
+
+  uint64 sections[NUM_SECTIONS];
+  BufferedWriter writer(out, 0);
+  for (uint64 i = 0; i < HEADER_SIZE; ++i)
+    writer.write((uint8)0);
+
+  sections[POSITIONS] = writer.getPosition();
+  for (long k = 0; k < nv; ++k)
+    writer.write(original_positions + 12 * (uint64)original_index[(size_t)k], 12);
+
+  sections[TILED_INDEX] = writer.getPosition();
+  if (nv > 0) writer.write(&tiled_index[0], 4 * (size_t)nv);
+
+  sections[ORIGINAL_INDEX] = writer.getPosition();
+  if (nv > 0) writer.write(&original_index[0], 4 * (size_t)nv);
+  std::vector<uint32>().swap(original_index);
+
+  writer.pad(8);
+  sections[TILES] = writer.getPosition();
+  for (uint64 i = 0; i < (uint64)nt * TILE_ENTRY_SIZE; ++i)
+    writer.write((uint8)0);
+
+  // Copy the faces, in original order, measuring the longest edge
+  sections[FACES] = writer.getPosition();
+  double max_edge_length = 0;
+  long num_face_vertices, vertex_index;
+  std::vector<uint32> face;
+  for (long i = 0; i < nf; ++i)
+  {
+    if (!in.readInteger(num_face_vertices) || num_face_vertices < 0 || num_face_vertices >= 0xFFFFFFFF)
+    {
+      DGP_ERROR << "Could not read valid vertex count of face " << i << " from '" << off_path << '\'';
+      return false;
+    }
+
+    face.resize((size_t)num_face_vertices);
+    for (long j = 0; j < num_face_vertices; ++j)
+    {
+      if (!in.readInteger(vertex_index) || vertex_index < 0 || vertex_index >= nv)
+      {
+        DGP_ERROR << "Could not read valid vertex " << j << " of face " << i << " from '" << off_path << '\'';
+        return false;
+      }
+
+      face[(size_t)j] = (uint32)vertex_index;
+    }
+
+    writer.write((uint32)num_face_vertices);
+    if (!face.empty()) writer.write(&face[0], 4 * face.size());
+
+    for (size_t j = 0; j < face.size(); ++j)
+    {
+      Vector3 e = loadPosition(original_positions, face[(j + 1) % face.size()]) - loadPosition(original_positions, face[j]);
+      max_edge_length = std::max(max_edge_length, (double)e.length());
+    }
+  }
+
+  sections[RECORDS] = writer.getPosition();
+  writer.flush();
+  out.flush();
+
+  // Each tile gets the faces with a vertex within the halo, found in two passes over the faces: one to size the records, one
+  // to fill them
+  double halo = radius + max_edge_length;
+  std::vector<uint64> record_faces((size_t)nt, 0), record_offsets((size_t)nt + 1, 0);
+  std::vector<uint32> face_tiles;
+  auto findFaceTiles = [&]() {
+    face_tiles.clear();
+    for (size_t j = 0; j < face.size(); ++j)
+      grid.appendNearbyTiles(loadPosition(original_positions, face[j]), halo, face_tiles);
+
+    std::sort(face_tiles.begin(), face_tiles.end());
+    face_tiles.erase(std::unique(face_tiles.begin(), face_tiles.end()), face_tiles.end());
+  };
+
+  std::ifstream faces_in(tiled_path.c_str(), std::ios::binary);
+  {
+    WordReader reader(faces_in, sections[FACES], sections[RECORDS]);
+    for (long i = 0; i < nf && reader.readFace(face); ++i)
+      if (face.size() >= 3)
+      {
+        findFaceTiles();
+        for (size_t k = 0; k < face_tiles.size(); ++k)
+        {
+          record_faces[face_tiles[k]]++;
+          record_offsets[(size_t)face_tiles[k] + 1] += 4 * (1 + face.size());
+        }
+      }
+  }
+
+  record_offsets[0] = sections[RECORDS];
+  for (long t = 0; t < nt; ++t)
+    record_offsets[(size_t)t + 1] += record_offsets[(size_t)t];
+
+  {
+    std::vector<uint64> cursor(record_offsets.begin(), record_offsets.end() - 1);
+    std::vector< std::vector<uint32> > buffers((size_t)nt);
+    auto flushRecord = [&](size_t t) {
+      if (buffers[t].empty()) return;
+
+      out.seekp((std::streamoff)cursor[t]);
+      out.write(reinterpret_cast<char const *>(&buffers[t][0]), (std::streamsize)(4 * buffers[t].size()));
+      cursor[t] += 4 * buffers[t].size();
+      buffers[t].clear();
+    };
+
+    WordReader reader(faces_in, sections[FACES], sections[RECORDS]);
+    for (long i = 0; i < nf && reader.readFace(face); ++i)
+      if (face.size() >= 3)
+      {
+        findFaceTiles();
+        for (size_t k = 0; k < face_tiles.size(); ++k)
+        {
+          std::vector<uint32> & buffer = buffers[face_tiles[k]];
+          buffer.push_back((uint32)face.size());
+          for (size_t j = 0; j < face.size(); ++j)
+            buffer.push_back(tiled_index[face[j]]);
+
+          if (buffer.size() >= RECORD_BUFFER_WORDS)
+            flushRecord(face_tiles[k]);
+        }
+      }
+
+    for (size_t t = 0; t < buffers.size(); ++t)
+      flushRecord(t);
+  }
+
+  if (!faces_in)
+  {
+    DGP_ERROR << "Could not read back the faces of '" << tiled_path << '\'';
+    return false;
+  }
+
+  BufferedWriter table(out, sections[TILES]);
+  for (long t = 0; t < nt; ++t)
+  {
+    table.write(tile_first[(size_t)t]);
+    table.write(tile_first[(size_t)t + 1] - tile_first[(size_t)t]);
+    table.write(record_offsets[(size_t)t]);
+    table.write(record_faces[(size_t)t]);
+  }
+  table.flush();
+
+  BufferedWriter header(out, 0);
+  header.write(MAGIC, sizeof(MAGIC));
+  header.write(VERSION);
+  header.write((uint32)nt);
+  header.write((uint64)nv);
+  header.write((uint64)nf);
+  for (int a = 0; a < 3; ++a) header.write((float32)(bounds.isNull() ? 0 : bounds.getLow()[a]));
+  for (int a = 0; a < 3; ++a) header.write((float32)(bounds.isNull() ? 0 : bounds.getHigh()[a]));
+  header.write((float64)halo);
+  header.write((float64)max_edge_length);
+  header.write(sections, sizeof(sections));
+  header.flush();
+
+  out.flush();
+  if (!out)
+  {
+    DGP_ERROR << "Could not write tiled mesh '" << tiled_path << '\'';
+    return false;
+  }
+
+  return true;
+}
+
+bool
+TiledMesh::open(std::string const & path_)
+{
+  using namespace TiledMeshInternal;
+
+  close();
+
+  if (!checkEndianness() || !file.open(path_))
+    return false;
+
+  uint64 size = (uint64)file.getSize();
+  if (size < HEADER_SIZE || std::memcmp(at(0), MAGIC, sizeof(MAGIC)) != 0)
+  {
+    DGP_ERROR << "File '" << path_ << "' is not a tiled mesh";
+    close();
+    return false;
+  }
+
+  uint32 version = load<uint32>(at(8));
+  if (version != VERSION)
+  {
+    DGP_ERROR << "Tiled mesh '" << path_ << "' has version " << version << ", expected " << VERSION;
+    close();
+    return false;
+  }
+
+  num_tiles = load<uint32>(at(12));
+  num_vertices = load<uint64>(at(16));
+  num_faces = load<uint64>(at(24));
+
+  Vector3 low, high;
+  for (int a = 0; a < 3; ++a)
+  {
+    low[a] = load<float32>(at(32 + 4 * a));
+    high[a] = load<float32>(at(44 + 4 * a));
+  }
+
+  bounds = (num_vertices > 0 ? AxisAlignedBox3(low, high) : AxisAlignedBox3());
+  halo = load<float64>(at(56));
+  max_edge_length = load<float64>(at(64));
+
+  sections.resize(NUM_SECTIONS);
+  for (int s = 0; s < NUM_SECTIONS; ++s)
+    sections[(size_t)s] = load<uint64>(at(72 + 8 * s));
+
+  // Guard against truncated files: every section must fit before the next one, and the records in the file
+  uint64 const min_sizes[NUM_SECTIONS - 1] = { 12 * num_vertices, 4 * num_vertices, 4 * num_vertices,
+                                               TILE_ENTRY_SIZE * num_tiles, 4 * num_faces };
+  bool ok = (sections[POSITIONS] >= HEADER_SIZE && sections[RECORDS] <= size);
+  for (int s = 0; ok && s < NUM_SECTIONS - 1; ++s)
+    ok = (sections[(size_t)s] + min_sizes[s] <= sections[(size_t)s + 1]);
+
+  for (uint32 t = 0; ok && t < num_tiles; ++t)
+  {
+    uint8 const * entry = at(sections[TILES] + TILE_ENTRY_SIZE * t);
+    ok = (load<uint64>(entry) + load<uint64>(entry + 8) <= num_vertices && load<uint64>(entry + 16) >= sections[RECORDS]
+       && load<uint64>(entry + 16) + 16 * load<uint64>(entry + 24) <= size);
+  }
+
+  if (!ok)
+  {
+    DGP_ERROR << "Tiled mesh '" << path_ << "' is truncated or corrupt";
+    close();
+    return false;
+  }
+
+  path = path_;
+  return true;
+}
+
+void
+TiledMesh::close()
+{
+  file.close();
+  path.clear();
+  num_tiles = 0;
+  num_vertices = num_faces = 0;
+  bounds = AxisAlignedBox3();
+  halo = max_edge_length = 0;
+  sections.clear();
+}
+
+long
+TiledMesh::numTileVertices(long tile) const
+{
+  using namespace TiledMeshInternal;
+  return (long)load<uint64>(at(sections[TILES] + TILE_ENTRY_SIZE * (uint64)tile + 8));
+}
+
+long
+TiledMesh::getFirstVertex(long tile) const
+{
+  using namespace TiledMeshInternal;
+  return (long)load<uint64>(at(sections[TILES] + TILE_ENTRY_SIZE * (uint64)tile));
+}
+
+Vector3
+TiledMesh::getPosition(long vertex) const
+{
+  using namespace TiledMeshInternal;
+  return loadPosition(at(sections[POSITIONS]), load<uint32>(at(sections[TILED_INDEX] + 4 * (uint64)vertex)));
+}
+
+void
+TiledMesh::loadTile(long tile, Mesh & mesh, std::vector<uint32> & vertex_indices) const
+{
+  using namespace TiledMeshInternal;
+
+  uint8 const * entry = at(sections[TILES] + TILE_ENTRY_SIZE * (uint64)tile);
+  uint64 first = load<uint64>(entry), count = load<uint64>(entry + 8);
+  uint64 nf = load<uint64>(entry + 24);
+  uint8 const * record = at(load<uint64>(entry + 16));
+
+  // The owned vertices, then the halo vertices referenced by the faces, without duplicates
+  std::vector<uint32> tiled;
+  tiled.reserve((size_t)count);
+  for (uint64 k = first; k < first + count; ++k)
+    tiled.push_back((uint32)k);
+
+  uint8 const * p = record;
+  for (uint64 f = 0; f < nf; ++f)
+  {
+    uint32 n = load<uint32>(p);
+    p += 4;
+    for (uint32 j = 0; j < n; ++j, p += 4)
+    {
+      uint32 v = load<uint32>(p);
+      if (v < first || v >= first + count)
+        tiled.push_back(v);
+    }
+  }
+
+  std::sort(tiled.begin(), tiled.end());
+  tiled.erase(std::unique(tiled.begin(), tiled.end()), tiled.end());
+
+  // The tile mesh lists its vertices in original order, like the whole mesh, so their adjacencies are in the same order too
+  size_t nv = tiled.size();
+  std::vector< std::pair<uint32, uint32> > by_original(nv);
+  for (size_t k = 0; k < nv; ++k)
+    by_original[k] = std::make_pair(load<uint32>(at(sections[ORIGINAL_INDEX] + 4 * (uint64)tiled[k])), tiled[k]);
+
+  std::sort(by_original.begin(), by_original.end());
+
+  std::vector<uint32> local(nv);  // local index of each entry of tiled
+  std::vector<Vector3> positions(nv);
+  vertex_indices.resize(nv);
+  for (size_t l = 0; l < nv; ++l)
+  {
+    uint32 v = by_original[l].second;
+    local[(size_t)(std::lower_bound(tiled.begin(), tiled.end(), v) - tiled.begin())] = (uint32)l;
+    positions[l] = loadPosition(at(sections[POSITIONS]), v);
+    vertex_indices[l] = v;
+  }
+
+  std::vector<uint32> face_offsets(1, 0), face_indices;
+  p = record;
+  for (uint64 f = 0; f < nf; ++f)
+  {
+    uint32 n = load<uint32>(p);
+    p += 4;
+    for (uint32 j = 0; j < n; ++j, p += 4)
+      face_indices.push_back(local[(size_t)(std::lower_bound(tiled.begin(), tiled.end(), load<uint32>(p)) - tiled.begin())]);
+
+    face_offsets.push_back((uint32)face_indices.size());
+  }
+
+  mesh.setFromArrays((long)nv, positions.empty() ? NULL : &positions[0], (long)nf, &face_offsets[0],
+                     face_indices.empty() ? NULL : &face_indices[0]);
+}
+
+bool
+TiledMesh::smooth(std::string const & out_path, double sigma_c, double sigma_s, SmoothingOptions const & options,
+                  SmoothingStats * stats) const
+{
+  using namespace TiledMeshInternal;
+
+  if (!isOpen())
+  {
+    DGP_ERROR << "TiledMesh: No tiled mesh is open";
+    return false;
+  }
+
+  if (2 * sigma_c > getRadius() * (1 + 1e-6))
+  {
+    DGP_ERROR << "Tiled mesh '" << path << "' was built for neighbourhoods of radius " << getRadius()
+              << ", which is less than 2 sigma_c = " << 2 * sigma_c;
+    return false;
+  }
+
+  if (out_path == path)
+  {
+    DGP_ERROR << "TiledMesh: Cannot smooth tiled mesh '" << path << "' in place";
+    return false;
+  }
+
+  // The output starts as a copy, and then the positions of each tile are overwritten as they are computed
+  {
+    std::ifstream src(path.c_str(), std::ios::binary);
+    std::ofstream dst(out_path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!src || !dst || !(dst << src.rdbuf()))
+    {
+      DGP_ERROR << "Could not copy tiled mesh '" << path << "' to '" << out_path << '\'';
+      return false;
+    }
+  }
+
+  std::fstream out(out_path.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+  if (!out)
+  {
+    DGP_ERROR << "Could not open '" << out_path << "' for writing";
+    return false;
+  }
+
+  ThreadPool & pool = (options.thread_pool ? *options.thread_pool : ThreadPool::common());
+  std::vector<SmoothingStats> participant_stats((size_t)pool.maxParticipants());
+  std::atomic<long> vertices_in_flight(0), max_vertices_in_flight(0);
+  std::mutex out_mutex;
+
+  pool.parallelFor(0, (long)num_tiles, [&](long lo, long hi, long t) {
+    SmoothingStats & st = participant_stats[(size_t)t];
+    Mesh mesh;
+    std::vector<uint32> vertex_indices;
+    std::vector<uint8> owned_mask;
+    std::vector<float32> owned;
+    Mesh::SmoothingOptions kernel = options.kernel;
+
+    for (long tile = lo; tile < hi; ++tile)
+    {
+      long first = getFirstVertex(tile), count = numTileVertices(tile);
+      if (count <= 0) continue;
+
+      loadTile(tile, mesh, vertex_indices);
+      long n = (long)vertex_indices.size();
+      long in_flight = (vertices_in_flight += n);
+      for (long m = max_vertices_in_flight; in_flight > m && !max_vertices_in_flight.compare_exchange_weak(m, in_flight); ) {}
+
+      // Only the owned vertices move. The halo vertices keep the positions they have in the input, and are only there to
+      // complete the neighbourhoods of the owned ones.
+      owned_mask.resize((size_t)n);
+      for (long l = 0; l < n; ++l)
+      {
+        long k = (long)vertex_indices[(size_t)l] - first;
+        owned_mask[(size_t)l] = (k >= 0 && k < count);
+      }
+
+      kernel.vertex_mask = &owned_mask[0];
+      mesh.bilateralSmooth(sigma_c, sigma_s, kernel);
+
+      owned.resize(3 * (size_t)count);
+      long l = 0;
+      for (Mesh::VertexConstIterator vi = mesh.verticesBegin(); vi != mesh.verticesEnd(); ++vi, ++l)
+      {
+        long k = (long)vertex_indices[(size_t)l] - first;
+        if (k < 0 || k >= count) continue;
+
+        Vector3 const & pos = vi->getPosition();
+        for (int a = 0; a < 3; ++a)
+          owned[3 * (size_t)k + a] = pos[a];
+      }
+
+      mesh.clear();
+      vertices_in_flight -= n;
+
+      {
+        std::lock_guard<std::mutex> lock(out_mutex);
+        out.seekp((std::streamoff)(sections[POSITIONS] + 12 * (uint64)first));
+        out.write(reinterpret_cast<char const *>(&owned[0]), (std::streamsize)(4 * owned.size()));
+      }
+
+      st.num_tiles++;
+      st.max_tile_vertices = std::max(st.max_tile_vertices, n);
+      st.total_halo_vertices += n - count;
+    }
+  }, 1);
+
+  out.flush();
+  if (!out)
+  {
+    DGP_ERROR << "Could not write smoothed positions to '" << out_path << '\'';
+    return false;
+  }
+
+  if (stats)
+  {
+    *stats = SmoothingStats();
+    for (size_t i = 0; i < participant_stats.size(); ++i)
+    {
+      stats->num_tiles += participant_stats[i].num_tiles;
+      stats->max_tile_vertices = std::max(stats->max_tile_vertices, participant_stats[i].max_tile_vertices);
+      stats->total_halo_vertices += participant_stats[i].total_halo_vertices;
+    }
+
+    stats->max_vertices_in_flight = max_vertices_in_flight;
+  }
+
+  return true;
+}
+
+bool
+TiledMesh::saveOFF(std::string const & out_path) const
+{
+  using namespace TiledMeshInternal;
+
+  if (!isOpen())
+  {
+    DGP_ERROR << "TiledMesh: No tiled mesh is open";
+    return false;
+  }
+
+  std::ofstream out(out_path.c_str(), std::ios::binary);
+  if (!out)
+  {
+    DGP_ERROR << "Could not open '" << out_path << "' for writing";
+    return false;
+  }
+
+  // Enough digits to read back the same positions
+  out.precision(std::numeric_limits<float32>::max_digits10);
+
+  out << "OFF\n";
+  out << num_vertices << ' ' << num_faces << " 0\n";
+
+  for (uint64 i = 0; i < num_vertices; ++i)
+  {
+    Vector3 p = getPosition((long)i);
+    out << p[0] << ' ' << p[1] << ' ' << p[2] << '\n';
+  }
+
+  uint8 const * p = at(sections[FACES]);
+  for (uint64 f = 0; f < num_faces; ++f)
+  {
+    uint32 n = load<uint32>(p);
+    p += 4;
+
+    out << n;
+    for (uint32 j = 0; j < n; ++j, p += 4)
+      out << ' ' << load<uint32>(p);
+
+    out << '\n';
+  }
+
+  if (!out)
+  {
+    DGP_ERROR << "Could not write '" << out_path << '\'';
+    return false;
+  }
+
+  return true;
+}
@@ -1,8 +1,14 @@
+#include "Batch.hpp"
+#include "Benchmark.hpp"
 #include "Mesh.hpp"
+#include "MeshMetrics.hpp"
+#include "TiledMesh.hpp"
 #include <algorithm>
+#include <cstdio>
 #include <cstdlib>
 #include <vector>
 #include <random>
+#include "DGP/Stopwatch.hpp"
 #include "DGP/VectorN.hpp"
 #include "Viewer.hpp"
 
@@ -12,35 +18,124 @@ int
 usage(int argc, char * argv[])
 {
   DGP_CONSOLE << "";
-  DGP_CONSOLE << "Usage: " << argv[0] << " <mesh> [vol2bbox] [d2 <#points> <#bins>]";
+  DGP_CONSOLE << "Usage: " << argv[0] << " <mesh>";
+  DGP_CONSOLE << "       " << argv[0] << " --batch <job list> [num threads]";
+  DGP_CONSOLE << "       " << argv[0] << " --bench <benchmark> <mesh>";
+  DGP_CONSOLE << "       " << argv[0] << " --tiled <input.off> <output.off> <sigma_c> <sigma_s> [passes]";
+  DGP_CONSOLE << "";
+  DGP_CONSOLE << "Benchmarks: assemble, bvh, cache, collapse, core, decimate, fair, load, matrix3, metrics, neighbourhood,";
+  DGP_CONSOLE << "            noise, normals, pick, random, raster, render, stats, tiled, weights";
   DGP_CONSOLE << "";
 
   return -1;
 }
 
+// Smooth an OFF file without loading it, by building a tiled mesh from it and smoothing that tile by tile.
+int
+tiledSmooth(std::string const & in_path, std::string const & out_path, double sigma_c, double sigma_s, long num_passes)
+{
+  // Passes alternate between two tiled meshes next to the output
+  std::string tiles_paths[2] = { out_path + ".0.tiles", out_path + ".1.tiles" };
+
+  Stopwatch timer;
+  timer.tick();
+    bool ok = TiledMesh::build(in_path, tiles_paths[0], 2 * sigma_c);
+  timer.tock();
+
+  if (ok)
+    DGP_CONSOLE << "Built tiled mesh from '" << in_path << "' in " << timer.elapsedTime() << " s";
+
+  int curr = 0;
+  for (long i = 0; ok && i < num_passes; ++i)
+  {
+    TiledMesh tiled;
+    TiledMesh::SmoothingStats stats;
+    timer.tick();
+      ok = tiled.open(tiles_paths[curr])
+        && tiled.smooth(tiles_paths[1 - curr], sigma_c, sigma_s, TiledMesh::SmoothingOptions::defaults(), &stats);
+    timer.tock();
+
+    if (ok)
+    {
+      DGP_CONSOLE << "Pass " << i + 1 << ": " << timer.elapsedTime() << " s, " << stats.num_tiles << " tiles of up to "
+                  << stats.max_tile_vertices << " vertices, at most " << stats.max_vertices_in_flight
+                  << " vertices in memory";
+      curr = 1 - curr;
+    }
+  }
+
+  if (ok)
+  {
+    TiledMesh result;
+    ok = result.open(tiles_paths[curr]) && result.saveOFF(out_path);
+  }
+
+  std::remove(tiles_paths[0].c_str());
+  std::remove(tiles_paths[1].c_str());
+
+  if (ok)
+    DGP_CONSOLE << "Saved smoothed mesh to '" << out_path << '\'';
+
+  return ok ? 0 : -1;
+}
+
 int
 main(int argc, char * argv[])
 {
   if (argc < 2)
     return usage(argc, argv);
 
+  if (std::string(argv[1]) == "--bench")
+  {
+    if (argc < 4)
+      return usage(argc, argv);
+
+    return Benchmark::run(argv[2], argv[3]) ? 0 : -1;
+  }
+
+  if (std::string(argv[1]) == "--tiled")
+  {
+    if (argc < 6)
+      return usage(argc, argv);
+
+    long num_passes = (argc > 6 ? std::atol(argv[6]) : 1);
+    return tiledSmooth(argv[2], argv[3], std::atof(argv[4]), std::atof(argv[5]), num_passes);
+  }
+
+  if (std::string(argv[1]) == "--batch")
+  {
+    if (argc < 3)
+      return usage(argc, argv);
+
+    long num_threads = (argc > 3 ? std::atol(argv[3]) : -1);
+    return Batch::run(argv[2], num_threads > 0 ? num_threads : -1) ? 0 : -1;
+  }
+
   std::string in_path = argv[1];
 
   Mesh mesh;
   if (!mesh.load(in_path))
     return -1;
 
-  std::cout << mesh.getAverageDistance() << std::endl;
+  DGP_CONSOLE << "Statistics of mesh as loaded: " << mesh.getStatistics().toJSON();
+
+  // Keep the mesh as loaded, to measure the smoothed mesh against
+  MeshMetrics metrics;
+  metrics.setReference(mesh);
 
+  // The OFF files are for other tools; the viewer reloads the binary copies, which load faster
   mesh.save("./orig.off");
+  mesh.save("./orig.bmesh");
   mesh.noiseMesh(0.006);
   mesh.save("./noisy.off");
+  mesh.save("./noisy.bmesh");
   
   DGP_CONSOLE << "Read mesh '" << mesh.getName() << "' with " << mesh.numVertices() << " vertices, " << mesh.numEdges()
               << " edges and " << mesh.numFaces() << " faces from " << in_path;
 
   Viewer viewer1;
   viewer1.setObject(&mesh,0.005,0.05);
+  viewer1.setMetrics(&metrics);
   viewer1.launch(argc, argv);
 
   // Viewer viewer2;